@@ -13,6 +13,7 @@
 #include <iostream>
 #include <fstream>
 #include <cmath>
+#include <algorithm>
 
 #include <boost/foreach.hpp>
 
@@ -22,10 +23,64 @@
 #include "DOMLauncher/I3DOM.h"
 #include "DOMLauncher/I3InIceDOM.h"
 #include "DOMLauncher/I3IceTopDOM.h"
+#include "DOMLauncher/PMTResponseSimulator.h"
+#ifdef USE_VUVUZELA
+#include "vuvuzela/Vuvuzela.h"
+#endif
 
 using namespace domlauncherutils;
 I3_MODULE(DOMLauncher);
 
+namespace{
+    ///A time ordered run of discriminator crossings of one DOM in a DCStream
+    struct DCRun{
+        DCRun(size_t d, size_t b, size_t e):dom(d),next(b),end(e){}
+        ///The index of the DOM
+        size_t dom;
+        ///The next crossing of the run and the end of the run
+        size_t next;
+        size_t end;
+    };
+
+    ///Orders DCRuns for a heap with the earliest next crossing on top. Ties go
+    ///to the DOM with the lower index, and then to the run appended first.
+    class LaterRun{
+    public:
+        LaterRun(const DCStream& stream):stream_(&stream){}
+        bool operator()(const DCRun& lhs, const DCRun& rhs) const{
+            double lt = (*stream_)[lhs.next].time, rt = (*stream_)[rhs.next].time;
+            if(lt != rt)
+                return lt > rt;
+            return lhs.dom > rhs.dom || (lhs.dom == rhs.dom && lhs.next > rhs.next);
+        }
+    private:
+        const DCStream* stream_;
+    };
+
+    ///Sets the parameters of a module run inside DOMLauncher, which uses the
+    ///random service of DOMLauncher unless they name another one.
+    void SetInternalConfig(I3Module& module, const boost::python::dict& config,
+                           const std::string& randomServiceName){
+        I3Configuration& moduleConfig = module.GetConfiguration();
+        moduleConfig.Set("RandomServiceName", boost::python::object(randomServiceName));
+        boost::python::list items = config.items();
+        for(boost::python::ssize_t i = 0; i < boost::python::len(items); i++){
+            std::string key = boost::python::extract<std::string>(items[i][0]);
+            moduleConfig.Set(key, items[i][1]);
+        }
+    }
+}
+
+struct DOMLauncher::DiscriminatorRuns{
+    DiscriminatorRuns():frameStart(DBL_MAX),frameEnd(-DBL_MAX){}
+    ///The discriminator crossings of all DOMs, and the time ordered run
+    ///of each DOM in it.
+    DCStream dcStream;
+    std::vector<DCRun> runs;
+    ///The times of the first and the last pulse of the frame.
+    double frameStart, frameEnd;
+};
+
 DOMLauncher::DOMLauncher(const I3Context& ctx)
   : I3ConditionalModule(ctx),
     domMapInitialized_(false),
@@ -74,6 +129,35 @@ DOMLauncher::DOMLauncher(const I3Context& ctx)
                 "Name of the random service in the context.",
                 randomServiceName_);
 
+    simulatePMTResponse_ = false;
+    AddParameter("SimulatePMTResponse","If the input is an I3MCPESeriesMap, to be run through "
+                "an internal PMTResponseSimulator DOM by DOM. This saves putting the "
+                "I3MCPulseSeriesMap in the frame and reading it back.",
+                simulatePMTResponse_);
+
+    AddParameter("PMTConfig","Parameters for the internal PMTResponseSimulator, as for the "
+                "module. Its RandomServiceName defaults to the one of this module.",
+                pmtConfig_);
+
+    pmtOutputName_ = "";
+    AddParameter("PMTOutput","If not empty, the name under which to also put the pulses of the "
+                "internal PMTResponseSimulator in the frame, with their I3ParticleIDMap.",
+                pmtOutputName_);
+
+    simulateNoise_ = false;
+    AddParameter("SimulateNoise","If noise should be added to the PEs of each DOM by an internal "
+                "Vuvuzela before the PMT simulation. Requires SimulatePMTResponse.",
+                simulateNoise_);
+
+    AddParameter("NoiseConfig","Parameters for the internal Vuvuzela, as for the module. Its "
+                "RandomServiceName defaults to the one of this module.",
+                noiseConfig_);
+
+    noiseOutputName_ = "";
+    AddParameter("NoiseOutput","If not empty, the name under which to also put the PEs with the "
+                "noise of the internal Vuvuzela in the frame.",
+                noiseOutputName_);
+
     AddOutBox("OutBox");
 }
 
@@ -88,11 +172,45 @@ void DOMLauncher::Configure(){
     GetParameter("MultiFrameEvents",multiFrameEvents_);
     GetParameter("BeaconLaunches",beaconLaunches_);
     GetParameter("BeaconLaunchRate",beaconLaunchRate_);
+    GetParameter("SimulatePMTResponse",simulatePMTResponse_);
+    GetParameter("PMTConfig",pmtConfig_);
+    GetParameter("PMTOutput",pmtOutputName_);
+    GetParameter("SimulateNoise",simulateNoise_);
+    GetParameter("NoiseConfig",noiseConfig_);
+    GetParameter("NoiseOutput",noiseOutputName_);
     
     I3DOM::beaconLaunchRate = beaconLaunchRate_;
     
     randomService_ = context_.Get<I3RandomServicePtr>(randomServiceName_);
     if(!randomService_) log_fatal("No random service available");
+
+    pmtResponse_.reset();
+    if(simulatePMTResponse_){
+        pmtResponse_.reset(new PMTResponseSimulator(context_));
+        SetInternalConfig(*pmtResponse_, pmtConfig_, randomServiceName_);
+        pmtResponse_->Configure();
+        if(pmtResponse_->getNumThreads() > 0)
+            log_warn("The internal PMTResponseSimulator processes the DOMs serially; "
+                     "NumThreads is ignored.");
+    }
+    else if(boost::python::len(pmtConfig_) > 0 || !pmtOutputName_.empty())
+        log_warn("PMTConfig and PMTOutput are only used with SimulatePMTResponse.");
+
+    noise_.reset();
+    if(simulateNoise_){
+        if(!simulatePMTResponse_)
+            log_fatal("SimulateNoise requires SimulatePMTResponse.");
+#ifdef USE_VUVUZELA
+        noise_.reset(new Vuvuzela(context_));
+        SetInternalConfig(*noise_, noiseConfig_, randomServiceName_);
+        noise_->GetConfiguration().Set("InputHitSeriesMapName", boost::python::object(mcPulseSeriesName_));
+        noise_->Configure();
+#else
+        log_fatal("SimulateNoise needs vuvuzela, which DOMLauncher was built without.");
+#endif
+    }
+    else if(boost::python::len(noiseConfig_) > 0 || !noiseOutputName_.empty())
+        log_warn("NoiseConfig and NoiseOutput are only used with SimulateNoise.");
 }
 
 void DOMLauncher::DetectorStatus(I3FramePtr frame){
@@ -117,50 +235,43 @@ void DOMLauncher::Calibration(I3FramePtr frame){
 }
 
 void DOMLauncher::DAQ(I3FramePtr frame){
-    // (Re-)Initializing the DOMMap if a new Geometry, Calibration,
-    // or a Detector frame has occured.
-    if(!domMapInitialized_) InitilizeDOMMap();
-
-    log_debug("Getting MCPulseSeries.");
-    I3MCPulseSeriesMapConstPtr pulseSeriesMap =
-        frame->Get<I3MCPulseSeriesMapConstPtr>(mcPulseSeriesName_);
-
-    if(!pulseSeriesMap){
-        log_debug("No I3MCPulseSeriesMap found in this frame...skipping.");
-        PushFrame(frame);
-        return;
-    }
-
-    log_debug("Simulating discriminators.");
-
-    domlauncherutils::DCStream dcStream;
-    // Simulating the discriminator and so determing the discriminator crossings for the entire
-    // event or more generally for an entire frame for each DOM.
-    double frameStart = DBL_MAX, frameEnd = -DBL_MAX;
-    
-    BOOST_FOREACH(I3MCPulseSeriesMap::const_reference kv_pair, *pulseSeriesMap){
-        const OMKey& omkey = kv_pair.first;
-        const I3MCPulseSeries& pulses = kv_pair.second;
-
-        I3DOMMap::iterator DOMit = domMap_.find(omkey);
-        if(DOMit != domMap_.end()){
-            //The frame end and start time is needed for calculating
-            //the time window of beacon launches.
-            if(!pulses.empty()){
-                int64_t end = pulses.size()-1;
-                frameStart = pulses[0].time < frameStart ? pulses[0].time:frameStart;
-                frameEnd   = pulses[end].time > frameEnd ? pulses[end].time:frameEnd;
-            }
-            
-            DOMit->second->Discriminator(pulses, dcStream);
-            activeDOMsMap_[omkey] = DOMit->second;
+    DiscriminatorRuns frameRuns;
+    I3MCPulseSeriesMapConstPtr pulseSeriesMap;
+    if(simulatePMTResponse_){
+        if(!SimulateDOMs(frame, frameRuns)){
+            log_debug("No PEs found in this frame...skipping.");
+            PushFrame(frame);
+            return;
         }
-        else{
-            log_fatal("PMT pulses exist on DOM %s, but there is no entry in the DOMMap.",
-                    omkey.str().c_str());
+    }
+    else{
+        // (Re-)Initializing the DOMMap if a new Geometry, Calibration,
+        // or a Detector frame has occured.
+        if(!domMapInitialized_) InitilizeDOMMap();
+
+        log_debug("Getting MCPulseSeries.");
+        pulseSeriesMap = frame->Get<I3MCPulseSeriesMapConstPtr>(mcPulseSeriesName_);
+        if(!pulseSeriesMap){
+            log_debug("No pulses found in this frame...skipping.");
+            PushFrame(frame);
+            return;
         }
+
+        log_debug("Simulating discriminators.");
+        // Simulating the discriminator and so determing the discriminator crossings for the entire
+        // event or more generally for an entire frame for each DOM.
+        // Both the pulse map and domKeys_ are ordered by OMKey, so each DOM
+        // is searched for only after the previous one.
+        std::vector<OMKey>::const_iterator keyIt = domKeys_.begin();
+        BOOST_FOREACH(I3MCPulseSeriesMap::const_reference kv_pair, *pulseSeriesMap)
+            Discriminate(FindDOM(keyIt, kv_pair.first), kv_pair.second, frameRuns);
     }
-    
+
+    // The discriminator crossings of each DOM, and its beacon launches, are appended
+    // to dcStream as time ordered runs.
+    DCStream& dcStream = frameRuns.dcStream;
+    std::vector<DCRun>& runs = frameRuns.runs;
+    const double frameStart = frameRuns.frameStart, frameEnd = frameRuns.frameEnd;
     
     if(frameEnd-frameStart> 60*I3Units::second){
         log_warn("MCPulses cover a time span larger than 1 minute (%lf min)",
@@ -169,9 +280,12 @@ void DOMLauncher::DAQ(I3FramePtr frame){
     //Adding beacon launches to the simulation.
     if(beaconLaunches_){
         log_debug("Adding beacon launches.");
-        BOOST_FOREACH(const I3DOMMap::value_type& pair, domMap_){
-            if(pair.second->AddBeaconLaunches(frameStart, frameEnd, dcStream))
-                activeDOMsMap_[pair.first] = pair.second;
+        for(size_t index = 0; index < domIndex_.size(); index++){
+            size_t begin = dcStream.size();
+            if(domIndex_[index]->AddBeaconLaunches(frameStart, frameEnd, dcStream)){
+                runs.push_back(DCRun(index, begin, dcStream.size()));
+                SetActive(index);
+            }
         }
     }
     
@@ -179,11 +293,9 @@ void DOMLauncher::DAQ(I3FramePtr frame){
 
     if(snMode_) DOTOutput(frame, dcStream);
 
-    log_debug("Time ordering discriminator crossings.");
-    sort(dcStream.begin(), dcStream.end(), domlauncherutils::detail::dcCompare);
     // The major part of the simulation takes place here. Triggers previously
     // simulated by the Discriminator() function of each I3DOM object have been
-    // put in triggerStream, which *needs* time ordered (sorted) so that it
+    // put in triggerStream, which *needs* time ordered so that it
     // becomes a stream. This stream is then fed back to the I3DOM objects which
     // when recieving a trigger depending on the information it gets from its
     // 'neighboring' I3DOM objects decides if it will launch and what kind of
@@ -191,24 +303,38 @@ void DOMLauncher::DAQ(I3FramePtr frame){
     // some triggers that haven't got any launch decision yet.  The main reason for
     // this happening is the way LC is working in the detector since it is in general
     // impossible to determine at launch time if the LC condition is true.
+    // Since every run is already time ordered, the stream is made by merging
+    // the runs with a heap ordered by the next crossing of each run.
     log_debug("Simulating LC logic.");
-    BOOST_FOREACH(DCStream::value_type& discrx, dcStream){
-        if(domMap_.find(discrx.DOM) != domMap_.end())
-        domMap_.at(discrx.DOM)->AddTrigger( discrx );
+    LaterRun later(dcStream);
+    std::make_heap(runs.begin(), runs.end(), later);
+    while(!runs.empty()){
+        std::pop_heap(runs.begin(), runs.end(), later);
+        DCRun& run = runs.back();
+        domIndex_[run.dom]->AddTrigger(dcStream[run.next]);
+        if(++run.next < run.end)
+            std::push_heap(runs.begin(), runs.end(), later);
+        else
+            runs.pop_back();
     }
     
+    // The DOMs are processed in OMKey order, as they were by the maps
+    // this replaced.
+    std::sort(activeDOMList_.begin(), activeDOMList_.end());
+
     log_debug("Finishing Frame and triggering trailing launches.");
     bool force = !multiFrameEvents_;
-    BOOST_FOREACH(const I3DOMMap::value_type& pair, activeDOMsMap_)
-        pair.second->TriggerLaunch(force);
+    BOOST_FOREACH(size_t index, activeDOMList_)
+        domIndex_[index]->TriggerLaunch(force);
 
     // Transfer all launches in the I3DOMMap to the output I3DOMLaunchSeriesMap
     log_debug("Gather DOMLaunches.");
     // This is the object to be filled and put in to frame
     I3DOMLaunchSeriesMapPtr launchMap(new I3DOMLaunchSeriesMap);
-    BOOST_FOREACH(const I3DOMMap::value_type& pair, activeDOMsMap_)
-        if(! pair.second->GetDOMLaunches().empty() )
-            (*launchMap)[pair.first] = pair.second->GetDOMLaunches();
+    BOOST_FOREACH(size_t index, activeDOMList_)
+        if(! domIndex_[index]->GetDOMLaunches().empty() )
+            launchMap->insert(launchMap->end(),
+                              std::make_pair(domKeys_[index], domIndex_[index]->GetDOMLaunches()));
 
     log_debug("Putting DOMLaunchSeriesMap to frame.");
     frame->Put(domLaunchMapName_, launchMap);
@@ -217,22 +343,178 @@ void DOMLauncher::DAQ(I3FramePtr frame){
     // I'm assuming the SN group wants to be able to combine consecutive
     // frames and doesn't want the DOMs reset on each pass.
     log_debug("Reseting the DOMMap.");
-    BOOST_FOREACH(const I3DOMMap::value_type& pair, activeDOMsMap_)
-        pair.second->Reset(!multiFrameEvents_);
-    // Removing inactive DOMs from the activeDOMsMap. 
-    std::map<OMKey, boost::shared_ptr<I3DOM> >::iterator itr = activeDOMsMap_.begin();
-    while (itr != activeDOMsMap_.end()) {
-        if (! itr->second->IsActive()) {
-            activeDOMsMap_.erase(itr++);
-        } else {
-            ++itr;
-        }
+    BOOST_FOREACH(size_t index, activeDOMList_)
+        domIndex_[index]->Reset(!multiFrameEvents_);
+    // Removing inactive DOMs from the active DOMs.
+    std::vector<size_t>::iterator keep = activeDOMList_.begin();
+    BOOST_FOREACH(size_t index, activeDOMList_){
+        if(domIndex_[index]->IsActive())
+            *keep++ = index;
+        else
+            activeDOMs_.reset(index);
     }
+    activeDOMList_.erase(keep, activeDOMList_.end());
         
     log_debug("Pushing frame.");
     PushFrame(frame, "OutBox");
 }
 
+void DOMLauncher::Discriminate(size_t index, const I3MCPulseSeries& pulses,
+                               DiscriminatorRuns& frameRuns){
+    //The frame end and start time is needed for calculating
+    //the time window of beacon launches.
+    if(!pulses.empty()){
+        frameRuns.frameStart = std::min(frameRuns.frameStart, pulses.front().time);
+        frameRuns.frameEnd   = std::max(frameRuns.frameEnd, pulses.back().time);
+    }
+
+    size_t begin = frameRuns.dcStream.size();
+    domIndex_[index]->Discriminator(pulses, frameRuns.dcStream);
+    if(frameRuns.dcStream.size() > begin)
+        frameRuns.runs.push_back(DCRun(index, begin, frameRuns.dcStream.size()));
+    SetActive(index);
+}
+
+size_t DOMLauncher::FindDOM(std::vector<OMKey>::const_iterator& hint, const OMKey& omkey) const{
+    hint = std::lower_bound(hint, domKeys_.end(), omkey);
+    if(hint == domKeys_.end() || *hint != omkey)
+        log_fatal("PMT pulses exist on DOM %s, but there is no entry in the DOMMap.",
+                omkey.str().c_str());
+    return hint - domKeys_.begin();
+}
+
+/**
+ * Does what a Vuvuzela, with SimulateNoise, and a PMTResponseSimulator in front
+ * of DOMLauncher would do, with the same random services, but one DOM at a time:
+ * the PEs of a DOM get their noise, are turned into pulses in the buffer of the
+ * DOM and go through its discriminator before the next DOM is simulated. The
+ * noise and pulses are only put in the frame if NoiseOutput and PMTOutput are set.
+ */
+bool DOMLauncher::SimulateDOMs(I3FramePtr frame, DiscriminatorRuns& frameRuns){
+    log_debug("Getting MCPESeries.");
+    I3MCPESeriesMapConstPtr peSeriesMap =
+        frame->Get<I3MCPESeriesMapConstPtr>(mcPulseSeriesName_);
+    if(!peSeriesMap){
+        if(!domMapInitialized_) InitilizeDOMMap();
+        return false;
+    }
+
+    // The DOMs Vuvuzela simulates noise for, in OMKey order
+    const std::vector<OMKey>* noiseDOMs = NULL;
+#ifdef USE_VUVUZELA
+    if(noise_){
+        noise_->BeginFrame(frame);
+        noiseDOMs = &noise_->GetGoodDOMs();
+    }
+#endif
+    I3MCPESeriesMapPtr noiseOutput;
+    if(noise_ && !noiseOutputName_.empty())
+        noiseOutput = I3MCPESeriesMapPtr(new I3MCPESeriesMap);
+    I3MCPulseSeriesMapPtr pmtOutput;
+    I3ParticleIDMapPtr pidOutput;
+    if(!pmtOutputName_.empty()){
+        pmtOutput = I3MCPulseSeriesMapPtr(new I3MCPulseSeriesMap);
+        pidOutput = I3ParticleIDMapPtr(new I3ParticleIDMap);
+    }
+
+    // (Re-)Initializing the DOMMap draws random numbers, which the separate
+    // modules do after all of the noise and PMT simulation. Until then the
+    // pulses are kept in a map and discriminated afterwards.
+    const bool deferDiscriminator = !domMapInitialized_;
+    I3MCPulseSeriesMap deferredPulses;
+
+    log_debug("Simulating PMT response and discriminators.");
+    // The PE map, the DOMs with noise and domKeys_ are all ordered by OMKey,
+    // so they are walked through together.
+    I3MCPESeriesMap::const_iterator signal = peSeriesMap->begin();
+    const I3MCPESeriesMap::const_iterator signalEnd = peSeriesMap->end();
+    size_t noiseIndex = 0;
+    const size_t nNoise = noiseDOMs ? noiseDOMs->size() : 0;
+    std::vector<OMKey>::const_iterator keyIt = domKeys_.begin();
+    while(signal != signalEnd || noiseIndex < nNoise){
+        const bool hasSignal = signal != signalEnd &&
+            (noiseIndex == nNoise || !((*noiseDOMs)[noiseIndex] < signal->first));
+        const bool hasNoise = noiseIndex < nNoise &&
+            (signal == signalEnd || !(signal->first < (*noiseDOMs)[noiseIndex]));
+        const OMKey omkey = hasSignal ? signal->first : (*noiseDOMs)[noiseIndex];
+        const I3MCPESeries* hits = hasSignal ? &signal->second : &hitBuffer_;
+        if(hasNoise){
+            // Every DOM gets its noise, to keep the buffers and random
+            // numbers of Vuvuzela in step
+            if(hasSignal)
+                hitBuffer_ = signal->second;
+            else
+                hitBuffer_.clear();
+#ifdef USE_VUVUZELA
+            noise_->AddDOMNoise(noiseIndex, hitBuffer_);
+#endif
+            noiseIndex++;
+            hits = &hitBuffer_;
+        }
+        if(hasSignal)
+            ++signal;
+
+        // Vuvuzela only adds the DOMs it made noise hits for
+        if(!hasSignal && hits->empty())
+            continue;
+        if(noiseOutput)
+            noiseOutput->insert(noiseOutput->end(), std::make_pair(omkey, *hits));
+
+        // Skip the same DOMs as PMTResponseSimulator. DAQ insists on
+        // the rest being in the DOMMap.
+        const I3DOMStatus* status;
+        const I3DOMCalibration* cal;
+        if(!pmtResponse_->selectDOM(omkey, *hits, domStatus_, domCal_, status, cal))
+            continue;
+
+        size_t index = 0;
+        I3MCPulseSeries* pulses;
+        if(deferDiscriminator)
+            pulses = &deferredPulses.insert(deferredPulses.end(),
+                                            std::make_pair(omkey, I3MCPulseSeries()))->second;
+        else{
+            index = FindDOM(keyIt, omkey);
+            pulses = &pulseBuffers_[index];
+        }
+        pmtResponse_->processHitsInto(*hits, omkey, *cal, *status, *pulses, particleBuffer_);
+        if(pmtOutput){
+            pmtOutput->insert(pmtOutput->end(), std::make_pair(omkey, *pulses));
+            pidOutput->insert(pidOutput->end(), std::make_pair(omkey, particleBuffer_));
+        }
+        if(!deferDiscriminator)
+            Discriminate(index, *pulses, frameRuns);
+    }
+#ifdef USE_VUVUZELA
+    if(noise_)
+        noise_->EndFrame();
+#endif
+
+    if(deferDiscriminator){
+        InitilizeDOMMap();
+        keyIt = domKeys_.begin();
+        BOOST_FOREACH(I3MCPulseSeriesMap::reference kv_pair, deferredPulses){
+            size_t index = FindDOM(keyIt, kv_pair.first);
+            pulseBuffers_[index].swap(kv_pair.second);
+            Discriminate(index, pulseBuffers_[index], frameRuns);
+        }
+    }
+
+    if(noiseOutput)
+        frame->Put(noiseOutputName_, noiseOutput);
+    if(pmtOutput){
+        frame->Put(pmtOutputName_, pmtOutput);
+        frame->Put(pmtOutputName_+"ParticleIDMap", pidOutput);
+    }
+    return true;
+}
+
+void DOMLauncher::SetActive(size_t index){
+    if(!activeDOMs_.test(index)){
+        activeDOMs_.set(index);
+        activeDOMList_.push_back(index);
+    }
+}
+
 /**
  * This function provides Discriminator Over Threshold (DOT) output, a feature which
  * was asked by the sn-wg group as they base their analysis on discriminator crossings.
@@ -320,6 +602,20 @@ void DOMLauncher::InitilizeDOMMap(){
         domMapIterator->second->CreateLCLinks(domMap_);
     }
 
+    domIndex_.clear();
+    domKeys_.clear();
+    BOOST_FOREACH(const I3DOMMap::value_type& pair, domMap_){
+        domKeys_.push_back(pair.first);
+        domIndex_.push_back(pair.second);
+    }
+    activeDOMs_.clear();
+    activeDOMs_.resize(domIndex_.size());
+    activeDOMList_.clear();
+    if(simulatePMTResponse_){
+        pulseBuffers_.clear();
+        pulseBuffers_.resize(domIndex_.size());
+    }
+
     domMapInitialized_ = true;
     log_debug("Done initializing.");
 }
@@ -706,16 +706,14 @@ bool I3DOM::ATWDDigitization(const DiscCross& discrx,
     //Making sure the array is reset to zero
     for(uint i = 0; i < nATWDBins; i++) analogReadOut[i] = 0;
 
-    //filling raw waveform
-    for(uint i = 0; i < nATWDBins; i++){
-        double binTime = discrx.time + (i+1) * binLength;
-        double t = binTime - transitDeltaTime;
-        analogReadOut[i] +=  norm * waveform_.WaveFormAmplitude(t,atwdSPETemplate);
-    }
+    //filling raw waveform, sampled at the end of each bin
+    waveform_.WaveFormAmplitudes(discrx.time + binLength - transitDeltaTime, binLength, nATWDBins,
+                                 atwdSPETemplate, analogReadOut);
     digitizedReadOut.resize(nATWDBins);
 
     //digitizing waveform
     for( uint64_t i = 0; i < nATWDBins; i++){
+        analogReadOut[i] *= norm;
         analogReadOut[i] /= domCal_.atwdBinCalib[chip][channel][i];//convert to number of counts
         // Adding electronic noise. The parameters are taken from the old DOMSimulator.
         analogReadOut[i] += rng_->Gaus(ATWDNoiseMean, ATWDNoiseVariance);
@@ -749,14 +747,13 @@ void I3DOM::FADCDigitization(const DiscCross& discrx,
     }//making sure the waveform is reset to zero.
 
 
-    for(uint i = 0; i < nFADCBins; i++){
-        double binTime = discrx.time + (i+1)*binLength;
-        double t = binTime - transitDeltaTime;
-        analogReadOut[i] += norm * waveform_.WaveFormAmplitude(t,*fadcSPETemplatePtr_);
-    }
+    //filling raw waveform, sampled at the end of each bin
+    waveform_.WaveFormAmplitudes(discrx.time + binLength - transitDeltaTime, binLength, nFADCBins,
+                                 *fadcSPETemplatePtr_, analogReadOut);
     digitizedReadOut.resize(nFADCBins);
     //digitizing waveform
     for( uint i = 0; i < nFADCBins; i++){
+        analogReadOut[i] *= norm;
         analogReadOut[i] /= gain;// convert from GV to counts
         analogReadOut[i] += domCal_.fadcBeaconBaseline;// add baseline (in counts)
         // Adding electronic noise. The parameters are taken from the old DOMSimulator.
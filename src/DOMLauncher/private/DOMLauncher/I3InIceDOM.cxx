@@ -129,15 +129,13 @@ void I3InIceDOM::MakeCoarseChargeStamp(const dlud::DiscCross& discrx,
         for(uint i = 0; i < nFADCCoarseChargeStampBins; i++) analogReadOut[i] = 0;
     
 
-      for(uint i = 0; i < nFADCCoarseChargeStampBins; i++){
-        double binTime = discrx.time + (i+1)*binLength;
-        double t = binTime - transitDeltaTime;
-        analogReadOut[i] += norm * waveform_.WaveFormAmplitude(t,*fadcSPETemplatePtr_);         
-      }
+      waveform_.WaveFormAmplitudes(discrx.time + binLength - transitDeltaTime, binLength,
+                                   nFADCCoarseChargeStampBins, *fadcSPETemplatePtr_, analogReadOut);
 
       //digitizing waveform
       for( uint i = 0; i < nFADCCoarseChargeStampBins; i++){
 
+         analogReadOut[i] *= norm;
          // convert from GV to counts
          analogReadOut[i] /= gain;
          // Adding electronic noise. The parameters are taken from the old DOMSimulator.
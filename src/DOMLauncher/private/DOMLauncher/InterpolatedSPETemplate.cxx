@@ -1,5 +1,7 @@
 #include "DOMLauncher/InterpolatedSPETemplate.h"
 
+#include <cmath>
+
 using namespace std;
 
 void InterpolatedSPETemplate::Tabulate(int nDenseSteps,
@@ -69,6 +71,64 @@ void InterpolatedSPETemplate::Tabulate(int nDenseSteps,
   }
 }
 
+namespace{
+  ///The first of the indices begin ... n-1 for which t+i*dt is not before boundary
+  unsigned regionEnd(double t, double dt, unsigned begin, unsigned n, double boundary){
+    double guess = std::ceil((boundary - t)/dt);
+    unsigned i = (!(guess > begin)) ? begin : (guess > n) ? n : unsigned(guess);
+    while(i > begin && !(t + (i-1)*dt < boundary))
+      i--;
+    while(i < n && t + i*dt < boundary)
+      i++;
+    return i;
+  }
+}
+
+void InterpolatedSPETemplate::Accumulate(double t, double dt, unsigned n, double scale, double* out){
+  if(!hasTabulated_){
+    for(unsigned i = 0; i < n; i++)
+      out[i] += scale * pulseTemplate_(t + i*dt);
+    return;
+  }
+
+  //for causality reasons the pulse template is defined to be zero for t<startPoint_
+  unsigned i = regionEnd(t, dt, 0, n, startPoint_);
+
+  //dense linear region
+  unsigned end = regionEnd(t, dt, i, n, changePointLinear_);
+  for(; i < end; i++){
+    double ti = t + i*dt;
+    uint64_t lowerIndex = uint64_t((ti - startPoint_ ) * invDenseStepSize_);
+    out[i] += scale * (tabulatedPulseDerivative_[lowerIndex] * (ti - lowerIndex * denseStepSize_ - startPoint_) +
+                       tabulatedPulse_[lowerIndex]);
+  }
+
+  //coarse linear region
+  end = regionEnd(t, dt, i, n, changePointQuadratic_);
+  for(; i < end; i++){
+    double ti = t + i*dt;
+    uint64_t internalIndex = uint64_t((ti - changePointLinear_) * invCoarseStepSize_);
+    uint lowerIndex = internalIndex + nDenseSteps_ - 1;
+    out[i] += scale * (tabulatedPulseDerivative_[lowerIndex] *
+                       (ti - coarseStepSize_ * internalIndex - changePointLinear_) + tabulatedPulse_[lowerIndex]);
+  }
+
+  //quadratic region
+  end = regionEnd(t, dt, i, n, endPoint_);
+  for(; i < end; i++){
+    double ti = t + i*dt;
+    uint64_t internalIndex =  uint64_t(sqrt( (ti - changePointQuadratic_) * invQuadraticStepScale_));
+    uint64_t lowerIndex = uint64_t(internalIndex + nDenseSteps_ + nCoarseSteps_ - 1 );
+    out[i] += scale * (tabulatedPulseDerivative_[lowerIndex] *
+                       (ti - (internalIndex) * (internalIndex) * quadraticStepScale_ - changePointQuadratic_) +
+                       tabulatedPulse_[lowerIndex]);
+  }
+
+  //beyond the tabulation
+  for(; i < n; i++)
+    out[i] += scale * pulseTemplate_(t + i*dt);
+}
+
 double InterpolatedSPETemplate::TabulationError(){
   double t=0;
   double stepSize=0.1;
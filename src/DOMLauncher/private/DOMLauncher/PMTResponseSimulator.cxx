@@ -9,6 +9,7 @@
 
 #include <boost/make_shared.hpp>
 #include <boost/math/constants/constants.hpp>
+#include <boost/thread.hpp>
 
 #include <icetray/I3Units.h>
 #include <simclasses/I3MCPE.h>
@@ -16,6 +17,7 @@
 #include <simclasses/I3ParticleIDMap.hpp>
 #include <dataclasses/status/I3DetectorStatus.h>
 #include <dataclasses/calibration/I3Calibration.h>
+#include <phys-services/I3PhiloxRandomService.h>
 
 #include "discreteDistribution.h"
 
@@ -35,7 +37,8 @@ afterPulseProbability_(0.0593), //http://icecube.wisc.edu/~chwendt/afterpulse-no
 applySaturation_(true),
 mergeHits_(true),
 lowMem_(false),
-randomServiceName_("I3RandomService")
+randomServiceName_("I3RandomService"),
+numThreads_(0)
 {
 	//For use if module description strings become supported in icetray
 	/*SetDescription("A module which simulates the behaviour of a PMT\n"
@@ -91,6 +94,13 @@ randomServiceName_("I3RandomService")
 	AddParameter("RandomServiceName",
 		     "Name of the random service in the context.",
 		     randomServiceName_);
+	AddParameter("NumThreads",
+	             "The number of threads among which to divide the DOMs of each frame. "
+	             "If zero, the DOMs are processed one after another with random numbers drawn "
+	             "directly from the random service. Otherwise each DOM draws from its own "
+	             "substream, seeded once per frame from the random service, so that the "
+	             "output is the same for any number of threads.",
+	             numThreads_);
 	AddOutBox("OutBox");
 }
 
@@ -108,6 +118,7 @@ void PMTResponseSimulator::Configure(){
 	GetParameter("MergeHits",mergeHits_);
 	GetParameter("LowMem",lowMem_);
 	GetParameter("RandomServiceName",randomServiceName_);
+	GetParameter("NumThreads",numThreads_);
 	randomService_ = context_.Get<I3RandomServicePtr>(randomServiceName_);
 	if(!randomService_)
 		log_fatal("No random service available");
@@ -172,43 +183,37 @@ void PMTResponseSimulator::DAQ(I3FramePtr frame){
 
 	I3ParticleIDMapPtr outputPIDMap(new I3ParticleIDMap());
 	I3MCPulseSeriesMapPtr outputPulses(new I3MCPulseSeriesMap());
+	std::vector<domWork> work;
 
 	//iterate over DOMs
 	for(I3Map<OMKey,std::vector<I3MCPE> >::const_iterator domIt=inputHits->begin(), domEnd=inputHits->end();
 	    domIt!=domEnd; domIt++){
-		std::map<OMKey,I3DOMStatus>::const_iterator omStatus=detStatus->domStatus.find(domIt->first);
-		if(omStatus==detStatus->domStatus.end()){
-			log_debug_stream("No detector status record for " << domIt->first);
+		const I3DOMStatus* omStatus;
+		const I3DOMCalibration* omCalibration;
+		if(!selectDOM(domIt->first, domIt->second, detStatus->domStatus, calibration->domCal,
+		              omStatus, omCalibration))
 			continue;
-		}
-
-		const double pmtVoltage=omStatus->second.pmtHV;
-		if(pmtVoltage==0.0){
-			log_debug_stream("Ignoring hits in DOM with voltage set to zero (" << domIt->first << ')');
-			continue;
-		}
 
-		std::map<OMKey, I3DOMCalibration>::const_iterator omCalibration=calibration->domCal.find(domIt->first);
-		if(omCalibration==calibration->domCal.end()){
-			log_warn_stream("No calibration record for " << domIt->first);
-			continue;
+		if(numThreads_==0){
+			std::pair<std::vector<I3MCPulse>, ParticlePulseIndexMap> pulses=
+			processHits(domIt->second, domIt->first, *omCalibration, *omStatus);
+			outputPulses->insert(std::make_pair(domIt->first,pulses.first));
+			outputPIDMap->insert(std::make_pair(domIt->first,pulses.second));
 		}
+		else
+			work.push_back(domWork(domIt, *omCalibration, *omStatus));
+	} //end of iteration over DOMs
 
-		if(pmtVoltage<0.0 || std::isnan(pmtVoltage)){
-			log_warn_stream("Ignoring hits in DOM with nonsensical voltage (" << pmtVoltage << ')');
-			continue;
-		}
-		
-		if(domIt->second.empty()){
-			log_trace_stream("Ignoring DOM with zero hits but with a PE map entry (" << domIt->first << ')');
-			continue;
+	if(!work.empty()){
+		processDOMsInParallel(work);
+		//the work items are in map order, so each insertion goes at the end
+		for(std::vector<domWork>::iterator it=work.begin(), end=work.end(); it!=end; it++){
+			outputPulses->insert(outputPulses->end(),std::make_pair(it->dom->first,std::vector<I3MCPulse>()))
+			  ->second.swap(it->result.first);
+			outputPIDMap->insert(outputPIDMap->end(),std::make_pair(it->dom->first,ParticlePulseIndexMap()))
+			  ->second.swap(it->result.second);
 		}
-
-		std::pair<std::vector<I3MCPulse>, ParticlePulseIndexMap> pulses=
-		processHits(domIt->second, domIt->first, omCalibration->second, omStatus->second);
-		outputPulses->insert(std::make_pair(domIt->first,pulses.first));
-		outputPIDMap->insert(std::make_pair(domIt->first,pulses.second));
-	} //end of iteration over DOMs
+	}
 
 	frame->Put(outputHitsName_,outputPulses);
 	frame->Put(outputHitsName_+"ParticleIDMap",outputPIDMap);
@@ -220,13 +225,119 @@ void PMTResponseSimulator::DAQ(I3FramePtr frame){
 	PushFrame(frame);
 }
 
+bool PMTResponseSimulator::selectDOM(const OMKey& dom, const std::vector<I3MCPE>& hits,
+                                     const std::map<OMKey,I3DOMStatus>& domStatus,
+                                     const std::map<OMKey,I3DOMCalibration>& domCal,
+                                     const I3DOMStatus*& status, const I3DOMCalibration*& cal) const{
+	std::map<OMKey,I3DOMStatus>::const_iterator omStatus=domStatus.find(dom);
+	if(omStatus==domStatus.end()){
+		log_debug_stream("No detector status record for " << dom);
+		return(false);
+	}
+
+	const double pmtVoltage=omStatus->second.pmtHV;
+	if(pmtVoltage==0.0){
+		log_debug_stream("Ignoring hits in DOM with voltage set to zero (" << dom << ')');
+		return(false);
+	}
+
+	std::map<OMKey, I3DOMCalibration>::const_iterator omCalibration=domCal.find(dom);
+	if(omCalibration==domCal.end()){
+		log_warn_stream("No calibration record for " << dom);
+		return(false);
+	}
+
+	if(pmtVoltage<0.0 || std::isnan(pmtVoltage)){
+		log_warn_stream("Ignoring hits in DOM with nonsensical voltage (" << pmtVoltage << ')');
+		return(false);
+	}
+
+	if(hits.empty()){
+		log_trace_stream("Ignoring DOM with zero hits but with a PE map entry (" << dom << ')');
+		return(false);
+	}
+
+	status=&omStatus->second;
+	cal=&omCalibration->second;
+	return(true);
+}
+
+namespace{
+	///The substream number of a DOM, unique for every PMT
+	uint64_t domStreamID(const OMKey& dom){
+		return((uint64_t(uint32_t(dom.GetString()))<<32) | (uint64_t(dom.GetOM())<<8) | dom.GetPMT());
+	}
+}
+
+void PMTResponseSimulator::processDOMsInParallel(std::vector<domWork>& work){
+	//draw one seed per frame from the main service; everything else depends
+	//only on it and on the DOM, not on which thread processes which DOM
+	const uint32_t maxInt=std::numeric_limits<uint32_t>::max();
+	uint64_t seed=randomService_->Integer(maxInt);
+	seed=(seed<<32) | randomService_->Integer(maxInt);
+
+	workQueue queue(*this,work,seed);
+	unsigned int nThreads=std::min<size_t>(numThreads_,work.size());
+	if(nThreads<=1)
+		queue();
+	else{
+		boost::thread_group threads;
+		for(unsigned int i=0; i<nThreads; i++)
+			threads.create_thread(boost::ref(queue));
+		threads.join_all();
+	}
+	if(!queue.error.empty())
+		log_fatal_stream("Processing DOMs failed: " << queue.error);
+}
+
+PMTResponseSimulator::workQueue::workQueue(const PMTResponseSimulator& sim,
+                                           std::vector<domWork>& work, uint64_t seed):
+sim(sim),work(work),seed(seed),next(0){}
+
+void PMTResponseSimulator::workQueue::operator()(){
+	while(true){
+		size_t index;
+		{
+			boost::lock_guard<boost::mutex> lock(mutex);
+			if(next>=work.size() || !error.empty())
+				return;
+			index=next++;
+		}
+		domWork& item=work[index];
+		try{
+			I3PhiloxRandomService rng(seed,domStreamID(item.dom->first));
+			sim.generatePulses(item.dom->second, item.dom->first, *item.cal, *item.status, rng,
+			                   item.result.first, item.result.second);
+		}catch(std::exception& ex){
+			boost::lock_guard<boost::mutex> lock(mutex);
+			if(error.empty())
+				error=ex.what();
+			return;
+		}
+	}
+}
+
 std::pair<std::vector<I3MCPulse>, ParticlePulseIndexMap>
 PMTResponseSimulator::processHits(const std::vector<I3MCPE>& inputHits, OMKey dom,
                                   const I3DOMCalibration& calibration, const I3DOMStatus& status){
-	//std::cout << dom << " has " << inputHits.size() << " input hits" << std::endl;
 	std::pair<std::vector<I3MCPulse>, ParticlePulseIndexMap> result;
-	std::vector<I3MCPulse>& outputHits=result.first;
-	ParticlePulseIndexMap& particleMap=result.second;
+	generatePulses(inputHits, dom, calibration, status, *randomService_, result.first, result.second);
+	return(result);
+}
+
+void PMTResponseSimulator::processHitsInto(const std::vector<I3MCPE>& inputHits, OMKey dom,
+                                           const I3DOMCalibration& calibration, const I3DOMStatus& status,
+                                           std::vector<I3MCPulse>& outputHits, ParticlePulseIndexMap& particleMap){
+	generatePulses(inputHits, dom, calibration, status, *randomService_, outputHits, particleMap);
+}
+
+void PMTResponseSimulator::generatePulses(const std::vector<I3MCPE>& inputHits, OMKey dom,
+                                          const I3DOMCalibration& calibration, const I3DOMStatus& status,
+                                          I3RandomService& rng, std::vector<I3MCPulse>& outputHits,
+                                          ParticlePulseIndexMap& particleMap) const{
+	//std::cout << dom << " has " << inputHits.size() << " input hits" << std::endl;
+	outputHits.clear();
+	particleMap.clear();
 	//std::vector<I3MCPE> outputHits;
 
 	const double pmtVoltage=status.pmtHV;
@@ -246,22 +357,22 @@ PMTResponseSimulator::processHits(const std::vector<I3MCPE>& inputHits, OMKey do
 			I3MCPulse pulse;
 			pulse.time=hitIt->time;
 			//decide randomly which kind of hit to make
-			double ran=randomService_->Uniform(1);
+			double ran=rng.Uniform(1);
 			if(ran<(1.-prePulseProbability_-latePulseProbability_)){ //regular pulse
 				log_trace("creating an SPE");
 				pulse.source=I3MCPulse::PE;
-				pulse.charge=normalHitWeight(1,dom);
-				pulse.time+=PMTJitter();
+				pulse.charge=normalHitWeight(1,dom,rng);
+				pulse.time+=PMTJitter(rng);
 			}
 			else if(ran<(1.-latePulseProbability_)){ //prepulse
 				log_trace("creating a prepulse");
 				pulse.source=I3MCPulse::PRE_PULSE;
 				pulse.charge=prePulseWeight(pmtVoltage);
-				pulse.time+=PMTJitter()+prePulseTimeShift(pmtVoltage);
+				pulse.time+=PMTJitter(rng)+prePulseTimeShift(pmtVoltage);
 			}
 			else{ //late pulse
 				log_trace("creating a late pulse");
-				createLatePulse(pulse,dom,pmtVoltage);
+				createLatePulse(pulse,dom,pmtVoltage,rng);
 			}
 			outputHits.push_back(pulse);
 			particleMap[pid].push_back(pulseIndex++);
@@ -270,11 +381,11 @@ PMTResponseSimulator::processHits(const std::vector<I3MCPE>& inputHits, OMKey do
 			//each additional afterpulse should have its time be defined relative
 			//to the hit which generates it, rather than raltive to the original hit
 			double afterpulseBaseTime=hitIt->time;
-			while(randomService_->Uniform(1)<afterPulseProbability_){
+			while(rng.Uniform(1)<afterPulseProbability_){
 				log_trace("adding an afterpulse");
 				I3MCPulse afterPulse;
 				afterPulse.time=afterpulseBaseTime; //use the parent hit's time
-				createAfterPulse(afterPulse,dom,pmtVoltage);
+				createAfterPulse(afterPulse,dom,pmtVoltage,rng);
 				afterpulseBaseTime=afterPulse.time; //set the base time for a possible subsidiary afterpulse
 				outputHits.push_back(afterPulse);
 				particleMap[pid].push_back(pulseIndex++);
@@ -299,18 +410,16 @@ PMTResponseSimulator::processHits(const std::vector<I3MCPE>& inputHits, OMKey do
 		timeMergeHits(outputHits,particleMap);
 		//std::cout << dom << " has " << outputHits.size() << " output hits after merging" << std::endl;
 	}
-	return(result);
 }
 
-double PMTResponseSimulator::normalHitWeight(unsigned int w, OMKey om){
+double PMTResponseSimulator::normalHitWeight(unsigned int w, OMKey om, I3RandomService& rng) const{
 	if(!useSPEDistribution_)
 		return(w);
 	std::map<OMKey, boost::shared_ptr<I3SumGenerator> >::const_iterator dist=chargeDistributions_.find(om);
-	if(dist==chargeDistributions_.end()){ //did not find this OM
+	if(dist==chargeDistributions_.end()) //did not find this OM
 		//TODO: use actual calibration data for the DOM in question
-		dist=chargeDistributions_.insert(std::make_pair(om,genericChargeDistribution_)).first;
-	}
-	return(dist->second->Generate(w));
+		return(genericChargeDistribution_->Generate(w,rng));
+	return(dist->second->Generate(w,rng));
 }
 
 //Taken directly from the I3HitMaker code
@@ -321,7 +430,7 @@ double PMTResponseSimulator::normalHitWeight(unsigned int w, OMKey om){
  * at 1345 [V] during DFL studies by C. Wendt. The fits were
  * performed by R. Porrata.
  */
-double PMTResponseSimulator::PMTJitter(){
+double PMTResponseSimulator::PMTJitter(I3RandomService& rng) const{
 	if(!usePMTJitter_)
 		return(0.0);
 
@@ -330,24 +439,24 @@ double PMTResponseSimulator::PMTJitter(){
 	const double ln_time_upper_bound=0.999998;
 	const double ln_time_lower_bound=1e-7;
 
-	return(fisherTippett(mu,beta,ln_time_lower_bound,ln_time_upper_bound));
+	return(fisherTippett(mu,beta,ln_time_lower_bound,ln_time_upper_bound,rng));
 }
 
 //Time shift formula taken from HitMaker
-double PMTResponseSimulator::prePulseTimeShift(double voltage){
+double PMTResponseSimulator::prePulseTimeShift(double voltage) const{
 	const double reference_time=31.8; //ns
 	const double reference_voltage=1345.*I3Units::volt; //V
 	return(-reference_time*sqrt(reference_voltage/voltage));
 }
 
-double PMTResponseSimulator::prePulseWeight(double voltage){
+double PMTResponseSimulator::prePulseWeight(double voltage) const{
 	if(!useSPEDistribution_)
 		return(1.0);
 	return(1/20.);
 }
 
 //Weighting formula taken from pmt-simulator
-double PMTResponseSimulator::earlyAfterPulseWeight(){
+double PMTResponseSimulator::earlyAfterPulseWeight(I3RandomService& rng) const{
 	if(!useSPEDistribution_)
 		return(1.0);
 	//Fisher-Tippett fit to Early Afterpulse Charge distribtion, peaks 2 and 3.
@@ -361,7 +470,7 @@ double PMTResponseSimulator::earlyAfterPulseWeight(){
 	const double ln_charge_lower_bound=1e-20;
 	//Lower bound of charge distribution corresponding to 3.33 PE
 	const double ln_charge_upper_bound=0.94883;
-	return(fisherTippett(peak_charge,charge_spread,ln_charge_lower_bound,ln_charge_upper_bound));
+	return(fisherTippett(peak_charge,charge_spread,ln_charge_lower_bound,ln_charge_upper_bound,rng));
 }
 
 struct pulseComponent{
@@ -376,7 +485,7 @@ struct pulseComponent{
 //This suggests to the compiler that var is 'used', suppressing unhelpful warnings
 #define used_var(var) while(0){ var++; }
 
-void PMTResponseSimulator::createLatePulse(I3MCPulse& hit, OMKey om, double voltage){
+void PMTResponseSimulator::createLatePulse(I3MCPulse& hit, OMKey om, double voltage, I3RandomService& rng) const{
 	//data for different types of late pulses
 	const static unsigned int nComponents=5;
 	const static pulseComponent pulseTypes[nComponents]={
@@ -395,7 +504,7 @@ void PMTResponseSimulator::createLatePulse(I3MCPulse& hit, OMKey om, double volt
 	static discrete_distribution dist(probabilities,probabilities+nComponents);
 
 	//decide which type of pulse to generate, randomly
-	random_adapter gen(randomService_.get());
+	random_adapter gen(&rng);
 	unsigned int index=dist(gen);
 	const pulseComponent& pulseType=pulseTypes[index];
 	hit.source=pulseType.source;
@@ -406,14 +515,14 @@ void PMTResponseSimulator::createLatePulse(I3MCPulse& hit, OMKey om, double volt
 	const double ln_time_upper_bound=0.999998;
 
 	double timeDelay=0.0;
-	timeDelay = fisherTippett(pulseType.location,pulseType.scale,ln_time_lower_bound,ln_time_upper_bound);
+	timeDelay = fisherTippett(pulseType.location,pulseType.scale,ln_time_lower_bound,ln_time_upper_bound,rng);
 	timeDelay *= sqrt(referenceVoltage/voltage);
 	hit.time+=timeDelay;
 
-	hit.charge=normalHitWeight(1,om);
+	hit.charge=normalHitWeight(1,om,rng);
 }
 
-void PMTResponseSimulator::createAfterPulse(I3MCPulse& hit, OMKey om, double voltage){
+void PMTResponseSimulator::createAfterPulse(I3MCPulse& hit, OMKey om, double voltage, I3RandomService& rng) const{
 	const static unsigned int nComponents=11;
 	//From hit-maker; should be derived from https://wiki.icecube.wisc.edu/index.php/Afterpulse_Data
 	//Note that early after pulse components produce multiple p.e. of charge, so
@@ -441,7 +550,7 @@ void PMTResponseSimulator::createAfterPulse(I3MCPulse& hit, OMKey om, double vol
 	static discrete_distribution dist(probabilities,probabilities+nComponents);
 
 	//decide which type of pulse to generate, randomly
-	random_adapter gen(randomService_.get());
+	random_adapter gen(&rng);
 	unsigned int index=dist(gen);
 	const pulseComponent& pulseType=pulseTypes[index];
 	hit.source=pulseType.source;
@@ -449,14 +558,14 @@ void PMTResponseSimulator::createAfterPulse(I3MCPulse& hit, OMKey om, double vol
 	const double referenceVoltage = 1345*I3Units::V;
 	double timeDelay=0.0;
 	while(timeDelay<=0.0)
-		timeDelay=randomService_->Gaus(pulseType.location,pulseType.scale);
+		timeDelay=rng.Gaus(pulseType.location,pulseType.scale);
 	timeDelay *= sqrt(referenceVoltage/voltage);
 	hit.time+=timeDelay;
 
 	if(pulseType.source==I3MCPulse::EARLY_AFTER_PULSE)
-		hit.charge=earlyAfterPulseWeight();
+		hit.charge=earlyAfterPulseWeight(rng);
 	else
-		hit.charge=normalHitWeight(1,om);
+		hit.charge=normalHitWeight(1,om,rng);
 }
 
 namespace{
@@ -581,7 +690,7 @@ public:
 	}
 };
 
-void PMTResponseSimulator::saturate(std::vector<I3MCPulse>& hits, double pmtVoltage, const I3DOMCalibration& cal){
+void PMTResponseSimulator::saturate(std::vector<I3MCPulse>& hits, double pmtVoltage, const I3DOMCalibration& cal) const{
 	if(hits.empty())
 		return;
 	const double log10Gain = cal.GetHVGainFit().slope*log10(pmtVoltage/I3Units::V)+cal.GetHVGainFit().intercept;
@@ -631,8 +740,9 @@ void PMTResponseSimulator::saturate(std::vector<I3MCPulse>& hits, double pmtVolt
 }
 
 double PMTResponseSimulator::fisherTippett(double location, double scale,
-                                           double logLowerBound, double logUpperBound){
-	return(location - scale * log(-log(randomService_->Uniform(logLowerBound,logUpperBound))));
+                                           double logLowerBound, double logUpperBound,
+                                           I3RandomService& rng) const{
+	return(location - scale * log(-log(rng.Uniform(logLowerBound,logUpperBound))));
 }
 
 PMTResponseSimulator::pmtChargeDistribution::pmtChargeDistribution(double exp_width_,
@@ -0,0 +1,184 @@
+#include <I3Test.h>
+#include <icetray/I3Tray.h>
+#include <dataclasses/geometry/I3Geometry.h>
+#include <dataclasses/calibration/I3Calibration.h>
+#include <dataclasses/status/I3DetectorStatus.h>
+#include <dataclasses/physics/I3DOMLaunch.h>
+#include <dataclasses/I3DOMFunctions.h>
+#include <simclasses/I3MCPE.h>
+#include <boost/foreach.hpp>
+#include <boost/python/dict.hpp>
+
+/* This test checks that DOMLauncher with SimulatePMTResponse makes the same
+launches as PMTResponseSimulator followed by DOMLauncher, when both start from
+the same seed, and likewise with SimulateNoise and Vuvuzela in front. The first
+frame after the GCD frames is included, since the DOMs draw random numbers of
+their own when they are configured. The noise has a random service of its own,
+as the fused module simulates the noise of each DOM just before its PMT. */
+
+TEST_GROUP(FusedPMTResponse);
+
+namespace{
+  ///The launches of each DAQ frame, by the name of the module which collected them
+  std::map<std::string, std::vector<I3DOMLaunchSeriesMap> > collectedLaunches;
+}
+
+class PEGenerator : public I3Module{
+private:
+        unsigned int frameCount;
+public:
+        PEGenerator(const I3Context& context):
+        I3Module(context),
+        frameCount(0){
+                AddOutBox("OutBox");
+        }
+
+        virtual void DAQ(boost::shared_ptr<I3Frame> frame){
+                const I3Geometry& geo=frame->Get<I3Geometry>();
+                const I3Calibration& cal=frame->Get<I3Calibration>();
+                const I3DetectorStatus& det=frame->Get<I3DetectorStatus>();
+                const I3Vector<OMKey> bad=frame->Get<I3Vector<OMKey> >("BadDomsList");
+                I3MCPESeriesMapPtr hits(new I3MCPESeriesMap);
+
+                for(I3Map<OMKey, I3OMGeo>::const_iterator domgeo=geo.omgeo.begin(), geoend=geo.omgeo.end(); domgeo!=geoend; domgeo++){
+                        //a light front moving down strings 41 to 43, including their IceTop DOMs
+                        const OMKey& om=domgeo->first;
+                        if(om.GetString()<41 || om.GetString()>43 || om.GetOM()>64)
+                                continue;
+                        if(std::find(bad.begin(),bad.end(),om)!=bad.end())
+                                continue;
+                        double gain=PMTGain(det.domStatus.find(om)->second,cal.domCal.find(om)->second);
+                        if(gain==0.0 || std::isnan(gain))
+                                continue;
+                        std::vector<I3MCPE>& domHits=(*hits)[om];
+                        for(unsigned int i=0; i<(om.GetOM()+frameCount)%7; i++){
+                                I3MCPE hit;
+                                hit.time=1000.0*frameCount+20.0*om.GetOM()+3.0*i*i;
+                                hit.npe=1+i%3;
+                                domHits.push_back(hit);
+                        }
+                }
+
+                frame->Put("I3MCPESeriesMap",hits);
+                PushFrame(frame);
+                frameCount++;
+        }
+};
+I3_MODULE(PEGenerator)
+
+class LaunchCollector : public I3Module{
+public:
+        LaunchCollector(const I3Context& context):I3Module(context){
+                AddOutBox("OutBox");
+        }
+
+        virtual void DAQ(boost::shared_ptr<I3Frame> frame){
+                collectedLaunches[GetName()].push_back(frame->Get<I3DOMLaunchSeriesMap>("InIceRawData"));
+                PushFrame(frame);
+        }
+};
+I3_MODULE(LaunchCollector)
+
+namespace{
+  const unsigned int nFrames=10;
+
+  void RunTray(bool fused, bool noise){
+        std::string I3_TESTDATA;
+        if(getenv("I3_TESTDATA") != NULL) {
+          I3_TESTDATA = std::string(getenv("I3_TESTDATA"));
+        }else{
+          ENSURE( false, "Neither I3_PORTS nor I3_TESTDATA is defined! On of them must be...");
+        }
+
+        I3Tray tray;
+        tray.AddService("I3GSLRandomServiceFactory","rng")
+          ("Seed",5);
+        tray.AddService("I3GSLRandomServiceFactory","noiseRng")
+          ("Seed",7)
+          ("InstallServiceAs","NoiseRandom");
+        tray.AddModule("I3InfiniteSource","FrameMaker")
+          ("Stream",I3Frame::DAQ)
+          ("Prefix", I3_TESTDATA + std::string("/sim/GeoCalibDetectorStatus_IC86.55697_corrected_V2.i3.gz"));
+        tray.AddModule("PEGenerator","Hitter");
+
+        boost::python::dict noiseConfig;
+        noiseConfig["RandomServiceName"]="NoiseRandom";
+        noiseConfig["UseIndividual"]=false;
+
+        std::string collector=std::string(fused ? "Fused" : "Separate")+(noise ? "Noise" : "");
+        if(fused){
+          tray.AddModule("DOMLauncher","DOMLauncher")
+            ("Input","I3MCPESeriesMap")
+            ("Output","InIceRawData")
+            ("SimulatePMTResponse",true)
+            ("SimulateNoise",noise)
+            ("NoiseConfig",noise ? noiseConfig : boost::python::dict());
+        }else{
+          if(noise){
+            tray.AddModule("Vuvuzela","Noise")
+              ("InputHitSeriesMapName","I3MCPESeriesMap")
+              ("OutputHitSeriesMapName","NoisyPESeriesMap")
+              ("RandomServiceName","NoiseRandom")
+              ("UseIndividual",false);
+          }
+          tray.AddModule("PMTResponseSimulator","PMTResponse")
+            ("Input",noise ? "NoisyPESeriesMap" : "I3MCPESeriesMap")
+            ("Output","I3MCPulseSeriesMap");
+          tray.AddModule("DOMLauncher","DOMLauncher")
+            ("Input","I3MCPulseSeriesMap")
+            ("Output","InIceRawData");
+        }
+        tray.AddModule("LaunchCollector",collector);
+        tray.Execute(3+nFrames);
+        tray.Finish();
+  }
+
+  ///Checks that two runs made the same launches and returns their number
+  unsigned int CompareLaunches(const std::vector<I3DOMLaunchSeriesMap>& separate,
+                               const std::vector<I3DOMLaunchSeriesMap>& fused){
+        ENSURE_EQUAL(separate.size(), (size_t)nFrames, "All frames collected");
+        ENSURE_EQUAL(fused.size(), (size_t)nFrames, "All frames collected");
+
+        unsigned int nLaunches=0;
+        for(unsigned int f=0; f<nFrames; f++){
+                ENSURE_EQUAL(fused[f].size(), separate[f].size(), "Same DOMs launched");
+                I3DOMLaunchSeriesMap::const_iterator sep=separate[f].begin();
+                for(I3DOMLaunchSeriesMap::const_iterator fus=fused[f].begin(); fus!=fused[f].end() && sep!=separate[f].end(); fus++, sep++){
+                        ENSURE(fus->first==sep->first, "Same DOMs launched");
+                        ENSURE_EQUAL(fus->second.size(), sep->second.size(), "Same number of launches");
+                        for(size_t i=0; i<std::min(fus->second.size(), sep->second.size()); i++){
+                                ENSURE(fus->second[i]==sep->second[i], "Identical launches");
+                                ENSURE_EQUAL(fus->second[i].GetStartTime(), sep->second[i].GetStartTime(), "Same launch time");
+                        }
+                        nLaunches+=sep->second.size();
+                }
+        }
+        return nLaunches;
+  }
+}
+
+TEST(LaunchesMatchSeparateModules){
+        collectedLaunches.clear();
+        RunTray(false, false);
+        RunTray(true, false);
+
+        unsigned int nLaunches=CompareLaunches(collectedLaunches["Separate"], collectedLaunches["Fused"]);
+        ENSURE(nLaunches>0, "The PEs make launches");
+}
+
+#ifdef USE_VUVUZELA
+TEST(NoiseLaunchesMatchSeparateModules){
+        collectedLaunches.clear();
+        RunTray(false, true);
+        RunTray(true, true);
+
+        unsigned int nLaunches=CompareLaunches(collectedLaunches["SeparateNoise"], collectedLaunches["FusedNoise"]);
+        ENSURE(nLaunches>0, "The PEs make launches");
+        unsigned int nNoiseLaunches=0;
+        BOOST_FOREACH(const I3DOMLaunchSeriesMap& launches, collectedLaunches["FusedNoise"])
+                BOOST_FOREACH(const I3DOMLaunchSeriesMap::value_type& dom, launches)
+                        if(dom.first.GetString()<41 || dom.first.GetString()>43)
+                                nNoiseLaunches+=dom.second.size();
+        ENSURE(nNoiseLaunches>0, "The noise makes launches away from the PEs");
+}
+#endif
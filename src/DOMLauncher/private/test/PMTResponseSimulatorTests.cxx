@@ -649,3 +649,43 @@ TEST(8_WholeShebang){
 	ENSURE_DISTANCE(totalAfterCharge/totalAfterHits,expectedAverageRegularCharge,.02,"Expected average afterpulse charge");
 	ENSURE_DISTANCE(totalEarlyAfterCharge/totalEarlyAfterHits,expectedAverageEarlyAfterCharge,.04,"Expected average early afterpulse charge");
 }
+
+//Check that in multi-threaded mode the output does not depend on the number of threads
+TEST(9_ThreadCountIndependence){
+	//several DOMs with enough hits to make every kind of pulse
+	boost::shared_ptr<I3Calibration> calibration=boost::make_shared<I3Calibration>();
+	boost::shared_ptr<I3DetectorStatus> status=boost::make_shared<I3DetectorStatus>();
+	boost::shared_ptr<I3Map<OMKey,std::vector<I3MCPE> > > hitMap(new I3Map<OMKey,std::vector<I3MCPE> >);
+	for(unsigned int i=0; i<20; i++){
+		OMKey om(1+i/5,1+i%5);
+		calibration->domCal[om]=getTestCalibration()->domCal[testOM];
+		status->domStatus[om]=getTestStatus()->domStatus[testOM];
+		for(unsigned int j=0; j<50; j++)
+			(*hitMap)[om].push_back(makeHit(10.*j,1+j%3,i,j%2));
+	}
+	
+	std::vector<boost::shared_ptr<I3Frame> > outputs;
+	const unsigned int threadCounts[]={1,4};
+	for(unsigned int n=0; n<2; n++){
+		I3Context context;
+		ServiceFactoryWrapper rng(context,"I3GSLRandomServiceFactory");
+		rng.Configure()("Seed",23456)(end_config);
+		rng.installService();
+		PMTResponseSimulatorTestSetup rts(context);
+		rts.Configure()("PrePulseProbability",.1)("LatePulseProbability",.1)("AfterPulseProbability",.1)("NumThreads",threadCounts[n])(end_config);
+		
+		boost::shared_ptr<I3Frame> frame(new I3Frame(I3Frame::DAQ));
+		frame->Put(calibration);
+		frame->Put(status);
+		frame->Put("I3MCPESeriesMap",hitMap);
+		outputs.push_back(rts.processFrame(frame));
+	}
+	
+	const I3Map<OMKey,std::vector<I3MCPulse> >& pulses1=outputs[0]->Get<I3Map<OMKey,std::vector<I3MCPulse> > >("I3MCPulseSeriesMap");
+	const I3Map<OMKey,std::vector<I3MCPulse> >& pulses4=outputs[1]->Get<I3Map<OMKey,std::vector<I3MCPulse> > >("I3MCPulseSeriesMap");
+	ENSURE_EQUAL(pulses1.size(),hitMap->size(),"All DOMs should have output");
+	ENSURE(pulses1==pulses4,"Pulses should not depend on the number of threads");
+	const I3ParticleIDMap& pids1=outputs[0]->Get<I3ParticleIDMap>("I3MCPulseSeriesMapParticleIDMap");
+	const I3ParticleIDMap& pids4=outputs[1]->Get<I3ParticleIDMap>("I3MCPulseSeriesMapParticleIDMap");
+	ENSURE(pids1==pids4,"Particle ID maps should not depend on the number of threads");
+}
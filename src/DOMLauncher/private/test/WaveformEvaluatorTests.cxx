@@ -0,0 +1,118 @@
+#include <I3Test.h>
+#include <icetray/I3Units.h>
+#include <dataclasses/calibration/I3Calibration.h>
+#include <simclasses/I3MCPulse.h>
+#include <phys-services/I3GSLRandomService.h>
+#include "DOMLauncher/domlauncherutils.h"
+#include "DOMLauncher/InterpolatedSPETemplate.h"
+
+#include <cmath>
+#include <algorithm>
+
+/* These tests check that filling a whole readout at once, with
+WaveformEvaluator::WaveFormAmplitudes() and InterpolatedSPETemplate::Accumulate(),
+gives the same amplitudes as evaluating the waveform bin by bin. */
+
+TEST_GROUP(WaveformEvaluator);
+
+namespace{
+
+  bool earlier(const I3MCPulse& lhs, const I3MCPulse& rhs){
+    return lhs.time < rhs.time;
+  }
+
+  ///The ATWD channel 0 template, tabulated as in I3DOM
+  InterpolatedSPETemplate ATWDTemplate(bool tabulate){
+    I3DOMCalibration cal;
+    cal.SetFrontEndImpedance(50*I3Units::ohm);
+    InterpolatedSPETemplate templ(cal.ATWDPulseTemplate(0));
+    if(tabulate)
+      templ.Tabulate(5000,
+                     1000,
+                     -10.0*I3Units::ns,
+                     80.0*I3Units::ns,
+                     6400.0*I3Units::ns,
+                     1*I3Units::second );
+    return templ;
+  }
+
+  ///The summing order differs, so the amplitudes only agree to rounding
+  void EnsureClose(double value, double expected, const char* what){
+    ENSURE_DISTANCE(value, expected, 1e-9*std::max(1.0, std::abs(expected)), what);
+  }
+
+  ///Fills readouts of a train of frames with both evaluators and compares them.
+  ///The readouts within each frame move forward in time over a train much longer
+  ///than cutoffTime, so the cut off of old merged pulses advances, and the last
+  ///readout goes back to the start of the frame.
+  void CompareReadouts(double span, unsigned nPulses, double cutoffTime){
+    I3GSLRandomService rng(11);
+    InterpolatedSPETemplate templ = ATWDTemplate(true);
+    domlauncherutils::BufferedWaveformEvaluator perBin(25*I3Units::ns, 200*I3Units::ns, cutoffTime);
+    domlauncherutils::BufferedWaveformEvaluator readout(25*I3Units::ns, 200*I3Units::ns, cutoffTime);
+
+    double start = 0;
+    for(unsigned frame = 0; frame < 4; frame++){
+      std::vector<I3MCPulse> pulses;
+      for(unsigned i = 0; i < nPulses; i++){
+        I3MCPulse pulse;
+        pulse.time = start + rng.Uniform(span);
+        pulse.charge = rng.Uniform(0.1, 3);
+        pulses.push_back(pulse);
+      }
+      std::sort(pulses.begin(), pulses.end(), earlier);
+      perBin.SetPulses(pulses);
+      readout.SetPulses(pulses);
+
+      std::vector<double> readoutTimes;
+      for(unsigned r = 0; r < 20; r++)
+        readoutTimes.push_back(start + rng.Uniform(-100, span + 1000));
+      std::sort(readoutTimes.begin(), readoutTimes.end());
+      readoutTimes.push_back(start);
+
+      for(unsigned r = 0; r < readoutTimes.size(); r++){
+        //ATWD and FADC like readouts
+        const double binLength = (r%2) ? 25*I3Units::ns : 3.3*I3Units::ns;
+        const unsigned nBins = (r%2) ? 256 : 128;
+        std::vector<double> amplitudes(nBins, 0);
+        readout.WaveFormAmplitudes(readoutTimes[r], binLength, nBins, templ, &amplitudes[0]);
+        for(unsigned i = 0; i < nBins; i++)
+          EnsureClose(amplitudes[i], perBin.WaveFormAmplitude(readoutTimes[r] + i*binLength, templ),
+                      "Readout amplitude differs from the per-bin amplitude");
+      }
+
+      //Carry the waveform over into the next frame
+      start = pulses.back().time + rng.Uniform(50, 500)*I3Units::ns;
+      perBin.Buffer(start);
+      readout.Buffer(start);
+    }
+  }
+}
+
+TEST(AccumulateMatchesEvaluation){
+  I3GSLRandomService rng(5);
+  for(int tabulate = 0; tabulate < 2; tabulate++){
+    InterpolatedSPETemplate templ = ATWDTemplate(tabulate);
+    //Readouts starting before the pulse and in each region of the tabulation
+    const double starts[] = {-50*I3Units::ns, 40*I3Units::ns, 500*I3Units::ns, 10*I3Units::microsecond};
+    for(unsigned s = 0; s < sizeof(starts)/sizeof(starts[0]); s++){
+      const double t = starts[s] + rng.Uniform(0, 5*I3Units::ns);
+      const double dt = rng.Uniform(1, 30)*I3Units::ns;
+      const unsigned n = 256;
+      const double scale = rng.Uniform(0.1, 3);
+      std::vector<double> out(n, 1.0);
+      templ.Accumulate(t, dt, n, scale, &out[0]);
+      for(unsigned i = 0; i < n; i++)
+        EnsureClose(out[i], 1.0 + scale*templ(t + i*dt),
+                    "Accumulated amplitude differs from the template");
+    }
+  }
+}
+
+TEST(AmplitudesMatchPerBin){
+  CompareReadouts(2*I3Units::microsecond, 200, 500*I3Units::microsecond);
+}
+
+TEST(AmplitudesMatchPerBinPastCutoff){
+  CompareReadouts(20*I3Units::microsecond, 2000, 3*I3Units::microsecond);
+}
@@ -9,10 +9,18 @@
 #include "dataclasses/physics/I3DOMLaunch.h"
 #include "phys-services/I3GSLRandomService.h"
 #include "simclasses/I3MCPulse.h"
+#include "simclasses/I3MCPE.h"
+#include "simclasses/I3ParticleIDMap.hpp"
 
 //DOMLauncher headers
 #include "domlauncherutils.h"
 
+#include <boost/dynamic_bitset.hpp>
+#include <boost/python/dict.hpp>
+
+class PMTResponseSimulator;
+class Vuvuzela;
+
 namespace dlud = domlauncherutils::detail;
 /**
  * class: DOMLauncher (Gyllenstierna)
@@ -46,6 +54,20 @@ class DOMLauncher : public I3ConditionalModule{
   /// puts in Frame as an MCPulseSeriesMap.
   void DOTOutput(I3FramePtr, const domlauncherutils::DCStream& );
   void InitilizeDOMMap();
+  /// Marks the DOM with the given index in domIndex_ as active in this frame.
+  void SetActive(size_t index);
+  /// The discriminator crossings of the DOMs in a frame and its time span.
+  struct DiscriminatorRuns;
+  /// Simulates the discriminator of the DOM with the given index in domIndex_.
+  /// The pulses must live until the end of DAQ, as the DOM digitizes them
+  /// when it launches.
+  void Discriminate(size_t index, const I3MCPulseSeries& pulses, DiscriminatorRuns& frameRuns);
+  /// Takes each DOM with PEs in the frame through the internal noise and PMT
+  /// simulation and its discriminator in turn. Returns false if the frame
+  /// has no PEs.
+  bool SimulateDOMs(I3FramePtr frame, DiscriminatorRuns& frameRuns);
+  /// The index in domIndex_ of a DOM, searching from hint onwards.
+  size_t FindDOM(std::vector<OMKey>::const_iterator& hint, const OMKey& omkey) const;
 
   DOMLauncher();
 
@@ -85,6 +107,33 @@ class DOMLauncher : public I3ConditionalModule{
   /// The name of the MCPulseSeriesMap to be processed.
   std::string mcPulseSeriesName_;
 
+  /// If the input is an I3MCPESeriesMap, to be turned into pulses DOM by DOM
+  /// with an internal PMTResponseSimulator instead of in a separate module.
+  bool simulatePMTResponse_;
+  /// Parameters for the internal PMTResponseSimulator.
+  boost::python::dict pmtConfig_;
+  /// If not empty, the name of the I3MCPulseSeriesMap (and its
+  /// I3ParticleIDMap) of the internal PMTResponseSimulator to put in the frame.
+  std::string pmtOutputName_;
+  boost::shared_ptr<PMTResponseSimulator> pmtResponse_;
+
+  /// If noise should be added to the PEs of each DOM with an internal
+  /// Vuvuzela before the PMT simulation.
+  bool simulateNoise_;
+  /// Parameters for the internal Vuvuzela.
+  boost::python::dict noiseConfig_;
+  /// If not empty, the name of the I3MCPESeriesMap with noise to put in the frame.
+  std::string noiseOutputName_;
+  boost::shared_ptr<Vuvuzela> noise_;
+
+  /// The PEs of the DOM being simulated, with noise.
+  I3MCPESeries hitBuffer_;
+  /// The pulses of each DOM of domIndex_ in the current frame, kept from
+  /// frame to frame to reuse their memory.
+  std::vector<I3MCPulseSeries> pulseBuffers_;
+  /// The particles of the pulses of the DOM being simulated.
+  ParticlePulseIndexMap particleBuffer_;
+
   std::map<OMKey, I3OMGeo> domGeo_;
   std::map<OMKey, I3DOMCalibration> domCal_;
   std::map<OMKey, I3DOMStatus> domStatus_;
@@ -92,8 +141,17 @@ class DOMLauncher : public I3ConditionalModule{
   I3RandomServicePtr randomService_;
 
   std::map<OMKey, boost::shared_ptr<I3DOM> > domMap_;
-  
-  std::map<OMKey, boost::shared_ptr<I3DOM> > activeDOMsMap_;
+
+  /// The DOMs of domMap_ in the same (OMKey) order, so that a DOM can be
+  /// referred to by its index.
+  std::vector<boost::shared_ptr<I3DOM> > domIndex_;
+  /// The OMKeys of domIndex_, for looking up indices.
+  std::vector<OMKey> domKeys_;
+
+  /// Which DOMs of domIndex_ have discriminator crossings or launches to
+  /// process, as flags and as a list of indices.
+  boost::dynamic_bitset<> activeDOMs_;
+  std::vector<size_t> activeDOMList_;
   
   domlauncherutils::I3DOMGlobals globalSimState;
   
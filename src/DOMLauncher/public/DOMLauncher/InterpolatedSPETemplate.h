@@ -73,6 +73,15 @@ class InterpolatedSPETemplate{
                 double endPoint);
   /// This member function returns the amplitude of the pulse at time \param t
   double operator()(double t);
+  ///Adds scale times the amplitude of the pulse at each of the times t, t+dt, ...
+  ///t+(n-1)*dt to out[0] ... out[n-1]. The values are the same as from the ()-operator,
+  ///but the region of the tabulation is looked up once per region instead of once per time.
+  ///\param t the first time
+  ///\param dt the spacing of the times, which must be positive
+  ///\param n the number of times
+  ///\param scale the factor to multiply the amplitudes with
+  ///\param out the array the amplitudes are added to
+  void Accumulate(double t, double dt, unsigned n, double scale, double* out);
   ///A testing function that prints out the square sum of the difference between
   ///the interpolated pulse template and the real pulse template.
   double TabulationError();
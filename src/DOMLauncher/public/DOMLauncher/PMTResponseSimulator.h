@@ -9,6 +9,8 @@
 #include <simclasses/I3MCPulse.h>
 #include <dataclasses/physics/I3ParticleID.h>
 #include <simclasses/I3ParticleIDMap.hpp>
+#include <dataclasses/I3Map.h>
+#include <boost/thread/mutex.hpp>
 
 class I3Calibration;
 class I3DOMCalibration;
@@ -67,6 +69,9 @@ private:
 	bool lowMem_;
 	///The ID of the random service to use
 	std::string randomServiceName_;
+	///The number of threads among which to divide the DOMs, or zero to
+	///  process them serially with the random service from the context
+	unsigned int numThreads_;
 
 	///The random service fetched from the tray
 	boost::shared_ptr<I3RandomService> randomService_;
@@ -84,41 +89,91 @@ private:
 	///
 	///\param w The weight of the hit in photons
 	///\param om The OM for which the charge is to be computed
+	///\param rng The random service to draw from
 	///\return  The amount of charge produced by the PMT for this hit, in units of the ideal charge
 	///         produced by a single photoelectron
-	double normalHitWeight(unsigned int w, OMKey om);
+	double normalHitWeight(unsigned int w, OMKey om, I3RandomService& rng) const;
 
 	///Generates a random time jitter value for a hit
+	///\param rng The random service to draw from
 	///\return A random time offset, in nanoseconds
-	double PMTJitter();
+	double PMTJitter(I3RandomService& rng) const;
 
 	///Computes the amount by which prepulses are early at a given voltage
 	///\param voltage The operating voltage of the DOM
 	///\return A time offset, in nanoseconds
-	double prePulseTimeShift(double voltage);
+	double prePulseTimeShift(double voltage) const;
 
 	///Computes the charge of a prepulse, relative to an ideal s.p.e. at a given voltage
 	///\param voltage The operating voltage of the DOM
 	///\return The amount of charge produced by the PMT for a prepulse, in units of the ideal
 	///        charge produced by a single photoelectron
-	double prePulseWeight(double voltage);
+	double prePulseWeight(double voltage) const;
 
 	///Computes the charge of an early afterpulse, relative to an ideal s.p.e. at a given voltage
+	///\param rng The random service to draw from
 	///\return The amount of charge produced by the PMT for an early afterpulse, in units of the ideal
 	///        charge produced by a single photoelectron
-	double earlyAfterPulseWeight();
+	double earlyAfterPulseWeight(I3RandomService& rng) const;
 
 	///Alters the properies of the given hit to describe a late pulse
 	///\param hit The existing raw hit to be turned into a late pulse hit
 	///\param om The DOM in which the hit is being detected
 	///\param voltage The operating voltage of the PMT
-	void createLatePulse(I3MCPulse& hit, OMKey om, double voltage);
+	///\param rng The random service to draw from
+	void createLatePulse(I3MCPulse& hit, OMKey om, double voltage, I3RandomService& rng) const;
 
 	///Alters the properies of the given hit to describe an afterpulse
 	///\param hit The existing raw hit to be turned into an afterpulse hit
 	///\param om The DOM in which the hit is being detected
 	///\param voltage The operating voltage of the PMT
-	void createAfterPulse(I3MCPulse& hit, OMKey om, double voltage);
+	///\param rng The random service to draw from
+	void createAfterPulse(I3MCPulse& hit, OMKey om, double voltage, I3RandomService& rng) const;
+
+	///The inputs and the result of processing one DOM in multi-threaded mode
+	struct domWork{
+		I3Map<OMKey,std::vector<I3MCPE> >::const_iterator dom;
+		const I3DOMCalibration* cal;
+		const I3DOMStatus* status;
+		std::pair<std::vector<I3MCPulse>, ParticlePulseIndexMap> result;
+
+		domWork(I3Map<OMKey,std::vector<I3MCPE> >::const_iterator dom,
+		        const I3DOMCalibration& cal, const I3DOMStatus& status):
+		dom(dom),cal(&cal),status(&status){}
+	};
+
+	///Hands out the DOMs of a frame to worker threads, one at a time.
+	///  Each result is written only to its own work item, so no locking is
+	///  needed to collect them.
+	struct workQueue{
+		const PMTResponseSimulator& sim;
+		std::vector<domWork>& work;
+		///The seed for the substreams of all DOMs in this frame
+		const uint64_t seed;
+		///The index of the next item to process
+		size_t next;
+		///The message of the first exception thrown by any worker
+		std::string error;
+		boost::mutex mutex;
+
+		workQueue(const PMTResponseSimulator& sim, std::vector<domWork>& work, uint64_t seed);
+		///Processes items until none are left
+		void operator()();
+	};
+
+	///Processes all of the given DOMs using numThreads_ threads, giving each
+	///  DOM a random substream determined by a per-frame seed and its OMKey
+	void processDOMsInParallel(std::vector<domWork>& work);
+
+	///Applies all transformations to a set of hits on a single DOM, drawing
+	///  random numbers from the given service, and replaces the contents of
+	///  outputHits and particleMap with the result. This only reads the state
+	///  of the module, so it may be called for different DOMs concurrently as
+	///  long as each call has its own random service and outputs.
+	void generatePulses(const std::vector<I3MCPE>& inputHits, OMKey dom,
+	                    const I3DOMCalibration& cal, const I3DOMStatus& status,
+	                    I3RandomService& rng, std::vector<I3MCPulse>& outputHits,
+	                    ParticlePulseIndexMap& particleMap) const;
 
 public:
 	///Applies all transformations to a set of hits on a single DOM
@@ -132,13 +187,40 @@ public:
 	processHits(const std::vector<I3MCPE>& inputHits, OMKey dom,
 	            const I3DOMCalibration& cal, const I3DOMStatus& status);
 
+	///As processHits, but writes the pulses to the given containers, replacing
+	///  their contents, so that their memory can be reused from DOM to DOM
+	///\param inputHits The raw hits on the DOM
+	///\param dom The DOM on which the hits occur
+	///\param cal The current calibration information for this DOM
+	///\param status The current status information for this DOM
+	///\param outputHits Receives the time ordered pulses
+	///\param particleMap Receives the indices of the pulses of each particle
+	void processHitsInto(const std::vector<I3MCPE>& inputHits, OMKey dom,
+	                     const I3DOMCalibration& cal, const I3DOMStatus& status,
+	                     std::vector<I3MCPulse>& outputHits, ParticlePulseIndexMap& particleMap);
+
+	///Decides whether the hits on a DOM are to be simulated, skipping DOMs
+	///  without hits, without a status or calibration record, or with a PMT
+	///  voltage which is zero or nonsensical
+	///\param dom The DOM on which the hits occur
+	///\param hits The raw hits on the DOM
+	///\param domStatus The status information for all DOMs
+	///\param domCal The calibration information for all DOMs
+	///\param status Set to the status information for this DOM if it is selected
+	///\param cal Set to the calibration information for this DOM if it is selected
+	///\return Whether the hits should be processed
+	bool selectDOM(const OMKey& dom, const std::vector<I3MCPE>& hits,
+	               const std::map<OMKey,I3DOMStatus>& domStatus,
+	               const std::map<OMKey,I3DOMCalibration>& domCal,
+	               const I3DOMStatus*& status, const I3DOMCalibration*& cal) const;
+
 	///Reweights the hits in the given series to mimic the effects of saturation in the PMT.
 	///  The 'inverse' saturation parameterization from T. Waldenmeier is used.
 	///\param hits The hit series to be reweighted
 	///\param pmtVoltage The operating voltage of the PMT
 	///\param cal The calibration data for the DOM
 	///\pre The input hits must be time ordered
-	void saturate(std::vector<I3MCPulse>& hits, double pmtVoltage, const I3DOMCalibration& cal);
+	void saturate(std::vector<I3MCPulse>& hits, double pmtVoltage, const I3DOMCalibration& cal) const;
 
 	///Merges together pulses which are within some small time window, compacting the hit series
 	///  if it is densely filled with hits.
@@ -180,6 +262,9 @@ public:
 	bool getLowMem() const{ return(lowMem_); }
 	void setLowMem(bool lowMem){ lowMem_=lowMem; }
 
+	unsigned int getNumThreads() const{ return(numThreads_); }
+	void setNumThreads(unsigned int numThreads){ numThreads_=numThreads; }
+
 	boost::shared_ptr<I3RandomService> getRandomService() const{ return(randomService_); }
 	void setRandomService(boost::shared_ptr<I3RandomService> randomService){ randomService_=randomService; }
 
@@ -191,7 +276,9 @@ private:
 	///              (variance = (pi * scale)**2 / 6)
 	///\param logLowerBound Indirectly determines the lower cutoff of the distribution
 	///\param logUpperBound Indirectly determines the upper cutoff of the distribution
-	double fisherTippett(double location, double scale, double logLowerBound, double logUpperBound);
+	///\param rng The random service to draw from
+	double fisherTippett(double location, double scale, double logLowerBound, double logUpperBound,
+	                     I3RandomService& rng) const;
 
 	///A helper object for storing and evaluating pulse charge distributions with the form of the
 	///sum of an exponential and a gaussian component.
@@ -182,9 +182,110 @@ namespace domlauncherutils{
             }
             return amplitude;
         }
+
+        ///Adds the waveform amplitude at each of the n times start, start+step, ...
+        ///to out[0] ... out[n-1]. This gives the same amplitudes as calling
+        ///WaveFormAmplitude() for each of the times in turn, but instead of summing
+        ///over the pulses for each time the template of each pulse is stamped onto
+        ///all of the times it contributes to at once.
+        void WaveFormAmplitudes(double start, double step, unsigned n,
+                                InterpolatedSPETemplate & templ, double *out){
+            if(n == 0)
+                return;
+            const uint64_t nMerged = mergedPulses_.size();
+            uint64_t firstMerged = 0;
+            if(nMerged > 0)
+                firstMerged = (start > mergedPulses_[lastCutoffindex_].time) ? lastCutoffindex_ : 0;
+
+            //For each time, the first pulse which is evaluated directly rather than
+            //as part of a merged pulse
+            startIndices_.assign(n, 0);
+            uint64_t firstNear = firstMerged;
+            for(unsigned i = 0; i < n; i++){
+                double time = TimeAt(start, step, i);
+                while(firstNear < nMerged && !(time - mergedPulses_[firstNear].time < padding_))
+                    firstNear++;
+                if(firstNear < nMerged && firstNear > 0)
+                    startIndices_[i] = mergedPulses_[firstNear-1].lastIndex;
+            }
+
+            //Merged pulses count once they are padding_ in the past, until the
+            //following merged pulse is more than cutoffTime_ in the past
+            uint64_t cutoffIndex = firstMerged;
+            for(uint64_t m = firstMerged; m < nMerged; m++){
+                const MergedPulse &pulse = mergedPulses_[m];
+                unsigned from = FirstAtLeast(start, step, n, pulse.time, padding_);
+                if(from >= n)
+                    break;
+                unsigned to = n;
+                if(m + 1 < nMerged)
+                    to = std::min(n, FirstAbove(start, step, n, mergedPulses_[m+1].time, cutoffTime_) + 1);
+                if(from < to)
+                    templ.Accumulate(start + from*step - pulse.time, step, to - from, pulse.charge, out + from);
+                if(TimeAt(start, step, n-1) - pulse.time > cutoffTime_)
+                    cutoffIndex = m;
+            }
+            lastCutoffindex_ = cutoffIndex;
+
+            //The other pulses count from their own time until they are padding_ in the past
+            uint64_t first = 0, last = pulsesSize_;
+            while(first < last){ //find the first pulse which may still count
+                uint64_t middle = (first + last)/2;
+                if((*currentPulses_)[middle].time < start - padding_ - step)
+                    first = middle + 1;
+                else
+                    last = middle;
+            }
+            for(uint64_t p = first; p < pulsesSize_; p++){
+                const I3MCPulse &pulse = (*currentPulses_)[p];
+                unsigned from = FirstAtLeast(start, step, n, pulse.time, 0);
+                if(from >= n)
+                    break;
+                unsigned to = FirstAbove(start, step, n, pulse.time, padding_);
+                unsigned i = from;
+                while(i < to){
+                    while(i < to && startIndices_[i] > p)
+                        i++;
+                    unsigned runStart = i;
+                    while(i < to && startIndices_[i] <= p)
+                        i++;
+                    if(i > runStart)
+                        templ.Accumulate(start + runStart*step - pulse.time, step, i - runStart,
+                                         pulse.charge, out + runStart);
+                }
+            }
+        }
         
         
     private:
+        static double TimeAt(double start, double step, unsigned i){ return start + i*step; }
+
+        ///The first i < n for which start + i*step - pulseTime >= delay, or n
+        static unsigned FirstAtLeast(double start, double step, unsigned n, double pulseTime, double delay){
+            unsigned first = 0, last = n;
+            while(first < last){
+                unsigned middle = (first + last)/2;
+                if(TimeAt(start, step, middle) - pulseTime < delay)
+                    first = middle + 1;
+                else
+                    last = middle;
+            }
+            return first;
+        }
+
+        ///The first i < n for which start + i*step - pulseTime > delay, or n
+        static unsigned FirstAbove(double start, double step, unsigned n, double pulseTime, double delay){
+            unsigned first = 0, last = n;
+            while(first < last){
+                unsigned middle = (first + last)/2;
+                if(!(TimeAt(start, step, middle) - pulseTime > delay))
+                    first = middle + 1;
+                else
+                    last = middle;
+            }
+            return first;
+        }
+
         ///
         struct MergedPulse: public I3MCPulse{
             MergedPulse():I3MCPulse(0,0),lastIndex(0){}
@@ -198,6 +299,8 @@ namespace domlauncherutils{
         double cutoffTime_;
         uint64_t lastCutoffindex_;
         uint64_t pulsesSize_;
+        ///Scratch space for WaveFormAmplitudes()
+        std::vector<uint64_t> startIndices_;
         
     };
   
@@ -224,6 +327,12 @@ namespace domlauncherutils{
              return bufferedWaveform_.WaveFormAmplitude(time, templ) + 
              currentWaveform_.WaveFormAmplitude(time, templ);             
         }
+
+        void WaveFormAmplitudes(double start, double step, unsigned n,
+                                InterpolatedSPETemplate & templ, double *out){
+             bufferedWaveform_.WaveFormAmplitudes(start, step, n, templ, out);
+             currentWaveform_.WaveFormAmplitudes(start, step, n, templ, out);
+        }
         
         void Buffer(double start_time){
             pulseBuffer_.clear();
@@ -98,10 +98,41 @@ def effective_domsim(frame, mapname = "I3MCPulseSeriesMap", outputmap = "I3RecoP
 @icetray.traysegment
 def DetectorResponse(tray, name,
                      pmt_config = dict(),
-                     dom_config = dict()):
-
-  #create PMT response
-  tray.AddModule('PMTResponseSimulator', name + "_pmt",**pmt_config)
+                     dom_config = dict(),
+                     fuse_pmt_response = False,
+                     noise_config = None):
+  """
+  :param fuse_pmt_response: Run the PMT simulation inside DOMLauncher, one DOM
+      at a time, instead of putting an I3MCPulseSeriesMap in the frame.
+  :param noise_config: If not None, the parameters of a Vuvuzela adding noise to
+      the PEs before the PMT simulation. With fuse_pmt_response it runs inside
+      DOMLauncher as well.
+  """
+
+  if noise_config is not None:
+    noise_config = dict(noise_config)
+    if fuse_pmt_response:
+      noise_config.pop("InputHitSeriesMapName", None)
+      noise_config.pop("OutputHitSeriesMapName", None)
+    else:
+      from icecube import vuvuzela
+      noise_config.setdefault("InputHitSeriesMapName", pmt_config.get("Input", "I3MCPESeriesMap"))
+      noise_config.pop("OutputHitSeriesMapName", None)
+      tray.AddModule("Vuvuzela", name + "_noise", **noise_config)
+
+  if fuse_pmt_response:
+    dom_config = dict(dom_config)
+    pmt_config = dict(pmt_config)
+    dom_config["Input"] = pmt_config.pop("Input", "I3MCPESeriesMap")
+    pmt_config.pop("Output", None)
+    dom_config["SimulatePMTResponse"] = True
+    dom_config["PMTConfig"] = pmt_config
+    if noise_config is not None:
+      dom_config["SimulateNoise"] = True
+      dom_config["NoiseConfig"] = noise_config
+  else:
+    #create PMT response
+    tray.AddModule('PMTResponseSimulator', name + "_pmt",**pmt_config)
 
   #create Detector response
   tray.AddModule('DOMLauncher', name+'_dommb',**dom_config)
@@ -10,17 +10,18 @@ extern "C" {
 
 namespace I3MuonGun {
 
-SplineTable::SplineTable() : bias_(0)
+SplineTable::SplineTable() : bias_(0), eval_(&ndsplineeval)
 {
   memset(&table_, 0, sizeof(struct splinetable));
 }
 
 SplineTable::SplineTable(const std::string &path)
 {
-	if (readsplinefitstable(path.c_str(), &table_) != 0)
+	if (readsplinetable(path.c_str(), &table_) != 0)
 		throw std::runtime_error("Couldn't read spline table " + path);
 	if (splinetable_read_key(&table_, SPLINETABLE_DOUBLE, "BIAS", &bias_))
 		bias_ = 0;
+	eval_ = ndsplineeval_select(&table_);
 }
 
 SplineTable::~SplineTable()
@@ -49,12 +50,22 @@ SplineTable::operator==(const SplineTable &other) const
 	// Same size of coefficient grid
 	if (!std::equal(table_.naxes, table_.naxes + table_.ndim, other.table_.naxes))
 		return false;
-	size_t size = 1;
-	for (int i=0; i < table_.ndim; i++)
-		size *= size_t(table_.naxes[i]);
-	// Same coefficient grid
-	if (!std::equal(table_.coefficients, table_.coefficients + size, other.table_.coefficients))
+	// Same coefficient layout and precision
+	if (table_.blocksize != other.table_.blocksize || table_.precision != other.table_.precision)
 		return false;
+	size_t size = splinetable_ncoefficients(&table_);
+	// Same coefficient grid
+	if (table_.precision == SPLINETABLE_FLOAT32) {
+		if (!std::equal(table_.coefficients, table_.coefficients + size, other.table_.coefficients))
+			return false;
+	} else {
+		if (!std::equal(table_.packed, table_.packed + size, other.table_.packed))
+			return false;
+		size_t nscales = (size + SPLINETABLE_QBLOCK - 1)/SPLINETABLE_QBLOCK;
+		if (table_.precision == SPLINETABLE_INT16 &&
+		    !std::equal(table_.scales, table_.scales + nscales, other.table_.scales))
+			return false;
+	}
 	
 	return true;
 }
@@ -65,7 +76,7 @@ SplineTable::Eval(double *coordinates, double *result) const
 	std::vector<int> centers(unsigned(table_.ndim));
 	
 	if (tablesearchcenters(&table_, coordinates, &centers[0]) == 0)
-		*result = ndsplineeval(&table_, coordinates, &centers[0], 0);
+		*result = eval_(&table_, coordinates, &centers[0], 0);
 	else
 		return EINVAL;
 	
@@ -115,6 +126,7 @@ SplineTable::load(Archive &ar, unsigned version)
 	ar & make_nvp("FITSFile", boost::serialization::make_binary_object(buf.data, buf.size));
 	readsplinefitstable_mem(&buf, &table_);
 	free(buf.data);
+	eval_ = ndsplineeval_select(&table_);
 }
 
 }
@@ -6,6 +6,7 @@
 
 extern "C" {
 	#include <photospline/splinetable.h>
+	#include <photospline/bspline.h>
 }
 
 #include "icetray/I3FrameObject.h"
@@ -58,6 +59,7 @@ public:
 private:
 	struct splinetable table_;
 	double bias_;
+	ndsplineeval_func eval_;
 	
 	friend class boost::serialization::access;
 	template <typename Archive>
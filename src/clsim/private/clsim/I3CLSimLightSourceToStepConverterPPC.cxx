@@ -43,6 +43,15 @@ const uint32_t I3CLSimLightSourceToStepConverterPPC::default_photonsPerStep=200;
 const uint32_t I3CLSimLightSourceToStepConverterPPC::default_highPhotonsPerStep=0;
 const double I3CLSimLightSourceToStepConverterPPC::default_useHighPhotonsPerStepStartingFromNumPhotons=1.0e9;
 
+namespace {
+    // parameters of the angular distribution of cascade steps
+    const double angularDist_a=0.39;
+    const double angularDist_b=2.61;
+    
+    // the multiplier of the MWC generator used by parallel step generation
+    const uint32_t taskRngA=1640531364;
+}
+
 
 
 I3CLSimLightSourceToStepConverterPPC::I3CLSimLightSourceToStepConverterPPC
@@ -57,7 +66,13 @@ maxBunchSize_(512000),
 photonsPerStep_(photonsPerStep),
 highPhotonsPerStep_(highPhotonsPerStep),
 useHighPhotonsPerStepStartingFromNumPhotons_(useHighPhotonsPerStepStartingFromNumPhotons),
-useCascadeExtension_(true)
+useCascadeExtension_(true),
+numParallelThreads_(0),
+nextSequence_(0),
+nextSequenceToReturn_(0),
+maxTasksInFlight_(0),
+barriersEnqueued_(0),
+stopWorkers_(false)
 {
     if (photonsPerStep_<=0)
         throw I3CLSimLightSourceToStepConverter_exception("photonsPerStep may not be <= 0!");
@@ -73,7 +88,32 @@ useCascadeExtension_(true)
 
 I3CLSimLightSourceToStepConverterPPC::~I3CLSimLightSourceToStepConverterPPC()
 {
+    StopWorkerThreads();
+}
 
+void I3CLSimLightSourceToStepConverterPPC::SetNumParallelThreads(unsigned int numThreads)
+{
+    if (initialized_)
+        throw I3CLSimLightSourceToStepConverter_exception("I3CLSimLightSourceToStepConverterPPC already initialized!");
+    
+    numParallelThreads_=numThreads;
+}
+
+void I3CLSimLightSourceToStepConverterPPC::StopWorkerThreads()
+{
+    if (numParallelThreads_==0) return;
+    
+    {
+        boost::unique_lock<boost::mutex> guard(taskMutex_);
+        stopWorkers_=true;
+    }
+    taskCondition_.notify_all();
+    
+    // an empty task tells a worker to stop
+    for (unsigned int i=0;i<numParallelThreads_;++i)
+        taskQueue_.Put(StepTaskPtr());
+    
+    workerThreads_.join_all();
 }
 
 void I3CLSimLightSourceToStepConverterPPC::Initialize()
@@ -100,8 +140,16 @@ void I3CLSimLightSourceToStepConverterPPC::Initialize()
     rngA_ = 1640531364; // magic number from numerical recipies
     rngState_ = mwcRngInitState(randomService_, rngA_);
     
-    // initialize the pre-calculator threads
-    preCalc_ = boost::shared_ptr<GenerateStepPreCalculator>(new GenerateStepPreCalculator(randomService_, /*a=*/0.39, /*b=*/2.61));
+    if (numParallelThreads_==0) {
+        // initialize the pre-calculator threads
+        preCalc_ = boost::shared_ptr<GenerateStepPreCalculator>(new GenerateStepPreCalculator(randomService_, angularDist_a, angularDist_b));
+    } else {
+        // every task generates its own angular values, start the worker pool instead
+        maxTasksInFlight_ = 4*numParallelThreads_;
+        for (unsigned int i=0;i<numParallelThreads_;++i)
+            workerThreads_.create_thread(boost::bind(&I3CLSimLightSourceToStepConverterPPC::WorkerThread, this));
+        log_debug("Generating steps on %u threads", numParallelThreads_);
+    }
 
     // make a copy of the medium properties
     {
@@ -191,7 +239,7 @@ void I3CLSimLightSourceToStepConverterPPC::EnqueueLightSource(const I3CLSimLight
     if (!initialized_)
         throw I3CLSimLightSourceToStepConverter_exception("I3CLSimLightSourceToStepConverterPPC is not initialized!");
 
-    if (barrier_is_enqueued_)
+    if ((barrier_is_enqueued_) && (numParallelThreads_==0))
         throw I3CLSimLightSourceToStepConverter_exception("A barrier is enqueued! You must receive all steps before enqueuing a new particle.");
 
     if (lightSource.GetType() != I3CLSimLightSource::Particle)
@@ -329,7 +377,7 @@ void I3CLSimLightSourceToStepConverterPPC::EnqueueLightSource(const I3CLSimLight
         cascadeStepGenInfo.pb=pb;
         
         log_trace("== enqueue cascade (e-m)");
-        stepGenerationQueue_.push_back(cascadeStepGenInfo);
+        EnqueueStepData(cascadeStepGenInfo);
         
         log_trace("Generate %u steps for E=%fGeV. (electron)", static_cast<unsigned int>(numSteps+1), E);
     } else if (isHadron) {
@@ -392,7 +440,7 @@ void I3CLSimLightSourceToStepConverterPPC::EnqueueLightSource(const I3CLSimLight
         cascadeStepGenInfo.pa=pa;
         cascadeStepGenInfo.pb=pb;
         log_trace("== enqueue cascade (hadron)");
-        stepGenerationQueue_.push_back(cascadeStepGenInfo);
+        EnqueueStepData(cascadeStepGenInfo);
 
         log_trace("Generate %lu steps for E=%fGeV. (hadron)", static_cast<unsigned long>(numSteps+1), E);
     } else if (isMuon || isTau) {
@@ -483,7 +531,7 @@ void I3CLSimLightSourceToStepConverterPPC::EnqueueLightSource(const I3CLSimLight
         muonStepGenInfo.stepIsCascadeLike=false;
         muonStepGenInfo.length=length;
         log_trace("== enqueue muon (muon-like)");
-        stepGenerationQueue_.push_back(muonStepGenInfo);
+        EnqueueStepData(muonStepGenInfo);
         
         log_trace("Generate %lu steps for E=%fGeV, l=%fm. (muon[muon])", static_cast<unsigned long>((numStepsFromMuon+((numPhotonsFromMuonInLastStep>0)?1:0))), E, length/I3Units::m);
         
@@ -507,7 +555,7 @@ void I3CLSimLightSourceToStepConverterPPC::EnqueueLightSource(const I3CLSimLight
         muonStepGenInfo.stepIsCascadeLike=true;
         muonStepGenInfo.length=length;
         log_trace("== enqueue muon (cascade-like)");
-        stepGenerationQueue_.push_back(muonStepGenInfo);
+        EnqueueStepData(muonStepGenInfo);
         
         log_trace("Generate %u steps for E=%fGeV, l=%fm. (muon[cascade])", static_cast<unsigned int>((numStepsFromCascades+((numPhotonsFromCascadesInLastStep>0)?1:0))), E, length/I3Units::m);
         
@@ -527,20 +575,74 @@ void I3CLSimLightSourceToStepConverterPPC::EnqueueBarrier()
     if (!initialized_)
         throw I3CLSimLightSourceToStepConverter_exception("I3CLSimLightSourceToStepConverterPPC is not initialized!");
 
-    if (barrier_is_enqueued_)
+    if ((barrier_is_enqueued_) && (numParallelThreads_==0))
         throw I3CLSimLightSourceToStepConverter_exception("A barrier is already enqueued!");
 
     // actually enqueue the barrier
     log_trace("== enqueue barrier");
-    stepGenerationQueue_.push_back(BarrierData_t());
+    EnqueueStepData(BarrierData_t());
     barrier_is_enqueued_=true;
 }
 
+void I3CLSimLightSourceToStepConverterPPC::EnqueueStepData(const StepData_t &data)
+{
+    if (numParallelThreads_==0) {
+        stepGenerationQueue_.push_back(data);
+        return;
+    }
+    
+    // Split the entry into chunks of at most maxBunchSize_ steps. The seed
+    // is drawn here, in enqueue order, so the steps in each chunk do not
+    // depend on which thread generates them (or when).
+    // number of steps, including a possible partial last step
+    uint64_t numSteps = 0;
+    if (const CascadeStepData_t *cascade = boost::get<CascadeStepData_t>(&data))
+        numSteps = cascade->numSteps + ((cascade->numPhotonsInLastStep>0)?1:0);
+    else if (const MuonStepData_t *muon = boost::get<MuonStepData_t>(&data))
+        numSteps = muon->numSteps + ((muon->numPhotonsInLastStep>0)?1:0);
+    const bool isBarrier = (boost::get<BarrierData_t>(&data) != NULL);
+    
+    uint64_t seed = 0;
+    if (!isBarrier) {
+        seed = static_cast<uint32_t>(randomService_->Integer(0xffffffff));
+        seed = seed<<32;
+        seed += static_cast<uint32_t>(randomService_->Integer(0xffffffff));
+    }
+    
+    std::vector<StepTaskPtr> tasks;
+    uint64_t firstStep=0;
+    do {
+        StepTaskPtr task(new StepTask_t);
+        task->data = data;
+        task->firstStep = firstStep;
+        task->numSteps = std::min(numSteps-firstStep, maxBunchSize_);
+        task->seed = splitMix64(seed + tasks.size());
+        tasks.push_back(task);
+        
+        firstStep += task->numSteps;
+    } while (firstStep < numSteps);
+    
+    {
+        boost::unique_lock<boost::mutex> guard(taskMutex_);
+        for (std::size_t i=0;i<tasks.size();++i)
+            tasks[i]->sequence = nextSequence_++;
+        if (isBarrier) ++barriersEnqueued_;
+    }
+    
+    for (std::size_t i=0;i<tasks.size();++i)
+        taskQueue_.Put(tasks[i]);
+}
+
 bool I3CLSimLightSourceToStepConverterPPC::BarrierActive() const
 {
     if (!initialized_)
         throw I3CLSimLightSourceToStepConverter_exception("I3CLSimLightSourceToStepConverterPPC is not initialized!");
 
+    if (numParallelThreads_>0) {
+        boost::unique_lock<boost::mutex> guard(taskMutex_);
+        return (barriersEnqueued_>0);
+    }
+
     return barrier_is_enqueued_;
 }
 
@@ -549,6 +651,11 @@ bool I3CLSimLightSourceToStepConverterPPC::MoreStepsAvailable() const
     if (!initialized_)
         throw I3CLSimLightSourceToStepConverter_exception("I3CLSimLightSourceToStepConverterPPC is not initialized!");
 
+    if (numParallelThreads_>0) {
+        boost::unique_lock<boost::mutex> guard(taskMutex_);
+        return (nextSequenceToReturn_ < nextSequence_);
+    }
+
     if (stepGenerationQueue_.size() > 0) return true;
     return false;
 }
@@ -695,6 +802,9 @@ I3CLSimStepSeriesConstPtr I3CLSimLightSourceToStepConverterPPC::GetConversionRes
     
     barrierWasReset=false;
     
+    if (numParallelThreads_>0)
+        return GetParallelResult(barrierWasReset);
+    
     if (stepGenerationQueue_.empty())
     {
         throw I3CLSimLightSourceToStepConverter_exception("I3CLSimLightSourceToStepConverterPPC: no particle is enqueued!");
@@ -717,6 +827,147 @@ I3CLSimStepSeriesConstPtr I3CLSimLightSourceToStepConverterPPC::GetConversionRes
 
 
 
+I3CLSimStepSeriesConstPtr I3CLSimLightSourceToStepConverterPPC::GetParallelResult(bool &barrierWasReset)
+{
+    boost::unique_lock<boost::mutex> guard(taskMutex_);
+    
+    if (nextSequenceToReturn_ >= nextSequence_)
+        throw I3CLSimLightSourceToStepConverter_exception("I3CLSimLightSourceToStepConverterPPC: no particle is enqueued!");
+    
+    // wait for the next chunk in sequence
+    std::map<uint64_t, I3CLSimStepSeriesConstPtr>::iterator it;
+    while ((it = finishedTasks_.find(nextSequenceToReturn_)) == finishedTasks_.end())
+        taskCondition_.wait(guard);
+    
+    I3CLSimStepSeriesConstPtr steps = it->second;
+    finishedTasks_.erase(it);
+    ++nextSequenceToReturn_;
+    
+    if (!steps) {
+        // a barrier
+        if (barriersEnqueued_==0)
+            log_fatal("logic error: barrier encountered, but none was enqueued.");
+        --barriersEnqueued_;
+        barrierWasReset=true;
+        steps = I3CLSimStepSeriesConstPtr(new I3CLSimStepSeries());
+    }
+    
+    guard.unlock();
+    // there is room for one more chunk now
+    taskCondition_.notify_all();
+    
+    return steps;
+}
+
+void I3CLSimLightSourceToStepConverterPPC::WorkerThread()
+{
+    for (;;)
+    {
+        StepTaskPtr task = taskQueue_.Get();
+        if (!task) return;
+        
+        // do not run too far ahead of the consumer
+        {
+            boost::unique_lock<boost::mutex> guard(taskMutex_);
+            while ((!stopWorkers_) && (task->sequence >= nextSequenceToReturn_+maxTasksInFlight_))
+                taskCondition_.wait(guard);
+            if (stopWorkers_) return;
+        }
+        
+        I3CLSimStepSeriesConstPtr steps = MakeStepsForTask(*task);
+        
+        {
+            boost::unique_lock<boost::mutex> guard(taskMutex_);
+            finishedTasks_.insert(std::make_pair(task->sequence, steps));
+        }
+        taskCondition_.notify_all();
+    }
+}
+
+class I3CLSimLightSourceToStepConverterPPC::MakeTaskSteps_visitor : public boost::static_visitor<I3CLSimStepSeriesConstPtr>
+{
+public:
+    MakeTaskSteps_visitor(const StepTask_t &task)
+    : task_(task), rngState_(mwcRngInitState(task.seed, taskRngA)),
+      angularDist_I_(1.-std::exp(-angularDist_b*std::pow(2., angularDist_a)))
+    {;}
+    
+    I3CLSimStepSeriesConstPtr operator()(const BarrierData_t &) const
+    {
+        return I3CLSimStepSeriesConstPtr();
+    }
+    
+    template <typename T>
+    I3CLSimStepSeriesConstPtr operator()(const T &data) const
+    {
+        I3CLSimStepSeriesPtr steps(new I3CLSimStepSeries(task_.numSteps));
+        
+        const double particleDir_x = data.particle.GetDir().GetX();
+        const double particleDir_y = data.particle.GetDir().GetY();
+        const double particleDir_z = data.particle.GetDir().GetZ();
+        
+        for (uint64_t i=0; i<task_.numSteps; ++i)
+        {
+            // the step after the last full one carries the remainder
+            const uint64_t photons = (task_.firstStep+i < data.numSteps) ?
+                data.photonsPerStep : data.numPhotonsInLastStep;
+            FillStep(data, (*steps)[i], photons, particleDir_x, particleDir_y, particleDir_z);
+        }
+        
+        return steps;
+    }
+    
+private:
+    // same distribution as GenerateStepPreCalculator::FeederThread()
+    void GetAngularCosSinValue(double &angular_cos, double &angular_sin, double &random_value) const
+    {
+        angular_cos=std::max(1.-std::pow(-std::log(1.-mwcRngRandomNumber_co(rngState_, taskRngA)*angularDist_I_)/angularDist_b, 1./angularDist_a), -1.);
+        angular_sin=std::sqrt(1.-angular_cos*angular_cos);
+        random_value=mwcRngRandomNumber_co(rngState_, taskRngA);
+    }
+    
+    void FillStep(const CascadeStepData_t &data, I3CLSimStep &newStep, uint64_t photonsPerStep,
+                  double particleDir_x, double particleDir_y, double particleDir_z) const
+    {
+        const double longitudinalPos = data.pb*gammaDistributedNumber(data.pa, rngState_, taskRngA)*I3Units::m;
+        double angular_cos, angular_sin, random_value;
+        GetAngularCosSinValue(angular_cos, angular_sin, random_value);
+        GenerateStep(newStep, data.particle,
+                     particleDir_x, particleDir_y, particleDir_z,
+                     data.particleIdentifier, photonsPerStep, longitudinalPos,
+                     angular_cos, angular_sin, random_value);
+    }
+    
+    void FillStep(const MuonStepData_t &data, I3CLSimStep &newStep, uint64_t photonsPerStep,
+                  double particleDir_x, double particleDir_y, double particleDir_z) const
+    {
+        if (data.stepIsCascadeLike) {
+            const double longitudinalPos = mwcRngRandomNumber_co(rngState_, taskRngA)*data.length;
+            double angular_cos, angular_sin, random_value;
+            GetAngularCosSinValue(angular_cos, angular_sin, random_value);
+            GenerateStep(newStep, data.particle,
+                         particleDir_x, particleDir_y, particleDir_z,
+                         data.particleIdentifier, photonsPerStep, longitudinalPos,
+                         angular_cos, angular_sin, random_value);
+        } else {
+            GenerateStepForMuon(newStep, data.particle,
+                                particleDir_x, particleDir_y, particleDir_z,
+                                data.particleIdentifier, photonsPerStep, data.length);
+        }
+    }
+    
+    const StepTask_t &task_;
+    mutable uint64_t rngState_;
+    const double angularDist_I_;
+};
+
+I3CLSimStepSeriesConstPtr I3CLSimLightSourceToStepConverterPPC::MakeStepsForTask(const StepTask_t &task) const
+{
+    return boost::apply_visitor(MakeTaskSteps_visitor(task), task.data);
+}
+
+
+
 /////// HELPERS
 
 I3CLSimLightSourceToStepConverterPPC::GenerateStepPreCalculator::GenerateStepPreCalculator(I3RandomServicePtr randomService,
@@ -835,6 +1086,20 @@ void I3CLSimLightSourceToStepConverterPPC::GenerateStep(I3CLSimStep &newStep,
     double angular_cos, angular_sin, random_value;
     preCalc.GetAngularCosSinValue(angular_cos, angular_sin, random_value);
     
+    GenerateStep(newStep, p,
+                 particleDir_x, particleDir_y, particleDir_z,
+                 identifier, photonsPerStep, longitudinalPos,
+                 angular_cos, angular_sin, random_value);
+}
+
+void I3CLSimLightSourceToStepConverterPPC::GenerateStep(I3CLSimStep &newStep,
+                                                        const I3Particle &p,
+                                                        double particleDir_x, double particleDir_y, double particleDir_z,
+                                                        uint32_t identifier,
+                                                        uint32_t photonsPerStep,
+                                                        const double &longitudinalPos,
+                                                        double angular_cos, double angular_sin, double random_value)
+{
     double step_dx = particleDir_x;
     double step_dy = particleDir_y;
     double step_dz = particleDir_z;
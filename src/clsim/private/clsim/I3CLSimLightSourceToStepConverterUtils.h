@@ -60,6 +60,30 @@ namespace I3CLSimLightSourceToStepConverterUtils
         return x;
     }
     
+    // SplitMix64 finalizer. Maps a counter (e.g. a seed plus a task
+    // number) to a well-mixed 64 bit value, suitable for deriving
+    // independent, reproducible sub-stream seeds.
+    inline uint64_t splitMix64(uint64_t x)
+    {
+        x += 0x9e3779b97f4a7c15ull;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+
+    // same as above, but deterministically derived from a 64 bit seed
+    // instead of drawing from a random service
+    inline uint64_t mwcRngInitState(uint64_t seed, uint32_t a)
+    {
+        uint64_t x=0;
+        while( (x==0) | (((uint32_t)(x>>32))>=(a-1)) | (((uint32_t)x)>=0xfffffffful))
+        {
+            seed = splitMix64(seed);
+            x = seed;
+        }
+        return x;
+    }
+
     inline double mwcRngRandomNumber_co(uint64_t &state, uint32_t a)
     {
         state=(state&0xfffffffful)*a+(state>>32);
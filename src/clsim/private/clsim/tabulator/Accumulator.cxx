@@ -0,0 +1,208 @@
+/**
+ * Copyright (c) 2016
+ * the IceCube Collaboration <http://www.icecube.wisc.edu>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *
+ * @file Accumulator.cxx
+ */
+
+#include "clsim/tabulator/Accumulator.h"
+
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace clsim {
+
+namespace tabulator {
+
+Accumulator::Accumulator(size_t nbins, unsigned nthreads, size_t maxPendingBatches,
+    const std::string &scratchFile)
+    : nbins_(nbins), binContent_(NULL), mappedSize_(0),
+    freeBatches_(std::max(maxPendingBatches, size_t(1))), finished_(false)
+{
+	if (scratchFile.empty() || nbins == 0) {
+		memory_.resize(nbins, 0.f);
+		binContent_ = nbins > 0 ? &memory_[0] : NULL;
+	} else {
+		// A new file is all zeros, and is only allocated on disk as
+		// bins are actually touched
+		int fd = open(scratchFile.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (fd < 0)
+			log_fatal_stream("Could not create " << scratchFile << ": " << strerror(errno));
+		const size_t size = nbins*sizeof(float);
+		void *map = MAP_FAILED;
+		if (ftruncate(fd, size) == 0)
+			map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		int err = errno;
+		close(fd);
+		unlink(scratchFile.c_str());
+		if (map == MAP_FAILED)
+			log_fatal_stream("Could not map " << size << " bytes of " << scratchFile << ": " << strerror(err));
+		binContent_ = static_cast<float*>(map);
+		mappedSize_ = size;
+		log_debug_stream("Accumulating in " << scratchFile);
+	}
+	
+	for (size_t i=0; i < std::max(maxPendingBatches, size_t(1)); i++)
+		freeBatches_.Put(boost::make_shared<Batch>());
+	
+	if (nthreads < 2) {
+		shardSize_ = nbins;
+		return;
+	}
+	if (nthreads > nbins)
+		nthreads = nbins;
+	
+	shardSize_ = (nbins + nthreads - 1)/nthreads;
+	for (unsigned i=0; i < nthreads; i++)
+		queues_.push_back(boost::make_shared<queue_t>(maxPendingBatches));
+	for (unsigned i=0; i < nthreads; i++)
+		workers_.create_thread(boost::bind(&Accumulator::Accumulate, this, i));
+	
+	log_debug_stream("Accumulating "<<nbins<<" bins in "<<nthreads
+	    <<" shards of "<<shardSize_);
+}
+
+Accumulator::~Accumulator()
+{
+	Finish();
+	if (mappedSize_ > 0)
+		munmap(binContent_, mappedSize_);
+}
+
+Accumulator::batch_ptr
+Accumulator::GetBatch(size_t streams, size_t entriesPerStream)
+{
+	batch_ptr batch = freeBatches_.Get();
+	batch->entries.resize(streams*entriesPerStream);
+	batch->counts.resize(streams);
+	batch->streams = streams;
+	batch->entriesPerStream = entriesPerStream;
+	
+	return batch;
+}
+
+void
+Accumulator::Fill(const batch_ptr &batch)
+{
+	if (finished_)
+		log_fatal("Can't add entries after Finish() has been called");
+	
+	if (queues_.empty()) {
+		for (size_t i = 0; i < batch->streams; i++) {
+			const I3CLSimTableEntry *entry = &batch->entries[i*batch->entriesPerStream];
+			for (const I3CLSimTableEntry *end = entry + batch->counts[i]; entry != end; entry++)
+				binContent_[entry->index] += entry->weight;
+		}
+		freeBatches_.Put(batch);
+		return;
+	}
+	
+	// Sort the entries into one bucket per shard, in two passes over the
+	// batch: count, then copy each entry to the end of its bucket.
+	const size_t nshards = queues_.size();
+	std::vector<size_t> &offsets = batch->offsets;
+	offsets.assign(nshards+1, 0);
+	for (size_t i = 0; i < batch->streams; i++) {
+		const I3CLSimTableEntry *entry = &batch->entries[i*batch->entriesPerStream];
+		for (const I3CLSimTableEntry *end = entry + batch->counts[i]; entry != end; entry++)
+			if (entry->index < nbins_)
+				offsets[entry->index/shardSize_ + 1]++;
+	}
+	for (size_t shard = 0; shard < nshards; shard++)
+		offsets[shard+1] += offsets[shard];
+	
+	batch->buckets.resize(offsets[nshards]);
+	std::vector<size_t> next(offsets.begin(), offsets.end()-1);
+	for (size_t i = 0; i < batch->streams; i++) {
+		const I3CLSimTableEntry *entry = &batch->entries[i*batch->entriesPerStream];
+		for (const I3CLSimTableEntry *end = entry + batch->counts[i]; entry != end; entry++)
+			if (entry->index < nbins_)
+				batch->buckets[next[entry->index/shardSize_]++] = *entry;
+	}
+	
+	batch->pending = nshards;
+	for (size_t shard = 0; shard < nshards; shard++)
+		queues_[shard]->Put(batch);
+}
+
+void
+Accumulator::Finish()
+{
+	if (finished_)
+		return;
+	finished_ = true;
+	
+	// An empty batch pointer tells the worker to exit
+	for (size_t shard = 0; shard < queues_.size(); shard++)
+		queues_[shard]->Put(batch_ptr());
+	workers_.join_all();
+}
+
+void
+Accumulator::Release(const batch_ptr &batch)
+{
+	boost::mutex::scoped_lock lock(pendingMutex_);
+	if (--batch->pending == 0)
+		freeBatches_.Put(batch);
+}
+
+void
+Accumulator::Accumulate(unsigned shard)
+{
+	queue_t &queue = *queues_[shard];
+	float *bins = binContent_;
+	
+	for (;;) {
+		batch_ptr batch = queue.Get();
+		if (!batch)
+			return;
+		const std::vector<I3CLSimTableEntry> &bucket = batch->buckets;
+		for (size_t i = batch->offsets[shard]; i < batch->offsets[shard+1]; i++)
+			bins[bucket[i].index] += bucket[i].weight;
+		Release(batch);
+	}
+}
+
+void
+Accumulator::Evict(size_t begin, size_t end)
+{
+	if (mappedSize_ == 0)
+		return;
+	
+	// Only whole pages can be dropped
+	const uintptr_t page = sysconf(_SC_PAGESIZE);
+	const uintptr_t first = (uintptr_t(binContent_ + begin) + page - 1) & ~(page - 1);
+	const uintptr_t last = uintptr_t(binContent_ + std::min(end, nbins_)) & ~(page - 1);
+	if (last <= first)
+		return;
+	
+	// Dirty pages of a shared mapping stay in the page cache until they
+	// are written back, so nothing is lost here
+	if (madvise(reinterpret_cast<void*>(first), last - first, MADV_DONTNEED) != 0)
+		log_warn_stream("Could not evict bins " << begin << "-" << end << ": " << strerror(errno));
+}
+
+}
+
+}
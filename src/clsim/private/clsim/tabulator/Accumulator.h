@@ -0,0 +1,146 @@
+/**
+ * Copyright (c) 2016
+ * the IceCube Collaboration <http://www.icecube.wisc.edu>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *
+ * @file Accumulator.h
+ */
+
+#ifndef CLSIM_TABULATOR_ACCUMULATOR_H_INCLUDED
+#define CLSIM_TABULATOR_ACCUMULATOR_H_INCLUDED
+
+#include "icetray/I3PointerTypedefs.h"
+#include "icetray/I3Logging.h"
+#include "clsim/I3CLSimQueue.h"
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+/// A single bin entry, as written by the tabulation kernel
+struct I3CLSimTableEntry {
+	uint32_t index;
+	float weight;
+} __attribute__ ((packed));
+
+namespace clsim {
+
+namespace tabulator {
+
+/**
+ * @brief Sums weighted bin entries into a dense bin-content array.
+ *
+ * The bin-content array is split into contiguous index ranges (shards),
+ * each of which is owned by exactly one worker thread. Fill() sorts the
+ * entries of a kernel invocation by shard once, keeping their order within
+ * each shard, and each worker then sums only its own bucket. No two threads
+ * ever write to the same bin, so the inner loop needs neither locks nor
+ * atomics, and every bin receives its entries in the same order as with a
+ * single thread. With a single thread the entries are accumulated directly
+ * in the calling thread.
+ *
+ * The array can be kept in a scratch file instead of anonymous memory, in
+ * which case only the pages currently being written have to be resident,
+ * and tables larger than the available RAM can be built.
+ */
+class Accumulator : boost::noncopyable {
+public:
+	/// @param nbins total number of bins in the table
+	/// @param nthreads number of worker threads (and shards)
+	/// @param maxPendingBatches number of batches that may be waiting to
+	///        be summed before GetBatch() blocks
+	/// @param scratchFile if not empty, map the bin content from this
+	///        (newly created) file rather than holding it in memory. The
+	///        file is removed again as soon as it is mapped.
+	Accumulator(size_t nbins, unsigned nthreads, size_t maxPendingBatches=4,
+	    const std::string &scratchFile="");
+	~Accumulator();
+	
+	/**
+	 * The entries recorded by a kernel invocation. The entries for
+	 * stream i are entries[i*entriesPerStream, i*entriesPerStream+counts[i]).
+	 */
+	struct Batch {
+		std::vector<I3CLSimTableEntry> entries;
+		std::vector<uint32_t> counts;
+		size_t streams;
+		size_t entriesPerStream;
+		// entries sorted by shard. Those for shard i are
+		// buckets[offsets[i], offsets[i+1]).
+		std::vector<I3CLSimTableEntry> buckets;
+		std::vector<size_t> offsets;
+		// number of shards that have not summed this batch yet
+		unsigned pending;
+	};
+	typedef boost::shared_ptr<Batch> batch_ptr;
+	
+	/**
+	 * Get an unused batch with room for the given number of streams to
+	 * read entries into. Blocks until one of the maxPendingBatches batches
+	 * has been summed by all workers.
+	 */
+	batch_ptr GetBatch(size_t streams, size_t entriesPerStream);
+	
+	/// Add the entries in a batch obtained from GetBatch()
+	void Fill(const batch_ptr &batch);
+	
+	/// Wait for all queued entries to be summed and stop the workers
+	void Finish();
+	
+	/**
+	 * Hint that bins [begin, end) will not be touched again for a while.
+	 * For a table kept in a scratch file, their pages are dropped from
+	 * memory once written back, and read in again if they are accessed.
+	 */
+	void Evict(size_t begin, size_t end);
+	
+	size_t GetNShards() const { return queues_.size(); }
+	size_t GetNBins() const { return nbins_; }
+	float* GetBinContent() { return binContent_; }
+	const float* GetBinContent() const { return binContent_; }
+	
+private:
+	typedef I3CLSimQueue<batch_ptr> queue_t;
+	
+	void Accumulate(unsigned shard);
+	void Release(const batch_ptr &batch);
+	
+	size_t nbins_;
+	float *binContent_;
+	// backing store if the table is held in memory
+	std::vector<float> memory_;
+	// size of the mapping if the table is held in a scratch file
+	size_t mappedSize_;
+	size_t shardSize_;
+	std::vector<boost::shared_ptr<queue_t> > queues_;
+	queue_t freeBatches_;
+	boost::mutex pendingMutex_;
+	boost::thread_group workers_;
+	bool finished_;
+	
+	SET_LOGGER("I3CLSimStepToTableConverter");
+};
+
+I3_POINTER_TYPEDEFS(Accumulator);
+
+}
+
+}
+
+#endif // CLSIM_TABULATOR_ACCUMULATOR_H_INCLUDED
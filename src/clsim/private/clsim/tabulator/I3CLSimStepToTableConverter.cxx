@@ -55,11 +55,6 @@ loadKernel(const std::string& name, bool header)
     return I3CLSimHelper::LoadProgramSource(kernelBaseDir+name+ext);
 }
 
-struct I3CLSimTableEntry {
-	uint32_t index;
-	float weight;
-} __attribute__ ((packed));
-
 struct I3CLSimReferenceParticle {
 	I3CLSimReferenceParticle(const I3Particle &source) {
 		((cl_float *)(&posAndTime))[0] = source.GetPos().GetX();
@@ -121,7 +116,8 @@ I3CLSimStepToTableConverter::I3CLSimStepToTableConverter(I3CLSimOpenCLDevice dev
     clsim::tabulator::AxesConstPtr axes, size_t entriesPerStream,
     I3CLSimMediumPropertiesConstPtr mediumProperties, I3CLSimSpectrumTableConstPtr spectrumTable,
     I3CLSimFunctionConstPtr wavelengthAcceptance, I3CLSimFunctionConstPtr angularAcceptance,
-    I3RandomServicePtr rng) : entriesPerStream_(entriesPerStream), stepQueue_(1), run_(true),
+    I3RandomServicePtr rng, unsigned accumulatorThreads,
+    const std::string &scratchFile) : entriesPerStream_(entriesPerStream), stepQueue_(1), run_(true),
     domArea_(M_PI*std::pow(0.16510*I3Units::m, 2)), stepLength_(1.), axes_(axes),
     numPhotons_(0), sumOfPhotonWeights_(0.)
 {
@@ -203,7 +199,8 @@ I3CLSimStepToTableConverter::I3CLSimStepToTableConverter(I3CLSimOpenCLDevice dev
 	sources.push_back(axes_->GenerateBinningCode());
 	sources.push_back(loadKernel("propagation_kernel", false));
 	
-	binContent_.resize(axes_->GetNBins());
+	accumulator_ = boost::make_shared<clsim::tabulator::Accumulator>(
+	    axes_->GetNBins(), accumulatorThreads, 4, scratchFile);
 	
 #ifndef NDEBUG
 	std::stringstream source;
@@ -285,6 +282,7 @@ I3CLSimStepToTableConverter::Finish()
 		log_debug("Finish");
 		harvesterThread_.join();
 	}
+	accumulator_->Finish();
 }
 
 namespace {
@@ -394,8 +392,6 @@ I3CLSimStepToTableConverter::FetchSteps(cl::Kernel kernel, I3RandomServicePtr rn
 	kernel.setArg(args++, buffers.mwc.a);
 	
 	I3CLSimStepSeries osteps(maxNumWorkitems_);
-	std::vector<uint32_t> numEntries(maxNumWorkitems_);
-	std::vector<I3CLSimTableEntry> tableEntries(maxNumWorkitems_*entriesPerStream_);
 	
 	KernelStatistics stats;
 	
@@ -445,12 +441,16 @@ I3CLSimStepToTableConverter::FetchSteps(cl::Kernel kernel, I3RandomServicePtr rn
 			throw;
 		}
 	
+		// Read the entries straight into a batch that the accumulator
+		// threads can share
+		clsim::tabulator::Accumulator::batch_ptr batch =
+		    accumulator_->GetBatch(items, entriesPerStream_);
 		commandQueue_.enqueueReadBuffer(buffers.inputSteps, CL_FALSE, 0,
 		    items*sizeof(I3CLSimStep), &osteps[0], &kernelFinished, &buffersRead[0]);
 		commandQueue_.enqueueReadBuffer(buffers.numEntries, CL_FALSE, 0,
-		    items*sizeof(uint32_t), &numEntries[0], &kernelFinished, &buffersRead[1]);
+		    items*sizeof(uint32_t), &batch->counts[0], &kernelFinished, &buffersRead[1]);
 		commandQueue_.enqueueReadBuffer(buffers.outputEntries, CL_FALSE, 0,
-		    items*entriesPerStream_*sizeof(I3CLSimTableEntry), &tableEntries[0], &kernelFinished, &buffersRead[2]);
+		    items*entriesPerStream_*sizeof(I3CLSimTableEntry), &batch->entries[0], &kernelFinished, &buffersRead[2]);
 
 		commandQueue_.flush();
 	
@@ -482,29 +482,25 @@ I3CLSimStepToTableConverter::FetchSteps(cl::Kernel kernel, I3RandomServicePtr rn
 		}
 		
 
-		for (size_t i = 0; i < items; i++) {
-			size_t size = numEntries[i];
-			size_t offset = i*entriesPerStream_;
-			for (size_t j = 0; j < size; j++) {
-				binContent_[tableEntries[offset+j].index] += tableEntries[offset+j].weight;
-			}
-		}
+		accumulator_->Fill(batch);
 		
 		stats.Record(kernelFinished[0], n_photons, real_steps, misses);
 	} // while (1)
 }
 
 void
-I3CLSimStepToTableConverter::Normalize()
+I3CLSimStepToTableConverter::Normalize(size_t begin, size_t end)
 {
 	const unsigned ndim = axes_->GetNDim();
 	const std::vector<size_t> shape = axes_->GetShape();
 	const std::vector<size_t> strides = axes_->GetStrides();
 	std::vector<size_t> idxs(ndim);
+	float *binContent = accumulator_->GetBinContent();
 
 	// NB: assume that the first 3 dimensions are spatial
 	const size_t spatial_stride = strides[2];
-	for (size_t offset = 0; offset < binContent_.size(); offset += spatial_stride) {
+	assert(begin % spatial_stride == 0);
+	for (size_t offset = begin; offset < end; offset += spatial_stride) {
 		// unravel index
 		for (unsigned j=0; j < ndim; j++)
 			idxs[j] = offset/strides[j] % shape[j];
@@ -513,7 +509,7 @@ I3CLSimStepToTableConverter::Normalize()
 		// apply volume normalization to each spatial cell
 		double norm = axes_->GetBinVolume(idxs)/(stepLength_*domArea_);
 		for (size_t i=0; i < spatial_stride; i++)
-			binContent_[i+offset] /= norm;
+			binContent[i+offset] /= norm;
 	}
 }
 
@@ -547,17 +543,28 @@ void I3CLSimStepToTableConverter::WriteFITSFile(const std::string &path, boost::
 	}
 	
 	/*
-	 * Write bin content
+	 * Normalize and write bin content in chunks of whole spatial cells,
+	 * so that the pages of each chunk are still hot when handed to cfitsio
 	 */
-	Normalize();
 	{
-		std::vector<long> fpixel(axes_->GetNDim(), 1);
-		fits_write_pix(fits, TFLOAT, &fpixel[0], binContent_.size(),
-		    &binContent_[0], &error);
-		if (error != 0) {
-			char err_text[30];
-			fits_get_errstatus(error, err_text);
-			log_fatal_stream("Could not fill image: " << err_text);
+		float *binContent = accumulator_->GetBinContent();
+		const size_t nbins = accumulator_->GetNBins();
+		const size_t spatial_stride = axes_->GetStrides()[2];
+		const size_t chunk = spatial_stride*std::max(size_t(1),
+		    (size_t(1)<<22)/spatial_stride);
+		for (size_t offset = 0; offset < nbins; offset += chunk) {
+			size_t end = std::min(offset+chunk, nbins);
+			Normalize(offset, end);
+			fits_write_img(fits, TFLOAT, offset+1, end-offset,
+			    &binContent[offset], &error);
+			if (error != 0) {
+				char err_text[30];
+				fits_get_errstatus(error, err_text);
+				log_fatal_stream("Could not fill image: " << err_text);
+			}
+			// cfitsio has its own copy now. For a table kept in a scratch
+			// file, the chunk no longer has to stay in memory.
+			accumulator_->Evict(offset, end);
 		}
 	}
 	
@@ -36,6 +36,7 @@
 #include "dataclasses/physics/I3Particle.h"
 
 #include "clsim/tabulator/Axes.h"
+#include "clsim/tabulator/Accumulator.h"
 
 #define __CL_ENABLE_EXCEPTIONS
 #include "clsim/cl.hpp"
@@ -51,7 +52,8 @@ public:
 	    I3CLSimSpectrumTableConstPtr spectrumTable,
 	    I3CLSimFunctionConstPtr wavelengthAcceptance,
 	    I3CLSimFunctionConstPtr angularAcceptance,
-	    I3RandomServicePtr rng);
+	    I3RandomServicePtr rng, unsigned accumulatorThreads=1,
+	    const std::string &scratchFile="");
 	virtual ~I3CLSimStepToTableConverter();
 	void EnqueueSteps(I3CLSimStepSeriesConstPtr, I3ParticleConstPtr);
 	void Finish();
@@ -65,7 +67,9 @@ private:
 	void FetchSteps(cl::Kernel, I3RandomServicePtr);
 	
 	float GetBinVolume(size_t i);
-	void Normalize();
+	/// Apply volume normalization to bins [begin, end). Both bounds
+	/// must be multiples of the stride of the last spatial dimension.
+	void Normalize(size_t begin, size_t end);
 	
 	cl::Context context_;
 	cl::CommandQueue commandQueue_;
@@ -82,7 +86,7 @@ private:
 	std::pair<double, double> minimumRefractiveIndex_;
 	
 	clsim::tabulator::AxesConstPtr axes_;
-	std::vector<float> binContent_;
+	clsim::tabulator::AccumulatorPtr accumulator_;
 	// double rather than an integer because steps have weights
 	uint64_t numPhotons_;
 	double sumOfPhotonWeights_;
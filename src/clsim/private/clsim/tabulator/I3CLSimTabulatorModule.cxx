@@ -68,6 +68,8 @@ private:
 	I3CLSimSpectrumTableConstPtr spectrumTable_;
 	I3CLSimOpenCLDeviceSeries openCLDeviceList_;
 	size_t photonsPerBunch_, entriesPerPhoton_;
+	unsigned accumulatorThreads_;
+	std::string scratchFile_;
 	
 	I3CLSimLightSourceToStepConverterPtr particleToStepsConverter_;
 	I3CLSimStepToTableConverterPtr tabulator_;
@@ -105,6 +107,12 @@ I3CLSimTabulatorModule::I3CLSimTabulatorModule(const I3Context &ctx)
 	AddParameter("OpenCLDeviceList", "", openCLDeviceList_);
 	AddParameter("PhotonsPerBunch", "", 200);
 	AddParameter("EntriesPerPhoton", "", 3000);
+	AddParameter("AccumulatorThreads", "Number of threads used to sum "
+	    "photon paths into the table. Each thread owns a contiguous slice "
+	    "of the bin content array.", 1u);
+	AddParameter("ScratchFile", "If set, keep the table in this (new) file "
+	    "while it is being filled, rather than in memory. This allows "
+	    "tables larger than the available RAM.", "");
 	AddParameter("Filename", "", "");
 	AddParameter("TableHeader", "", boost::python::dict());
 	AddParameter("Axes", "", axes_);
@@ -123,6 +131,8 @@ void I3CLSimTabulatorModule::Configure()
 	GetParameter("OpenCLDeviceList",openCLDeviceList_);
 	GetParameter("PhotonsPerBunch", photonsPerBunch_);
 	GetParameter("EntriesPerPhoton", entriesPerPhoton_);
+	GetParameter("AccumulatorThreads", accumulatorThreads_);
+	GetParameter("ScratchFile", scratchFile_);
 	GetParameter("Filename", tablePath_);
 	GetParameter("TableHeader", tableHeader_);
 	GetParameter("Axes", axes_);
@@ -141,7 +151,8 @@ void I3CLSimTabulatorModule::Configure()
 	tabulator_ = boost::make_shared<I3CLSimStepToTableConverter>(
 	    openCLDeviceList_[0], axes_, entriesPerPhoton_*photonsPerBunch_,
 	    mediumProperties_, spectrumTable_,
-	    wavelengthGenerationBias_, angularAcceptance_, randomService_);
+	    wavelengthGenerationBias_, angularAcceptance_, randomService_,
+	    accumulatorThreads_, scratchFile_);
 	
 	particleToStepsConverter_ =
 	    I3CLSimModuleHelper::initializeGeant4(randomService_,
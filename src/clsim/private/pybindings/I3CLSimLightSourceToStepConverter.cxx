@@ -235,6 +235,9 @@ void register_I3CLSimLightSourceToStepConverter()
            )
          )
         .def("SetUseCascadeExtension", &I3CLSimLightSourceToStepConverterPPC::SetUseCascadeExtension)
+        .def("SetNumParallelThreads", &I3CLSimLightSourceToStepConverterPPC::SetNumParallelThreads)
+        .def("GetNumParallelThreads", &I3CLSimLightSourceToStepConverterPPC::GetNumParallelThreads)
+        .add_property("NumParallelThreads", &I3CLSimLightSourceToStepConverterPPC::GetNumParallelThreads, &I3CLSimLightSourceToStepConverterPPC::SetNumParallelThreads)
         ;
     }
     
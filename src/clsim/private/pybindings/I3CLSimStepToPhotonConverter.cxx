@@ -183,6 +183,12 @@ void register_I3CLSimStepToPhotonConverter()
         .def("SetDOMPancakeFactor", &I3CLSimStepToPhotonConverterOpenCLWrapper::SetDOMPancakeFactor)
         .def("GetDOMPancakeFactor", &I3CLSimStepToPhotonConverterOpenCLWrapper::GetDOMPancakeFactor)
 
+        .def("GetTotalDeviceTime", &I3CLSimStepToPhotonConverterOpenCLWrapper::GetTotalDeviceTime)
+        .def("GetTotalHostTime", &I3CLSimStepToPhotonConverterOpenCLWrapper::GetTotalHostTime)
+        .def("GetNumKernelCalls", &I3CLSimStepToPhotonConverterOpenCLWrapper::GetNumKernelCalls)
+        .def("GetTotalNumPhotonsGenerated", &I3CLSimStepToPhotonConverterOpenCLWrapper::GetTotalNumPhotonsGenerated)
+        .def("GetTotalNumPhotonsAtDOMs", &I3CLSimStepToPhotonConverterOpenCLWrapper::GetTotalNumPhotonsAtDOMs)
+
         
         .add_property("workgroupSize", &I3CLSimStepToPhotonConverterOpenCLWrapper::GetWorkgroupSize, &I3CLSimStepToPhotonConverterOpenCLWrapper::SetWorkgroupSize)
         .add_property("maxNumWorkitems", &I3CLSimStepToPhotonConverterOpenCLWrapper::GetMaxNumWorkitems, &I3CLSimStepToPhotonConverterOpenCLWrapper::SetMaxNumWorkitems)
@@ -194,6 +200,12 @@ void register_I3CLSimStepToPhotonConverter()
         .add_property("photonHistoryEntries", &I3CLSimStepToPhotonConverterOpenCLWrapper::GetPhotonHistoryEntries, &I3CLSimStepToPhotonConverterOpenCLWrapper::SetPhotonHistoryEntries)
         .add_property("fixedNumberOfAbsorptionLengths", &I3CLSimStepToPhotonConverterOpenCLWrapper::GetFixedNumberOfAbsorptionLengths, &I3CLSimStepToPhotonConverterOpenCLWrapper::SetFixedNumberOfAbsorptionLengths)
         .add_property("DOMPancakeFactor", &I3CLSimStepToPhotonConverterOpenCLWrapper::GetDOMPancakeFactor, &I3CLSimStepToPhotonConverterOpenCLWrapper::SetDOMPancakeFactor)
+
+        .add_property("totalDeviceTime", &I3CLSimStepToPhotonConverterOpenCLWrapper::GetTotalDeviceTime)
+        .add_property("totalHostTime", &I3CLSimStepToPhotonConverterOpenCLWrapper::GetTotalHostTime)
+        .add_property("numKernelCalls", &I3CLSimStepToPhotonConverterOpenCLWrapper::GetNumKernelCalls)
+        .add_property("totalNumPhotonsGenerated", &I3CLSimStepToPhotonConverterOpenCLWrapper::GetTotalNumPhotonsGenerated)
+        .add_property("totalNumPhotonsAtDOMs", &I3CLSimStepToPhotonConverterOpenCLWrapper::GetTotalNumPhotonsAtDOMs)
         ;
     }
     
@@ -26,6 +26,7 @@
 
 #include "clsim/tabulator/Axis.h"
 #include "clsim/tabulator/Axes.h"
+#include "clsim/tabulator/Accumulator.h"
 
 namespace bp = boost::python;
 
@@ -70,6 +71,62 @@ void register_Axes()
 	;
 }
 
+namespace {
+
+// Add a list of streams, each a list of (index, weight) pairs, as if they
+// had been returned by one kernel invocation
+void
+Accumulator_Fill(clsim::tabulator::Accumulator &self, bp::object streams)
+{
+	const size_t nstreams = bp::len(streams);
+	size_t entriesPerStream = 1;
+	for (size_t i = 0; i < nstreams; i++)
+		entriesPerStream = std::max(entriesPerStream, size_t(bp::len(streams[i])));
+	
+	clsim::tabulator::Accumulator::batch_ptr batch =
+	    self.GetBatch(nstreams, entriesPerStream);
+	for (size_t i = 0; i < nstreams; i++) {
+		bp::object stream = streams[i];
+		batch->counts[i] = bp::len(stream);
+		for (size_t j = 0; j < batch->counts[i]; j++) {
+			I3CLSimTableEntry &entry = batch->entries[i*entriesPerStream + j];
+			entry.index = bp::extract<uint32_t>(stream[j][0]);
+			entry.weight = bp::extract<float>(stream[j][1]);
+		}
+	}
+	self.Fill(batch);
+}
+
+bp::list
+Accumulator_GetBinContent(const clsim::tabulator::Accumulator &self)
+{
+	bp::list binContent;
+	const float *bins = self.GetBinContent();
+	for (size_t i = 0; i < self.GetNBins(); i++)
+		binContent.append(bins[i]);
+	return binContent;
+}
+
+}
+
+void register_Accumulator()
+{
+	using namespace clsim::tabulator;
+	
+	bp::class_<Accumulator, boost::shared_ptr<Accumulator>, boost::noncopyable>
+	    ("Accumulator", bp::init<size_t,unsigned,size_t,std::string>(
+	     (bp::arg("nbins"),"nthreads",bp::arg("maxPendingBatches")=4,bp::arg("scratchFile")=""),
+	     "Create an accumulator for *nbins* bins, summed in *nthreads* shards"))
+	    .def("Fill", &Accumulator_Fill, bp::arg("streams"),
+	     "Add a list of streams of (index, weight) pairs")
+	    .def("Finish", &Accumulator::Finish,
+	     "Wait for all entries to be summed")
+	    .def("GetBinContent", &Accumulator_GetBinContent,
+	     "Get a copy of the bin content. Call Finish() first.")
+	    .add_property("nshards", &Accumulator::GetNShards)
+	;
+}
+
 void register_tabulator()
 {
 	// Put all tabulator-related classes in a submodule
@@ -82,5 +139,6 @@ void register_tabulator()
 	
 	register_Axis();
 	register_Axes();
+	register_Accumulator();
 }
 
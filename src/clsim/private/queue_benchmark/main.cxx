@@ -0,0 +1,128 @@
+/**
+ * Copyright (c) 2016
+ * the IceCube Collaboration <http://www.icecube.wisc.edu>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *
+ * @file main.cxx
+ * @brief Contention benchmark for I3CLSimQueue
+ *
+ * Pushes shared pointers through a queue from P producer threads to C
+ * consumer threads and reports the throughput for the mutex-based queue,
+ * the lock-free queue and the lock-free queue with batched dequeue, all
+ * with the same capacity. Usage:
+ *
+ *   clsim-queue_benchmark [producers] [consumers] [items] [capacity] [batch]
+ */
+
+#include <icetray/I3Logging.h>
+#include "clsim/I3CLSimQueue.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+namespace {
+
+typedef boost::shared_ptr<std::size_t> item_t;
+
+void Produce(I3CLSimQueue<item_t> &queue, std::size_t items)
+{
+	for (std::size_t i = 0; i < items; i++)
+		queue.Put(item_t(new std::size_t(i)));
+}
+
+void Consume(I3CLSimQueue<item_t> &queue, std::size_t batch, std::size_t &sum)
+{
+	std::vector<item_t> values;
+	for (;;) {
+		values.clear();
+		if (batch > 1)
+			queue.GetBatch(values, batch);
+		else
+			values.push_back(queue.Get());
+		bool done = false;
+		for (std::vector<item_t>::const_iterator it = values.begin(); it != values.end(); it++) {
+			if (*it) {
+				sum += **it;
+			} else if (!done) {
+				done = true;
+			} else {
+				// this stop signal was meant for someone else
+				queue.Put(item_t());
+			}
+		}
+		if (done)
+			return;
+	}
+}
+
+double Run(std::size_t capacity, bool lockFree, unsigned producers,
+    unsigned consumers, std::size_t items, std::size_t batch)
+{
+	I3CLSimQueue<item_t> queue(capacity, lockFree);
+	std::vector<std::size_t> sums(consumers, 0);
+	boost::thread_group producerThreads, consumerThreads;
+	
+	const boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+	for (unsigned i = 0; i < consumers; i++)
+		consumerThreads.create_thread(boost::bind(&Consume, boost::ref(queue), batch, boost::ref(sums[i])));
+	for (unsigned i = 0; i < producers; i++)
+		producerThreads.create_thread(boost::bind(&Produce, boost::ref(queue), items/producers));
+	producerThreads.join_all();
+	// an empty pointer tells a consumer to stop
+	for (unsigned i = 0; i < consumers; i++)
+		queue.Put(item_t());
+	consumerThreads.join_all();
+	const boost::posix_time::ptime end = boost::posix_time::microsec_clock::universal_time();
+	
+	std::size_t sum = 0, expected = 0;
+	for (unsigned i = 0; i < consumers; i++)
+		sum += sums[i];
+	for (std::size_t i = 0; i < items/producers; i++)
+		expected += i;
+	expected *= producers;
+	if (sum != expected)
+		log_fatal("Lost items: checksum %zu != %zu", sum, expected);
+	
+	return double((items/producers)*producers)/(1e-6*double((end-start).total_microseconds()));
+}
+
+}
+
+int main (int argc, char const *argv[])
+{
+	const unsigned producers = (argc > 1) ? atoi(argv[1]) : 4;
+	const unsigned consumers = (argc > 2) ? atoi(argv[2]) : 4;
+	const std::size_t items = (argc > 3) ? atol(argv[3]) : 1000000;
+	const std::size_t capacity = (argc > 4) ? atol(argv[4]) : 64;
+	const std::size_t batch = (argc > 5) ? atol(argv[5]) : 16;
+	
+	if (producers == 0 || consumers == 0 || capacity < 2)
+		log_fatal("Need at least one producer, one consumer and a capacity of at least 2");
+	
+	printf("# producers consumers items capacity batch\n");
+	printf("# %u %u %zu %zu %zu\n", producers, consumers, items, capacity, batch);
+	printf("# queue items/s\n");
+	printf("mutex %.4g\n", Run(capacity, false, producers, consumers, items, 1));
+	printf("mutex_batch %.4g\n", Run(capacity, false, producers, consumers, items, batch));
+	printf("lockfree %.4g\n", Run(capacity, true, producers, consumers, items, 1));
+	printf("lockfree_batch %.4g\n", Run(capacity, true, producers, consumers, items, batch));
+	
+	return 0;
+}
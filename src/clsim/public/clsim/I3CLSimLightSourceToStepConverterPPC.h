@@ -67,6 +67,19 @@ public:
 
     void SetUseCascadeExtension(bool v) { useCascadeExtension_ = v; };
 
+    /**
+     * Generate steps on a pool of numThreads worker threads instead of in
+     * the thread calling GetConversionResult(). Light sources are split
+     * into chunks of at most MaxBunchSize steps, and each chunk draws its
+     * random numbers from its own sub-stream, seeded from the random
+     * service when the light source is enqueued. The steps are therefore
+     * identical for any number of threads. In this mode new light sources
+     * may be enqueued while a barrier is still active.
+     * A value of 0 (the default) keeps the single-threaded behavior.
+     */
+    void SetNumParallelThreads(unsigned int numThreads);
+    unsigned int GetNumParallelThreads() const { return numParallelThreads_; };
+
     // inherited:
     
     virtual void SetBunchSizeGranularity(uint64_t num);
@@ -122,8 +135,45 @@ private:
     
     std::deque<StepData_t> stepGenerationQueue_;
     
+    // adds a step generation entry to the queue (or the worker pool)
+    void EnqueueStepData(const StepData_t &data);
+    
     // forward declaration
     class GenerateStepPreCalculator;
+    
+    ///////////////
+    // parallel step generation
+    
+    // a chunk of at most maxBunchSize_ consecutive steps of one entry
+    struct StepTask_t {
+        StepData_t data;
+        uint64_t sequence;
+        uint64_t firstStep;
+        uint64_t numSteps;
+        uint64_t seed;
+    };
+    typedef boost::shared_ptr<StepTask_t> StepTaskPtr;
+    
+    void WorkerThread();
+    I3CLSimStepSeriesConstPtr MakeStepsForTask(const StepTask_t &task) const;
+    I3CLSimStepSeriesConstPtr GetParallelResult(bool &barrierWasReset);
+    void StopWorkerThreads();
+    
+    class MakeTaskSteps_visitor;
+    
+    unsigned int numParallelThreads_;
+    boost::thread_group workerThreads_;
+    I3CLSimQueue<StepTaskPtr> taskQueue_;
+    // finished chunks by sequence number; a NULL pointer is a barrier
+    std::map<uint64_t, I3CLSimStepSeriesConstPtr> finishedTasks_;
+    uint64_t nextSequence_;
+    uint64_t nextSequenceToReturn_;
+    // how far ahead of the consumer the workers may run
+    uint64_t maxTasksInFlight_;
+    uint32_t barriersEnqueued_;
+    bool stopWorkers_;
+    mutable boost::mutex taskMutex_;
+    boost::condition_variable taskCondition_;
 
     
     I3CLSimStepSeriesConstPtr MakeSteps(bool &barrierWasReset);
@@ -231,6 +281,14 @@ private:
                              const double &longitudinalPos,
                              GenerateStepPreCalculator &preCalc);
 
+    static void GenerateStep(I3CLSimStep &newStep,
+                             const I3Particle &p,
+                             double particleDir_x, double particleDir_y, double particleDir_z,
+                             uint32_t identifier,
+                             uint32_t photonsPerStep,
+                             const double &longitudinalPos,
+                             double angular_cos, double angular_sin, double random_value);
+
     static void GenerateStepForMuon(I3CLSimStep &newStep,
                                     const I3Particle &p,
                                     double particleDir_x, double particleDir_y, double particleDir_z,
@@ -0,0 +1,327 @@
+/**
+ * Copyright (c) 2016
+ * the IceCube Collaboration <http://www.icecube.wisc.edu>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *
+ * @file I3CLSimLockFreeQueue.h
+ */
+
+#ifndef I3CLSIMLOCKFREEQUEUE_H_INCLUDED
+#define I3CLSIMLOCKFREEQUEUE_H_INCLUDED
+
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+#include <stdexcept>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace I3CLSimLockFreeQueueDetail {
+    // Minimal atomics on top of the GCC __sync builtins (full barriers),
+    // since we cannot rely on Boost.Atomic or C++11 being available.
+    inline std::size_t load(const volatile std::size_t *p)
+    {
+        std::size_t v = *p;
+        __sync_synchronize();
+        return v;
+    }
+
+    inline void store(volatile std::size_t *p, std::size_t v)
+    {
+        __sync_synchronize();
+        *p = v;
+    }
+
+    inline bool cas(volatile std::size_t *p, std::size_t expected, std::size_t desired)
+    {
+        return __sync_bool_compare_and_swap(p, expected, desired);
+    }
+
+    enum { cacheLineSize = 64 };
+}
+
+/**
+ * @brief A bounded, lock-free, multi-producer/multi-consumer queue
+ * storing objects of type T.
+ *
+ * This is a ring buffer in which every slot carries a sequence number
+ * (D. Vyukov's bounded MPMC queue). Producers and consumers each claim a
+ * slot with a single compare-and-swap on their own position counter, so
+ * there is no lock on the fast path. Threads only fall back to a mutex and
+ * condition variable when they have to sleep because the queue is full
+ * (Put) or empty (Get), and the other side only touches that mutex if
+ * someone is actually asleep.
+ *
+ * Same interface and blocking semantics as I3CLSimQueue, except that the
+ * size must be at least 2. T must be default-constructible and assignable;
+ * a slot is reset to T() once its value has been taken.
+ */
+template <typename T>
+class I3CLSimLockFreeQueue : private boost::noncopyable
+{
+public:
+    I3CLSimLockFreeQueue(std::size_t max_size)
+    : buffer_(max_size), max_size_(max_size),
+      enqueuePos_(0), dequeuePos_(0),
+      producersWaiting_(0), consumersWaiting_(0)
+    {
+        // with a single slot, "full" and "free for the next lap" would
+        // have the same sequence number
+        if (max_size < 2)
+            throw std::invalid_argument("I3CLSimLockFreeQueue needs a size of at least 2");
+        for (std::size_t i=0; i<max_size_; ++i)
+            buffer_[i].sequence = i;
+    }
+
+    ~I3CLSimLockFreeQueue() {;}
+
+    /// Add an element. Returns false immediately if the queue is full.
+    bool PutNonBlocking(const T &msg)
+    {
+        if (!TryPut(msg)) return false;
+        WakeConsumers();
+        return true;
+    }
+
+    void Put(const T &msg)
+    {
+        if (PutNonBlocking(msg)) return;
+
+        for (unsigned i=0; i<spinCount; ++i) {
+            boost::this_thread::yield();
+            if (PutNonBlocking(msg)) return;
+        }
+
+        boost::unique_lock<boost::mutex> guard(mutex_);
+        __sync_fetch_and_add(&producersWaiting_, 1);
+        while (!TryPut(msg))
+        {
+            notFull_.wait(guard);
+        }
+        __sync_fetch_and_sub(&producersWaiting_, 1);
+        guard.unlock();
+
+        WakeConsumers();
+    }
+
+    T Get()
+    {
+        T msg;
+        if (GetNonBlocking(msg)) return msg;
+
+        for (unsigned i=0; i<spinCount; ++i) {
+            boost::this_thread::yield();
+            if (GetNonBlocking(msg)) return msg;
+        }
+
+        boost::unique_lock<boost::mutex> guard(mutex_);
+        __sync_fetch_and_add(&consumersWaiting_, 1);
+        while (!TryGet(msg))
+        {
+            notEmpty_.wait(guard);
+        }
+        __sync_fetch_and_sub(&consumersWaiting_, 1);
+        guard.unlock();
+
+        WakeProducers();
+        return msg;
+    }
+
+    bool GetNonBlocking(T &value)
+    {
+        if (!TryGet(value)) return false;
+        WakeProducers();
+        return true;
+    }
+
+    T Get(double timeout, T returnOnTimeout) // timeout in seconds
+    {
+        T msg;
+        if (GetNonBlocking(msg)) return msg;
+
+        const boost::system_time deadline = boost::get_system_time() +
+            boost::posix_time::milliseconds(static_cast<long>(timeout*1000.));
+
+        boost::unique_lock<boost::mutex> guard(mutex_);
+        __sync_fetch_and_add(&consumersWaiting_, 1);
+        while (!TryGet(msg))
+        {
+            if (!notEmpty_.timed_wait(guard, deadline)) {
+                // one last try, then give up
+                if (TryGet(msg)) break;
+                __sync_fetch_and_sub(&consumersWaiting_, 1);
+                return returnOnTimeout;
+            }
+        }
+        __sync_fetch_and_sub(&consumersWaiting_, 1);
+        guard.unlock();
+
+        WakeProducers();
+        return msg;
+    }
+
+    /**
+     * Block until at least one element is available, then take up to
+     * max_items elements without blocking any further. The elements are
+     * appended to values. Returns the number of elements taken.
+     */
+    std::size_t GetBatch(std::vector<T> &values, std::size_t max_items)
+    {
+        if (max_items == 0) return 0;
+        values.push_back(Get());
+        return 1 + GetBatchNonBlocking(values, max_items-1);
+    }
+
+    /// Take up to max_items elements without blocking.
+    std::size_t GetBatchNonBlocking(std::vector<T> &values, std::size_t max_items)
+    {
+        std::size_t n = 0;
+        T msg;
+        while ((n < max_items) && TryGet(msg)) {
+            values.push_back(msg);
+            msg = T();
+            ++n;
+        }
+        if (n > 0) WakeProducers();
+        return n;
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    /// Number of elements in the queue. Only a snapshot if other threads
+    /// are accessing the queue at the same time.
+    std::size_t size() const
+    {
+        const std::size_t head = I3CLSimLockFreeQueueDetail::load(&dequeuePos_);
+        const std::size_t tail = I3CLSimLockFreeQueueDetail::load(&enqueuePos_);
+        if (tail <= head) return 0;
+        return std::min(tail-head, max_size_);
+    }
+
+    inline std::size_t max_size() const
+    {
+        return max_size_;
+    }
+
+private:
+    // number of non-blocking attempts (with a yield in between) before
+    // going to sleep
+    static const unsigned spinCount = 16;
+
+    struct Cell {
+        volatile std::size_t sequence;
+        T data;
+    };
+
+    bool TryPut(const T &msg)
+    {
+        using namespace I3CLSimLockFreeQueueDetail;
+
+        Cell *cell;
+        std::size_t pos = load(&enqueuePos_);
+        for (;;) {
+            cell = &buffer_[pos % max_size_];
+            const std::size_t seq = load(&cell->sequence);
+            const std::ptrdiff_t dif = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+
+            if (dif == 0) {
+                if (cas(&enqueuePos_, pos, pos+1)) break;
+                pos = load(&enqueuePos_);
+            } else if (dif < 0) {
+                return false; // full
+            } else {
+                pos = load(&enqueuePos_);
+            }
+        }
+
+        cell->data = msg;
+        store(&cell->sequence, pos+1);
+        return true;
+    }
+
+    bool TryGet(T &msg)
+    {
+        using namespace I3CLSimLockFreeQueueDetail;
+
+        Cell *cell;
+        std::size_t pos = load(&dequeuePos_);
+        for (;;) {
+            cell = &buffer_[pos % max_size_];
+            const std::size_t seq = load(&cell->sequence);
+            const std::ptrdiff_t dif = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos+1);
+
+            if (dif == 0) {
+                if (cas(&dequeuePos_, pos, pos+1)) break;
+                pos = load(&dequeuePos_);
+            } else if (dif < 0) {
+                return false; // empty
+            } else {
+                pos = load(&dequeuePos_);
+            }
+        }
+
+        msg = cell->data;
+        cell->data = T(); // do not keep a reference to the value around
+        store(&cell->sequence, pos+max_size_);
+        return true;
+    }
+
+    // Sleepers increment the waiting counter with the mutex held and then
+    // retry before sleeping. Together with the full barrier between the
+    // queue update and the counter check below, either the sleeper sees
+    // the new element/slot or we see the sleeper.
+    void WakeConsumers()
+    {
+        __sync_synchronize();
+        if (I3CLSimLockFreeQueueDetail::load(&consumersWaiting_) == 0) return;
+        boost::unique_lock<boost::mutex> guard(mutex_);
+        notEmpty_.notify_one();
+    }
+
+    void WakeProducers()
+    {
+        __sync_synchronize();
+        if (I3CLSimLockFreeQueueDetail::load(&producersWaiting_) == 0) return;
+        boost::unique_lock<boost::mutex> guard(mutex_);
+        notFull_.notify_one();
+    }
+
+    std::vector<Cell> buffer_;
+    const std::size_t max_size_;
+
+    // keep the producer and consumer positions on separate cache lines
+    char pad0_[I3CLSimLockFreeQueueDetail::cacheLineSize];
+    volatile std::size_t enqueuePos_;
+    char pad1_[I3CLSimLockFreeQueueDetail::cacheLineSize];
+    volatile std::size_t dequeuePos_;
+    char pad2_[I3CLSimLockFreeQueueDetail::cacheLineSize];
+
+    volatile std::size_t producersWaiting_;
+    volatile std::size_t consumersWaiting_;
+    boost::mutex mutex_;
+    boost::condition_variable_any notFull_;
+    boost::condition_variable_any notEmpty_;
+};
+
+
+#endif //I3CLSIMLOCKFREEQUEUE_H_INCLUDED
@@ -28,13 +28,17 @@
 #define I3CLSIMQUEUE_H_INCLUDED
 
 #include <queue>
+#include <vector>
 
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/locks.hpp>
 #include <boost/thread/condition.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/noncopyable.hpp>
 
+#include "clsim/I3CLSimLockFreeQueue.h"
+
 /**
  * @brief A thread-safe queue, storing objects of type T.
  * T will be copied around quite a bit, so make it light-weight.
@@ -42,21 +46,31 @@
  * 
  * Will block on Get if queue is empty and on Put if queue is full.
  * A max_size argument of 0 will get you a queue with no limit.
+ *
+ * Queues with a limit of 2 or more are implemented by I3CLSimLockFreeQueue
+ * and only take a lock when a thread has to sleep, unless lockFree is
+ * false. All others are a std::queue protected by a mutex.
  */
 
 template <typename T>
 class I3CLSimQueue : private boost::noncopyable
 {
 public:
-    I3CLSimQueue(std::size_t max_size) 
-    : max_size_(max_size) {}
+    I3CLSimQueue(std::size_t max_size, bool lockFree=true) 
+    : max_size_(max_size)
+    {
+        if (lockFree && (max_size_ > 1))
+            ring_.reset(new I3CLSimLockFreeQueue<T>(max_size_));
+    }
     
-    I3CLSimQueue() {;}
+    I3CLSimQueue() : max_size_(0) {;}
     
     ~I3CLSimQueue() {;}
 
     void Put(const T &msg)
     {
+        if (ring_) {ring_->Put(msg); return;}
+        
         // lock the mutex to ensure exclusive access to the queue
         boost::unique_lock<boost::mutex> guard(mutex_);
         
@@ -69,13 +83,16 @@ public:
         // add the message to the queue
         queue_.push(msg);
         
-        // notify the consumer thread
-        cond_.notify_one();
+        // notify the consumer thread. Producers wait on the same condition,
+        // so wake everyone to make sure a consumer gets the message.
+        cond_.notify_all();
     }
     
     
     T Get()
     {
+        if (ring_) return ring_->Get();
+        
         // lock the mutex to ensure exclusive access to the queue
         boost::unique_lock<boost::mutex> guard(mutex_);
         
@@ -92,13 +109,15 @@ public:
         queue_.pop();
         
         // notify the producer that there is space on the queue now
-        cond_.notify_one();
+        cond_.notify_all();
         
         return msg;
     }
 
     bool GetNonBlocking(T &value)
     {
+        if (ring_) return ring_->GetNonBlocking(value);
+        
         // lock the mutex to ensure exclusive access to the queue
         boost::unique_lock<boost::mutex> guard(mutex_);
         
@@ -112,13 +131,15 @@ public:
         queue_.pop();
         
         // notify the producer that there is space on the queue now
-        cond_.notify_one();
+        cond_.notify_all();
         
         return true;
     }
 
     T Get(double timeout, T returnOnTimeout) // timeout in seconds
     {
+        if (ring_) return ring_->Get(timeout, returnOnTimeout);
+        
         // lock the mutex to ensure exclusive access to the queue
         boost::unique_lock<boost::mutex> guard(mutex_);
         
@@ -141,13 +162,48 @@ public:
         queue_.pop();
         
         // notify the producer that there is space on the queue now
-        cond_.notify_one();
+        cond_.notify_all();
         
         return msg;
     }
 
+    /**
+     * Block until at least one element is available, then take up to
+     * max_items elements without blocking any further. The elements are
+     * appended to values. Returns the number of elements taken.
+     */
+    std::size_t GetBatch(std::vector<T> &values, std::size_t max_items)
+    {
+        if (ring_) return ring_->GetBatch(values, max_items);
+        if (max_items == 0) return 0;
+        
+        // lock the mutex to ensure exclusive access to the queue
+        boost::unique_lock<boost::mutex> guard(mutex_);
+        
+        // in case the queue is empty, sleep waiting for something to be put onto it
+        while (queue_.empty())
+        {
+            cond_.wait(guard);
+        }
+        
+        std::size_t n = 0;
+        while ((n < max_items) && (!queue_.empty()))
+        {
+            values.push_back(queue_.front());
+            queue_.pop();
+            ++n;
+        }
+        
+        // notify the producer that there is space on the queue now
+        cond_.notify_all();
+        
+        return n;
+    }
+
     bool empty() const
     {
+        if (ring_) return ring_->empty();
+        
         // lock the mutex to ensure exclusive access to the queue
         boost::unique_lock<boost::mutex> guard(mutex_);
         
@@ -156,6 +212,8 @@ public:
 
     std::size_t size() const
     {
+        if (ring_) return ring_->size();
+        
         // lock the mutex to ensure exclusive access to the queue
         boost::unique_lock<boost::mutex> guard(mutex_);
         
@@ -172,6 +230,7 @@ private:
     boost::condition_variable_any cond_;
     std::queue<T> queue_;
     std::size_t max_size_;
+    boost::scoped_ptr<I3CLSimLockFreeQueue<T> > ring_;
 };
 
 
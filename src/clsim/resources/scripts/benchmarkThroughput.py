@@ -0,0 +1,297 @@
+#!/usr/bin/env python
+"""
+Measure the throughput of an I3CLSimStepToPhotonConverter on canned step
+sets (cascades, muon segments, flasher pulses) for a set of ice models.
+
+All steps are generated up front from a fixed seed, so every run propagates
+exactly the same steps. Only the step-to-photon conversion is timed. The
+results are written as JSON, one record per (ice model, light source)
+combination, to make it easy to compare devices and releases.
+"""
+
+from __future__ import print_function
+
+from optparse import OptionParser
+from os.path import expandvars
+
+usage = "usage: %prog [options]"
+parser = OptionParser(usage, description=__doc__)
+parser.add_option("-s", "--seed", type="int", default=12345,
+                  dest="SEED", help="Seed for the random number generator [%default]")
+parser.add_option("-o", "--output", default=None,
+                  dest="OUTPUT", help="Write the JSON results to OUTPUT instead of stdout")
+parser.add_option("--icemodel", action="append", default=None,
+                  dest="ICEMODELS", help="A clsim ice model file/directory. Can be given more than once. [default: every model in $I3_SRC/clsim/resources/ice]")
+parser.add_option("--sources", default="cascade,muon,flasher",
+                  dest="SOURCES", help="Comma-separated list of light sources to benchmark [%default]")
+parser.add_option("-n", "--numsources", type="int", default=10,
+                  dest="NUMSOURCES", help="Number of light sources per step set [%default]")
+parser.add_option("--cascade-energy", type="float", default=10e3,
+                  dest="CASCADEENERGY", help="Cascade energy in GeV [%default]")
+parser.add_option("--muon-energy", type="float", default=1e3,
+                  dest="MUONENERGY", help="Muon segment energy in GeV [%default]")
+parser.add_option("--muon-length", type="float", default=500.,
+                  dest="MUONLENGTH", help="Muon segment length in m [%default]")
+parser.add_option("--flasher-photons", type="float", default=1e9,
+                  dest="FLASHERPHOTONS", help="Number of (unbiased) photons per flasher pulse [%default]")
+parser.add_option("--oversize", type="float", default=5.,
+                  dest="OVERSIZE", help="DOM oversize factor [%default]")
+parser.add_option("--gcd", default=None,
+                  dest="GCD", help="Take the geometry from this GCD file instead of using a built-in 7-string detector")
+parser.add_option("--use-cpu",  action="store_true", default=False,
+                  dest="USECPU", help="simulate using CPU instead of GPU")
+parser.add_option("-d", "--device", type="int", default=None,
+                  dest="DEVICE", help="device number")
+parser.add_option("--double-buffering", action="store_true", default=False,
+                  dest="DOUBLEBUFFERING", help="Enable double buffering on the device")
+
+(options,args) = parser.parse_args()
+if len(args) != 0:
+    parser.error("Got undefined options: " + " ".join(args))
+
+import os
+import sys
+import json
+import time
+import math
+
+from icecube import icetray, dataclasses, dataio, phys_services, clsim
+from icecube.icetray import I3Units
+from icecube.clsim.traysegments.common import configureOpenCLDevices, parseIceModel
+
+icetray.I3Logger.global_logger.set_level(icetray.I3LogLevel.LOG_WARN)
+
+DOMRadius = 0.16510*I3Units.m # 13" diameter
+
+def listIceModels():
+    """every PPC-style directory and every photonics table file in resources/ice"""
+    iceDir = expandvars("$I3_SRC/clsim/resources/ice")
+    models = []
+    for name in sorted(os.listdir(iceDir)):
+        path = os.path.join(iceDir, name)
+        if not os.path.isdir(path):
+            continue
+        if os.path.isfile(os.path.join(path, "icemodel.dat")):
+            models.append(path)
+        elif name.startswith("photonics_"):
+            models += [os.path.join(path, f) for f in sorted(os.listdir(path)) if f.endswith(".txt")]
+    return models
+
+def makeGeometryFrame():
+    """a frame with an I3ModuleGeoMap, either from a GCD file or built in"""
+    moduleGeoMap = dataclasses.I3ModuleGeoMap()
+    subdetectors = dataclasses.I3MapModuleKeyString()
+
+    def addModule(string, om, pos):
+        geo = dataclasses.I3ModuleGeo()
+        geo.pos = pos
+        geo.orientation = dataclasses.I3Orientation(dataclasses.I3Direction(0.,0.,-1.))
+        geo.module_type = dataclasses.I3ModuleGeo.ModuleType.IceCube
+        geo.radius = DOMRadius
+        key = icetray.ModuleKey(string, om)
+        moduleGeoMap[key] = geo
+        subdetectors[key] = "IceCube"
+
+    if options.GCD is not None:
+        gcdFile = dataio.I3File(options.GCD)
+        geometry = None
+        while gcdFile.more():
+            frame = gcdFile.pop_frame()
+            if "I3Geometry" in frame:
+                geometry = frame["I3Geometry"]
+                break
+        if geometry is None:
+            raise RuntimeError("No I3Geometry found in %s" % options.GCD)
+        for omkey, omgeo in geometry.omgeo.items():
+            if omgeo.omtype != dataclasses.I3OMGeo.OMType.IceCube: continue
+            if omkey.om > 60: continue # skip IceTop
+            addModule(omkey.string, omkey.om, omgeo.position)
+    else:
+        # a central string surrounded by a hexagon of six strings with
+        # 125m spacing, 60 DOMs each at 17m spacing
+        stringPos = [(0.,0.)] + [(125.*math.cos(i*math.pi/3.), 125.*math.sin(i*math.pi/3.)) for i in range(6)]
+        for i, (x, y) in enumerate(stringPos):
+            for om in range(1, 61):
+                z = 500. - (om-1)*17.
+                addModule(i+1, om, dataclasses.I3Position(x*I3Units.m, y*I3Units.m, z*I3Units.m))
+
+    frame = icetray.I3Frame(icetray.I3Frame.Geometry)
+    frame["I3ModuleGeoMap"] = moduleGeoMap
+    frame["Subdetectors"] = subdetectors
+    return frame
+
+def makeLightSources(sourceType, rng):
+    """the canned light sources, placed randomly within 50m of the center string"""
+    sources = []
+    for i in range(options.NUMSOURCES):
+        x = rng.uniform(-50., 50.)*I3Units.m
+        y = rng.uniform(-50., 50.)*I3Units.m
+        z = rng.uniform(-300., 300.)*I3Units.m
+        if sourceType == "flasher":
+            pulse = clsim.I3CLSimFlasherPulse()
+            pulse.type = clsim.I3CLSimFlasherPulse.FlasherPulseType.LED405nm
+            pulse.pos = dataclasses.I3Position(x, y, z)
+            pulse.dir = dataclasses.I3Direction(90.*I3Units.deg, rng.uniform(0., 360.)*I3Units.deg)
+            pulse.time = 0.
+            pulse.pulseWidth = 63.5*I3Units.ns
+            pulse.numberOfPhotonsNoBias = options.FLASHERPHOTONS
+            profile = clsim.FlasherInfoVectToFlasherPulseSeriesConverter.LEDangularEmissionProfile[(pulse.type, False)]
+            pulse.angularEmissionSigmaPolar = profile[0]
+            pulse.angularEmissionSigmaAzimuthal = profile[1]
+            sources.append(clsim.I3CLSimLightSource(pulse))
+            continue
+
+        particle = dataclasses.I3Particle()
+        particle.pos = dataclasses.I3Position(x, y, z)
+        particle.dir = dataclasses.I3Direction(rng.uniform(0., 180.)*I3Units.deg, rng.uniform(0., 360.)*I3Units.deg)
+        particle.time = 0.
+        particle.location_type = dataclasses.I3Particle.LocationType.InIce
+        if sourceType == "cascade":
+            particle.type = dataclasses.I3Particle.ParticleType.EMinus
+            particle.energy = options.CASCADEENERGY*I3Units.GeV
+        elif sourceType == "muon":
+            particle.type = dataclasses.I3Particle.ParticleType.MuMinus
+            particle.energy = options.MUONENERGY*I3Units.GeV
+            particle.length = options.MUONLENGTH*I3Units.m
+        else:
+            raise RuntimeError("unknown light source type \"%s\"" % sourceType)
+        sources.append(clsim.I3CLSimLightSource(particle))
+    return sources
+
+def makeSteps(converter, sources):
+    """run the light sources through a light source to step converter"""
+    for i, source in enumerate(sources):
+        converter.EnqueueLightSource(source, i)
+    bunches = []
+    while converter.MoreStepsAvailable():
+        steps = converter.GetConversionResult()
+        if len(steps) > 0:
+            bunches.append(steps)
+    return bunches
+
+def propagate(converter, bunches):
+    """push all step bunches through the converter, return the number of detected photons"""
+    inFlight = 0
+    detected = 0
+    for i, steps in enumerate(bunches):
+        converter.EnqueueSteps(steps, i)
+        inFlight += 1
+        # keep two bunches queued so the device never waits for us
+        while inFlight > 2:
+            detected += len(converter.GetConversionResult().photons)
+            inFlight -= 1
+    while inFlight > 0:
+        detected += len(converter.GetConversionResult().photons)
+        inFlight -= 1
+    return detected
+
+devices = configureOpenCLDevices(UseGPUs=not options.USECPU, UseCPUs=options.USECPU,
+                                 DoNotParallelize=False, UseOnlyDeviceNumber=options.DEVICE)
+if len(devices) == 0:
+    raise RuntimeError("No OpenCL device found")
+device = devices[0]
+
+iceModels = options.ICEMODELS if options.ICEMODELS else listIceModels()
+sourceTypes = [s.strip() for s in options.SOURCES.split(",") if s.strip()]
+
+results = []
+for iceModel in iceModels:
+    # start every ice model from the same seed, so adding or removing
+    # models does not change the steps of the others
+    rng = phys_services.I3GSLRandomService(options.SEED)
+
+    mediumProperties = parseIceModel(iceModel)
+    domAcceptance = clsim.GetIceCubeDOMAcceptance(domRadius=DOMRadius*options.OVERSIZE)
+    geometry = clsim.I3CLSimSimpleGeometryFromI3Geometry(DOMRadius, options.OVERSIZE, makeGeometryFrame())
+
+    spectrumTable = clsim.I3CLSimSpectrumTable()
+    flasherParameterizations = clsim.GetFlasherParameterizationList(spectrumTable)
+    wavelengthGenerators = [clsim.makeCherenkovWavelengthGenerator(domAcceptance, False, mediumProperties)]
+    for i in range(1, len(spectrumTable)):
+        wavelengthGenerators.append(clsim.makeWavelengthGenerator(spectrumTable[i], domAcceptance, mediumProperties))
+
+    setupStart = time.time()
+    photonConverter = clsim.initializeOpenCL(device, rng, geometry, mediumProperties,
+        domAcceptance, wavelengthGenerators,
+        enableDoubleBuffering=options.DOUBLEBUFFERING,
+        pancakeFactor=options.OVERSIZE)
+    setupTime = time.time()-setupStart
+
+    for sourceType in sourceTypes:
+        if sourceType == "flasher":
+            stepConverter = [p.converter for p in flasherParameterizations
+                             if p.forFlasherPulseType == clsim.I3CLSimFlasherPulse.FlasherPulseType.LED405nm][0]
+        else:
+            stepConverter = clsim.I3CLSimLightSourceToStepConverterPPC(photonsPerStep=200)
+        stepConverter.SetRandomService(rng)
+        stepConverter.SetWlenBias(domAcceptance)
+        stepConverter.SetMediumProperties(mediumProperties)
+        stepConverter.SetBunchSizeGranularity(photonConverter.workgroupSize)
+        stepConverter.SetMaxBunchSize(photonConverter.maxNumWorkitems)
+        stepConverter.Initialize()
+
+        stepStart = time.time()
+        bunches = makeSteps(stepConverter, makeLightSources(sourceType, rng))
+        stepTime = time.time()-stepStart
+
+        numSteps = 0
+        numPhotons = 0
+        for steps in bunches:
+            for step in steps:
+                if step.num == 0: continue # padding
+                numSteps += 1
+                numPhotons += step.num
+
+        deviceTimeBefore = photonConverter.totalDeviceTime
+        hostTimeBefore = photonConverter.totalHostTime
+        kernelCallsBefore = photonConverter.numKernelCalls
+
+        start = time.time()
+        numDetected = propagate(photonConverter, bunches)
+        wallTime = time.time()-start
+
+        deviceTime = (photonConverter.totalDeviceTime-deviceTimeBefore)*1e-9
+        hostTime = (photonConverter.totalHostTime-hostTimeBefore)*1e-9
+
+        results.append(dict(
+            ice_model=os.path.basename(os.path.normpath(iceModel)),
+            source=sourceType,
+            num_sources=options.NUMSOURCES,
+            num_bunches=len(bunches),
+            num_kernel_calls=photonConverter.numKernelCalls-kernelCallsBefore,
+            steps=numSteps,
+            photons=numPhotons,
+            photons_detected=numDetected,
+            wall_time=wallTime,
+            device_time=deviceTime,
+            host_time=hostTime,
+            host_overhead=wallTime-deviceTime,
+            device_utilization=deviceTime/wallTime if wallTime > 0 else float('nan'),
+            step_generation_time=stepTime,
+            setup_time=setupTime,
+            photons_per_second=numPhotons/wallTime if wallTime > 0 else float('nan'),
+            steps_per_second=numSteps/wallTime if wallTime > 0 else float('nan'),
+            detected_photons_per_second=numDetected/wallTime if wallTime > 0 else float('nan'),
+            ))
+        print("%-40s %-8s %.3g photons/s" % (results[-1]["ice_model"], sourceType, results[-1]["photons_per_second"]), file=sys.stderr)
+
+    del photonConverter
+
+report = dict(
+    device=dict(platform=device.platform, device=device.device, cpu=device.cpu, gpu=device.gpu,
+                driverVersion=device.driverVersion,
+                useNativeMath=device.useNativeMath,
+                approximateNumberOfWorkItems=device.approximateNumberOfWorkItems),
+    seed=options.SEED,
+    geometry=options.GCD if options.GCD is not None else "builtin-7-strings",
+    dom_oversize_factor=options.OVERSIZE,
+    double_buffering=options.DOUBLEBUFFERING,
+    results=results,
+    )
+
+if options.OUTPUT is None:
+    json.dump(report, sys.stdout, indent=2, sort_keys=True)
+    print()
+else:
+    with open(options.OUTPUT, "w") as f:
+        json.dump(report, f, indent=2, sort_keys=True)
@@ -0,0 +1,57 @@
+#!/usr/bin/env python
+
+"""
+Test that the PPC parameterizations produce identical steps on 1 and N threads
+"""
+
+from icecube import icetray, dataclasses, clsim, phys_services
+
+def MakeSources():
+    sources = []
+    for i, (ptype, energy) in enumerate([(dataclasses.I3Particle.EMinus, 10.),
+                                         (dataclasses.I3Particle.Hadrons, 1e3),
+                                         (dataclasses.I3Particle.MuMinus, 1e2),
+                                         (dataclasses.I3Particle.EPlus, 1e4)]):
+        p = dataclasses.I3Particle()
+        p.pos = dataclasses.I3Position(10.*i,-5.*i,100.-20.*i)
+        p.dir = dataclasses.I3Direction(0.3*i,0.2,-1.)
+        p.time = 100.*i
+        p.energy = energy
+        p.type = ptype
+        if ptype == dataclasses.I3Particle.MuMinus:
+            p.shape = p.ContainedTrack
+            p.length = 300.
+        sources.append(clsim.I3CLSimLightSource(p))
+    return sources
+
+def ConvertSteps(numThreads):
+    converter = clsim.I3CLSimLightSourceToStepConverterPPC()
+    converter.SetWlenBias(clsim.GetIceCubeDOMAcceptance())
+    converter.SetMediumProperties(clsim.MakeIceCubeMediumProperties())
+    converter.SetRandomService(phys_services.I3GSLRandomService(42))
+    # small bunches, so each light source is split across several threads
+    converter.SetMaxBunchSize(1000)
+    converter.SetNumParallelThreads(numThreads)
+    converter.Initialize()
+
+    for event in range(2):
+        for i, source in enumerate(MakeSources()):
+            converter.EnqueueLightSource(source, 10*event+i)
+        converter.EnqueueBarrier()
+
+    steps = []
+    while converter.MoreStepsAvailable():
+        steps.extend([(s.x, s.y, s.z, s.time, s.theta, s.phi, s.length,
+                       s.beta, s.num, s.weight, s.id, s.sourceType)
+                      for s in converter.GetConversionResult()])
+    assert not converter.BarrierActive(), "All barriers were returned"
+    return steps
+
+reference = ConvertSteps(1)
+assert len(reference) > 0, "Steps were generated"
+
+for numThreads in [2, 4]:
+    steps = ConvertSteps(numThreads)
+    assert len(steps) == len(reference), "Same number of steps on %u threads" % numThreads
+    for i, (a, b) in enumerate(zip(reference, steps)):
+        assert a == b, "Step %u differs on %u threads: %s != %s" % (i, numThreads, a, b)
@@ -0,0 +1,51 @@
+#!/usr/bin/env python
+
+"""
+Test that the tabulator sums bin entries identically with 1 and N threads,
+and with the table held in memory or in a scratch file
+"""
+
+import os, random, sys, tempfile
+from icecube import icetray, clsim
+
+if not hasattr(clsim, "tabulator"):
+    print("clsim was built without the tabulator, skipping")
+    sys.exit(0)
+
+from icecube.clsim.tabulator import Accumulator
+
+nbins = 10007
+
+def MakeBatches(seed):
+    rng = random.Random(seed)
+    batches = []
+    for b in range(20):
+        streams = []
+        for s in range(rng.randint(1, 20)):
+            # mostly a few hot bins, so that the order of the sums matters
+            streams.append([(rng.randrange(nbins) if rng.random() < 0.2 else rng.randrange(5),
+                             rng.uniform(0, 1)*10**rng.randint(-6, 3))
+                            for i in range(rng.randint(0, 50))])
+        batches.append(streams)
+    return batches
+
+def Accumulate(batches, nthreads, scratchFile=""):
+    acc = Accumulator(nbins, nthreads, scratchFile=scratchFile)
+    for streams in batches:
+        acc.Fill(streams)
+    acc.Finish()
+    return acc.GetBinContent()
+
+batches = MakeBatches(42)
+reference = Accumulate(batches, 1)
+assert sum(1 for v in reference if v != 0) > 5, "Bins were filled"
+
+scratchDir = tempfile.mkdtemp()
+try:
+    for nthreads in [2, 3, 8]:
+        assert Accumulate(batches, nthreads) == reference, "Same bin content with %u threads" % nthreads
+        scratchFile = os.path.join(scratchDir, "table%u" % nthreads)
+        assert Accumulate(batches, nthreads, scratchFile) == reference, "Same bin content with %u threads in a scratch file" % nthreads
+        assert not os.path.exists(scratchFile), "Scratch file is removed"
+finally:
+    os.rmdir(scratchDir)
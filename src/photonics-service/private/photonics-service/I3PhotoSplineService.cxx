@@ -4,18 +4,154 @@
 #include <photonics-service/I3PhotoSplineService.h>
 #include "photonics-service/I3PhotonicsServiceCommons.h"
 #include "photonics-service/I3PhotoSplineTable.h"
-#include <cmath>   
+#include <cmath>
+#include <cerrno>
+#include <vector>
+#include <algorithm>
+#include <list>
+#include <stdint.h>
+#include <boost/scoped_array.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/functional/hash.hpp>   
+
+/*
+ * Bounded least-recently-used map from quantized amplitude table
+ * coordinates to the spline value and, once asked for, its gradient.
+ */
+class I3PhotoSplineService::AmplitudeCache {
+public:
+	AmplitudeCache(size_t capacity, double resolution,
+	    const I3PhotoSplineTable &table);
+
+	/* Fill values and err from the cache; false if not there */
+	bool Lookup(const double *x, bool gradients, int *err, double *values);
+	void Store(const double *x, bool gradients, int err,
+	    const double *values);
+	void Clear();
+
+	size_t hits, misses;
+
+private:
+	struct Key {
+		int64_t q[6];
+		bool operator==(const Key &other) const
+		{ return std::equal(q, q + 6, other.q); }
+	};
+	struct KeyHash {
+		size_t operator()(const Key &key) const
+		{ return boost::hash_range(key.q, key.q + 6); }
+	};
+	struct Entry {
+		Key key;
+		int err;
+		bool gradients;
+		double values[7];
+	};
+	typedef std::list<Entry> EntryList;
+
+	Key Quantize(const double *x) const;
+
+	size_t capacity_;
+	int ndim_;
+	double step_[6];
+	EntryList entries_; /* most recently used first */
+	boost::unordered_map<Key, EntryList::iterator, KeyHash> index_;
+};
+
+I3PhotoSplineService::AmplitudeCache::AmplitudeCache(size_t capacity,
+    double resolution, const I3PhotoSplineTable &table) :
+    hits(0), misses(0), capacity_(capacity), ndim_(table.GetNDim())
+{
+	for (int i = 0; i < 6; i++)
+		step_[i] = (i < ndim_) ? resolution*(table.GetExtent(i)[1] -
+		    table.GetExtent(i)[0]) : 0;
+}
+
+I3PhotoSplineService::AmplitudeCache::Key
+I3PhotoSplineService::AmplitudeCache::Quantize(const double *x) const
+{
+	Key key;
+
+	for (int i = 0; i < 6; i++) {
+		if (i >= ndim_)
+			key.q[i] = 0;
+		else if (step_[i] > 0)
+			key.q[i] = (int64_t)floor(x[i]/step_[i]);
+		else
+			memcpy(&key.q[i], &x[i], sizeof(key.q[i]));
+	}
+
+	return key;
+}
+
+bool
+I3PhotoSplineService::AmplitudeCache::Lookup(const double *x, bool gradients,
+    int *err, double *values)
+{
+	boost::unordered_map<Key, EntryList::iterator, KeyHash>::iterator it =
+	    index_.find(Quantize(x));
+
+	if (it == index_.end() || (gradients && !it->second->gradients)) {
+		misses++;
+		return false;
+	}
+
+	entries_.splice(entries_.begin(), entries_, it->second);
+	*err = it->second->err;
+	std::copy(it->second->values, it->second->values +
+	    (gradients ? ndim_ + 1 : 1), values);
+	hits++;
+
+	return true;
+}
+
+void
+I3PhotoSplineService::AmplitudeCache::Store(const double *x, bool gradients,
+    int err, const double *values)
+{
+	Entry entry;
+
+	entry.key = Quantize(x);
+	entry.err = err;
+	entry.gradients = gradients;
+	std::fill(entry.values, entry.values + 7, 0.);
+	std::copy(values, values + (gradients ? ndim_ + 1 : 1), entry.values);
+
+	boost::unordered_map<Key, EntryList::iterator, KeyHash>::iterator it =
+	    index_.find(entry.key);
+	if (it != index_.end()) {
+		/* A value-only entry being upgraded with gradients */
+		entries_.erase(it->second);
+		index_.erase(it);
+	} else if (entries_.size() >= capacity_) {
+		index_.erase(entries_.back().key);
+		entries_.pop_back();
+	}
+
+	entries_.push_front(entry);
+	index_[entry.key] = entries_.begin();
+}
+
+void
+I3PhotoSplineService::AmplitudeCache::Clear()
+{
+	entries_.clear();
+	index_.clear();
+}
+
 
 I3PhotoSplineService::I3PhotoSplineService() :
     I3PhotonicsService(), I3ServiceBase("I3PhotoSplineService"),
-    amplitudeSplineTable_(), timingSplineTable_(),
+    amplitudeSplineTable_(), timingSplineTable_(), cacheSize_(0),
+    cacheResolution_(0), maxRadius_(std::numeric_limits<double>::infinity()),
     meanPEs_(-1.), sourceType_(-1), sourceLength_(-2), lastSource_(),
     rawYield_(0.)
 { }
 
 I3PhotoSplineService::I3PhotoSplineService(
     I3Context const &context) : I3PhotonicsService(), I3ServiceBase(context),
-    amplitudeSplineTable_(), timingSplineTable_(),
+    amplitudeSplineTable_(), timingSplineTable_(), cacheSize_(0),
+    cacheResolution_(0), maxRadius_(std::numeric_limits<double>::infinity()),
     meanPEs_(-1.), sourceType_(-1), sourceLength_(-2), lastSource_(),
     rawYield_(0.)
 {
@@ -25,6 +161,11 @@ I3PhotoSplineService::I3PhotoSplineService(
 	    "a B-spline of order 1 and this standard deviation.", 0.0);
 	AddParameter("MaxRadius","Maximum expected distance for detected light from emitter",
 	    std::numeric_limits<double>::infinity());
+	AddParameter("CacheSize", "Number of amplitude evaluations to "
+	    "remember (0 to disable)", 0);
+	AddParameter("CacheResolution", "Round table coordinates to this "
+	    "fraction of the table extent before looking them up in the "
+	    "cache (0 for exact matches)", 0.0);
 }
 
 void I3PhotoSplineService::Configure()
@@ -49,12 +190,21 @@ void I3PhotoSplineService::Configure()
 		amplitudeSplineTable_->SetMaximumRadius(maxRadius_);
 		timingSplineTable_->SetMaximumRadius(maxRadius_);
 	}
+
+	int cacheSize;
+	double cacheResolution;
+	GetParameter("CacheSize", cacheSize);
+	GetParameter("CacheResolution", cacheResolution);
+	if (cacheSize < 0 || cacheResolution < 0)
+		log_fatal("CacheSize and CacheResolution can't be negative");
+	SetCache(cacheSize, cacheResolution);
 }
 
 I3PhotoSplineService::I3PhotoSplineService(const std::string& amplitudeTable,
     const std::string& timingTable, double timingSigma, double maxRadius) :
     I3PhotonicsService(), I3ServiceBase("I3PhotoSplineService"),
-    amplitudeSplineTable_(), timingSplineTable_(), maxRadius_(maxRadius),
+    amplitudeSplineTable_(), timingSplineTable_(), cacheSize_(0),
+    cacheResolution_(0), maxRadius_(maxRadius),
     meanPEs_(-1.), sourceType_(-1), sourceLength_(-2), lastSource_(),
     rawYield_(0.)
 {
@@ -77,12 +227,129 @@ I3PhotoSplineService::I3PhotoSplineService(const std::string& amplitudeTable,
 }
  
 I3PhotoSplineService::~I3PhotoSplineService()
-{ }
+{
+	if (cache_)
+		log_info("Amplitude cache: %zu hits, %zu misses",
+		    cache_->hits, cache_->misses);
+}
+
+void
+I3PhotoSplineService::SetCache(size_t size, double resolution)
+{
+	/* Remembered to set the cache up again in LoadSplineTables() */
+	cacheSize_ = size;
+	cacheResolution_ = resolution;
+	if (size == 0 || !amplitudeSplineTable_)
+		cache_.reset();
+	else
+		cache_ = boost::shared_ptr<AmplitudeCache>(new AmplitudeCache(
+		    size, resolution, *amplitudeSplineTable_));
+}
+
+void
+I3PhotoSplineService::ResetCache()
+{
+	if (cache_)
+		cache_->Clear();
+	/* The single-entry cache in SelectSource() goes too */
+	meanPEs_ = -1;
+}
+
+void
+I3PhotoSplineService::GetCacheStatistics(size_t &hits, size_t &misses) const
+{
+	hits = cache_ ? cache_->hits : 0;
+	misses = cache_ ? cache_->misses : 0;
+}
+
+int
+I3PhotoSplineService::EvalAmplitude(double tablecoordinates[6],
+    double buffer[7], bool gradients)
+{
+	int err;
+
+	if (cache_ && cache_->Lookup(tablecoordinates, gradients, &err, buffer))
+		return err;
+
+	err = gradients ?
+	    amplitudeSplineTable_->EvalGradients(tablecoordinates, buffer) :
+	    amplitudeSplineTable_->Eval(tablecoordinates, buffer);
+	if (cache_)
+		cache_->Store(tablecoordinates, gradients, err, buffer);
+
+	return err;
+}
+
+/*
+ * EvalAmplitude() for many table coordinates (ndim each), with the spline
+ * evaluated in one batch for those not found in the cache.
+ */
+void
+I3PhotoSplineService::EvalAmplitudeBatch(
+    const std::vector<double> &tablecoordinates, double *yields,
+    double *gradients, bool *inside, size_t n)
+{
+	const int ndim = amplitudeSplineTable_->GetNDim();
+	std::vector<size_t> missed;
+	std::vector<double> misscoords;
+	double buffer[7];
+	size_t i, k;
+	int err;
+
+	if (!cache_) {
+		amplitudeSplineTable_->EvalGradientsBatch(&tablecoordinates[0],
+		    yields, gradients, inside, n);
+		return;
+	}
+
+	for (i = 0; i < n; i++) {
+		if (cache_->Lookup(&tablecoordinates[i*ndim], gradients != NULL,
+		    &err, buffer)) {
+			inside[i] = (err == 0);
+			yields[i] = buffer[0];
+			if (gradients != NULL)
+				std::copy(buffer + 1, buffer + 1 + ndim,
+				    &gradients[i*ndim]);
+			continue;
+		}
+		missed.push_back(i);
+		misscoords.insert(misscoords.end(), &tablecoordinates[i*ndim],
+		    &tablecoordinates[(i+1)*ndim]);
+	}
+	if (missed.empty())
+		return;
+
+	std::vector<double> missyields(missed.size());
+	std::vector<double> missgradients(gradients != NULL ?
+	    missed.size()*ndim : 0);
+	boost::scoped_array<bool> missinside(new bool[missed.size()]);
+	amplitudeSplineTable_->EvalGradientsBatch(&misscoords[0],
+	    &missyields[0], (gradients != NULL) ? &missgradients[0] : NULL,
+	    missinside.get(), missed.size());
+
+	for (k = 0; k < missed.size(); k++) {
+		i = missed[k];
+		inside[i] = missinside[k];
+		yields[i] = buffer[0] = missyields[k];
+		if (gradients != NULL) {
+			std::copy(&missgradients[k*ndim],
+			    &missgradients[(k+1)*ndim], buffer + 1);
+			std::copy(buffer + 1, buffer + 1 + ndim,
+			    &gradients[i*ndim]);
+		}
+		cache_->Store(&misscoords[k*ndim], gradients != NULL,
+		    inside[i] ? 0 : EINVAL, buffer);
+	}
+}
         
 bool
 I3PhotoSplineService::LoadSplineTables(std::string ampFileName,
     std::string timeFileName)
 {
+	/* Nothing remembered from the old tables applies to the new ones */
+	cache_.reset();
+	meanPEs_ = -1;
+
 	amplitudeSplineTable_ = I3PhotoSplineTablePtr(new I3PhotoSplineTable());
 	if (!amplitudeSplineTable_->SetupTable(ampFileName, -1)) {
 		amplitudeSplineTable_.reset();
@@ -116,6 +383,8 @@ I3PhotoSplineService::LoadSplineTables(std::string ampFileName,
 	
 	parity_ = amplitudeSplineTable_->GetParity();
 
+	SetCache(cacheSize_, cacheResolution_);
+
 	return true;
 }
 
@@ -233,41 +502,15 @@ I3PhotoSplineService::SelectSource(double &meanPEs, double *gradient,
 	bool supported = amplitudeSplineTable_->CheckSupport(
 	    tablecoordinates);
 
-	switch (geotype_) {
-	case POINTSOURCE:
-		// showers and other point-like light sources
-		
-		geoTime = r_*nGroup_/I3PhotonicsCommons::cVacuum;
-		break;
-	case INFINITEMUON:
-		/**
-		 * Calculate "geometric time", which has two options for
-		 * infinite muons:
-		 *  - time for muon to propagate to emission point + time for
-		 *  light to reach OM from there for muons (length >= 0)
-		 *  - cascade-like direct time for lightsaber (length = -1)
-		 */
-
-		if (source.length == -1)
-			geoTime = r_*nGroup_/
-			    I3PhotonicsCommons::cVacuum;
-		else
-			geoTime = (emissionPointOffset_ + 
-			    emissionPointDistance_*nGroup_)/cVacuum_;
-
-		break;
-	default:
-		log_fatal("Unknown table geometry type %d", geotype_);
-	}
+	geoTime = GeometricTime(source);
 
 	if (!supported) {
 		rawYield_ = -1;
 	} else if (!getAmp) {
 		rawYield_ = 0;
 	} else if (gradient == NULL) {
-		if (amplitudeSplineTable_->Eval(tablecoordinates,
-		    &rawYield_) == 0)
-			rawYield_ = exp(rawYield_);
+		if (EvalAmplitude(tablecoordinates, buffer, false) == 0)
+			rawYield_ = exp(buffer[0]);
 		else
 			rawYield_ = -1;
 	}
@@ -275,8 +518,8 @@ I3PhotoSplineService::SelectSource(double &meanPEs, double *gradient,
 	if (gradient != NULL) {
 		if (!supported || !getAmp) {
 			memset(gradient, 0, 6*sizeof(gradient[0]));
-		} else if (amplitudeSplineTable_->EvalGradients(
-		    tablecoordinates, buffer) == 0) {
+		} else if (EvalAmplitude(tablecoordinates, buffer,
+		    true) == 0) {
 			rawYield_ = exp(buffer[0]);
 			ConvertMeanAmplitudeGradient(
 			    &buffer[1], gradient, source);
@@ -316,6 +559,216 @@ I3PhotoSplineService::SelectSource(double &meanPEs, double *gradient,
 	}
 }
 
+double
+I3PhotoSplineService::GeometricTime(PhotonicsSource const &source)
+{
+	double geoTime = 0;
+
+	switch (geotype_) {
+	case POINTSOURCE:
+		// showers and other point-like light sources
+		
+		geoTime = r_*nGroup_/I3PhotonicsCommons::cVacuum;
+		break;
+	case INFINITEMUON:
+		/**
+		 * Calculate "geometric time", which has two options for
+		 * infinite muons:
+		 *  - time for muon to propagate to emission point + time for
+		 *  light to reach OM from there for muons (length >= 0)
+		 *  - cascade-like direct time for lightsaber (length = -1)
+		 */
+
+		if (source.length == -1)
+			geoTime = r_*nGroup_/
+			    I3PhotonicsCommons::cVacuum;
+		else
+			geoTime = (emissionPointOffset_ + 
+			    emissionPointDistance_*nGroup_)/cVacuum_;
+
+		break;
+	default:
+		log_fatal("Unknown table geometry type %d", geotype_);
+	}
+
+	return geoTime;
+}
+
+void
+I3PhotoSplineService::QueryModules(PhotonicsSource const &source,
+    const double *positions, size_t n_modules, double *meanPEs,
+    double *emissionPointDistances, double *geoTimes, double gradients[][6],
+    const double *delay_edges, double *quantiles, size_t n_bins)
+{
+	const int ampdim = amplitudeSplineTable_->GetNDim();
+	const int timedim = timingSplineTable_->GetNDim();
+	const int timeindex = (geotype_ == POINTSOURCE) ? 3 : 2;
+	const bool timing = (delay_edges != NULL && quantiles != NULL &&
+	    n_bins > 0);
+	double tablecoordinates[6];
+	std::vector<size_t> selected;
+	std::vector<double> ampcoords, timecoords;
+	size_t i, j, k;
+
+	if (geotype_ != POINTSOURCE && geotype_ != INFINITEMUON)
+		log_fatal("Unknown table geometry type %d", geotype_);
+
+	/*
+	 * Work out the geometry of each module, and gather the table
+	 * coordinates of those that may see light.
+	 */
+	for (i = 0; i < n_modules; i++) {
+		const double *pos = &positions[3*i];
+		double ePDist = sqrt(pow(pos[0] - source.x, 2) +
+		    pow(pos[1] - source.y, 2) + pow(pos[2] - source.z, 2));
+
+		if (gradients != NULL)
+			memset(gradients[i], 0, 6*sizeof(gradients[i][0]));
+		if (timing)
+			std::fill(&quantiles[i*n_bins],
+			    &quantiles[(i+1)*n_bins], 0.);
+		if (ePDist > maxRadius_) {
+			meanPEs[i] = 0.0;
+			emissionPointDistances[i] = ePDist;
+			geoTimes[i] = ePDist*nGroup_/cVacuum_;
+			continue;
+		}
+
+		CalculatePhotonicsInput(false, pos[0], pos[1], pos[2], source);
+		emissionPointDistances[i] = emissionPointDistance_;
+		geoTimes[i] = GeometricTime(source);
+		meanPEs[i] = -1;
+
+		FillTableCoordinates(tablecoordinates, false);
+		if (!amplitudeSplineTable_->CheckSupport(tablecoordinates))
+			continue;
+		selected.push_back(i);
+		ampcoords.insert(ampcoords.end(), tablecoordinates,
+		    tablecoordinates + ampdim);
+		if (timing) {
+			FillTableCoordinates(tablecoordinates, true);
+			timecoords.insert(timecoords.end(), tablecoordinates,
+			    tablecoordinates + timedim);
+		}
+	}
+
+	/* Any module selected for the single-module interface is gone now */
+	meanPEs_ = -1;
+	rawYield_ = -1;
+	if (selected.empty())
+		return;
+
+	const size_t nsel = selected.size();
+	std::vector<double> yields(nsel);
+	std::vector<double> raw_gradients(gradients != NULL ? nsel*ampdim : 0);
+	boost::scoped_array<bool> inside(new bool[nsel]);
+
+	EvalAmplitudeBatch(ampcoords, &yields[0],
+	    (gradients != NULL) ? &raw_gradients[0] : NULL, inside.get(),
+	    nsel);
+
+	for (k = 0; k < nsel; k++) {
+		double rawYield = inside[k] ? exp(yields[k]) : -1;
+
+		i = selected[k];
+		if (gradients != NULL && inside[k]) {
+			double raw_gradient[6] = {0, 0, 0, 0, 0, 0};
+
+			std::copy(&raw_gradients[k*ampdim],
+			    &raw_gradients[(k+1)*ampdim], raw_gradient);
+			/* The Jacobian needs this module's geometry again */
+			CalculatePhotonicsInput(false, positions[3*i],
+			    positions[3*i+1], positions[3*i+2], source);
+			ConvertMeanAmplitudeGradient(raw_gradient,
+			    gradients[i], source);
+		}
+
+		if (!std::isfinite(rawYield) || rawYield <= 0) {
+			meanPEs[i] = -1;
+		} else {
+			meanPEs[i] = I3PhotonicsCommons::scaleLightYield(source,
+			    rawYield);
+			if (gradients != NULL)
+				ScaleMeanAmplitudeGradient(gradients[i],
+				    rawYield, meanPEs[i], source);
+		}
+	}
+
+	if (!timing)
+		return;
+
+	/*
+	 * Evaluate the time CDF at every bin edge of every lit module in one
+	 * go, skipping edges outside the time support, where the CDF is known.
+	 */
+	const double *const timesupport = timingSplineTable_->GetTimeRange();
+	std::vector<double> timepoints;
+	std::vector<ssize_t> pointindex(nsel*(n_bins+1), -1);
+	size_t npoints = 0;
+
+	for (k = 0; k < nsel; k++) {
+		if (meanPEs[selected[k]] <= 0)
+			continue;
+		for (j = 0; j <= n_bins; j++) {
+			double dt = delay_edges[j];
+
+			if (dt > timesupport[1] || dt < timesupport[0] ||
+			    (j > 0 && dt == timesupport[0]))
+				continue;
+			timepoints.insert(timepoints.end(),
+			    &timecoords[k*timedim], &timecoords[(k+1)*timedim]);
+			timepoints[npoints*timedim + timeindex] = dt;
+			pointindex[k*(n_bins+1) + j] = npoints++;
+		}
+	}
+
+	std::vector<double> cdf(npoints);
+	boost::scoped_array<bool> cdf_inside(new bool[npoints]);
+	if (npoints > 0)
+		timingSplineTable_->EvalGradientsBatch(&timepoints[0], &cdf[0],
+		    NULL, cdf_inside.get(), npoints);
+
+	/* Same binning as GetProbabilityQuantiles() */
+	for (k = 0; k < nsel; k++) {
+		i = selected[k];
+		if (meanPEs[i] <= 0)
+			continue;
+
+		const ssize_t *index = &pointindex[k*(n_bins+1)];
+		double prev = (index[0] >= 0 && cdf_inside[index[0]]) ?
+		    cdf[index[0]] : 0;
+		if (!std::isfinite(prev) || prev < 0)
+			prev = 0;
+
+		for (j = 0; j < n_bins; j++) {
+			double value = 0;
+			bool err = false;
+
+			if (delay_edges[j+1] > timesupport[1])
+				value = 1.0;
+			else if (index[j+1] >= 0 && cdf_inside[index[j+1]])
+				value = cdf[index[j+1]];
+			else if (index[j+1] >= 0)
+				err = true;
+
+			double bin_prob = value - prev;
+			if (bin_prob < 0)
+				bin_prob = 0;
+			if (value < 0)
+				value = 0;
+			if (err || !std::isfinite(bin_prob)) {
+				log_warn("A PhotoSpline call failed for module "
+				    "%zu at delay %.2e -- %.2e, set to 0", i,
+				    delay_edges[j], delay_edges[j+1]);
+				bin_prob = 0;
+			}
+
+			prev = value;
+			quantiles[i*n_bins + j] = bin_prob;
+		}
+	}
+}
+
 void
 I3PhotoSplineService::GetTimeDelay(double random, double &timeDelay)
 {
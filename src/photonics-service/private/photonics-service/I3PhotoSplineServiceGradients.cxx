@@ -152,7 +152,7 @@ I3PhotoSplineService::GetMeanAmplitudeGradient(double gradient[6])
 	
 	FillTableCoordinates(tablecoordinates, false);
 	
-	err = amplitudeSplineTable_->EvalGradients(tablecoordinates, buffer);
+	err = EvalAmplitude(tablecoordinates, buffer, true);
 	if (err)
 		return false;
 	
@@ -184,15 +184,14 @@ I3PhotoSplineService::GetMeanAmplitudeHessian(double gradient[6],double hessian[
 	
 	FillTableCoordinates(tablecoordinates, false);
 	
-	amplitudeSplineTable_->EvalGradients(tablecoordinates, grad_buffer);
+	amplitudeSplineTable_->EvalGradientsHessian(tablecoordinates,
+	    grad_buffer, hessian_buffer);
 	
 	for (i = 0; i < 5; i++) {
 		if (!std::isfinite(grad[i]))
 			grad[i] = 0.;
 	}
 	
-	amplitudeSplineTable_->EvalHessian(tablecoordinates, hessian_buffer);
-	
 	/* 
 	 * Amplitudes are time-independent: scootch source zenith and depth
 	 * one column to the right and add an entry for delay time before
@@ -413,18 +412,14 @@ I3PhotoSplineService::GetProbabilityQuantileHessians(double *time_edges,
 	FillTableCoordinates(tablecoordinates, true);
 	tablecoordinates[3] = time_edges[0] - t_0;
 	
-	timingSplineTable_->EvalGradients(tablecoordinates,
-	    prev_grad_buffer);
-	timingSplineTable_->EvalHessian(tablecoordinates,
-	    prev_hessian_buffer);
+	timingSplineTable_->EvalGradientsHessian(tablecoordinates,
+	    prev_grad_buffer, prev_hessian_buffer);
 	
 	for (i = 0; i < n_bins; i++) {
 		tablecoordinates[3] = time_edges[i+1] - t_0;
 		
-		timingSplineTable_->EvalGradients(tablecoordinates,
-		    grad_buffer);
-		err = timingSplineTable_->EvalHessian(tablecoordinates,
-		    hessian_buffer);
+		err = timingSplineTable_->EvalGradientsHessian(tablecoordinates,
+		    grad_buffer, hessian_buffer);
 			
 		values[i] = grad_buffer[0] - prev_grad_buffer[0];
 		prev_grad_buffer[0] = grad_buffer[0];
@@ -3,6 +3,7 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <sys/time.h>
+#include <vector>
 
 #include <gsl/gsl_randist.h>
 #include <gsl/gsl_rng.h>
@@ -21,7 +22,8 @@ extern "C" {
 }
 
 I3PhotoSplineTable::I3PhotoSplineTable() : 
-    tablestruct_(), errorvalue_(-1), localbasis_(), centers_(),
+    tablestruct_(), eval_(&ndsplineeval), errorvalue_(-1), localbasis_(),
+    centers_(),
     fastGradients_(true), adhoc_rng_(NULL) {}
 
 I3PhotoSplineTable::~I3PhotoSplineTable()
@@ -52,10 +54,12 @@ I3PhotoSplineTable::SetupTable(const std::string& path, double errorvalue)
 
 	tablestruct_ = boost::shared_ptr<splinetable>(new splinetable,
 	    splinetable_destructor);
-	if (readsplinefitstable(path.c_str(), &*tablestruct_) == 0) {
+	if (readsplinetable(path.c_str(), &*tablestruct_) == 0) {
 		long geo, geotype, par, err;
 		double nGroupTable;
 
+		eval_ = ndsplineeval_select(tablestruct_.get());
+
 		err = splinetable_read_key(tablestruct_.get(), SPLINETABLE_INT,
 		    "GEOMETRY", &geo);
 		if (err)
@@ -151,6 +155,8 @@ I3PhotoSplineTable::SetTimeSmearing(double sigma)
 		return;
 	}
 
+	// Convolution raised the order along the time axis
+	eval_ = ndsplineeval_select(tablestruct_.get());
 	smearing_ = sigma;
 }
 
@@ -202,6 +208,18 @@ I3PhotoSplineTable::CheckSupport(double *coordinates)
 	return true;
 }
 
+int
+I3PhotoSplineTable::GetNDim() const
+{
+	return tablestruct_->ndim;
+}
+
+const double *
+I3PhotoSplineTable::GetExtent(int dim) const
+{
+	return tablestruct_->extents[dim];
+}
+
 const double *const
 I3PhotoSplineTable::GetTimeRange() const
 {
@@ -283,13 +301,73 @@ I3PhotoSplineTable::Eval(double *coordinates, double *result)
 
 	// tablesearchcenters should get const double* coordinates
 	if (tablesearchcenters(&*tablestruct_, coordinates, centers) == 0) {
-		*result = ndsplineeval(&*tablestruct_, coordinates, centers, 0);
+		*result = eval_(&*tablestruct_, coordinates, centers, 0);
 		return 0;
 	}
 
 	return EINVAL;
 }
 
+int
+I3PhotoSplineTable::EvalBatch(const double *coordinates, double *results,
+    size_t npts)
+{
+	const int ndim = tablestruct_->ndim;
+	std::vector<int> centers(npts*ndim);
+	size_t i;
+
+	if (npts == 0)
+		return 0;
+
+	int noutside = tablesearchcenters_batch(&*tablestruct_, npts,
+	    coordinates, &centers[0]);
+	ndsplineeval_batch(&*tablestruct_, npts, coordinates, &centers[0], 0,
+	    results);
+	if (noutside == 0)
+		return 0;
+
+	for (i = 0; i < npts; i++)
+		if (centers[i*ndim] < 0)
+			results[i] = errorvalue_;
+
+	return EINVAL;
+}
+
+int
+I3PhotoSplineTable::EvalGradientsBatch(const double *coordinates,
+    double *results, double *gradients, bool *inside, size_t npts)
+{
+	const int ndim = tablestruct_->ndim;
+	std::vector<int> centers(npts*ndim);
+	std::vector<double> derivs(gradients != NULL ? npts : 0);
+	size_t i;
+	int dim;
+
+	if (npts == 0)
+		return 0;
+
+	int noutside = tablesearchcenters_batch(&*tablestruct_, npts,
+	    coordinates, &centers[0]);
+	ndsplineeval_batch(&*tablestruct_, npts, coordinates, &centers[0], 0,
+	    results);
+	for (i = 0; i < npts; i++) {
+		inside[i] = (centers[i*ndim] >= 0);
+		if (!inside[i])
+			results[i] = errorvalue_;
+	}
+	if (gradients != NULL) {
+		for (dim = 0; dim < ndim; dim++) {
+			ndsplineeval_batch(&*tablestruct_, npts, coordinates,
+			    &centers[0], (1 << dim), &derivs[0]);
+			for (i = 0; i < npts; i++)
+				gradients[i*ndim + dim] =
+				    inside[i] ? derivs[i] : 0;
+		}
+	}
+
+	return (noutside == 0) ? 0 : EINVAL;
+}
+
 int
 I3PhotoSplineTable::EvalGradients(double *coordinates, double *result)
 {
@@ -303,10 +381,10 @@ I3PhotoSplineTable::EvalGradients(double *coordinates, double *result)
 		ndsplineeval_gradient(&*tablestruct_, coordinates, centers,
 		    result);
 	} else {
-		result[0] = ndsplineeval(&*tablestruct_, coordinates, centers,
+		result[0] = eval_(&*tablestruct_, coordinates, centers,
 		    0);
 		for (dim = 0; dim < tablestruct_->ndim; dim++) {
-			result[dim+1] = ndsplineeval(&*tablestruct_,
+			result[dim+1] = eval_(&*tablestruct_,
 			    coordinates, centers, (1 << dim));
 		}
 	}
@@ -316,6 +394,15 @@ I3PhotoSplineTable::EvalGradients(double *coordinates, double *result)
 
 int
 I3PhotoSplineTable::EvalHessian(double *coordinates, double result[6][6])
+{
+	double gradients[7];
+
+	return EvalGradientsHessian(coordinates, gradients, result);
+}
+
+int
+I3PhotoSplineTable::EvalGradientsHessian(double *coordinates,
+    double *gradients, double hessian[6][6])
 {
 	unsigned i, j;
 	unsigned ndim = tablestruct_->ndim;
@@ -324,17 +411,33 @@ I3PhotoSplineTable::EvalHessian(double *coordinates, double result[6][6])
 	if (tablesearchcenters(&*tablestruct_, coordinates, centers) != 0)
 		return EINVAL; 
 
+	if (fastGradients_) {
+		double flat[ndim*ndim];
+
+		ndsplineeval_hessian(&*tablestruct_, coordinates, centers,
+		    &gradients[0], &gradients[1], flat);
+		for (i = 0; i < ndim; i++)
+			for (j = 0; j < ndim; j++)
+				hessian[i][j] = flat[i*ndim + j];
+		return 0;
+	}
+
+	gradients[0] = eval_(&*tablestruct_, coordinates, centers, 0);
+	for (i = 0; i < ndim; i++)
+		gradients[i+1] = eval_(&*tablestruct_, coordinates, centers,
+		    (1 << i));
 	for (i = 0; i < ndim; i++) {
 		for (j = 0; j <= i; j++) {
 			// For diagonal entries, we need the second derviative
 			if (i == j)
-				result[i][j] = ndsplineeval_deriv2(
+				hessian[i][j] = ndsplineeval_deriv2(
 				    &*tablestruct_, coordinates, centers,
 				    (1 << i));
 			// Mixed derivatives, otoh, separate nicely.
 			else
-				result[i][j] = ndsplineeval(&*tablestruct_,
-				    coordinates, centers, (1 << i)|(1 << j));
+				hessian[i][j] = hessian[j][i] =
+				    eval_(&*tablestruct_, coordinates,
+				    centers, (1 << i)|(1 << j));
 		}
 	}
 	
@@ -358,7 +461,7 @@ I3PhotoSplineTable::EvalGradient(double *coordinates, double *result,
 
 	// tablesearchcenters should get const double* coordinates
 	if (tablesearchcenters(&*tablestruct_, coordinates, centers) == 0) {
-		*result = ndsplineeval(&*tablestruct_, coordinates, centers,
+		*result = eval_(&*tablestruct_, coordinates, centers,
 		    (1 << dim));
 		return 0;
 	}
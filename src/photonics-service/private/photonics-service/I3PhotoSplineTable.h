@@ -20,6 +20,8 @@ extern "C" {
 }
 
 struct splinetable;
+typedef double (*ndsplineeval_func)(const struct splinetable *table,
+    const double *x, const int *centers, int derivatives);
 #ifndef __GSL_RNG_H__
 struct gsl_rng;
 #endif
@@ -37,12 +39,32 @@ public:
 
 	bool SetupTable(const std::string& path, double errorvalue);
 	int Eval(double *x, double *result);
+	/*
+	 * Evaluate npts points stored one after the other in x. Points
+	 * outside the table get errorvalue. Returns EINVAL if there were any.
+	 */
+	int EvalBatch(const double *x, double *results, size_t npts);
+	/*
+	 * As EvalBatch, also flagging the points inside the table and, if
+	 * gradients is not NULL, storing ndim derivatives for each point
+	 * (zero outside the table).
+	 */
+	int EvalGradientsBatch(const double *x, double *results,
+	    double *gradients, bool *inside, size_t npts);
 	int EvalGradient(double *x, double *result, unsigned derivdim);
 	int EvalHessian(double *coordinates, double result[6][6]);
+	/*
+	 * Value, ndim derivatives (as EvalGradients) and the symmetric Hessian
+	 * from a single center search and pass over the coefficients.
+	 */
+	int EvalGradientsHessian(double *coordinates, double *gradients,
+	    double hessian[6][6]);
 	int EvalGradients(double *x, double *results);
 
 	bool CheckSupport(double *x);
 	const double *const GetTimeRange() const;
+	int GetNDim() const;
+	const double *GetExtent(int dim) const;
 
 	void GetTimeDelays(double *coords, double *times, int samples, 
 	    I3RandomServicePtr random_service);
@@ -60,6 +82,8 @@ public:
 
 private:
 	boost::shared_ptr<splinetable> tablestruct_;
+	// ndsplineeval(), or a version specialized for this table's shape
+	ndsplineeval_func eval_;
 	// the value return by ndsplineeval in case of errors
 	double errorvalue_;
 	double **localbasis_;
@@ -142,6 +142,11 @@ I3PhotonicsHitMaker::DAQ(I3FramePtr frame)
         }
         if(!mchits) log_fatal("Could not create an I3MCPeSeriesMap");
 
+	if (cascadep_)
+		cascadep_->ResetCache();
+	if (trackp_)
+		trackp_->ResetCache();
+
 	// Assumes cascade and track services have same range. Assert?
 	double lowZ, highZ, lowAng, highAng;
 	if (cascadep_) {
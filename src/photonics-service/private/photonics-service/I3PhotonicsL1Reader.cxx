@@ -31,7 +31,6 @@
 #include <cerrno>
 #include <cstring>
 #include <cassert>
-#include <sys/user.h> 
 #include <sys/mman.h>
 #include "icetray/I3Logging.h"
 #include "dataclasses/I3Constants.h"
@@ -1283,53 +1282,25 @@ Header_type *I3PhotonicsL1Reader::get_header()const{
 }
 
 bool I3PhotonicsL1Reader::mmap_file(const Opt_type *opt,Data_type *data,bool errs)const{
-  int fd = 0;
   int i = 0;
-  char *ptr = NULL;  //char pointer to match void* arithmatic in original photonics file :-(
-
   size_t size = io.h->n[0]*io.h->n[1]*io.h->n[2]*io.h->n[3]*io.h->n[4]*io.h->n[5]
     * sizeof(float);
 
-  if (isLittleEndian() != checkMetaHeadLittle(&(io.h->MetaHead))){
-	  return false;
-  } else {
+  if (isLittleEndian() != checkMetaHeadLittle(&(io.h->MetaHead)))
+    return false;
 
-	  off_t offset, remainder;
+  data->offset[VARS-1] = 1;
+  for(i=VARS-1;i>0;--i) data->offset[i-1]=data->offset[i]*io.h->n[i];
 
-	  data->offset[VARS-1] = 1;
-	  for(i=VARS-1;i>0;--i) data->offset[i-1]=data->offset[i]*io.h->n[i];
-	
-	  fd = fileno(in);
-
-	  offset = ftell(in);
-	  remainder = offset % PAGE_SIZE;
-	  offset -= remainder;
-	  ptr = (char *)mmap(NULL,size + remainder,PROT_READ,
-		     MAP_PRIVATE, fd, offset);
-	  if (ptr == MAP_FAILED){
-	    log_error("mmap() failed with %s", strerror(errno));
-	    return false;
-	  }
-          if (ptr == NULL) {
-            log_error("whoa something wierd happend with mmap()");
-            return false;
-          }
-	  fseek(in, size, SEEK_CUR);
-	  ptr += remainder;
-	  data->cont = (float *)ptr;
-
-	  if (errs) {
-	       offset = ftell(in);
-	       remainder = offset % PAGE_SIZE;
-	       offset -= remainder;
-	       ptr = (char *)mmap(NULL,size + remainder,PROT_READ,
-		     MAP_PRIVATE, fd, offset);
-	       fseek(in, size, SEEK_CUR);
-	       ptr += remainder;
-	       data->err = (float *)ptr;
-	  }
-	  data->mmaped = size + remainder;
+  /* The errors, if any, directly follow the contents */
+  data->cont = map_table_data(fileno(in), ftell(in), errs ? 2*size : size,
+			      &data->map, &data->mmaped);
+  if (data->cont == NULL) {
+    data->mmaped = 0;
+    return false;
   }
+  data->err = errs ? data->cont + size/sizeof(float) : NULL;
+  advise_random_access(data->map, data->mmaped);
 
   return true;
 }
@@ -1339,6 +1310,8 @@ bool I3PhotonicsL1Reader::mmap_file(const Opt_type *opt,Data_type *data,bool err
 bool I3PhotonicsL1Reader::read_file_without_errors(const Opt_type *opt,Data_type *data){
   test_input(opt);
   
+  data->err = NULL;
+  data->map = NULL;
   data->mmaped = 0;
   if (mmap_file(opt, data, false))
 	return true;
@@ -2297,8 +2270,7 @@ unsigned long I3PhotonicsL1Reader::data_allocated(Data_type *data,const Header_t
 /* Free memory from our main data array                            */
 void I3PhotonicsL1Reader::data_free(Data_type *data){
   if (data->mmaped > 0) {
-    munmap(data->cont, data->mmaped);
-    munmap(data->err, data->mmaped);
+    munmap(data->map, data->mmaped);
   } else {
     free(data->cont);
     if(data->err) free(data->err);
@@ -30,6 +30,7 @@
 #include <cstdio>
 #include <cerrno>
 #include <cstring>
+#include <sys/mman.h>
 #include "icetray/I3Logging.h"
 #include "dataclasses/I3Constants.h"
 #include "photonics-service/I3PhotonicsL2Reader.h"
@@ -260,8 +261,8 @@ void I3PhotonicsL2Reader::free_tablesets_level2( )
 	/* Free memory used by each table */
 	for ( j = 0; j < (*mytablesets_level2.tableset[i].n_tables); j++ ) {
 
-	    free( mytablesets_level2.tableset[i].table[j].abs.cont ); 
-	    free( mytablesets_level2.tableset[i].table[j].prob.cont ); 
+	    free_level2_data( &mytablesets_level2.tableset[i].table[j].abs );
+	    free_level2_data( &mytablesets_level2.tableset[i].table[j].prob );
 	}
 
 	/* Free tableset members */
@@ -651,6 +652,8 @@ int I3PhotonicsL2Reader::load_level2_tables(const char *driver_file){
 	  }
 	}
 	log_debug("cleared some nans: %d*%f",h->n[3],i_warnings/(1.0*h->n[3]));
+	advise_random_access(table[*n_tables].abs.map,
+			     table[*n_tables].abs.mmaped);
       }
 
       mytablesets_level2.tableset[mytablesets_level2.current].memused+=memused;
@@ -679,6 +682,8 @@ int I3PhotonicsL2Reader::load_level2_tables(const char *driver_file){
 	  }
 	}
 	log_debug("clearing some nans: %d*%f",h->n[3],i_warnings/(1.0*h->n[3]));
+	advise_random_access(table[*n_tables].prob.map,
+			     table[*n_tables].prob.mmaped);
 	
 	
       }
@@ -2658,8 +2663,29 @@ int I3PhotonicsL2Reader::read_level2_file(const char *file,Level2_header_type *h
   data->offset[1]=data->offset[2]*h->n[2];
   data->offset[0]=data->offset[1]*h->n[1];
   
-  /* Allocate memory and read it */
   size=data->offset[0]*h->n[0];
+  *memused= (unsigned long) (size*sizeof(float));
+
+  /*
+   * Map the data straight from the file if it is in our byte order, so
+   * that processes loading the same tables share one copy. Only pages
+   * the nan/inf cleanup in load_level2_tables() writes to get copied;
+   * readahead is left on until that cleanup has been through the table.
+   */
+  data->map=NULL;
+  data->mmaped=0;
+  if(isLittleEndian()==checkMetaHeadLittle(&(h->MetaHead))){
+    data->cont=map_table_data(fileno(fh),sizeof(Level2_header_type),
+			      size*sizeof(float),&data->map,&data->mmaped);
+    if(data->cont!=NULL){
+      fclose(fh);
+      return true;
+    }
+    log_warn("Photonics Level2: Unable to map %s, reading it instead.",file);
+    data->mmaped=0;
+  }
+
+  /* Allocate memory and read it */
   if((data->cont=(float *)malloc(size*sizeof(float)))==NULL){
     log_error("Photonics Level2: Unable to allocate memory for data in file %s.",file);
     return false;
@@ -2686,12 +2712,17 @@ int I3PhotonicsL2Reader::read_level2_file(const char *file,Level2_header_type *h
     }
   }
 
-  //  mytablesets_level2.tableset[mytablesets_level2.current].memused+=(unsigned long) (size*sizeof(float));
-
-  *memused= (unsigned long) (size*sizeof(float));
   return true;
 }
 
+/* Free the data of a single level2 file */
+void I3PhotonicsL2Reader::free_level2_data(Level2_data_type *data){
+  if(data->mmaped>0)
+    munmap(data->map,data->mmaped);
+  else
+    free(data->cont);
+}
+
 // performs byte swapping on relevant members of level2 headers for Power-PC etc.
 void I3PhotonicsL2Reader::byteswap32_l2header(Level2_header_type * h)
 {
@@ -28,6 +28,9 @@
 #include <cmath>
 #include <cstring>
 #include <stdint.h>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <sys/mman.h> 
 #include "dataclasses/I3Constants.h"
 #include "icetray/I3Logging.h"
@@ -415,5 +418,39 @@ namespace photonics{
     *((long long *)p_swapit_) = s;
 
   }
+
+  float *map_table_data(int fd, size_t offset, size_t len,
+			void **base, size_t *mapped){
+    struct stat st;
+    size_t remainder = offset % sysconf(_SC_PAGESIZE);
+    char *ptr;
+
+    if(fstat(fd,&st)!=0){
+      log_error("fstat() failed with %s",strerror(errno));
+      return NULL;
+    }
+    if((size_t)st.st_size < offset+len){
+      log_error("Table file is shorter than its header says (%zu < %zu bytes)",
+		(size_t)st.st_size,offset+len);
+      return NULL;
+    }
+
+    ptr=(char *)mmap(NULL,len+remainder,PROT_READ|PROT_WRITE,MAP_PRIVATE,
+		     fd,offset-remainder);
+    if(ptr==MAP_FAILED){
+      log_error("mmap() failed with %s",strerror(errno));
+      return NULL;
+    }
+
+    *base=ptr;
+    *mapped=len+remainder;
+    return (float *)(ptr+remainder);
+  }
+
+  void advise_random_access(void *base, size_t mapped){
+    /* lookups hop around the table; don't bother reading ahead */
+    if(base!=NULL && mapped>0)
+      madvise(base,mapped,MADV_RANDOM);
+  }
     
 }  //namespace photonics
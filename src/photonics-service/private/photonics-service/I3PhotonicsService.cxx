@@ -8,6 +8,8 @@
  *(c) the IceCube Collaboration
  */
 
+#include <algorithm>
+
 #include <icetray/I3Units.h>
 #include <photonics-service/I3PhotonicsService.h>
 #include <dataclasses/geometry/I3OMGeo.h>
@@ -270,6 +272,32 @@ I3PhotonicsService::SelectSource( double &meanPEs, double gradients[6],
 		GetMeanAmplitudeGradient(gradients);
 }
 
+void
+I3PhotonicsService::QueryModules(PhotonicsSource const &source,
+    const double *positions, size_t n_modules, double *meanPEs,
+    double *emissionPointDistances, double *geoTimes, double gradients[][6],
+    const double *delay_edges, double *quantiles, size_t n_bins)
+{
+	for (size_t i = 0; i < n_modules; i++) {
+		SelectModuleCoordinates(positions[3*i], positions[3*i+1],
+		    positions[3*i+2]);
+		if (gradients != NULL)
+			SelectSource(meanPEs[i], gradients[i],
+			    emissionPointDistances[i], geoTimes[i], source);
+		else
+			SelectSource(meanPEs[i], emissionPointDistances[i],
+			    geoTimes[i], source);
+
+		if (delay_edges == NULL || quantiles == NULL)
+			continue;
+		if (meanPEs[i] <= 0 || !GetProbabilityQuantiles(
+		    const_cast<double *>(delay_edges), 0, &quantiles[i*n_bins],
+		    n_bins))
+			std::fill(&quantiles[i*n_bins], &quantiles[(i+1)*n_bins],
+			    0.);
+	}
+}
+
 void
 I3PhotonicsService::SelectSource(double &meanPEs, double &emissionPointDistance,
     double &geoTime, double x, double y, double z, double zenith,
@@ -26,6 +26,12 @@ void register_I3PhotoSplineService() {
 	        (args("amplitudetable", "timingtable"), args("timingSigma")=0.0, args("maxRadius")=std::numeric_limits<double>::infinity()),
 	        "Create an I3PhotoSplineService object."))
 	    .def("LoadSplineTables", &I3PhotoSplineService::LoadSplineTables)
+	    .def("SetCache", &I3PhotoSplineService::SetCache,
+	        (args("self", "size"), args("resolution")=0.0),
+	        "Remember up to `size` amplitude evaluations, keyed on table "
+	        "coordinates rounded to `resolution` times the table extent")
+	    .def("GetCacheStatistics", &GetCacheStatistics, args("self"),
+	        "Returns the number of cache hits and misses")
 	    #define PHOTOSPLINE_PROPS (Geometry)(Parity)
 	    BOOST_PP_SEQ_FOR_EACH(WRAP_PROP_RO, I3PhotoSplineService, PHOTOSPLINE_PROPS)
 	    ;
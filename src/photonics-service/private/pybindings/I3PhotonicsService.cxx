@@ -8,7 +8,7 @@
     (SetAngularSelection)(GetAngularSelectionLow)(GetAngularSelectionHigh)\
     (SetDepthSelection)\
     (SelectModuleCoordinates)(SelectModule)(GetLmaxLevel1)(GetLmaxLevel2)\
-    (CalculatePhotonicsInput)(GetPhotonicsInput)
+    (CalculatePhotonicsInput)(GetPhotonicsInput)(ResetCache)
 
 #define PSFIELDS (x)(y)(z)(dirx)(diry)(dirz)(perpx)(perpy)(perpz)(zenith)\
     (E)(length)(speed)(type)(sintheta)(costheta)(sinphi)(cosphi)
@@ -150,6 +150,16 @@ splinetableeval_gradient(I3PhotoSplineTable & self,
 #define PY_TYPESTRING(pyobj) \
 	pyobj.ptr()->ob_type->tp_name
 
+tuple
+GetCacheStatistics(const I3PhotoSplineService &self)
+{
+	size_t hits, misses;
+
+	self.GetCacheStatistics(hits, misses);
+
+	return make_tuple(hits, misses);
+}
+
 double
 splinetableeval(I3PhotoSplineTable & self,
     object coordinates)
@@ -66,6 +66,9 @@ object getHessian(const double xOM, const double yOM, const double zOM,
 #endif /* USE_NUMPY */
 
 #ifdef USE_PHOTOSPLINE
+/* I3PhotoSplineService functions */
+tuple GetCacheStatistics(const I3PhotoSplineService &self);
+
 /* I3PhotoSplineTable functions */
 double splinetableeval(I3PhotoSplineTable & self,
     object coordinates);
@@ -216,5 +216,204 @@ TEST(GradientEvaluation)
 	}
 }
 
+TEST(BatchedModuleQueries)
+{
+	TableSet tables = get_splinetables();
+	
+	I3RandomServicePtr rng(new I3GSLRandomService(7));
+	I3PhotoSplineService pxs(tables.abs.string(), tables.prob.string(), 0.0);
+	const size_t nmodules = 200, nbins = 20;
+	
+	std::vector<double> delay_edges;
+	delay_edges.push_back(-10);
+	for (unsigned i=0; i < nbins; i++)
+		delay_edges.push_back(rng->Uniform(0, 3000));
+	std::sort(delay_edges.begin(), delay_edges.end());
+	
+	for (int i=0; i < 5; i++) {
+		PhotonicsSource source = CoordBundle::randomSource(*rng);
+		std::vector<double> positions;
+		for (unsigned j=0; j < nmodules; j++) {
+			CoordBundle coord = CoordBundle::random(*rng, source);
+			positions.push_back(coord.x_);
+			positions.push_back(coord.y_);
+			positions.push_back(coord.z_);
+		}
+		
+		std::vector<double> meanPEs(nmodules), distances(nmodules),
+		    geoTimes(nmodules), quantiles(nmodules*nbins);
+		std::vector<double> gradients(nmodules*6);
+		pxs.QueryModules(source, &positions[0], nmodules, &meanPEs[0],
+		    &distances[0], &geoTimes[0],
+		    (double (*)[6])&gradients[0], &delay_edges[0], &quantiles[0],
+		    nbins);
+		
+		for (unsigned j=0; j < nmodules; j++) {
+			double meanPE, distance, geoTime, gradient[6];
+			std::vector<double> quantile(nbins, 0.);
+			pxs.SelectModuleCoordinates(positions[3*j],
+			    positions[3*j+1], positions[3*j+2]);
+			pxs.SelectSource(meanPE, gradient, distance, geoTime, source);
+			if (meanPE > 0)
+				pxs.GetProbabilityQuantiles(&delay_edges[0], 0,
+				    &quantile[0], nbins);
+			
+			ENSURE_DISTANCE(meanPEs[j], meanPE, 1e-6*fabs(meanPE),
+			    "Batched amplitude matches SelectSource()");
+			ENSURE_EQUAL(distances[j], distance);
+			ENSURE_EQUAL(geoTimes[j], geoTime);
+			for (unsigned k=0; k < 6; k++)
+				ENSURE_DISTANCE(gradients[6*j+k], gradient[k],
+				    1e-6*fabs(gradient[k]) + 1e-12,
+				    "Batched gradient matches SelectSource()");
+			for (unsigned k=0; k < nbins; k++)
+				ENSURE_DISTANCE(quantiles[j*nbins+k], quantile[k],
+				    1e-6,
+				    "Batched quantiles match GetProbabilityQuantiles()");
+		}
+	}
+}
+
+TEST(AmplitudeCache)
+{
+	TableSet tables = get_splinetables();
+	
+	I3RandomServicePtr rng(new I3GSLRandomService(11));
+	I3PhotoSplineService plain(tables.abs.string(), tables.prob.string(), 0.0);
+	I3PhotoSplineService cached(tables.abs.string(), tables.prob.string(), 0.0);
+	cached.SetCache(50);
+	
+	PhotonicsSource source = CoordBundle::randomSource(*rng);
+	std::vector<CoordBundle> coords;
+	for (int j=0; j < 100; j++)
+		coords.push_back(CoordBundle::random(*rng, source));
+	
+	// Two passes: the second should come entirely from the cache for
+	// the 50 most recently seen modules
+	size_t hits, misses;
+	for (int pass=0; pass < 2; pass++) {
+		for (unsigned j=0; j < coords.size(); j++) {
+			const CoordBundle &coord = coords[(pass == 0) ? j :
+			    coords.size()-1-j];
+			double meanPE, cachedPE, distance, geoTime;
+			double gradient[6], cachedGradient[6];
+			plain.SelectModuleCoordinates(coord.x_, coord.y_, coord.z_);
+			cached.SelectModuleCoordinates(coord.x_, coord.y_, coord.z_);
+			plain.SelectSource(meanPE, gradient, distance, geoTime,
+			    source);
+			cached.SelectSource(cachedPE, cachedGradient, distance,
+			    geoTime, source);
+			ENSURE_EQUAL(meanPE, cachedPE,
+			    "Cached amplitude is identical");
+			for (unsigned k=0; k < 6; k++)
+				ENSURE_EQUAL(gradient[k], cachedGradient[k],
+				    "Cached gradient is identical");
+		}
+		cached.GetCacheStatistics(hits, misses);
+		if (pass == 0)
+			ENSURE_EQUAL(hits, 0u, "Nothing to hit on the first pass");
+	}
+	ENSURE(hits > 0, "Second pass hits the cache");
+	ENSURE(hits <= 50u, "No more hits than cache entries");
+	
+	cached.ResetCache();
+	cached.SelectModuleCoordinates(coords[0].x_, coords[0].y_, coords[0].z_);
+	double meanPE, distance, geoTime;
+	cached.SelectSource(meanPE, distance, geoTime, source);
+	size_t newhits, newmisses;
+	cached.GetCacheStatistics(newhits, newmisses);
+	ENSURE_EQUAL(newhits, hits, "ResetCache() empties the cache");
+}
+
+TEST(CachedModuleQueries)
+{
+	TableSet tables = get_splinetables();
+	
+	I3RandomServicePtr rng(new I3GSLRandomService(13));
+	I3PhotoSplineService plain(tables.abs.string(), tables.prob.string(), 0.0);
+	I3PhotoSplineService cached(tables.abs.string(), tables.prob.string(), 0.0);
+	cached.SetCache(1000);
+	const size_t nmodules = 100;
+	
+	PhotonicsSource source = CoordBundle::randomSource(*rng);
+	std::vector<double> positions;
+	for (unsigned j=0; j < nmodules; j++) {
+		CoordBundle coord = CoordBundle::random(*rng, source);
+		positions.push_back(coord.x_);
+		positions.push_back(coord.y_);
+		positions.push_back(coord.z_);
+	}
+	
+	std::vector<double> meanPEs(nmodules), distances(nmodules),
+	    geoTimes(nmodules), gradients(nmodules*6);
+	plain.QueryModules(source, &positions[0], nmodules, &meanPEs[0],
+	    &distances[0], &geoTimes[0], (double (*)[6])&gradients[0]);
+	
+	// The first query fills the cache, the second is answered from it
+	size_t hits, misses;
+	for (int pass=0; pass < 2; pass++) {
+		std::vector<double> cachedPEs(nmodules), cachedGradients(nmodules*6);
+		cached.QueryModules(source, &positions[0], nmodules,
+		    &cachedPEs[0], &distances[0], &geoTimes[0],
+		    (double (*)[6])&cachedGradients[0]);
+		for (unsigned j=0; j < nmodules; j++) {
+			ENSURE_EQUAL(meanPEs[j], cachedPEs[j],
+			    "Cached amplitude is identical");
+			for (unsigned k=0; k < 6; k++)
+				ENSURE_EQUAL(gradients[6*j+k],
+				    cachedGradients[6*j+k],
+				    "Cached gradient is identical");
+		}
+		cached.GetCacheStatistics(hits, misses);
+		if (pass == 0) {
+			ENSURE_EQUAL(hits, 0u, "Nothing to hit on the first query");
+		} else {
+			ENSURE_EQUAL(hits, misses,
+			    "Second query comes from the cache");
+		}
+	}
+	ENSURE(hits > 0, "Some modules are in the table support");
+}
+
+TEST(CacheAfterReload)
+{
+	TableSet tables = get_splinetables();
+	
+	I3RandomServicePtr rng(new I3GSLRandomService(17));
+	I3PhotoSplineService pxs;
+	// The cache is set up once there are tables to go with it
+	pxs.SetCache(50);
+	ENSURE(pxs.LoadSplineTables(tables.abs.string(), tables.prob.string()),
+	    "Tables load");
+	
+	// A module in the table support, so that its amplitude is evaluated
+	PhotonicsSource source = CoordBundle::randomSource(*rng);
+	CoordBundle coord = CoordBundle::random(*rng, source);
+	double meanPE, reloadedPE, distance, geoTime;
+	size_t hits, misses = 0;
+	for (int j=0; j < 100 && misses == 0; j++) {
+		coord = CoordBundle::random(*rng, source);
+		pxs.SelectModuleCoordinates(coord.x_, coord.y_, coord.z_);
+		pxs.SelectSource(meanPE, distance, geoTime, source);
+		pxs.GetCacheStatistics(hits, misses);
+	}
+	ENSURE_EQUAL(misses, 1u, "The amplitude goes through the cache");
+	
+	ENSURE(pxs.LoadSplineTables(tables.abs.string(), tables.prob.string()),
+	    "Tables reload");
+	pxs.SelectModuleCoordinates(coord.x_, coord.y_, coord.z_);
+	pxs.SelectSource(reloadedPE, distance, geoTime, source);
+	pxs.GetCacheStatistics(hits, misses);
+	ENSURE_EQUAL(hits, 0u, "Nothing is served from the old tables");
+	ENSURE_EQUAL(misses, 1u, "The reloaded tables have a new cache");
+	ENSURE_EQUAL(meanPE, reloadedPE, "Same tables, same amplitude");
+	
+	pxs.SelectModuleCoordinates(coord.x_, coord.y_, coord.z_);
+	pxs.SelectSource(reloadedPE, distance, geoTime, source);
+	pxs.GetCacheStatistics(hits, misses);
+	ENSURE_EQUAL(hits, 1u, "The new cache is in use");
+	ENSURE_EQUAL(meanPE, reloadedPE, "Cached amplitude is identical");
+}
+
 #endif /* USE_PHOTOSPLINE */
 
@@ -29,7 +29,8 @@ class I3PhotoSplineService : public I3PhotonicsService, public I3ServiceBase {
         void Configure();
 
         /**
-         *@brief Load fitted photonics tables (spline coeffs)
+         *@brief Load fitted photonics tables (spline coeffs). An amplitude
+         * cache set up with SetCache() starts out empty for the new tables.
          */
         virtual bool LoadSplineTables(std::string ampFileName, std::string timeFileName);
 
@@ -39,6 +40,27 @@ class I3PhotoSplineService : public I3PhotonicsService, public I3ServiceBase {
          */
         void ConvoluteTime(double sigma);
 
+        /**
+         *@brief Remember up to size amplitude evaluations (value and
+         * gradient), keyed on the amplitude table coordinates rounded to
+         * resolution times the table extent in each dimension. With a
+         * resolution of 0 only identical coordinates match; anything
+         * larger trades accuracy for hits. A size of 0 turns the cache off.
+         * SelectSource() and QueryModules() both go through the cache.
+         */
+        void SetCache(size_t size, double resolution=0);
+
+        /**
+         *@brief Empty the amplitude cache, e.g. at the start of each event
+         */
+        virtual void ResetCache();
+
+        /**
+         *@brief Number of amplitude evaluations answered from the cache
+         * and passed on to the spline table since SetCache()
+         */
+        void GetCacheStatistics(size_t &hits, size_t &misses) const;
+
         /**
          *@brief Select OM coordinates
          *@param OMx,OMy,OMz    OM coordinates
@@ -66,6 +88,17 @@ class I3PhotoSplineService : public I3PhotonicsService, public I3ServiceBase {
                                    PhotonicsSource const &source,
 				   bool getAmp=true);
 
+        /**
+         *@brief Evaluate one source at many modules, with one batched
+         *       spline evaluation for all amplitudes and one for all
+         *       time bin edges (see I3PhotonicsService::QueryModules)
+         */
+        virtual void QueryModules(PhotonicsSource const &source,
+            const double *positions, size_t n_modules, double *meanPEs,
+            double *emissionPointDistances, double *geoTimes,
+            double gradients[][6] = NULL, const double *delay_edges = NULL,
+            double *quantiles = NULL, size_t n_bins = 0);
+
         /**
          *@brief Get residual time for hit (w.r.t direct propagation from nominal 
          *       emission point)
@@ -147,6 +180,11 @@ class I3PhotoSplineService : public I3PhotonicsService, public I3ServiceBase {
         I3PhotoSplineTablePtr amplitudeSplineTable_;
         I3PhotoSplineTablePtr timingSplineTable_;
 
+        class AmplitudeCache;
+        boost::shared_ptr<AmplitudeCache> cache_;
+        size_t cacheSize_;
+        double cacheResolution_;
+
         SET_LOGGER("I3PhotoSplineService");
 
     private:
@@ -169,6 +207,14 @@ class I3PhotoSplineService : public I3PhotonicsService, public I3ServiceBase {
 
         double rawYield_; // unscaled npe returned by photonics
 
+	double GeometricTime(PhotonicsSource const &source);
+
+	int EvalAmplitude(double tablecoordinates[6], double buffer[7],
+	    bool gradients);
+
+	void EvalAmplitudeBatch(const std::vector<double> &tablecoordinates,
+	    double *yields, double *gradients, bool *inside, size_t n);
+
 	void FillTableCoordinates(double tablecoordinates[6], bool timing);
 
 	void ConvertMeanAmplitudeGradient(double raw_gradient[6],
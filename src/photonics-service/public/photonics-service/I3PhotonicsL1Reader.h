@@ -48,6 +48,7 @@ class I3PhotonicsL1Reader {
   struct Data_type{
     float *cont;            /**< Data pointer */
     float *err;             /**< Error matrix pointer */
+    void   *map;            /**< Start of the mapping holding cont and err */
     size_t  mmaped;         /**< Bytes mmaped in cont and err. If zero, data
 			       were allocated with malloc(), not mmap() */
     photonics::ph_size_t offset[VARS]; /**< Array encoding size of each subtable */
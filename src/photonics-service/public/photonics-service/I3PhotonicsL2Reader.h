@@ -91,6 +91,9 @@ class I3PhotonicsL2Reader {
 
   struct Level2_data_type{
     float *cont;                          /**< Pointer to data table */
+    void *map;                            /**< Start of the mapping holding cont */
+    size_t mmaped;                        /**< Bytes mmaped for cont. If zero, data
+					     were allocated with malloc(), not mmap() */
     photonics::ph_size_t offset[L2VARS];  /**< Array encoding size of each subtable */
   };
 
@@ -586,6 +589,11 @@ class I3PhotonicsL2Reader {
    */
   static int read_level2_file(const char *file,Level2_header_type *h,Level2_data_type *data,unsigned long *memused);
 
+  /**
+   * @brief Release the data read by read_level2_file
+   */
+  static void free_level2_data(Level2_data_type *data);
+
   /**
    * @brief Table comparator for sorting of data tables
    */
@@ -248,6 +248,27 @@ namespace photonics {
    * Operates directly on p_swapit_ 
    */
   void px_swap64 (void * p_swapit_);
+
+  /**
+   * @brief Map len bytes of table data starting at byte offset of the
+   * open file fd into memory
+   *
+   * The mapping is private: pages are shared with the page cache (and so
+   * with every other process mapping the same table) until written to.
+   *
+   * @returns pointer to the data, or NULL if the file is too short or
+   * mmap() fails. *base and *mapped receive the arguments for munmap().
+   */
+  float *map_table_data(int fd, size_t offset, size_t len,
+			void **base, size_t *mapped);
+
+  /**
+   * @brief Turn off readahead for a mapping made by map_table_data()
+   *
+   * Call this once any pass over the whole table is done, since lookups
+   * only touch a few pages each. Does nothing if nothing is mapped.
+   */
+  void advise_random_access(void *base, size_t mapped);
   
 }//namespace photonics
 
@@ -201,6 +201,38 @@ public:
 	    double azimuth, double length, double Energy, int type)
 	    __attribute__((__deprecated__));
 
+	/**
+	 *@brief Evaluate one light source at many modules at once
+	 *
+	 * Gives the same results as calling SelectModuleCoordinates() and
+	 * SelectSource() for each module in turn, followed by
+	 * GetProbabilityQuantiles() with t_0 = 0 if quantiles are requested.
+	 * Derived classes may evaluate all modules together, so the module
+	 * and source left selected for the single-module methods afterwards
+	 * are unspecified.
+	 *
+	 *@param[in]  source        Source parameters
+	 *@param[in]  positions     Module coordinates, x,y,z for each module
+	 *                          (metres)
+	 *@param[in]  n_modules     Number of modules
+	 *@param[out] meanPEs       Mean number of PEs at each module, negative
+	 *                          where there is no timing information
+	 *@param[out] emissionPointDistances  As in SelectSource()
+	 *@param[out] geoTimes      As in SelectSource()
+	 *@param[out] gradients     If not NULL, the gradient of each mean
+	 *                          amplitude, as in SelectSource()
+	 *@param[in]  delay_edges   If not NULL, the n_bins+1 edges of time bins
+	 *                          relative to the direct arrival time
+	 *@param[out] quantiles     n_bins mean PE fractions for each module,
+	 *                          zero where meanPEs <= 0
+	 *@param[in]  n_bins        Number of time bins
+	 */
+	virtual void QueryModules(PhotonicsSource const &source,
+	    const double *positions, size_t n_modules, double *meanPEs,
+	    double *emissionPointDistances, double *geoTimes,
+	    double gradients[][6] = NULL, const double *delay_edges = NULL,
+	    double *quantiles = NULL, size_t n_bins = 0);
+
 	/** 
 	 *@brief Get photon arrival time 
 	 * Draws a photon arrival time (in ns) using table pointers set up 
@@ -342,6 +374,12 @@ public:
 	*/
 	virtual double GetLmaxLevel2() { return DBL_MAX; }
 
+	/**
+	 *@brief Forget results cached from previous calls, e.g. at the start
+	 * of each event. A no-op for services without a cache.
+	 */
+	virtual void ResetCache() {}
+
 	/**
 	 *@brief return photonics geometry parameters (+ emission point
 	 * parameters) as doubles
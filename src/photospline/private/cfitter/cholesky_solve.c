@@ -119,6 +119,178 @@ cholesky_solve(cholmod_sparse *AtA, cholmod_dense *Atb, cholmod_common *c,
 	return (x);
 }
 
+/*
+ * Products with a symmetric matrix stored in full, split by column over
+ * threads. Since A' = A, y[j] is the dot product of column j with x, so
+ * every thread writes its own slice of y.
+ */
+
+struct cg_product {
+	const cholmod_sparse *A;
+	const double *x;
+	double *y;
+	long first, last;
+	pthread_t thread;
+};
+
+static void *
+cg_multiply_columns(void *arg)
+{
+	struct cg_product *prod = arg;
+	const long *Ap = prod->A->p, *Ai = prod->A->i, *Anz = prod->A->nz;
+	const double *Ax = prod->A->x;
+	long j, k, end;
+	double sum;
+
+	for (j = prod->first; j < prod->last; j++) {
+		end = prod->A->packed ? Ap[j+1] : Ap[j] + Anz[j];
+		sum = 0;
+		for (k = Ap[j]; k < end; k++)
+			sum += Ax[k]*prod->x[Ai[k]];
+		prod->y[j] = sum;
+	}
+
+	return (NULL);
+}
+
+static void
+cg_multiply(struct cg_product *prods, int nthreads, const double *x,
+    double *y)
+{
+	int t, started;
+
+	for (t = 0; t < nthreads; t++) {
+		prods[t].x = x;
+		prods[t].y = y;
+	}
+	if (nthreads == 1) {
+		cg_multiply_columns(&prods[0]);
+		return;
+	}
+	for (t = 0; t < nthreads; t++)
+		if (pthread_create(&prods[t].thread, NULL,
+		    cg_multiply_columns, &prods[t]) != 0)
+			break;
+	/* Do the columns of any threads that could not be started here */
+	for (started = t; t < nthreads; t++)
+		cg_multiply_columns(&prods[t]);
+	for (t = 0; t < started; t++)
+		pthread_join(prods[t].thread, NULL);
+}
+
+cholmod_dense *
+cg_solve(cholmod_sparse *AtA, cholmod_dense *Atb, double tolerance,
+    long max_iterations, int verbose, cholmod_common *c)
+{
+	cholmod_sparse *A;
+	cholmod_dense *result;
+	struct cg_product *prods;
+	double *x, *r, *z, *p, *q, *precond;
+	const double *b;
+	double rz, rz_old, pq, alpha, rr, bb;
+	long nvar, i, j, k, end, iteration;
+	int t, nthreads;
+	clock_t t0;
+
+	/* The column products need both triangles */
+	A = (AtA->stype == 0) ? AtA : cholmod_l_copy(AtA, 0, 1, c);
+	if (A == NULL)
+		return (NULL);
+
+	nvar = A->nrow;
+	b = (const double *)(Atb->x);
+	result = cholmod_l_zeros(nvar, 1, CHOLMOD_REAL, c);
+	r = malloc(nvar*sizeof(double));
+	z = malloc(nvar*sizeof(double));
+	p = malloc(nvar*sizeof(double));
+	q = malloc(nvar*sizeof(double));
+	precond = malloc(nvar*sizeof(double));
+
+	/* Don't bother with threads for products that take microseconds */
+	nthreads = get_nthreads();
+	if (nthreads > cholmod_l_nnz(A, c)/100000 + 1)
+		nthreads = cholmod_l_nnz(A, c)/100000 + 1;
+	prods = malloc(nthreads*sizeof(struct cg_product));
+
+	if (result == NULL || r == NULL || z == NULL || p == NULL ||
+	    q == NULL || precond == NULL || prods == NULL) {
+		if (result != NULL)
+			cholmod_l_free_dense(&result, c);
+		result = NULL;
+		goto done;
+	}
+
+	x = (double *)(result->x);
+	for (t = 0; t < nthreads; t++) {
+		prods[t].A = A;
+		prods[t].first = nvar*t/nthreads;
+		prods[t].last = nvar*(t+1)/nthreads;
+	}
+
+	/* Jacobi preconditioner: the inverse of the diagonal */
+	for (j = 0; j < nvar; j++) {
+		precond[j] = 1;
+		end = A->packed ? ((long *)(A->p))[j+1] :
+		    ((long *)(A->p))[j] + ((long *)(A->nz))[j];
+		for (k = ((long *)(A->p))[j]; k < end; k++)
+			if (((long *)(A->i))[k] == j &&
+			    ((double *)(A->x))[k] > 0)
+				precond[j] = 1./((double *)(A->x))[k];
+	}
+
+	/* Start from x = 0, so the residual is just b */
+	bb = rz = 0;
+	for (i = 0; i < nvar; i++) {
+		r[i] = b[i];
+		p[i] = z[i] = precond[i]*r[i];
+		rz += r[i]*z[i];
+		bb += b[i]*b[i];
+	}
+	rr = bb;
+
+	t0 = clock();
+	for (iteration = 0; iteration < max_iterations &&
+	    rr > tolerance*tolerance*bb; iteration++) {
+		cg_multiply(prods, nthreads, p, q);
+
+		pq = 0;
+		for (i = 0; i < nvar; i++)
+			pq += p[i]*q[i];
+		if (pq <= 0)
+			break;
+		alpha = rz/pq;
+
+		rz_old = rz;
+		rz = rr = 0;
+		for (i = 0; i < nvar; i++) {
+			x[i] += alpha*p[i];
+			r[i] -= alpha*q[i];
+			z[i] = precond[i]*r[i];
+			rz += r[i]*z[i];
+			rr += r[i]*r[i];
+		}
+		for (i = 0; i < nvar; i++)
+			p[i] = z[i] + (rz/rz_old)*p[i];
+
+		if (verbose && (iteration+1) % 100 == 0)
+			printf("CG iteration %ld: relative residual %e\n",
+			    iteration+1, sqrt(rr/bb));
+	}
+
+	if (verbose)
+		printf("CG[%ld]: %ld iterations, relative residual %e, "
+		    "%f s\n", nvar, iteration, sqrt(rr/bb),
+		    (double)(clock()-t0)/(CLOCKS_PER_SEC));
+
+done:
+	free(prods);
+	free(r); free(z); free(p); free(q); free(precond);
+	if (A != AtA)
+		cholmod_l_free_sparse(&A, c);
+
+	return (result);
+}
+
 cholmod_sparse* get_column(cholmod_sparse *A, long k, 
     long *iPerm, long *Fset, long nF, cholmod_common *c)
 {
@@ -8,6 +8,16 @@
 cholmod_dense *
 cholesky_solve(cholmod_sparse *AtA, cholmod_dense *Atb, cholmod_common *c, int verbose, int n_resolves);
 
+/*
+ * Solve AtA*x = Atb with the conjugate gradient method, preconditioned with
+ * the diagonal of AtA. No factor is formed, so memory stays at the size of
+ * AtA itself, and the products with AtA run on get_nthreads() threads.
+ * Stops once |AtA*x - Atb| < tolerance*|Atb| or after max_iterations.
+ */
+cholmod_dense *
+cg_solve(cholmod_sparse *AtA, cholmod_dense *Atb, double tolerance,
+    long max_iterations, int verbose, cholmod_common *c);
+
 cholmod_sparse *
 get_column(cholmod_sparse *A, long k, long *iPerm, 
     long *Fset, long nF, cholmod_common *c);
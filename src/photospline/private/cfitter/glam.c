@@ -20,7 +20,7 @@ void print_ndsparse_py(struct ndsparse *a);
 void
 glamfit(struct ndsparse *data, double *weights, double **coords,
     struct splinetable *out, double smooth, int *order, int *penorder,
-    int monodim, int verbose, cholmod_common *c)
+    int monodim, enum glam_solver solver, int verbose, cholmod_common *c)
 {
 	long *nsplines;
 	cholmod_sparse *penalty;
@@ -55,7 +55,7 @@ glamfit(struct ndsparse *data, double *weights, double **coords,
 	free(nsplines);
 	
 	glamfit_complex(data, weights, coords, out, order, penalty,
-	    monodim, verbose, c);
+	    monodim, solver, verbose, c);
 	
 	/* clean up what we passed in */
 	cholmod_l_free_sparse(&penalty, c);
@@ -64,7 +64,7 @@ glamfit(struct ndsparse *data, double *weights, double **coords,
 void
 glamfit_complex(struct ndsparse *data, double *weights, double **coords,
     struct splinetable *out, int *order, cholmod_sparse* penalty,
-    int monodim, int verbose, cholmod_common *c)
+    int monodim, enum glam_solver solver, int verbose, cholmod_common *c)
 {
 	cholmod_sparse **bases, **boxedbases;
 	cholmod_dense *coefficients, *Rdens;
@@ -163,8 +163,25 @@ glamfit_complex(struct ndsparse *data, double *weights, double **coords,
 		if (verbose)
 			printf("\t\tConvolving dimension %ld\n",i);
 
-		slicemultiply(&F, boxedbases[i], i, c);
-		slicemultiply(&R, bases[i], i, c);
+		if (slicemultiply(&F, boxedbases[i], i, c) != 0 ||
+		    slicemultiply(&R, bases[i], i, c) != 0) {
+			printf("Convolving bases FAILED\n");
+			for (j = 0; j < data->ndim; j++) {
+				free(F.i[j]);
+				free(R.i[j]);
+			}
+			free(F.x); free(F.i); free(F.ranges);
+			free(R.x); free(R.i); free(R.ranges);
+			for (j = 0; j < out->ndim; j++) {
+				cholmod_l_free_sparse(&bases[j], c);
+				cholmod_l_free_sparse(&boxedbases[j], c);
+			}
+			free(bases); free(boxedbases);
+			free(nsplines);
+			out->coefficients = NULL;
+			out->naxes = NULL;
+			return;
+		}
 	}
 
 	/* Now flatten R into a matrix */
@@ -261,6 +278,9 @@ glamfit_complex(struct ndsparse *data, double *weights, double **coords,
 	if (monodim >= 0) {
 		coefficients = nnls_normal_block3(fitmat, Rdens,
 		    verbose, c);
+	} else if (solver == GLAM_CG) {
+		coefficients = cg_solve(fitmat, Rdens, 1e-10, 10*sidelen,
+		    verbose, c);
 	} else {
 		/* XXX: clamped to one iteration */
 		coefficients = cholesky_solve(fitmat, Rdens, c,
@@ -12,13 +12,24 @@
 #include "photospline/splinetable.h"
 #include "splineutil.h"
 
+/*
+ * Solvers for the penalized normal equations. Cholesky factorization is
+ * exact, but the factor can take far more memory than the system itself
+ * for many dimensions; conjugate gradient needs only the system. Fits with
+ * a monotonic dimension always use the NNLS solver.
+ */
+enum glam_solver {
+	GLAM_CHOLESKY,
+	GLAM_CG
+};
+
 void glamfit(struct ndsparse *data, double *weights, double **coords,
     struct splinetable *out, double smooth, int *order, int *penorder,
-    int monodim, int verbose, cholmod_common *c);
+    int monodim, enum glam_solver solver, int verbose, cholmod_common *c);
     
 void glamfit_complex(struct ndsparse *data, double *weights, double **coords,
     struct splinetable *out, int *order, cholmod_sparse* penalty,
-    int monodim, int verbose, cholmod_common *c);
+    int monodim, enum glam_solver solver, int verbose, cholmod_common *c);
 
 cholmod_sparse* add_penalty_term(long *nsplines, double *knots, int ndim,
     int dim, int order, int porder, double scale, int mono,
@@ -369,8 +369,10 @@ static PyObject *pyfit(PyObject *self, PyObject *args, PyObject *kw)
 	double smooth;
 	int i, j, k, elements, err;
 	int monodim = -1;
+	char *solver_name = NULL;
+	enum glam_solver solver = GLAM_CHOLESKY;
 	char *keywordargs[] = {"z", "w", "coords", "knots", "order", "smooth",
-	    "periods", "penalties", "monodim", NULL};
+	    "periods", "penalties", "monodim", "solver", NULL};
 
 	/* Initialize a few things to NULL */
 	moduli = NULL;
@@ -384,11 +386,19 @@ static PyObject *pyfit(PyObject *self, PyObject *args, PyObject *kw)
 	memset(&out, 0, sizeof(out));
 
 	/* Parse our arguments from Python land */
-	if (!PyArg_ParseTupleAndKeywords(args, kw, "OOOOO|dOOi", keywordargs,
+	if (!PyArg_ParseTupleAndKeywords(args, kw, "OOOOO|dOOiz", keywordargs,
 	    &z, &w, &coords, &knots, &order, &smooth, &periods, &penorder_py,
-	    &monodim))
+	    &monodim, &solver_name))
 		return NULL;
 
+	if (solver_name != NULL && strcmp(solver_name, "cg") == 0)
+		solver = GLAM_CG;
+	else if (solver_name != NULL && strcmp(solver_name, "cholesky") != 0) {
+		PyErr_SetString(PyExc_ValueError,
+		    "solver must be 'cholesky' or 'cg'");
+		return NULL;
+	}
+
 	/* Parse weights first to avoid storing data with 0 weight */
 	err = numpynd_to_ndsparse(w, &data);
 	if (err == 0)
@@ -542,17 +552,22 @@ static PyObject *pyfit(PyObject *self, PyObject *args, PyObject *kw)
 	if (penorder_py == NULL) {
 		/* do a fit with default penalties, weighted with smoothness */
 		glamfit(&data, weights, c_coords, &out, smooth, out.order,
-		    penorder, monodim, 1, &c);
+		    penorder, monodim, solver, 1, &c);
 	} else {
 		/* do a fit with arbitrary linear combinations of penalties */
 		cholmod_sparse* penalty = construct_penalty(&out, penorder_py,
 		    smooth, monodim, &c);
 		glamfit_complex(&data, weights, c_coords, &out, out.order,
-		    penalty, monodim, 1, &c);
+		    penalty, monodim, solver, 1, &c);
 	        cholmod_l_free_sparse(&penalty, &c);
 	}
 	cholmod_l_finish(&c);
 
+	if (out.coefficients == NULL) {
+		PyErr_SetString(PyExc_RuntimeError, "Spline fit failed");
+		goto exit;
+	}
+
 	/* Now process the splinetable into a numpy array */
 	elements = 1;
 	for (i = 0; i < out.ndim; i++)
@@ -697,7 +712,7 @@ pygrideval(PyObject *self, PyObject *args)
 	struct ndsparse nd;
 	cholmod_common c;
 	long order;
-	int i;
+	int i, err;
 	
 	if (!PyArg_ParseTuple(args, "OO", &table, &coords))
 		return NULL;
@@ -717,7 +732,8 @@ pygrideval(PyObject *self, PyObject *args)
 
 	cholmod_l_start(&c);
 
-	for (i = 0; i < PySequence_Length(knots); i++) {
+	err = 0;
+	for (i = 0; err == 0 && i < PySequence_Length(knots); i++) {
 		PyArrayObject *coord_vec, *knots_vec;
 		cholmod_sparse *basis, *basist;
 
@@ -742,7 +758,7 @@ pygrideval(PyObject *self, PyObject *args)
 		Py_DECREF(coord_vec);
 		Py_DECREF(knots_vec);
 
-		slicemultiply(&nd, basist, i, &c);
+		err = slicemultiply(&nd, basist, i, &c);
 	
 		cholmod_l_free_sparse(&basist, &c);
 	}
@@ -750,7 +766,13 @@ pygrideval(PyObject *self, PyObject *args)
 
 	cholmod_l_finish(&c);
 
-	result = numpy_ndsparse_to_ndarray(&nd);
+	if (err == 0) {
+		result = numpy_ndsparse_to_ndarray(&nd);
+	} else {
+		PyErr_SetString(PyExc_RuntimeError,
+		    "Could not evaluate the spline on the grid");
+		result = NULL;
+	}
 	for (i = 0; i < nd.ndim; i++)
 		free(nd.i[i]);
 	free(nd.i);
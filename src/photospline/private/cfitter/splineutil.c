@@ -1,8 +1,12 @@
 #include <cholmod.h>
 #include <math.h>
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 
 #include "splineutil.h"
+#include "cholesky_solve.h"
 #include "photospline/bspline.h"
 
 cholmod_sparse *
@@ -63,129 +67,383 @@ bsplinebasis(double *knots, size_t nknots, double *x, size_t npts, int order,
  * the axis specified by dim, returning the result in the original array. It
  * is equivalent to glam.rho() in the Python implementation, and the
  * function 'rho' defined by Eilers and Currie.
- * 
- * If you want to understand how it works, look at the Python implementation.
+ *
+ * Each 1-D fiber of the array along dim (all entries that share their
+ * coordinates on the other axes) is multiplied by b independently. The
+ * entries are sorted by their coordinates on the other axes (the fiber
+ * key) so that fibers become contiguous runs, and the runs are then
+ * multiplied in parallel. Only non-zero entries are ever stored, so memory
+ * scales with the number of filled bins rather than with the product of
+ * the axis lengths, and the result is the same for any number of threads.
+ *
+ * The sort is split into partitions of the key range: the threads first
+ * count how many of their entries fall into each partition, then scatter
+ * them, and then sort and multiply whole partitions.
  */
 
-int
-slicemultiply(struct ndsparse *a, cholmod_sparse *b, int dim,
-    cholmod_common *c)
+struct rho_item {
+	unsigned long key;	/* Flattened coordinates on the other axes */
+	long i;			/* Coordinate along dim */
+	double x;
+};
+
+struct rho_partition {
+	struct rho_item *items;	/* Input, sorted by key and coordinate */
+	size_t nitems;
+	struct rho_item *out;	/* Output, i now indexes the columns of b */
+	size_t nout;
+	size_t offset;		/* Position of the output in the result */
+};
+
+struct rho_work {
+	struct ndsparse *a;
+	int dim;
+
+	/* Rows of b, i.e. b' in compressed-column form */
+	const long *bp, *bi;
+	const double *bx;
+	size_t bcols;
+
+	int nthreads, npartitions;
+	unsigned long keyspan;	/* Keys per partition */
+	size_t *counts;		/* Entries per thread and partition */
+	struct rho_item *items;
+	struct rho_partition *partitions;
+
+	enum { RHO_COUNT, RHO_SCATTER, RHO_MULTIPLY, RHO_UNFLATTEN } phase;
+	int next;		/* Next partition to hand out */
+	int err;
+	pthread_mutex_t mutex;
+};
+
+struct rho_thread {
+	struct rho_work *work;
+	int id;
+	pthread_t thread;
+};
+
+static unsigned long
+rho_key(const struct ndsparse *a, int dim, size_t row)
 {
-	cholmod_triplet *section;
-	cholmod_sparse *ssection;
-	int cols, i, j, k, stride;
+	unsigned long key = 0, stride = 1;
+	int k;
 
-	/* Check that the dimensions match */
-	if (b->nrow != a->ranges[dim])
-		return -1;
+	/* The axis after dim is the slowest, the one before it the fastest */
+	for (k = dim + a->ndim - 1; k > dim; k--) {
+		key += stride*a->i[k % a->ndim][row];
+		stride *= a->ranges[k % a->ndim];
+	}
 
-	/*
-	 * Construct a matrix with a->ranges[dim] rows based on flattening a 
-	 * transposed version of a.
-	 *
-	 * Since we are just shuffling things about, the max number of
-	 * non-zero elements is just the number of elements in a.
-	 */
+	return (key);
+}
 
-	cols = 1;
-	for (i = 0; i < a->ndim; i++)
-		if (i != dim) cols *= a->ranges[i];
+static int
+rho_itemcmp(const void *xa, const void *xb)
+{
+	const struct rho_item *a = xa, *b = xb;
 
-	section = cholmod_l_allocate_triplet(a->ranges[dim], cols, a->rows, 0,
-	    CHOLMOD_REAL,c);
-	section->nnz = a->rows;
+	if (a->key != b->key)
+		return ((a->key < b->key) ? -1 : 1);
+	return ((a->i > b->i) - (a->i < b->i));
+}
 
-	/* We rotate the array so that dim is at the front, then flatten. */
-	assert(a->ndim > 0);
-	for (i = 0; i < a->rows; i++) {
-		/* The flattened row number is straightforward: it is
-		 * the dim'th coordinate. */
-	
-		((long *)(section->i))[i] = a->i[dim][i];
-
-		/* The fastest running index is the dimension we are looking at.
-		 * The next fastest is that the one that came after that, in a
-		 * modular fashion. For non-primary (dim) indices, build up
-		 * an aggregate range step.
-		 */
-
-		stride = 1;
-		((long *)(section->j))[i] = 0;
-		for (k = dim + a->ndim - 1; k > dim; k--) {
-			((long *)(section->j))[i] += stride*a->i[k % a->ndim][i];
-			stride *= a->ranges[k % a->ndim];
+static int
+longcmp(const void *xa, const void *xb)
+{
+	const long *a = xa, *b = xb;
+
+	return ((*a > *b) - (*a < *b));
+}
+
+static int
+rho_next_partition(struct rho_work *work)
+{
+	int p;
+
+	pthread_mutex_lock(&work->mutex);
+	p = (work->err == 0 && work->next < work->npartitions) ?
+	    work->next++ : -1;
+	pthread_mutex_unlock(&work->mutex);
+
+	return (p);
+}
+
+/* Multiply the fibers of one partition by b */
+static int
+rho_multiply(struct rho_work *work, struct rho_partition *part,
+    double *acc, char *mark, long *touched)
+{
+	struct rho_item *item, *end, *fiber;
+	size_t nalloc, ntouched, j;
+	long k, col;
+
+	qsort(part->items, part->nitems, sizeof(struct rho_item),
+	    rho_itemcmp);
+
+	nalloc = part->nitems;
+	part->out = malloc((nalloc > 0 ? nalloc : 1)*sizeof(struct rho_item));
+	if (part->out == NULL)
+		return (-1);
+	part->nout = 0;
+
+	end = part->items + part->nitems;
+	for (fiber = part->items; fiber < end; fiber = item) {
+		/* Accumulate the fiber's product with b */
+		ntouched = 0;
+		for (item = fiber; item < end && item->key == fiber->key;
+		    item++) {
+			for (k = work->bp[item->i]; k < work->bp[item->i+1];
+			    k++) {
+				col = work->bi[k];
+				if (!mark[col]) {
+					mark[col] = 1;
+					acc[col] = 0;
+					touched[ntouched++] = col;
+				}
+				acc[col] += item->x*work->bx[k];
+			}
 		}
-	
-		/* Copy the data */
-		((double *)(section->x))[i] = a->x[i];
-	}
 
-	/* Now obtain the sparse representation */
-	ssection = cholmod_l_triplet_to_sparse(section, 0, c);
-	
-	cholmod_l_free_triplet(&section, c);
+		/* Emit it in column order, resetting the accumulator */
+		qsort(touched, ntouched, sizeof(long), longcmp);
+		if (part->nout + ntouched > nalloc) {
+			struct rho_item *out;
 
-	/* Compute bT . ssection, putting the result in ssection */
-	{
-		cholmod_sparse *bt, *bta;
-		bt = cholmod_l_transpose(b,1,c);
-		bta = cholmod_l_ssmult(bt,ssection,0 /*assymmetric */,
-		    1 /* compute values */, 0 /* don't bother sorting */,c);
+			nalloc = 2*(part->nout + ntouched);
+			out = realloc(part->out, nalloc*sizeof(struct rho_item));
+			if (out == NULL)
+				return (-1);
+			part->out = out;
+		}
+		for (j = 0; j < ntouched; j++) {
+			col = touched[j];
+			part->out[part->nout].key = fiber->key;
+			part->out[part->nout].i = col;
+			part->out[part->nout].x = acc[col];
+			part->nout++;
+			mark[col] = 0;
+		}
+	}
 
-		cholmod_l_free_sparse(&bt,c);
-		cholmod_l_free_sparse(&ssection,c);
+	return (0);
+}
 
-		ssection = bta;
+static void *
+rho_worker(void *arg)
+{
+	struct rho_thread *thread = arg;
+	struct rho_work *work = thread->work;
+	struct ndsparse *a = work->a;
+	size_t *counts = work->counts + thread->id*work->npartitions;
+	size_t row, first, last;
+	unsigned long key;
+	double *acc;
+	char *mark;
+	long *touched;
+	int p;
+
+	first = a->rows*thread->id/work->nthreads;
+	last = a->rows*(thread->id+1)/work->nthreads;
+
+	switch (work->phase) {
+	case RHO_COUNT:
+		for (row = first; row < last; row++)
+			counts[rho_key(a, work->dim, row)/work->keyspan]++;
+		break;
+	case RHO_SCATTER:
+		/* counts now holds this thread's offset in each partition */
+		for (row = first; row < last; row++) {
+			struct rho_item *item;
+
+			key = rho_key(a, work->dim, row);
+			item = &work->items[counts[key/work->keyspan]++];
+			item->key = key;
+			item->i = a->i[work->dim][row];
+			item->x = a->x[row];
+		}
+		break;
+	case RHO_MULTIPLY:
+		acc = malloc(work->bcols*sizeof(double));
+		mark = calloc(work->bcols, sizeof(char));
+		touched = malloc(work->bcols*sizeof(long));
+		if (acc == NULL || mark == NULL || touched == NULL) {
+			pthread_mutex_lock(&work->mutex);
+			work->err = -1;
+			pthread_mutex_unlock(&work->mutex);
+		} else {
+			while ((p = rho_next_partition(work)) >= 0) {
+				if (rho_multiply(work, &work->partitions[p],
+				    acc, mark, touched) == 0)
+					continue;
+				pthread_mutex_lock(&work->mutex);
+				work->err = -1;
+				pthread_mutex_unlock(&work->mutex);
+			}
+		}
+		free(acc);
+		free(mark);
+		free(touched);
+		break;
+	case RHO_UNFLATTEN:
+		while ((p = rho_next_partition(work)) >= 0) {
+			struct rho_partition *part = &work->partitions[p];
+			size_t j;
+			int k;
+
+			for (j = 0; j < part->nout; j++) {
+				row = part->offset + j;
+				key = part->out[j].key;
+				for (k = work->dim + a->ndim - 1; k > work->dim;
+				    k--) {
+					a->i[k % a->ndim][row] =
+					    key % a->ranges[k % a->ndim];
+					key /= a->ranges[k % a->ndim];
+				}
+				a->i[work->dim][row] = part->out[j].i;
+				a->x[row] = part->out[j].x;
+			}
+		}
+		break;
 	}
 
-	/* Now we need to undo the rotation and flattening from above */
+	return (NULL);
+}
+/* Run one phase of slicemultiply() on all threads */
+static void
+rho_run(struct rho_work *work, struct rho_thread *threads, int phase)
+{
+	int t, started;
 
-	section = cholmod_l_sparse_to_triplet(ssection,c);
-	cholmod_l_free_sparse(&ssection,c);
+	work->phase = phase;
+	work->next = 0;
+	if (work->nthreads == 1) {
+		rho_worker(&threads[0]);
+		return;
+	}
+	for (t = 0; t < work->nthreads; t++)
+		if (pthread_create(&threads[t].thread, NULL, rho_worker,
+		    &threads[t]) != 0)
+			break;
+	/* Do the share of any threads that could not be started here */
+	for (started = t; t < work->nthreads; t++)
+		rho_worker(&threads[t]);
+	for (t = 0; t < started; t++)
+		pthread_join(threads[t].thread, NULL);
+}
 
-	/* Set up the nd-array again, bearing in mind that it need not have
-	 * the same number of non-zero elements as before, and that the range
-	 * along dimension dim is also now the number of columns in b */
+int
+slicemultiply(struct ndsparse *a, cholmod_sparse *b, int dim,
+    cholmod_common *c)
+{
+	struct rho_work work;
+	struct rho_thread *threads;
+	cholmod_sparse *bt;
+	unsigned long nkeys;
+	size_t total, n;
+	int i, p, t;
 
-	for (i = 0; i < a->ndim; i++)
-		a->i[i] = realloc(a->i[i],sizeof(int)*section->nnz);
-	a->x = realloc(a->x,sizeof(double)*section->nnz);
-	a->rows = section->nnz;
-	a->ranges[dim] = b->ncol;
+	/* Check that the dimensions match */
+	if (b->nrow != a->ranges[dim])
+		return -1;
 
-	/* We unflatten the array and rotate so that the front is at dim */
+	nkeys = 1;
+	for (i = 0; i < a->ndim; i++)
+		if (i != dim) nkeys *= a->ranges[i];
+
+	memset(&work, 0, sizeof(work));
+	work.a = a;
+	work.dim = dim;
+	work.nthreads = get_nthreads();
+	if (work.nthreads > a->rows/1024 + 1)
+		work.nthreads = a->rows/1024 + 1;
+	/* Several partitions per thread to even out the load */
+	work.npartitions = 8*work.nthreads;
+	work.keyspan = nkeys/work.npartitions + 1;
+	pthread_mutex_init(&work.mutex, NULL);
+
+	bt = cholmod_l_transpose(b, 1, c);
+	work.bp = bt->p;
+	work.bi = bt->i;
+	work.bx = bt->x;
+	work.bcols = b->ncol;
+
+	threads = malloc(work.nthreads*sizeof(struct rho_thread));
+	work.counts = calloc(work.nthreads*work.npartitions, sizeof(size_t));
+	work.items = malloc((a->rows > 0 ? a->rows : 1)*
+	    sizeof(struct rho_item));
+	work.partitions = calloc(work.npartitions,
+	    sizeof(struct rho_partition));
+	if (threads == NULL || work.counts == NULL || work.items == NULL ||
+	    work.partitions == NULL) {
+		work.err = -1;
+		goto cleanup;
+	}
+	for (t = 0; t < work.nthreads; t++) {
+		threads[t].work = &work;
+		threads[t].id = t;
+	}
 
-	for (i = 0; i < a->rows; i++) {
-		/* The flattened column number is straightforward: it is
-		 * the dim'th coordinate. */
-	
-		a->i[dim][i] = ((long *)(section->i))[i];
-
-		/* The fastest running index is the dimension we are looking at.
-		 * The next fastest is that the one that came after that, in a
-		 * modular fashion. For non-primary (dim) indices, build up
-		 * an aggregate range step.
-		 */
-
-		stride = 1;
-		for (k = dim + a->ndim - 1; k > dim; k--)
-			stride *= a->ranges[k % a->ndim];
-		j = ((long *)(section->j))[i];
-		for (k = dim+1; k < dim + a->ndim; k++) {
-			/* See how many of this dimension's strides we fit */
-			stride /= a->ranges[k % a->ndim];
-			a->i[k % a->ndim][i] = j/stride;
-			/* Collect the remainder */
-			j = j % stride;
+	/* Sort the entries into partitions of the key range */
+	rho_run(&work, threads, RHO_COUNT);
+	for (p = 0, total = 0; p < work.npartitions; p++) {
+		work.partitions[p].items = work.items + total;
+		for (t = 0; t < work.nthreads; t++) {
+			n = work.counts[t*work.npartitions + p];
+			work.counts[t*work.npartitions + p] = total;
+			total += n;
+			work.partitions[p].nitems += n;
 		}
+	}
+	rho_run(&work, threads, RHO_SCATTER);
 
-		/* Copy the data */
-		a->x[i] = ((double *)(section->x))[i];
+	/* The input has been copied out; multiply each partition's fibers */
+	rho_run(&work, threads, RHO_MULTIPLY);
+	if (work.err != 0)
+		goto cleanup;
+
+	/*
+	 * Set up the nd-array again, bearing in mind that it need not have
+	 * the same number of non-zero elements as before, and that the range
+	 * along dimension dim is also now the number of columns in b
+	 */
+	for (p = 0, total = 0; p < work.npartitions; p++) {
+		work.partitions[p].offset = total;
+		total += work.partitions[p].nout;
 	}
+	for (i = 0; i < a->ndim; i++) {
+		int *column = realloc(a->i[i],
+		    sizeof(int)*(total > 0 ? total : 1));
+		if (column == NULL) {
+			work.err = -1;
+			goto cleanup;
+		}
+		a->i[i] = column;
+	}
+	{
+		double *x = realloc(a->x, sizeof(double)*(total > 0 ? total : 1));
+		if (x == NULL) {
+			work.err = -1;
+			goto cleanup;
+		}
+		a->x = x;
+	}
+	a->rows = total;
+	a->ranges[dim] = b->ncol;
+
+	rho_run(&work, threads, RHO_UNFLATTEN);
 
-	cholmod_l_free_triplet(&section,c);
+cleanup:
+	if (work.partitions != NULL)
+		for (p = 0; p < work.npartitions; p++)
+			free(work.partitions[p].out);
+	free(work.partitions);
+	free(work.items);
+	free(work.counts);
+	free(threads);
+	cholmod_l_free_sparse(&bt, c);
+	pthread_mutex_destroy(&work.mutex);
 
-	return 0;
+	return (work.err);
 }
 
 /* Computes the kronecker product of sparse matrices a and b */
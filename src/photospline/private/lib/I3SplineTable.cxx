@@ -1,15 +1,22 @@
 #include <cerrno>
+#include <cmath>
 #include <stdexcept>
 #include <sstream>
+#include <vector>
 #include <photospline/I3SplineTable.h>
 #include <photospline/bspline.h>
 
-I3SplineTable::I3SplineTable(const std::string &path)
+I3SplineTable::I3SplineTable(const std::string &path, int blocksize)
 {
-	if (readsplinefitstable(path.c_str(), &table_) != 0)
+	if (readsplinetable(path.c_str(), &table_) != 0)
 		throw std::runtime_error("Couldn't read spline table " + path);
+	if (blocksize > 0 && splinetable_block(&table_, blocksize) != 0) {
+		splinetable_free(&table_);
+		throw std::runtime_error("Couldn't block spline table " + path);
+	}
 	if (splinetable_read_key(&table_, SPLINETABLE_DOUBLE, "BIAS", &bias_))
 		bias_ = 0;
+	eval_ = ndsplineeval_select(&table_);
 }
 
 I3SplineTable::~I3SplineTable()
@@ -23,7 +30,7 @@ I3SplineTable::Eval(double *coordinates, double *result, int derivatives) const
 	int centers[table_.ndim];
 	
 	if (tablesearchcenters(&table_, coordinates, centers) == 0)
-		*result = ndsplineeval(&table_, coordinates, centers, derivatives);
+		*result = eval_(&table_, coordinates, centers, derivatives);
 	else
 		return EINVAL;
 	
@@ -47,6 +54,30 @@ I3SplineTable::EvalDeriv2(double *coordinates, double *result, int derivatives)
 	return 0;
 }
 
+int
+I3SplineTable::EvalBatch(const double *coordinates, double *results,
+    size_t npts, int derivatives) const
+{
+	std::vector<int> centers(npts*table_.ndim);
+	
+	if (npts == 0)
+		return 0;
+	
+	int noutside = tablesearchcenters_batch(&table_, npts, coordinates,
+	    &centers[0]);
+	ndsplineeval_batch(&table_, npts, coordinates, &centers[0],
+	    derivatives, results);
+	
+	for (size_t i = 0; i < npts; i++) {
+		if (centers[i*table_.ndim] < 0)
+			results[i] = NAN;
+		else
+			results[i] -= bias_;
+	}
+	
+	return (noutside == 0) ? 0 : EINVAL;
+}
+
 std::pair<double, double>
 I3SplineTable::GetExtents(int dim) const
 {
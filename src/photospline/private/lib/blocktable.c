@@ -0,0 +1,182 @@
+/*
+ * blocktable.c: Converts spline coefficient arrays between the plain
+ *  row-major layout and a blocked one.
+ *
+ * In the blocked layout, index i along axis n is split into a block index
+ * i / B and an index within the block i % B. Blocks of B^ndim coefficients
+ * are stored one after the other in row-major order of their block
+ * indices, and within each block the coefficients are again in row-major
+ * order. A cubic spline (B = 4) then needs at most 2 blocks per axis for
+ * one evaluation, and within a block the 4x4 innermost coefficients share
+ * a 64-byte cache line.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "photospline/splinetable.h"
+#include "photospline/bspline.h"
+
+/* Compute block strides and the padded array size for the given block size */
+static size_t
+blocklayout(const struct splinetable *table, int blocksize,
+    unsigned long *blockstrides)
+{
+	size_t size;
+	int n;
+
+	size = 1;
+	for (n = 0; n < table->ndim; n++)
+		size *= blocksize;
+	for (n = table->ndim-1; n >= 0; n--) {
+		blockstrides[n] = size;
+		size *= (table->naxes[n] + blocksize - 1)/blocksize;
+	}
+
+	return (size);
+}
+
+size_t
+splinetable_ncoefficients(const struct splinetable *table)
+{
+	size_t size;
+	int n;
+
+	if (table->blocksize > 0)
+		return (table->blockstrides[0]*((table->naxes[0] +
+		    table->blocksize - 1)/table->blocksize));
+
+	for (n = 0, size = 1; n < table->ndim; n++)
+		size *= table->naxes[n];
+
+	return (size);
+}
+
+/* Position in the blocked layout of the coefficient at rowpos */
+static size_t
+blockposition(const struct splinetable *table, int blocksize,
+    const unsigned long *blockstrides, size_t rowpos)
+{
+	size_t pos = 0;
+	unsigned long instride = 1;
+	long i;
+	int n;
+
+	for (n = table->ndim-1; n >= 0; n--) {
+		i = (rowpos / table->strides[n]) % table->naxes[n];
+		pos += (i / blocksize)*blockstrides[n] + (i % blocksize)*instride;
+		instride *= blocksize;
+	}
+
+	return (pos);
+}
+
+void
+splinetable_coefficients_rowmajor(const struct splinetable *table,
+    float *dest)
+{
+	size_t total, rowpos;
+	int n;
+
+	for (n = 0, total = 1; n < table->ndim; n++)
+		total *= table->naxes[n];
+
+	if (table->precision != SPLINETABLE_FLOAT32) {
+		for (rowpos = 0; rowpos < total; rowpos += SPLINETABLE_QBLOCK)
+			tablecoefficients(table, rowpos,
+			    (total - rowpos < SPLINETABLE_QBLOCK) ?
+			    total - rowpos : SPLINETABLE_QBLOCK, dest + rowpos);
+		return;
+	}
+
+	if (table->blocksize == 0) {
+		memcpy(dest, table->coefficients, total*sizeof(float));
+		return;
+	}
+
+	for (rowpos = 0; rowpos < total; rowpos++)
+		dest[rowpos] = table->coefficients[blockposition(table,
+		    table->blocksize, table->blockstrides, rowpos)];
+}
+
+int
+splinetable_block(struct splinetable *table, int blocksize)
+{
+	size_t total, size, rowpos;
+	unsigned long *blockstrides;
+	float *coefficients;
+	int n, err;
+
+	if (blocksize < 1 || table->precision != SPLINETABLE_FLOAT32)
+		return (EINVAL);
+	if (blocksize == table->blocksize)
+		return (0);
+	if (table->blocksize > 0 && (err = splinetable_unblock(table)) != 0)
+		return (err);
+
+	for (n = 0, total = 1; n < table->ndim; n++)
+		total *= table->naxes[n];
+
+	blockstrides = malloc(sizeof(unsigned long)*table->ndim);
+	size = blocklayout(table, blocksize, blockstrides);
+	coefficients = calloc(size, sizeof(float));
+	if (blockstrides == NULL || coefficients == NULL) {
+		free(blockstrides);
+		free(coefficients);
+		return (ENOMEM);
+	}
+
+	for (rowpos = 0; rowpos < total; rowpos++)
+		coefficients[blockposition(table, blocksize, blockstrides,
+		    rowpos)] = table->coefficients[rowpos];
+
+	splinetable_free_coefficients(table);
+	table->coefficients = coefficients;
+	table->blocksize = blocksize;
+	table->blockstrides = blockstrides;
+
+	return (0);
+}
+
+int
+splinetable_unblock(struct splinetable *table)
+{
+	float *coefficients;
+
+	if (table->blocksize == 0)
+		return (0);
+
+	coefficients = malloc(sizeof(float)*(table->strides[0]*
+	    table->naxes[0]));
+	if (coefficients == NULL)
+		return (ENOMEM);
+	splinetable_coefficients_rowmajor(table, coefficients);
+
+	splinetable_free_coefficients(table);
+	free(table->blockstrides);
+	table->coefficients = coefficients;
+	table->blocksize = 0;
+	table->blockstrides = NULL;
+
+	return (0);
+}
+
+void
+tableblockoffsets(const struct splinetable *table, const int *centers,
+    int maxdegree, unsigned long *offsets)
+{
+	unsigned long instride = 1;
+	long i;
+	int n, k;
+
+	for (n = table->ndim-1; n >= 0; n--) {
+		for (k = 0; k <= table->order[n]; k++) {
+			i = centers[n] - table->order[n] + k;
+			offsets[n*maxdegree + k] =
+			    (i / table->blocksize)*table->blockstrides[n] +
+			    (i % table->blocksize)*instride;
+		}
+		instride *= table->blocksize;
+	}
+}
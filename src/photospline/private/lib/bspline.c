@@ -305,54 +305,101 @@ splineeval(const double *knots, const double *weights, int nknots, double x, int
 	return work;
 }
 
+/*
+ * Find the center for coordinate x in dimension dim, or -1 if x is outside
+ * the table. If hint is a valid center and the knot span it names still
+ * contains x, the binary search is skipped.
+ */
+static inline int
+searchcenter(const struct splinetable *table, int dim, double x, int hint)
+{
+	const double *knots = table->knots[dim];
+	int center, min, max;
+
+	/* Ensure we are actually inside the table. */
+	if (x <= knots[0] || x > knots[table->nknots[dim]-1])
+		return (-1);
+
+	/*
+	 * If we're only a few knots in, take the center to be
+	 * the nearest fully-supported knot.
+	 */
+	if (x < knots[table->order[dim]])
+		return (table->order[dim]);
+	else if (x >= knots[table->naxes[dim]])
+		return (table->naxes[dim]-1);
+
+	if (hint >= 0 && x >= knots[hint] && x < knots[hint+1])
+		return (hint);
+
+	min = table->order[dim];
+	max = table->nknots[dim]-2;
+	do {
+		center = (max+min)/2;
+
+		if (x < knots[center])
+			max = center-1;
+		else
+			min = center+1;
+	} while (x < knots[center] || x >= knots[center+1]);
+
+	/*
+	 * B-splines are defined on a half-open interval. For the
+	 * last point of the interval, move center one point to the
+	 * left to get the limit of the sum without evaluating
+	 * absent basis functions.
+	 */
+	if (center == table->naxes[dim])
+		center--;
+
+	return (center);
+}
+
 int
 tablesearchcenters(const struct splinetable *table, const double *x, int *centers)
 {
-	int i, min, max;
+	int i;
 
 	for (i = 0; i < table->ndim; i++) {
-		
-		/* Ensure we are actually inside the table. */
-		if (x[i] <= table->knots[i][0] ||
-		    x[i] > table->knots[i][table->nknots[i]-1])
+		if ((centers[i] = searchcenter(table, i, x[i], -1)) < 0)
 			return (-1);
-		
-		/*
-		 * If we're only a few knots in, take the center to be
-		 * the nearest fully-supported knot.
-		 */
-		if (x[i] < table->knots[i][table->order[i]]) {
-			centers[i] = table->order[i];
-			continue;
-		} else if (x[i] >= table->knots[i][table->naxes[i]]) {
-			centers[i] = table->naxes[i]-1;
-			continue;
-		}
+	}
 
-		min = table->order[i];
-		max = table->nknots[i]-2;
-		do {
-			centers[i] = (max+min)/2;
+	return (0);
+}
 
-			if (x[i] < table->knots[i][centers[i]])
-				max = centers[i]-1;
-			else
-				min = centers[i]+1;
-		} while (x[i] < table->knots[i][centers[i]] ||
-		    x[i] >= table->knots[i][centers[i]+1]);
+int
+tablesearchcenters_batch(const struct splinetable *table, size_t npts,
+    const double *x, int *centers)
+{
+	size_t p;
+	int i, noutside = 0;
+	int hint[table->ndim];
 
-		/*
-		 * B-splines are defined on a half-open interval. For the
-		 * last point of the interval, move center one point to the
-		 * left to get the limit of the sum without evaluating
-		 * absent basis functions.
-		 */
-		if (centers[i] == table->naxes[i])
-			centers[i]--;
-	}
+	for (i = 0; i < table->ndim; i++)
+		hint[i] = -1;
 
+	/*
+	 * Neighboring points (e.g. along a track or a time series) usually
+	 * fall into the same knot span, so use the last point's centers as
+	 * a starting guess.
+	 */
+	for (p = 0; p < npts; p++, x += table->ndim, centers += table->ndim) {
+		for (i = 0; i < table->ndim; i++) {
+			if ((centers[i] = searchcenter(table, i, x[i],
+			    hint[i])) < 0)
+				break;
+		}
+		if (i < table->ndim) {
+			centers[0] = -1;
+			noutside++;
+			continue;
+		}
+		for (i = 0; i < table->ndim; i++)
+			hint[i] = centers[i];
+	}
 
-	return (0);
+	return (noutside);
 }
 
 static int
@@ -377,6 +424,71 @@ maxorder(int *order, int ndim)
  * x is the vector at which we will evaluate the space
  */
 
+/*
+ * Same as ndsplineeval_core() below, for tables in the blocked layout.
+ * The walk over the coefficients, and hence the result, is identical;
+ * only the addresses come from per-axis offset tables.
+ */
+static double
+ndsplineeval_core_blocked(const struct splinetable *table, const int *centers,
+    int maxdegree, float localbasis[table->ndim][maxdegree])
+{
+	int i, j, n;
+	float result;
+	float basis_tree[table->ndim+1];
+	unsigned long pos_tree[table->ndim];
+	unsigned long offsets[table->ndim][maxdegree];
+	const float *coefficients;
+	int nchunks;
+	int decomposedposition[table->ndim];
+
+	tableblockoffsets(table, centers, maxdegree, &offsets[0][0]);
+
+	basis_tree[0] = 1;
+	pos_tree[0] = 0;
+	for (n = 0; n < table->ndim; n++) {
+		decomposedposition[n] = 0;
+		basis_tree[n+1] = basis_tree[n]*localbasis[n][0];
+		if (n < table->ndim - 1)
+			pos_tree[n+1] = pos_tree[n] + offsets[n][0];
+	}
+	nchunks = 1;
+	for (n = 0; n < table->ndim - 1; n++)
+		nchunks *= (table->order[n] + 1);
+
+	result = 0;
+	n = 0;
+	while (1) {
+		coefficients = table->coefficients + pos_tree[table->ndim-1];
+		for (i = 0; __builtin_expect(i < table->order[table->ndim-1] +
+		    1, 1); i++) {
+			result += basis_tree[table->ndim-1]*
+			    localbasis[table->ndim-1][i]*
+			    coefficients[offsets[table->ndim-1][i]];
+		}
+
+		if (__builtin_expect(++n == nchunks, 0))
+			break;
+
+		decomposedposition[table->ndim-2]++;
+
+		/* Carry to higher dimensions */
+		for (i = table->ndim-2;
+		    decomposedposition[i] > table->order[i]; i--) {
+			decomposedposition[i-1]++;
+			decomposedposition[i] = 0;
+		}
+		for (j = i; __builtin_expect(j < table->ndim-1, 1); j++) {
+			basis_tree[j+1] = basis_tree[j]*
+			    localbasis[j][decomposedposition[j]];
+			pos_tree[j+1] = pos_tree[j] +
+			    offsets[j][decomposedposition[j]];
+		}
+	}
+
+	return result;
+}
+
 static double
 ndsplineeval_core(const struct splinetable *table, const int *centers, int maxdegree,
     float localbasis[table->ndim][maxdegree])
@@ -384,9 +496,15 @@ ndsplineeval_core(const struct splinetable *table, const int *centers, int maxde
 	int i, j, n, tablepos;
 	float result;
 	float basis_tree[table->ndim+1];
+	float buf[maxdegree];
+	const float *coefficients;
 	int nchunks;
 	int decomposedposition[table->ndim];
 
+	if (table->blocksize > 0)
+		return ndsplineeval_core_blocked(table, centers, maxdegree,
+		    localbasis);
+
 	tablepos = 0;
 	for (n = 0; n < table->ndim; n++) {
 		decomposedposition[n] = 0;
@@ -403,11 +521,13 @@ ndsplineeval_core(const struct splinetable *table, const int *centers, int maxde
 	result = 0;
 	n = 0;
 	while (1) {
+		coefficients = tablecoefficients(table, tablepos,
+		    table->order[table->ndim-1] + 1, buf);
 		for (i = 0; __builtin_expect(i < table->order[table->ndim-1] +
 		    1, 1); i++) {
 			result += basis_tree[table->ndim-1]*
 			    localbasis[table->ndim-1][i]*
-			    table->coefficients[tablepos + i];
+			    coefficients[i];
 		}
 
 		if (__builtin_expect(++n == nchunks, 0))
@@ -491,6 +611,9 @@ ndsplineeval_linalg(const struct splinetable *table, const double *x,
 	gsl_matrix_float *basis1, *basis2, *basis_elem;
 
 	assert(table->ndim > 0);
+	/* The coefficient gather below assumes row-major single precision */
+	if (table->blocksize > 0 || table->precision != SPLINETABLE_FLOAT32)
+		return ndsplineeval(table, x, centers, derivatives);
 	coeffstrides[table->ndim - 1] = totalcoeff = 1;
         for (n = table->ndim-1; n >= 0; n--) {
                 totalcoeff *= (table->order[n] + 1);
@@ -0,0 +1,319 @@
+/*
+ * bspline_fixed.cxx: Versions of ndsplineeval() specialized at compile time
+ *    for the table shapes (number of dimensions, spline order) that are
+ *    used in practice. With both known, the basis calculation and the walk
+ *    through the coefficient array unroll completely. The terms are summed
+ *    in the same order as in ndsplineeval_core(), so the results are
+ *    bit-for-bit the same.
+ */
+
+#include "photospline/bspline.h"
+
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+
+namespace {
+
+/*
+ * bsplvb_simple() for a fixed number of non-zero splines K (i.e. order+1).
+ * The arithmetic is identical, so the basis is bit-for-bit the same.
+ */
+template <int K>
+ALWAYS_INLINE void
+bsplvb_fixed(const double *knots, const unsigned nknots, double x, int left,
+    float *biatx)
+{
+	int i, j;
+	double saved, term;
+	double delta_l[K], delta_r[K];
+
+	biatx[0] = 1.0;
+
+	/*
+	 * Handle the (rare) cases where x is outside the full
+	 * support of the spline surface.
+	 */
+	if (left == K-1)
+		while (left >= 0 && x < knots[left])
+			left--;
+	else if (unsigned(left) == nknots-K-1)
+		while (unsigned(left) < nknots-1 && x > knots[left+1])
+			left++;
+
+	for (j = 0; j < K-1; j++) {
+		delta_r[j] = knots[left+j+1] - x;
+		delta_l[j] = x - knots[left-j];
+
+		saved = 0.0;
+
+		for (i = 0; i < j+1; i++) {
+			term = biatx[i] / (delta_r[i] + delta_l[j-i]);
+			biatx[i] = saved + delta_r[i]*term;
+			saved = delta_l[j-i]*term;
+		}
+
+		biatx[j+1] = saved;
+	}
+
+	/* Shift the valid splines for partially-supported points. */
+	if ((i = K-1-left) > 0) {
+		for (j = 0; j < left+1; j++)
+			biatx[j] = biatx[j+i];
+		for ( ; j < K; j++)
+			biatx[j] = 0.0;
+	} else if ((i = left+K+1-int(nknots)) > 0) {
+		for (j = K-1; j > i-1; j--)
+			biatx[j] = biatx[j-i];
+		for ( ; j >= 0; j--)
+			biatx[j] = 0.0;
+	}
+}
+
+/*
+ * Walk the (O+1)^R block of coefficient rows below the current corner in
+ * row-major order, adding tree*basis*coefficient to a single sum just as
+ * ndsplineeval_core() does. Any other grouping of the terms (e.g. applying
+ * the last dimension's basis once per block) changes the rounding.
+ */
+template <int O, int R>
+struct TensorProduct {
+	static ALWAYS_INLINE void
+	Accumulate(const float *coefficients, const unsigned long *strides,
+	    const float (*localbasis)[O+1], float tree, float &result)
+	{
+		for (int i = 0; i <= O; i++)
+			TensorProduct<O, R-1>::Accumulate(
+			    coefficients + i*strides[0], strides + 1,
+			    localbasis + 1, tree*localbasis[0][i], result);
+	}
+};
+
+template <int O>
+struct TensorProduct<O, 0> {
+	static ALWAYS_INLINE void
+	Accumulate(const float *coefficients, const unsigned long *,
+	    const float (*localbasis)[O+1], float tree, float &result)
+	{
+		for (int i = 0; i <= O; i++)
+			result += tree*localbasis[0][i]*coefficients[i];
+	}
+};
+
+/*
+ * The same walk for tables in the blocked layout, where the position of
+ * each coefficient is the sum of per-axis offsets.
+ */
+template <int O, int R>
+struct BlockedTensorProduct {
+	static ALWAYS_INLINE void
+	Accumulate(const float *coefficients,
+	    const unsigned long (*offsets)[O+1],
+	    const float (*localbasis)[O+1], float tree, float &result)
+	{
+		for (int i = 0; i <= O; i++)
+			BlockedTensorProduct<O, R-1>::Accumulate(
+			    coefficients + offsets[0][i], offsets + 1,
+			    localbasis + 1, tree*localbasis[0][i], result);
+	}
+};
+
+template <int O>
+struct BlockedTensorProduct<O, 0> {
+	static ALWAYS_INLINE void
+	Accumulate(const float *coefficients,
+	    const unsigned long (*offsets)[O+1],
+	    const float (*localbasis)[O+1], float tree, float &result)
+	{
+		for (int i = 0; i <= O; i++)
+			result += tree*localbasis[0][i]*
+			    coefficients[offsets[0][i]];
+	}
+};
+
+/*
+ * Decoding of a single 16-bit coefficient (see tablecoefficients()), with
+ * the storage format fixed at compile time so that the row loop in
+ * PackedTensorProduct is free of branches.
+ */
+template <int P>
+struct Decode;
+
+template <>
+struct Decode<SPLINETABLE_FLOAT16> {
+	static ALWAYS_INLINE float
+	Get(const struct splinetable *table, unsigned long pos)
+	{
+		unsigned short h = table->packed[pos];
+		unsigned bits = ((h & 0x8000u) << 16) | ((h & 0x7fffu) << 13);
+		float f;
+
+		memcpy(&f, &bits, sizeof(f));
+		return f*5.192296858534828e33f;
+	}
+};
+
+template <>
+struct Decode<SPLINETABLE_BFLOAT16> {
+	static ALWAYS_INLINE float
+	Get(const struct splinetable *table, unsigned long pos)
+	{
+		unsigned bits = (unsigned)table->packed[pos] << 16;
+		float f;
+
+		memcpy(&f, &bits, sizeof(f));
+		return f;
+	}
+};
+
+template <>
+struct Decode<SPLINETABLE_INT16> {
+	static ALWAYS_INLINE float
+	Get(const struct splinetable *table, unsigned long pos)
+	{
+		return ((const short *)table->packed)[pos]*
+		    table->scales[pos/SPLINETABLE_QBLOCK];
+	}
+};
+
+/*
+ * TensorProduct for tables stored in 16 bits (see splinetable_pack()),
+ * expanding each coefficient to single precision as it is read.
+ */
+template <int P, int O, int R>
+struct PackedTensorProduct {
+	static ALWAYS_INLINE void
+	Accumulate(const struct splinetable *table, unsigned long pos,
+	    const unsigned long *strides, const float (*localbasis)[O+1],
+	    float tree, float &result)
+	{
+		for (int i = 0; i <= O; i++)
+			PackedTensorProduct<P, O, R-1>::Accumulate(table,
+			    pos + i*strides[0], strides + 1, localbasis + 1,
+			    tree*localbasis[0][i], result);
+	}
+};
+
+template <int P, int O>
+struct PackedTensorProduct<P, O, 0> {
+	static ALWAYS_INLINE void
+	Accumulate(const struct splinetable *table, unsigned long pos,
+	    const unsigned long *, const float (*localbasis)[O+1],
+	    float tree, float &result)
+	{
+		for (int i = 0; i <= O; i++)
+			result += tree*localbasis[0][i]*
+			    Decode<P>::Get(table, pos + i);
+	}
+};
+
+template <int D, int O>
+ALWAYS_INLINE void
+localbasis_fixed(const struct splinetable *table, const double *x,
+    const int *centers, int derivatives, float (*localbasis)[O+1])
+{
+	for (int n = 0; n < D; n++) {
+		if (derivatives & (1 << n)) {
+			bspline_deriv_nonzero(table->knots[n],
+			    table->nknots[n], x[n], centers[n], O,
+			    localbasis[n]);
+		} else {
+			bsplvb_fixed<O+1>(table->knots[n], table->nknots[n],
+			    x[n], centers[n], localbasis[n]);
+		}
+	}
+}
+
+template <int D, int O>
+double
+ndsplineeval_fixed(const struct splinetable *table, const double *x,
+    const int *centers, int derivatives)
+{
+	float localbasis[D][O+1];
+	const float *coefficients = table->coefficients;
+	float result = 0;
+	int n;
+
+	localbasis_fixed<D, O>(table, x, centers, derivatives, localbasis);
+	for (n = 0; n < D; n++)
+		coefficients += (centers[n] - O)*table->strides[n];
+
+	TensorProduct<O, D-1>::Accumulate(coefficients, table->strides,
+	    localbasis, 1, result);
+
+	return result;
+}
+
+template <int D, int O>
+double
+ndsplineeval_fixed_blocked(const struct splinetable *table, const double *x,
+    const int *centers, int derivatives)
+{
+	float localbasis[D][O+1];
+	unsigned long offsets[D][O+1];
+	float result = 0;
+
+	localbasis_fixed<D, O>(table, x, centers, derivatives, localbasis);
+	tableblockoffsets(table, centers, O+1, &offsets[0][0]);
+
+	BlockedTensorProduct<O, D-1>::Accumulate(table->coefficients, offsets,
+	    localbasis, 1, result);
+
+	return result;
+}
+
+template <int P, int D, int O>
+double
+ndsplineeval_fixed_packed(const struct splinetable *table, const double *x,
+    const int *centers, int derivatives)
+{
+	float localbasis[D][O+1];
+	unsigned long pos = 0;
+	float result = 0;
+	int n;
+
+	localbasis_fixed<D, O>(table, x, centers, derivatives, localbasis);
+	for (n = 0; n < D; n++)
+		pos += (centers[n] - O)*table->strides[n];
+
+	PackedTensorProduct<P, O, D-1>::Accumulate(table, pos, table->strides,
+	    localbasis, 1, result);
+
+	return result;
+}
+
+}
+
+ndsplineeval_func
+ndsplineeval_select(const struct splinetable *table)
+{
+	int n;
+
+	/* Only tables with the same order in every dimension */
+	for (n = 1; n < table->ndim; n++)
+		if (table->order[n] != table->order[0])
+			return &ndsplineeval;
+
+	#define SPECIALIZE(D, O) \
+		if (table->ndim == D && table->order[0] == O) \
+			return (table->blocksize > 0) ? \
+			    &ndsplineeval_fixed_blocked<D, O> : \
+			    (table->precision == SPLINETABLE_FLOAT16) ? \
+			    &ndsplineeval_fixed_packed<SPLINETABLE_FLOAT16, D, O> : \
+			    (table->precision == SPLINETABLE_BFLOAT16) ? \
+			    &ndsplineeval_fixed_packed<SPLINETABLE_BFLOAT16, D, O> : \
+			    (table->precision == SPLINETABLE_INT16) ? \
+			    &ndsplineeval_fixed_packed<SPLINETABLE_INT16, D, O> : \
+			    &ndsplineeval_fixed<D, O>;
+
+	SPECIALIZE(3, 2)
+	SPECIALIZE(3, 3)
+	SPECIALIZE(4, 2)
+	SPECIALIZE(4, 3)
+	SPECIALIZE(5, 2)
+	SPECIALIZE(5, 3)
+	SPECIALIZE(6, 2)
+	SPECIALIZE(6, 3)
+
+	#undef SPECIALIZE
+
+	return &ndsplineeval;
+}
@@ -53,6 +53,19 @@ typedef float v4sf __attribute__((vector_size(VECTOR_SIZE*sizeof(float))));
 }
 #endif
 
+/* Load a[idx[0]], ..., a[idx[3]] into the lanes of v */
+#if defined(__i386__) || defined (__x86_64__)
+#define v4sf_gather(v, a, idx) \
+	v = _mm_set_ps((a)[(idx)[3]], (a)[(idx)[2]], (a)[(idx)[1]], (a)[(idx)[0]])
+#else
+#define v4sf_gather(v, a, idx) { \
+	((float *)(&v))[0] = (a)[(idx)[0]]; \
+	((float *)(&v))[1] = (a)[(idx)[1]]; \
+	((float *)(&v))[2] = (a)[(idx)[2]]; \
+	((float *)(&v))[3] = (a)[(idx)[3]]; \
+}
+#endif
+
 static int
 maxorder(int *order, int ndim)
 {
@@ -65,9 +78,80 @@ maxorder(int *order, int ndim)
 	return (max);
 }
 
+/*
+ * Same as ndsplineeval_multibasis_core() below, for tables in the blocked
+ * layout. It is only called from there, on the already realigned stack.
+ */
 static void 
-ndsplineeval_multibasis_core(const struct splinetable *table, const int *centers,
+ndsplineeval_multibasis_core_blocked(const struct splinetable *table,
+    const int *centers, int nvecs,
     const v4sf **restrict localbasis[table->ndim], v4sf *restrict result)
+{
+	int maxdegree = maxorder(table->order, table->ndim) + 1;
+	int i, j, k, n;
+	v4sf basis_tree[table->ndim+1][nvecs];
+	unsigned long pos_tree[table->ndim];
+	unsigned long offsets[table->ndim][maxdegree];
+	const float *coefficients;
+	int nchunks;
+	int decomposedposition[table->ndim];
+
+	tableblockoffsets(table, centers, maxdegree, &offsets[0][0]);
+
+	pos_tree[0] = 0;
+	for (n = 0; n < table->ndim; n++) {
+		decomposedposition[n] = 0;
+		if (n < table->ndim - 1)
+			pos_tree[n+1] = pos_tree[n] + offsets[n][0];
+	}
+
+	for (k = 0; k < nvecs; k++) {
+		v4sf_init(basis_tree[0][k], 1);
+		for (n = 0; n < table->ndim; n++)
+			basis_tree[n+1][k] = basis_tree[n][k]*localbasis[n][0][k];
+	}
+	
+	nchunks = 1;
+	for (n = 0; n < table->ndim - 1; n++)
+		nchunks *= (table->order[n] + 1);
+
+	n = 0;
+	while (1) {
+		coefficients = table->coefficients + pos_tree[table->ndim-1];
+		for (i = 0; __builtin_expect(i < table->order[table->ndim-1] +
+		    1, 1); i++) {
+			v4sf weights;
+			v4sf_init(weights, coefficients[offsets[table->ndim-1][i]]);
+			for (k = 0; k < nvecs; k++)
+				result[k] += basis_tree[table->ndim-1][k]*
+				    localbasis[table->ndim-1][i][k]*weights;
+		}
+
+		if (__builtin_expect(++n == nchunks, 0))
+			break;
+
+		decomposedposition[table->ndim-2]++;
+
+		/* Carry to higher dimensions */
+		for (i = table->ndim-2;
+		    decomposedposition[i] > table->order[i]; i--) {
+			decomposedposition[i-1]++;
+			decomposedposition[i] = 0;
+		}
+		for (j = i; __builtin_expect(j < table->ndim-1, 1); j++) {
+			pos_tree[j+1] = pos_tree[j] +
+			    offsets[j][decomposedposition[j]];
+			for (k = 0; k < nvecs; k++)
+				basis_tree[j+1][k] = basis_tree[j][k]*
+				    localbasis[j][decomposedposition[j]][k];
+		}
+	}
+}
+
+static void 
+ndsplineeval_multibasis_core(const struct splinetable *table, const int *centers,
+    int nvecs, const v4sf **restrict localbasis[table->ndim],
+    v4sf *restrict result)
 {
 #if (defined(__i386__) || defined (__x86_64__)) && defined(__ELF__)
 	/*
@@ -80,17 +164,25 @@ ndsplineeval_multibasis_core(const struct splinetable *table, const int *centers
 		(void)alloca(16 - (sp & 15UL));
 #endif
 	int i, j, k, n, tablepos;
-	v4sf basis_tree[table->ndim+1][NVECS];
+	v4sf basis_tree[table->ndim+1][nvecs];
+	float buf[maxorder(table->order, table->ndim) + 1];
+	const float *coefficients;
 	int nchunks;
 	int decomposedposition[table->ndim];
 
+	if (table->blocksize > 0) {
+		ndsplineeval_multibasis_core_blocked(table, centers, nvecs,
+		    localbasis, result);
+		return;
+	}
+
 	tablepos = 0;
 	for (n = 0; n < table->ndim; n++) {
 		decomposedposition[n] = 0;
 		tablepos += (centers[n] - table->order[n])*table->strides[n];
 	}
 	
-	for (k = 0; k < NVECS; k++) {
+	for (k = 0; k < nvecs; k++) {
 		v4sf_init(basis_tree[0][k], 1);
 		for (n = 0; n < table->ndim; n++)
 			basis_tree[n+1][k] = basis_tree[n][k]*localbasis[n][0][k];
@@ -102,11 +194,13 @@ ndsplineeval_multibasis_core(const struct splinetable *table, const int *centers
 
 	n = 0;
 	while (1) {
+		coefficients = tablecoefficients(table, tablepos,
+		    table->order[table->ndim-1] + 1, buf);
 		for (i = 0; __builtin_expect(i < table->order[table->ndim-1] +
 		    1, 1); i++) {
 			v4sf weights;
-			v4sf_init(weights, table->coefficients[tablepos + i]);
-			for (k = 0; k < NVECS; k++)
+			v4sf_init(weights, coefficients[i]);
+			for (k = 0; k < nvecs; k++)
 				result[k] += basis_tree[table->ndim-1][k]*
 				    localbasis[table->ndim-1][i][k]*weights;
 		}
@@ -126,7 +220,7 @@ ndsplineeval_multibasis_core(const struct splinetable *table, const int *centers
 			decomposedposition[i] = 0;
 		}
 		for (j = i; __builtin_expect(j < table->ndim-1, 1); j++)
-			for (k = 0; k < NVECS; k++)
+			for (k = 0; k < nvecs; k++)
 				basis_tree[j+1][k] = basis_tree[j][k]*
 				    localbasis[j][decomposedposition[j]][k];
 	}
@@ -273,8 +367,288 @@ ndsplineeval_gradient(const struct splinetable *table, const double *x,
 	for (i = 0; i < nbases; i++)
 		acc_ptr[i] = 0;
 
-	ndsplineeval_multibasis_core(table, centers, localbasis_ptr, acc);
+	ndsplineeval_multibasis_core(table, centers, NVECS, localbasis_ptr,
+	    acc);
 
 	for (i = 0; i < nbases; i++)
 		evaluates[i] = acc_ptr[i];
 }
+
+/*
+ * Evaluate the spline surface, its gradient and its Hessian at x in one
+ * pass over the coefficients. The lanes hold the value, then the ndim first
+ * derivatives, then the second derivatives d2/dx_i dx_j for j <= i, each
+ * lane with its own tensor product of value, derivative or second
+ * derivative bases.
+ */
+
+#define MAXLANES (2*MAXDIM*VECTOR_SIZE)
+
+void
+ndsplineeval_hessian(const struct splinetable *table, const double *x,
+    const int *centers, double *value, double *gradient, double *hessian)
+{
+	int n, i, j, k, lane;
+	int ndim = table->ndim;
+	int maxdegree = maxorder(table->order, table->ndim) + 1;
+	int nlanes = 1 + ndim + ndim*(ndim+1)/2;
+	int nvecs = (nlanes + VECTOR_SIZE - 1)/VECTOR_SIZE;
+	float valbasis[maxdegree], gradbasis[maxdegree], hessbasis[maxdegree];
+	/* Which derivative each lane takes along each dimension */
+	int lanederiv[MAXLANES][MAXDIM];
+	v4sf acc[MAXLANES/VECTOR_SIZE];
+	float *acc_ptr;
+	assert(table->ndim>0);
+	v4sf localbasis[table->ndim][maxdegree][nvecs];
+	const v4sf *localbasis_rowptr[table->ndim][maxdegree];
+	const v4sf **localbasis_ptr[table->ndim];
+
+	if (table->ndim+1 > MAXDIM) {
+		fprintf(stderr, "Error: ndsplineeval_hessian() can only "
+		    "process up to %d-dimensional tables. Adjust MAXDIM in "
+		    "bspline_multi.c to change this.\n", MAXDIM-1);
+		exit(1);
+	}
+
+	memset(lanederiv, 0, sizeof(lanederiv));
+	lane = 1;
+	for (i = 0; i < ndim; i++)
+		lanederiv[lane++][i] = 1;
+	for (i = 0; i < ndim; i++)
+		for (j = 0; j <= i; j++, lane++) {
+			lanederiv[lane][i]++;
+			lanederiv[lane][j]++;
+		}
+
+	for (n = 0; n < ndim; n++) {
+		bspline_nonzero(table->knots[n], table->nknots[n],
+		    x[n], centers[n], table->order[n], valbasis, gradbasis);
+		/* Same second derivatives as ndsplineeval_deriv2() */
+		for (i = 0; i <= table->order[n]; i++)
+			hessbasis[i] = bspline_deriv_2(table->knots[n], x[n],
+			    centers[n] - table->order[n] + i, table->order[n]);
+
+		for (i = 0; i <= table->order[n]; i++) {
+			for (k = 0; k < nvecs*VECTOR_SIZE; k++) {
+				float *b = &((float*)(localbasis[n][i]))[k];
+				if (k >= nlanes || lanederiv[k][n] == 0)
+					*b = valbasis[i];
+				else if (lanederiv[k][n] == 1)
+					*b = gradbasis[i];
+				else
+					*b = hessbasis[i];
+			}
+			localbasis_rowptr[n][i] = localbasis[n][i];
+		}
+		localbasis_ptr[n] = localbasis_rowptr[n];
+	}
+
+	acc_ptr = (float*)acc;
+	for (i = 0; i < nvecs*VECTOR_SIZE; i++)
+		acc_ptr[i] = 0;
+
+	ndsplineeval_multibasis_core(table, centers, nvecs, localbasis_ptr,
+	    acc);
+
+	*value = acc_ptr[0];
+	for (i = 0; i < ndim; i++)
+		gradient[i] = acc_ptr[1+i];
+	lane = 1 + ndim;
+	for (i = 0; i < ndim; i++)
+		for (j = 0; j <= i; j++, lane++)
+			hessian[i*ndim + j] = hessian[j*ndim + i] =
+			    acc_ptr[lane];
+}
+
+/*
+ * Batched evaluation: points are processed in blocks of BATCH_BLOCK. Within
+ * a block the bases are computed one dimension at a time (so that each knot
+ * vector stays in cache), and the tensor product is accumulated for
+ * VECTOR_SIZE points at once, one point per vector lane. The walk through
+ * the coefficient array is the same for every point relative to its own
+ * corner, so only the coefficient loads differ between lanes.
+ */
+
+#define BATCH_BLOCK 64
+#define BATCH_GROUPS (BATCH_BLOCK/VECTOR_SIZE)
+
+/*
+ * ndsplineeval_batch() keeps vectors on its own stack, so on i386, where
+ * callers need only keep the stack 4-byte aligned, have GCC realign it on
+ * entry.
+ */
+#if defined(__i386__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 2))
+#define BATCH_ALIGN_STACK __attribute__((force_align_arg_pointer))
+#else
+#define BATCH_ALIGN_STACK
+#endif
+
+static void
+ndsplineeval_batch_core(const struct splinetable *table,
+    const int *restrict tablepos, int maxdegree,
+    const v4sf localbasis[table->ndim][maxdegree], v4sf *restrict result)
+{
+	int i, j, n, offset;
+	v4sf basis_tree[table->ndim+1];
+	v4sf acc, weights;
+	int nchunks;
+	int decomposedposition[table->ndim];
+
+	offset = 0;
+	for (n = 0; n < table->ndim; n++)
+		decomposedposition[n] = 0;
+
+	v4sf_init(basis_tree[0], 1);
+	for (n = 0; n < table->ndim; n++)
+		basis_tree[n+1] = basis_tree[n]*localbasis[n][0];
+	nchunks = 1;
+	for (n = 0; n < table->ndim - 1; n++)
+		nchunks *= (table->order[n] + 1);
+
+	v4sf_init(acc, 0);
+	n = 0;
+	while (1) {
+#if defined(__i386__) || defined (__x86_64__)
+		if (table->order[table->ndim-1] == VECTOR_SIZE-1) {
+			/*
+			 * Cubic splines (the usual case): each lane needs
+			 * exactly one vector's worth of contiguous
+			 * coefficients, so load them row by row and
+			 * transpose instead of gathering element-wise.
+			 */
+			v4sf w0, w1, w2, w3;
+			w0 = _mm_loadu_ps(table->coefficients + tablepos[0] + offset);
+			w1 = _mm_loadu_ps(table->coefficients + tablepos[1] + offset);
+			w2 = _mm_loadu_ps(table->coefficients + tablepos[2] + offset);
+			w3 = _mm_loadu_ps(table->coefficients + tablepos[3] + offset);
+			_MM_TRANSPOSE4_PS(w0, w1, w2, w3);
+			acc += basis_tree[table->ndim-1]*
+			    localbasis[table->ndim-1][0]*w0;
+			acc += basis_tree[table->ndim-1]*
+			    localbasis[table->ndim-1][1]*w1;
+			acc += basis_tree[table->ndim-1]*
+			    localbasis[table->ndim-1][2]*w2;
+			acc += basis_tree[table->ndim-1]*
+			    localbasis[table->ndim-1][3]*w3;
+		} else
+#endif
+		for (i = 0; __builtin_expect(i < table->order[table->ndim-1] +
+		    1, 1); i++) {
+			v4sf_gather(weights, table->coefficients + offset + i,
+			    tablepos);
+			acc += basis_tree[table->ndim-1]*
+			    localbasis[table->ndim-1][i]*weights;
+		}
+
+		if (__builtin_expect(++n == nchunks, 0))
+			break;
+
+		offset += table->strides[table->ndim-2];
+		decomposedposition[table->ndim-2]++;
+
+		/* Carry to higher dimensions */
+		for (i = table->ndim-2;
+		    decomposedposition[i] > table->order[i]; i--) {
+			decomposedposition[i-1]++;
+			offset += (table->strides[i-1]
+			    - decomposedposition[i]*table->strides[i]);
+			decomposedposition[i] = 0;
+		}
+		for (j = i; __builtin_expect(j < table->ndim-1, 1); j++)
+			basis_tree[j+1] = basis_tree[j]*
+			    localbasis[j][decomposedposition[j]];
+	}
+
+	*result = acc;
+}
+
+BATCH_ALIGN_STACK void
+ndsplineeval_batch(const struct splinetable *table, size_t npts,
+    const double *x, const int *centers, int derivatives, double *results)
+{
+	const int ndim = table->ndim;
+	int maxdegree = maxorder(table->order, ndim) + 1;
+	int i, k, n, p, g, nblock, nvalid;
+	size_t start;
+	float biatx[maxdegree];
+	int tablepos[BATCH_BLOCK];
+	int valid[BATCH_BLOCK];
+	v4sf localbasis[BATCH_GROUPS][ndim][maxdegree];
+	v4sf acc;
+
+	assert(ndim > 0);
+
+	/* The gathers below assume row-major single precision */
+	if (table->blocksize > 0 || table->precision != SPLINETABLE_FLOAT32) {
+		for (start = 0; start < npts; start++)
+			if (centers[start*ndim] >= 0)
+				results[start] = ndsplineeval(table,
+				    &x[start*ndim], &centers[start*ndim],
+				    derivatives);
+		return;
+	}
+
+	for (start = 0; start < npts; start += BATCH_BLOCK) {
+		const double *xblock = x + start*ndim;
+		const int *cblock = centers + start*ndim;
+
+		nblock = (npts - start < BATCH_BLOCK) ? npts - start :
+		    BATCH_BLOCK;
+
+		/*
+		 * Locate each point's corner in the coefficient array.
+		 * Padding lanes and points outside the table get a zero
+		 * basis and read from the start of the array.
+		 */
+		for (p = 0; p < BATCH_BLOCK; p++) {
+			tablepos[p] = 0;
+			valid[p] = (p < nblock && cblock[p*ndim] >= 0);
+			if (!valid[p])
+				continue;
+			for (n = 0; n < ndim; n++)
+				tablepos[p] += (cblock[p*ndim + n] -
+				    table->order[n])*table->strides[n];
+		}
+
+		for (n = 0; n < ndim; n++) {
+			for (p = 0; p < ((nblock + VECTOR_SIZE - 1) /
+			    VECTOR_SIZE)*VECTOR_SIZE; p++) {
+				float *lane = (float*)localbasis[p/VECTOR_SIZE][n]
+				    + p%VECTOR_SIZE;
+
+				if (!valid[p]) {
+					for (i = 0; i <= table->order[n]; i++)
+						biatx[i] = 0;
+				} else if (derivatives & (1 << n)) {
+					bspline_deriv_nonzero(table->knots[n],
+					    table->nknots[n], xblock[p*ndim + n],
+					    cblock[p*ndim + n], table->order[n],
+					    biatx);
+				} else {
+					bsplvb_simple(table->knots[n],
+					    table->nknots[n], xblock[p*ndim + n],
+					    cblock[p*ndim + n], table->order[n] + 1,
+					    biatx);
+				}
+				for (i = 0; i <= table->order[n]; i++)
+					lane[i*VECTOR_SIZE] = biatx[i];
+			}
+		}
+
+		for (g = 0; g*VECTOR_SIZE < nblock; g++) {
+			for (k = 0, nvalid = 0; k < VECTOR_SIZE; k++)
+				nvalid += valid[g*VECTOR_SIZE + k];
+			if (nvalid == 0)
+				continue;
+
+			ndsplineeval_batch_core(table, &tablepos[g*VECTOR_SIZE],
+			    maxdegree, (const v4sf (*)[maxdegree])localbasis[g],
+			    &acc);
+
+			for (k = 0; k < VECTOR_SIZE; k++)
+				if (valid[g*VECTOR_SIZE + k])
+					results[start + g*VECTOR_SIZE + k] =
+					    ((float*)&acc)[k];
+		}
+	}
+}
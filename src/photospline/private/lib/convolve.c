@@ -30,6 +30,11 @@ splinetable_convolve(struct splinetable *table, const int dim, const double *kno
 	unsigned convorder;
 	long stride1, stride2;
 	int i, j, k, l, q;
+
+	/* The transformation below works on row-major single precision */
+	if ((i = splinetable_unblock(table)) != 0 ||
+	    (i = splinetable_unpack(table)) != 0)
+		return (i);
 		
 	/* Construct the new knot field. */
 	n_rho = 0;
@@ -141,7 +146,7 @@ splinetable_convolve(struct splinetable *table, const int dim, const double *kno
 		table->extents[dim][0] = rho[convorder];
 	
 	/* Swap out the new components of the table */
-	free(table->coefficients);
+	splinetable_free_coefficients(table);
 	free(table->naxes);
 	free(table->strides);
 	free(table->knots[dim] - table->order[dim]);
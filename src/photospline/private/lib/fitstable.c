@@ -136,9 +136,10 @@ void splinetable_free(struct splinetable *table)
 	}
 	free(table->nknots);
 	free(table->naxes);
-	free(table->coefficients);
+	splinetable_free_coefficients(table);
 	free(table->periods);
 	free(table->strides);
+	free(table->blockstrides);
 	
 	if (table->extents) {
 		free(table->extents[0]);
@@ -161,6 +162,9 @@ splinetable_permute(struct splinetable *table, int *permutation)
 	float *coefficients;
 	
 	assert(table->ndim >= 1);
+	if (splinetable_unblock(table) != 0 ||
+	    splinetable_unpack(table) != 0)
+		return;
 	order   = malloc(sizeof(table->order[0])*table->ndim);
 	naxes   = malloc(sizeof(table->naxes[0])*table->ndim);
 	strides = malloc(sizeof(table->strides[0])*table->ndim);
@@ -201,7 +205,7 @@ splinetable_permute(struct splinetable *table, int *permutation)
 		coefficients[npos] = table->coefficients[pos];
 	}
 	
-	free(table->coefficients);
+	splinetable_free_coefficients(table);
 	free(table->order);
 	free(table->naxes);
 	free(table->strides);
@@ -247,13 +251,22 @@ fillfitstable(fitsfile *fits, const struct splinetable *table)
 	{
 		long *fpixel = malloc(sizeof(long)*table->ndim);
 		long arraysize = 1;
+		float *coefficients = table->coefficients;
 		for (i = 0; i < table->ndim; i++) {
 			fpixel[i] = 1;
 			arraysize *= table->naxes[i];
 		}
 		
+		/* FITS tables are always row-major single precision */
+		if (table->blocksize > 0 ||
+		    table->precision != SPLINETABLE_FLOAT32) {
+			coefficients = malloc(sizeof(float)*arraysize);
+			splinetable_coefficients_rowmajor(table, coefficients);
+		}
 		fits_write_pix(fits, TFLOAT, fpixel, arraysize,
-		    table->coefficients, &error);
+		    coefficients, &error);
+		if (coefficients != table->coefficients)
+			free(coefficients);
 		free(fpixel);
 		
 		if (error != 0)
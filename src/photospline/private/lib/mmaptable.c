@@ -0,0 +1,381 @@
+/*
+ * mmaptable.c: Reads and writes spline tables in a native binary layout
+ *  whose coefficient array can be mapped straight into memory. Read-only
+ *  shared mappings of the same file are backed by the same page cache
+ *  pages, so any number of processes on a machine can use a multi-GB
+ *  table for the price of one copy, and loading it costs next to nothing.
+ *
+ * The files are laid out in the following way (all in host byte order,
+ *  which is checked when reading):
+ *  Header:
+ *   struct mmaptable_header
+ *  Per-axis records, one for each of the ndim axes:
+ *   struct mmaptable_axis
+ *  Knot vectors:
+ *   nknots doubles for each axis, one after the other
+ *  Auxiliary keywords, one after the other:
+ *   uint32 key length, uint32 value length, key, value (including NULs)
+ *  Padding to the next MMAPTABLE_ALIGN byte boundary
+ *  Coefficients:
+ *   ncoefficients floats, in the same order as in memory, i.e. in blocks
+ *   if blocksize is not zero (see splinetable_block()), or 16-bit words if
+ *   precision is not SPLINETABLE_FLOAT32 (see splinetable_pack())
+ *  For SPLINETABLE_INT16 only, padding to a 4-byte boundary and the scales:
+ *   ceil(ncoefficients/SPLINETABLE_QBLOCK) floats
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "photospline/splinetable.h"
+
+#define MMAPTABLE_MAGIC "SPLNMMAP"
+#define MMAPTABLE_VERSION 2
+#define MMAPTABLE_BYTEORDER 0x01020304u
+#define MMAPTABLE_ALIGN 4096
+
+struct mmaptable_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byteorder;
+	int32_t ndim;
+	int32_t naux;
+	int32_t blocksize;
+	int32_t precision;
+	uint64_t coefficients_offset;
+	uint64_t ncoefficients;
+};
+
+struct mmaptable_axis {
+	int32_t order;
+	int32_t reserved;
+	int64_t nknots;
+	int64_t naxes;
+	double period;
+	double extents[2];
+};
+
+static int
+write_all(FILE *fp, const void *data, size_t size)
+{
+	return (fwrite(data, 1, size, fp) == size ? 0 : EIO);
+}
+
+int
+writesplinemmaptable(const char *path, const struct splinetable *table)
+{
+	struct mmaptable_header header;
+	struct mmaptable_axis axis;
+	uint64_t offset;
+	uint32_t len[2];
+	size_t ncoeffs, nscales;
+	char zero[MMAPTABLE_ALIGN];
+	FILE *fp;
+	int i, err = 0;
+
+	ncoeffs = splinetable_ncoefficients(table);
+
+	/* Everything up to the coefficients */
+	offset = sizeof(header) + table->ndim*sizeof(axis);
+	for (i = 0; i < table->ndim; i++)
+		offset += table->nknots[i]*sizeof(double);
+	for (i = 0; i < table->naux; i++)
+		offset += sizeof(len) + strlen(table->aux[i][0]) + 1 +
+		    strlen(table->aux[i][1]) + 1;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MMAPTABLE_MAGIC, sizeof(header.magic));
+	header.version = MMAPTABLE_VERSION;
+	header.byteorder = MMAPTABLE_BYTEORDER;
+	header.ndim = table->ndim;
+	header.naux = table->naux;
+	header.blocksize = table->blocksize;
+	header.precision = table->precision;
+	header.coefficients_offset = (offset + MMAPTABLE_ALIGN - 1) &
+	    ~(uint64_t)(MMAPTABLE_ALIGN - 1);
+	header.ncoefficients = ncoeffs;
+
+	if ((fp = fopen(path, "wb")) == NULL)
+		return (errno);
+
+	err = write_all(fp, &header, sizeof(header));
+	for (i = 0; i < table->ndim && !err; i++) {
+		memset(&axis, 0, sizeof(axis));
+		axis.order = table->order[i];
+		axis.nknots = table->nknots[i];
+		axis.naxes = table->naxes[i];
+		axis.period = table->periods ? table->periods[i] : 0;
+		axis.extents[0] = table->extents[i][0];
+		axis.extents[1] = table->extents[i][1];
+		err = write_all(fp, &axis, sizeof(axis));
+	}
+	for (i = 0; i < table->ndim && !err; i++)
+		err = write_all(fp, table->knots[i],
+		    table->nknots[i]*sizeof(double));
+	for (i = 0; i < table->naux && !err; i++) {
+		len[0] = strlen(table->aux[i][0]) + 1;
+		len[1] = strlen(table->aux[i][1]) + 1;
+		err = write_all(fp, len, sizeof(len));
+		if (!err)
+			err = write_all(fp, table->aux[i][0], len[0]);
+		if (!err)
+			err = write_all(fp, table->aux[i][1], len[1]);
+	}
+	memset(zero, 0, sizeof(zero));
+	if (!err)
+		err = write_all(fp, zero,
+		    header.coefficients_offset - offset);
+	if (!err && table->precision == SPLINETABLE_FLOAT32)
+		err = write_all(fp, table->coefficients,
+		    ncoeffs*sizeof(float));
+	else if (!err)
+		err = write_all(fp, table->packed,
+		    ncoeffs*sizeof(unsigned short));
+	if (!err && table->precision == SPLINETABLE_INT16) {
+		nscales = (ncoeffs + SPLINETABLE_QBLOCK - 1)/SPLINETABLE_QBLOCK;
+		err = write_all(fp, zero, (ncoeffs % 2)*sizeof(unsigned short));
+		if (!err)
+			err = write_all(fp, table->scales,
+			    nscales*sizeof(float));
+	}
+
+	if (fclose(fp) != 0 && !err)
+		err = errno;
+
+	return (err);
+}
+
+/*
+ * Bounds-checked sequential reader for the metadata at the start of
+ * the mapping.
+ */
+struct cursor {
+	const char *pos, *end;
+};
+
+static const void *
+take(struct cursor *cur, size_t size)
+{
+	const void *p = cur->pos;
+
+	if (size > (size_t)(cur->end - cur->pos))
+		return (NULL);
+	cur->pos += size;
+	return (p);
+}
+
+int
+readsplinemmaptable(const char *path, struct splinetable *table)
+{
+	const struct mmaptable_header *header;
+	const struct mmaptable_axis *axes;
+	struct cursor cur;
+	struct stat st;
+	void *base;
+	size_t size, ncoeffs, elemsize, scales_offset = 0;
+	int fd, i, err = 0;
+
+	memset(table, 0, sizeof(struct splinetable));
+
+	if ((fd = open(path, O_RDONLY)) < 0)
+		return (errno);
+	if (fstat(fd, &st) != 0) {
+		err = errno;
+		close(fd);
+		return (err);
+	}
+	size = st.st_size;
+	if (size < sizeof(*header)) {
+		close(fd);
+		return (EINVAL);
+	}
+
+	base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	/* The mapping stays valid after the descriptor is closed */
+	close(fd);
+	if (base == MAP_FAILED)
+		return (errno);
+
+	cur.pos = base;
+	cur.end = cur.pos + size;
+	header = take(&cur, sizeof(*header));
+	if (memcmp(header->magic, MMAPTABLE_MAGIC, sizeof(header->magic)) != 0
+	    || header->version != MMAPTABLE_VERSION
+	    || header->byteorder != MMAPTABLE_BYTEORDER
+	    || header->ndim < 1 || header->naux < 0 || header->blocksize < 0
+	    || header->precision < SPLINETABLE_FLOAT32
+	    || header->precision > SPLINETABLE_INT16
+	    || (header->blocksize > 0 &&
+	    header->precision != SPLINETABLE_FLOAT32)
+	    || (axes = take(&cur, header->ndim*sizeof(*axes))) == NULL) {
+		munmap(base, size);
+		return (EINVAL);
+	}
+
+	table->ndim = header->ndim;
+	table->order = malloc(sizeof(table->order[0])*table->ndim);
+	table->nknots = malloc(sizeof(table->nknots[0])*table->ndim);
+	table->naxes = malloc(sizeof(table->naxes[0])*table->ndim);
+	table->strides = malloc(sizeof(table->strides[0])*table->ndim);
+	table->periods = malloc(sizeof(table->periods[0])*table->ndim);
+	table->extents = malloc(sizeof(table->extents[0])*table->ndim);
+	table->extents[0] = malloc(sizeof(table->extents[0][0])*2*table->ndim);
+	table->knots = calloc(table->ndim, sizeof(table->knots[0]));
+
+	for (i = 0; i < table->ndim; i++) {
+		table->order[i] = axes[i].order;
+		table->nknots[i] = axes[i].nknots;
+		table->naxes[i] = axes[i].naxes;
+		table->periods[i] = axes[i].period;
+		table->extents[i] = &table->extents[0][2*i];
+		table->extents[i][0] = axes[i].extents[0];
+		table->extents[i][1] = axes[i].extents[1];
+		if (table->order[i] < 0 || table->naxes[i] < 1 ||
+		    table->naxes[i] != table->nknots[i] - table->order[i] - 1)
+			err = EINVAL;
+	}
+	table->strides[table->ndim-1] = 1;
+	for (i = table->ndim-1; i > 0; i--)
+		table->strides[i-1] = table->strides[i]*table->naxes[i];
+
+	if (header->blocksize > 0) {
+		unsigned long blockvolume = 1;
+
+		table->blocksize = header->blocksize;
+		table->blockstrides = malloc(sizeof(unsigned long)*table->ndim);
+		for (i = 0; i < table->ndim; i++)
+			blockvolume *= table->blocksize;
+		table->blockstrides[table->ndim-1] = blockvolume;
+		for (i = table->ndim-1; i > 0; i--)
+			table->blockstrides[i-1] = table->blockstrides[i]*
+			    ((table->naxes[i] + table->blocksize - 1)/
+			    table->blocksize);
+	}
+	ncoeffs = splinetable_ncoefficients(table);
+	elemsize = (header->precision == SPLINETABLE_FLOAT32) ?
+	    sizeof(float) : sizeof(unsigned short);
+
+	/*
+	 * The knots are small, so copy them, with room to run off either
+	 * end as in parsefitstable().
+	 */
+	for (i = 0; i < table->ndim && !err; i++) {
+		const double *knots = take(&cur,
+		    table->nknots[i]*sizeof(double));
+		double *knot_scratch;
+
+		if (knots == NULL) {
+			err = EINVAL;
+			break;
+		}
+		knot_scratch = calloc(table->nknots[i] + 2*table->order[i],
+		    sizeof(double));
+		table->knots[i] = knot_scratch + table->order[i];
+		memcpy(table->knots[i], knots, table->nknots[i]*sizeof(double));
+	}
+
+	if (!err && header->naux > 0)
+		table->aux = calloc(header->naux, sizeof(char**));
+	for (i = 0; i < header->naux && !err; i++) {
+		const void *lenp = take(&cur, 2*sizeof(uint32_t));
+		const char *key, *value;
+		uint32_t len[2];
+
+		/* Records after the first are not necessarily aligned */
+		if (lenp != NULL)
+			memcpy(len, lenp, sizeof(len));
+		if (lenp == NULL || (key = take(&cur, len[0])) == NULL ||
+		    (value = take(&cur, len[1])) == NULL ||
+		    len[0] == 0 || len[1] == 0 ||
+		    key[len[0]-1] != '\0' || value[len[1]-1] != '\0') {
+			err = EINVAL;
+			break;
+		}
+		table->aux[i] = calloc(sizeof(char*), 2);
+		table->aux[i][0] = strdup(key);
+		table->aux[i][1] = strdup(value);
+		table->naux++;
+	}
+
+	if (!err && (header->ncoefficients != ncoeffs ||
+	    header->coefficients_offset % MMAPTABLE_ALIGN != 0 ||
+	    header->coefficients_offset < (uint64_t)(cur.pos - (char*)base) ||
+	    header->coefficients_offset > size ||
+	    ncoeffs > (size - header->coefficients_offset)/elemsize))
+		err = EINVAL;
+	if (!err && header->precision == SPLINETABLE_INT16) {
+		scales_offset = header->coefficients_offset +
+		    ((ncoeffs + 1)/2)*2*sizeof(unsigned short);
+		if (scales_offset > size ||
+		    (ncoeffs + SPLINETABLE_QBLOCK - 1)/SPLINETABLE_QBLOCK >
+		    (size - scales_offset)/sizeof(float))
+			err = EINVAL;
+	}
+
+	if (err) {
+		munmap(base, size);
+		splinetable_free(table);
+		memset(table, 0, sizeof(struct splinetable));
+		return (err);
+	}
+
+	table->precision = header->precision;
+	if (table->precision == SPLINETABLE_FLOAT32)
+		table->coefficients = (float*)((char*)base +
+		    header->coefficients_offset);
+	else
+		table->packed = (unsigned short*)((char*)base +
+		    header->coefficients_offset);
+	if (table->precision == SPLINETABLE_INT16)
+		table->scales = (float*)((char*)base + scales_offset);
+	table->mmap_base = base;
+	table->mmap_size = size;
+
+	return (0);
+}
+
+int
+readsplinetable(const char *path, struct splinetable *table)
+{
+	char magic[8];
+	FILE *fp;
+	int is_mmap;
+
+	if ((fp = fopen(path, "rb")) == NULL)
+		return (errno);
+	is_mmap = (fread(magic, 1, sizeof(magic), fp) == sizeof(magic) &&
+	    memcmp(magic, MMAPTABLE_MAGIC, sizeof(magic)) == 0);
+	fclose(fp);
+
+	if (is_mmap)
+		return (readsplinemmaptable(path, table));
+	else
+		return (readsplinefitstable(path, table));
+}
+
+void
+splinetable_free_coefficients(struct splinetable *table)
+{
+	if (table->mmap_base != NULL) {
+		munmap(table->mmap_base, table->mmap_size);
+		table->mmap_base = NULL;
+		table->mmap_size = 0;
+	} else {
+		free(table->coefficients);
+		free(table->packed);
+		free(table->scales);
+	}
+	table->coefficients = NULL;
+	table->packed = NULL;
+	table->scales = NULL;
+	table->precision = SPLINETABLE_FLOAT32;
+}
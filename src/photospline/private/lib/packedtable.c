@@ -0,0 +1,174 @@
+/*
+ * packedtable.c: Converts spline coefficients between single precision
+ *  and the 16-bit storage formats of splinetable_pack(). Decoding happens
+ *  in tablecoefficients() (bspline.h), right where the evaluators read the
+ *  coefficients, so that the packed array is all that has to stay in
+ *  memory.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+
+#include "photospline/splinetable.h"
+#include "photospline/bspline.h"
+
+/*
+ * NB: the library is built with -ffinite-math-only, so infinities and NaNs
+ * are caught by looking at the bits rather than with isfinite().
+ */
+static int
+finite_bits(float f)
+{
+	uint32_t bits;
+
+	memcpy(&bits, &f, sizeof(bits));
+	return ((bits & 0x7f800000) != 0x7f800000);
+}
+
+/* Round to the nearest half-precision float, ties to even */
+static int
+float_to_half(float f, unsigned short *h)
+{
+	uint32_t bits, mant, rem, half;
+	unsigned short sign;
+
+	memcpy(&bits, &f, sizeof(bits));
+	sign = (bits >> 16) & 0x8000;
+	bits &= 0x7fffffff;
+
+	/* Anything from 65520 up would round to infinity */
+	if (bits >= 0x477ff000)
+		return (ERANGE);
+
+	if (bits < 0x38800000) {
+		/* Subnormal in half precision: a multiple of 2^-24 */
+		*h = sign | (unsigned short)lrintf(fabsf(f)*16777216.f);
+		return (0);
+	}
+
+	mant = bits & 0x7fffff;
+	half = ((((bits >> 23) - 127 + 15) << 10) | (mant >> 13));
+	rem = mant & 0x1fff;
+	/* A carry out of the mantissa correctly bumps the exponent */
+	if (rem > 0x1000 || (rem == 0x1000 && (half & 1)))
+		half++;
+	*h = sign | half;
+
+	return (0);
+}
+
+/* Round to the nearest bfloat16, ties to even */
+static int
+float_to_bfloat16(float f, unsigned short *h)
+{
+	uint32_t bits;
+
+	if (!finite_bits(f))
+		return (ERANGE);
+	memcpy(&bits, &f, sizeof(bits));
+	bits += 0x7fff + ((bits >> 16) & 1);
+	*h = bits >> 16;
+
+	/* Catch overflow in the rounding */
+	return (((*h & 0x7f80) == 0x7f80) ? ERANGE : 0);
+}
+
+int
+splinetable_pack(struct splinetable *table, splinetable_precision precision)
+{
+	unsigned short *packed;
+	float *coefficients, *scales = NULL;
+	size_t i, j, n, nblocks;
+	float maxabs;
+	int err = 0;
+
+	if (precision == table->precision)
+		return (0);
+	if (table->blocksize > 0 || precision < SPLINETABLE_FLOAT32 ||
+	    precision > SPLINETABLE_INT16)
+		return (EINVAL);
+	if (precision == SPLINETABLE_FLOAT32)
+		return (splinetable_unpack(table));
+
+	n = splinetable_ncoefficients(table);
+	coefficients = table->coefficients;
+	if (table->precision != SPLINETABLE_FLOAT32) {
+		if ((coefficients = malloc(n*sizeof(float))) == NULL)
+			return (ENOMEM);
+		splinetable_coefficients_rowmajor(table, coefficients);
+	}
+
+	packed = malloc(n*sizeof(unsigned short));
+	if (packed == NULL)
+		err = ENOMEM;
+
+	switch (precision) {
+	case SPLINETABLE_FLOAT16:
+		for (i = 0; i < n && !err; i++)
+			err = float_to_half(coefficients[i], &packed[i]);
+		break;
+	case SPLINETABLE_BFLOAT16:
+		for (i = 0; i < n && !err; i++)
+			err = float_to_bfloat16(coefficients[i], &packed[i]);
+		break;
+	default:
+		nblocks = (n + SPLINETABLE_QBLOCK - 1)/SPLINETABLE_QBLOCK;
+		if (!err && (scales = malloc(nblocks*sizeof(float))) == NULL)
+			err = ENOMEM;
+		for (i = 0; i < nblocks && !err; i++) {
+			size_t end = (i+1)*SPLINETABLE_QBLOCK < n ?
+			    (i+1)*SPLINETABLE_QBLOCK : n;
+
+			maxabs = 0;
+			for (j = i*SPLINETABLE_QBLOCK; j < end; j++) {
+				if (!finite_bits(coefficients[j]))
+					err = ERANGE;
+				if (fabsf(coefficients[j]) > maxabs)
+					maxabs = fabsf(coefficients[j]);
+			}
+			scales[i] = maxabs/32767.f;
+			for (j = i*SPLINETABLE_QBLOCK; j < end; j++)
+				packed[j] = (scales[i] > 0) ? (unsigned short)
+				    (short)lrintf(coefficients[j]/scales[i]) : 0;
+		}
+		break;
+	}
+
+	if (coefficients != table->coefficients)
+		free(coefficients);
+	if (err) {
+		free(packed);
+		free(scales);
+		return (err);
+	}
+
+	splinetable_free_coefficients(table);
+	table->packed = packed;
+	table->scales = scales;
+	table->precision = precision;
+
+	return (0);
+}
+
+int
+splinetable_unpack(struct splinetable *table)
+{
+	float *coefficients;
+
+	if (table->precision == SPLINETABLE_FLOAT32)
+		return (0);
+
+	coefficients = malloc(splinetable_ncoefficients(table)*sizeof(float));
+	if (coefficients == NULL)
+		return (ENOMEM);
+	splinetable_coefficients_rowmajor(table, coefficients);
+
+	splinetable_free_coefficients(table);
+	table->coefficients = coefficients;
+	table->precision = SPLINETABLE_FLOAT32;
+
+	return (0);
+}
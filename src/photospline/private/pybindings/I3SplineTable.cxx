@@ -56,6 +56,36 @@ splinetableeval_deriv2(I3SplineTable &self, bp::object coordinates, int derivati
 	return retvalue;
 }
 
+static bp::object
+splinetableeval_batch(I3SplineTable &self, bp::object coordinates, int derivatives)
+{
+	PyObject *coords;
+	coords = PyArray_ContiguousFromObject(coordinates.ptr(), NPY_DOUBLE, 2, 2);
+	if (!coords) {
+		PyErr_Format(PyExc_ValueError, "Can't convert object of type"
+		    "'%s' to a 2-d array of doubles!", PY_TYPESTRING(coordinates));
+		bp::throw_error_already_set();
+	}
+	npy_intp npts = PyArray_DIM((PyArrayObject *)coords, 0);
+	if (PyArray_DIM((PyArrayObject *)coords, 1) != npy_intp(self.GetNDim())) {
+		Py_DECREF(coords);
+		PyErr_Format(PyExc_ValueError, "Coordinates must have shape "
+		    "(npoints, %u)", self.GetNDim());
+		bp::throw_error_already_set();
+	}
+	
+	PyObject *results = PyArray_SimpleNew(1, &npts, NPY_DOUBLE);
+	if (!results) {
+		Py_DECREF(coords);
+		bp::throw_error_already_set();
+	}
+	self.EvalBatch((double*)PyArray_DATA((PyArrayObject *)coords),
+	    (double*)PyArray_DATA((PyArrayObject *)results), npts, derivatives);
+	Py_DECREF(coords);
+
+	return bp::object(bp::handle<>(results));
+}
+
 static bp::list
 GetExtents(const I3SplineTable &self)
 {
@@ -70,7 +100,8 @@ GetExtents(const I3SplineTable &self)
 
 void register_I3SplineTable() {
 	bp::class_<I3SplineTable, boost::shared_ptr<I3SplineTable>, boost::noncopyable>
-	    ("I3SplineTable", bp::init<const std::string&>(bp::arg("path")))
+	    ("I3SplineTable", bp::init<const std::string&, bp::optional<int> >((bp::arg("path"),
+	    bp::arg("blocksize")=0)))
 	    .def("eval", splinetableeval, (bp::args("coordinates"), bp::arg("derivatives")=0),
 	        "Evaluate the spline surface at the given coordinates.\n\n"
 	        ":param coordinates: N-dimensonal coordinates at which to evaluate\n"
@@ -82,6 +113,11 @@ void register_I3SplineTable() {
 	                          "will be the gradient of the surface in that "
 	                          "dimension.")
 	    .def("eval_deriv2", splinetableeval_deriv2, (bp::args("coordinates"), bp::arg("derivatives")=0))
+	    .def("eval_batch", splinetableeval_batch, (bp::args("coordinates"), bp::arg("derivatives")=0),
+	        "Evaluate the spline surface at many points at once.\n\n"
+	        ":param coordinates: array of shape (npoints, ndim)\n"
+	        ":param derivatives: as for eval()\n"
+	        ":returns: array of npoints values, NaN outside the table")
 	    .add_property("ndim", &I3SplineTable::GetNDim)
 	    .add_property("extents", &GetExtents)
 	;
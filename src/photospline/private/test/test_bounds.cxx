@@ -8,6 +8,10 @@ extern "C" {
 #include <boost/filesystem.hpp>
 #include <sys/time.h>
 #include <limits>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <cerrno>
 
 namespace fs = boost::filesystem;
 
@@ -118,6 +122,30 @@ TEST(MemoryFile)
 	compare_tables(oldtable.get(), newtable.get());
 }
 
+TEST(MmapFile)
+{
+	TableSet tables = get_splinetables();
+	boost::shared_ptr<struct splinetable> oldtable = load_splinetable(tables.abs);
+
+	fs::path tmp("photospline-mmap-test.spline");
+	if (fs::exists(tmp))
+		fs::remove(tmp);
+	ENSURE_EQUAL(writesplinemmaptable(tmp.string().c_str(), oldtable.get()), 0, "Table can be written");
+
+	boost::shared_ptr<struct splinetable> newtable(new struct splinetable, splinetable_destructor);
+	ENSURE_EQUAL(readsplinetable(tmp.string().c_str(), newtable.get()), 0, "Table can be read.");
+	ENSURE(newtable->mmap_base != NULL, "Coefficients are mapped from the file");
+
+	compare_tables(oldtable.get(), newtable.get());
+
+	/* Convolution replaces the mapped coefficients with its own */
+	double knots[3] = {-20, 0, 20};
+	ENSURE_EQUAL(splinetable_convolve(newtable.get(), 0, knots, 3), 0);
+	ENSURE(newtable->mmap_base == NULL);
+
+	fs::remove(tmp);
+}
+
 /*
  * Check that analytic convolution works and preserves the monotonicity
  * of the arrival-time CDF.
@@ -331,6 +359,387 @@ TEST(ndssplineeval_vs_ndssplineeval_gradient)
 	}
 }
 
+TEST(ndsplineeval_vs_ndsplineeval_hessian)
+{
+	srand(42);
+	
+	TableSet tables = get_splinetables();
+	boost::shared_ptr<struct splinetable> table = load_splinetable(tables.prob);
+	
+	const int ndim = table->ndim;
+	for (int i=0; i < 1000; i++) {
+		double x[ndim];
+		int centers[ndim];
+		for (int j=0; j < ndim; j++) {
+			double p = double(rand())/double(RAND_MAX);
+			x[j] = table->extents[j][0] + p*(table->extents[j][1]-table->extents[j][0]);
+		}
+		ENSURE_EQUAL(tablesearchcenters(table.get(), x, centers), 0);
+		double value, gradient[ndim], hessian[ndim*ndim];
+		ndsplineeval_hessian(table.get(), x, centers, &value, gradient,
+		    hessian);
+		ENSURE_EQUAL(value, ndsplineeval(table.get(), x, centers, 0),
+		    "ndsplineeval() and ndsplineeval_hessian() yield identical evaluates");
+		for (int j=0; j < ndim; j++) {
+			ENSURE_EQUAL(gradient[j],
+			    ndsplineeval(table.get(), x, centers, 1 << j),
+			    "ndsplineeval() and ndsplineeval_hessian() yield identical derivatives");
+			for (int k=0; k < ndim; k++) {
+				double expected = (j == k) ?
+				    ndsplineeval_deriv2(table.get(), x, centers, 1 << j) :
+				    ndsplineeval(table.get(), x, centers, (1 << j) | (1 << k));
+				ENSURE_EQUAL(hessian[j*ndim + k], expected,
+				    "ndsplineeval_hessian() yields the same second derivatives");
+			}
+		}
+	}
+}
+
+/*
+ * The specialized evaluators sum the tensor product in the same order as
+ * ndsplineeval(), so they must give exactly the same results for every
+ * coefficient layout and storage format.
+ */
+TEST(ndsplineeval_vs_ndsplineeval_select)
+{
+	srand(42);
+
+	for (int ndim=3; ndim <= 6; ndim++) {
+		for (int order=2; order <= 3; order++) {
+			/* Build a random table of the given shape */
+			struct splinetable table;
+			std::vector<int> orders(ndim, order);
+			std::vector<long> nknots(ndim), naxes(ndim);
+			std::vector<unsigned long> strides(ndim);
+			std::vector<std::vector<double> > knotvecs(ndim);
+			std::vector<double*> knots(ndim);
+			size_t ncoeffs = 1;
+
+			memset(&table, 0, sizeof(table));
+			table.ndim = ndim;
+			table.order = &orders[0];
+			for (int j=0; j < ndim; j++) {
+				nknots[j] = 10 + 2*j;
+				naxes[j] = nknots[j] - order - 1;
+				ncoeffs *= naxes[j];
+				// bsplvb_simple() may access up to *order* elements
+				// off either end. Pad accordingly.
+				knotvecs[j].resize(nknots[j] + 2*order, 0.);
+				for (int k=0; k < nknots[j]; k++)
+					knotvecs[j][k+order] = k + 0.5*double(rand())/double(RAND_MAX);
+				knots[j] = &knotvecs[j][order];
+			}
+			strides[ndim-1] = 1;
+			for (int j=ndim-2; j >= 0; j--)
+				strides[j] = strides[j+1]*naxes[j+1];
+			std::vector<float> coefficients(ncoeffs);
+			for (size_t i=0; i < ncoeffs; i++)
+				coefficients[i] = double(rand())/double(RAND_MAX);
+			table.knots = &knots[0];
+			table.nknots = &nknots[0];
+			table.naxes = &naxes[0];
+			table.strides = &strides[0];
+			table.coefficients = &coefficients[0];
+
+			ndsplineeval_func eval = ndsplineeval_select(&table);
+			ENSURE(eval != &ndsplineeval, "Common table shapes have "
+			    "a specialized evaluator");
+
+			/* A copy in the blocked layout */
+			struct splinetable blocked = table;
+			blocked.coefficients = (float*)malloc(ncoeffs*sizeof(float));
+			std::copy(coefficients.begin(), coefficients.end(), blocked.coefficients);
+			ENSURE_EQUAL(splinetable_block(&blocked, order+1), 0);
+			ndsplineeval_func blocked_eval = ndsplineeval_select(&blocked);
+			ENSURE(blocked_eval != &ndsplineeval && blocked_eval != eval,
+			    "Blocked tables have their own specialized evaluator");
+
+			/* And copies stored in 16 bits */
+			const splinetable_precision precisions[] =
+			    { SPLINETABLE_FLOAT16, SPLINETABLE_BFLOAT16, SPLINETABLE_INT16 };
+			const unsigned npacked = sizeof(precisions)/sizeof(precisions[0]);
+			struct splinetable packed[npacked];
+			ndsplineeval_func packed_eval[npacked];
+			for (unsigned p=0; p < npacked; p++) {
+				packed[p] = table;
+				packed[p].coefficients = (float*)malloc(ncoeffs*sizeof(float));
+				std::copy(coefficients.begin(), coefficients.end(),
+				    packed[p].coefficients);
+				ENSURE_EQUAL(splinetable_pack(&packed[p], precisions[p]), 0);
+				packed_eval[p] = ndsplineeval_select(&packed[p]);
+				ENSURE(packed_eval[p] != &ndsplineeval,
+				    "Packed tables have a specialized evaluator");
+			}
+
+			for (int i=0; i < 200; i++) {
+				double x[ndim];
+				int centers[ndim];
+				for (int j=0; j < ndim; j++)
+					x[j] = knots[j][0] + (knots[j][nknots[j]-1] - knots[j][0])*
+					    double(rand())/double(RAND_MAX);
+				if (tablesearchcenters(&table, x, centers) != 0)
+					continue;
+				double ref = ndsplineeval(&table, x, centers, 0);
+				ENSURE_EQUAL(eval(&table, x, centers, 0), ref,
+				    "Specialized evaluates are identical");
+				ENSURE_EQUAL(ndsplineeval(&blocked, x, centers, 0), ref,
+				    "Blocked layout yields identical evaluates");
+				ENSURE_EQUAL(blocked_eval(&blocked, x, centers, 0), ref,
+				    "Blocked layout yields identical specialized evaluates");
+				for (unsigned p=0; p < npacked; p++)
+					ENSURE_EQUAL(packed_eval[p](&packed[p], x, centers, 0),
+					    ndsplineeval(&packed[p], x, centers, 0),
+					    "Packed tables yield identical specialized evaluates");
+				for (int j=0; j < ndim; j++) {
+					ref = ndsplineeval(&table, x, centers, 1 << j);
+					ENSURE_EQUAL(eval(&table, x, centers, 1 << j), ref,
+					    "Specialized derivatives are identical");
+					ENSURE_EQUAL(blocked_eval(&blocked, x, centers, 1 << j),
+					    ndsplineeval(&blocked, x, centers, 1 << j),
+					    "Blocked specialized derivatives are identical");
+				}
+			}
+
+			splinetable_free_coefficients(&blocked);
+			free(blocked.blockstrides);
+			for (unsigned p=0; p < npacked; p++)
+				splinetable_free_coefficients(&packed[p]);
+		}
+	}
+
+	/* Mixed orders fall back to the generic evaluator */
+	TableSet tables = get_splinetables();
+	boost::shared_ptr<struct splinetable> table = load_splinetable(tables.prob);
+	bool uniform = true;
+	for (int j=1; j < table->ndim; j++)
+		uniform &= (table->order[j] == table->order[0]);
+	if (!uniform)
+		ENSURE(ndsplineeval_select(table.get()) == &ndsplineeval);
+}
+
+TEST(ndsplineeval_vs_ndsplineeval_batch)
+{
+	srand(42);
+
+	TableSet tables = get_splinetables();
+	boost::shared_ptr<struct splinetable> table = load_splinetable(tables.prob);
+
+	const int ndim = table->ndim;
+	const size_t npts = 1001;
+	std::vector<double> x(npts*ndim);
+	std::vector<int> centers(npts*ndim);
+	std::vector<double> results(npts);
+
+	/*
+	 * Sample a bit beyond the support so that some points fall
+	 * outside the table, and repeat every other point with a small
+	 * offset so that neighbors often share a knot span.
+	 */
+	for (size_t i=0; i < npts; i++) {
+		for (int j=0; j < ndim; j++) {
+			double p = 1.2*double(rand())/double(RAND_MAX) - 0.1;
+			double low = table->extents[j][0], high = table->extents[j][1];
+			x[i*ndim+j] = (i % 2 == 1) ? x[(i-1)*ndim+j] + 1e-3*(high-low) :
+			    low + p*(high-low);
+		}
+	}
+
+	for (int deriv=-1; deriv < ndim; deriv++) {
+		int derivatives = (deriv < 0) ? 0 : (1 << deriv);
+		int noutside = tablesearchcenters_batch(table.get(), npts,
+		    &x[0], &centers[0]);
+		ndsplineeval_batch(table.get(), npts, &x[0], &centers[0],
+		    derivatives, &results[0]);
+
+		int nscalar = 0;
+		for (size_t i=0; i < npts; i++) {
+			int scalar_centers[ndim];
+			if (tablesearchcenters(table.get(), &x[i*ndim], scalar_centers) != 0) {
+				nscalar++;
+				ENSURE_EQUAL(centers[i*ndim], -1,
+				    "Points outside the table are flagged");
+				continue;
+			}
+			for (int j=0; j < ndim; j++)
+				ENSURE_EQUAL(centers[i*ndim+j], scalar_centers[j],
+				    "Batched center search finds the same centers");
+			ENSURE_EQUAL(results[i], ndsplineeval(table.get(), &x[i*ndim],
+			    scalar_centers, derivatives),
+			    "ndsplineeval() and ndsplineeval_batch() yield identical evaluates");
+		}
+		ENSURE_EQUAL(noutside, nscalar, "Same number of points outside the table");
+		ENSURE(noutside > 0);
+	}
+}
+
+/*
+ * The blocked coefficient layout only changes where the coefficients are
+ * stored, so every evaluator must give bit-identical results, and the
+ * table must survive the round trip through every file format.
+ */
+TEST(BlockedLayout)
+{
+	srand(42);
+
+	TableSet tables = get_splinetables();
+	boost::shared_ptr<struct splinetable> table = load_splinetable(tables.prob);
+	boost::shared_ptr<struct splinetable> blocked = load_splinetable(tables.prob);
+	ENSURE_EQUAL(splinetable_block(blocked.get(), 4), 0);
+	ENSURE_EQUAL(blocked->blocksize, 4);
+	ENSURE(splinetable_ncoefficients(blocked.get()) >=
+	    splinetable_ncoefficients(table.get()), "Blocks are padded");
+
+	const int ndim = table->ndim;
+	const size_t npts = 1000;
+	std::vector<double> x(npts*ndim);
+	std::vector<int> centers(npts*ndim);
+	std::vector<double> results(npts);
+	for (size_t i=0; i < npts; i++)
+		for (int j=0; j < ndim; j++)
+			x[i*ndim+j] = table->extents[j][0] + (table->extents[j][1] -
+			    table->extents[j][0])*double(rand())/double(RAND_MAX);
+	ENSURE_EQUAL(tablesearchcenters_batch(table.get(), npts, &x[0], &centers[0]), 0);
+
+	ndsplineeval_batch(blocked.get(), npts, &x[0], &centers[0], 0, &results[0]);
+	for (size_t i=0; i < npts; i++) {
+		const double *xi = &x[i*ndim];
+		const int *ci = &centers[i*ndim];
+		double ref = ndsplineeval(table.get(), xi, ci, 0);
+		ENSURE_EQUAL(ndsplineeval(blocked.get(), xi, ci, 0), ref,
+		    "ndsplineeval() yields identical evaluates");
+		ENSURE_EQUAL(results[i], ref,
+		    "ndsplineeval_batch() yields identical evaluates");
+		ENSURE_EQUAL(ndsplineeval_deriv2(blocked.get(), xi, ci, 1),
+		    ndsplineeval_deriv2(table.get(), xi, ci, 1),
+		    "ndsplineeval_deriv2() yields identical evaluates");
+
+		double gradient[ndim+1], blocked_gradient[ndim+1];
+		ndsplineeval_gradient(table.get(), xi, ci, gradient);
+		ndsplineeval_gradient(blocked.get(), xi, ci, blocked_gradient);
+		for (int j=0; j < ndim+1; j++)
+			ENSURE_EQUAL(blocked_gradient[j], gradient[j],
+			    "ndsplineeval_gradient() yields identical evaluates");
+	}
+
+	/* FITS files are written in row-major order */
+	struct splinetable_buffer buf;
+	buf.mem_alloc = &malloc;
+	buf.mem_realloc = &realloc;
+	ENSURE_EQUAL(writesplinefitstable_mem(&buf, blocked.get()), 0, "Table can be written");
+	boost::shared_ptr<struct splinetable> fitstable(new struct splinetable, splinetable_destructor);
+	ENSURE_EQUAL(readsplinefitstable_mem(&buf, fitstable.get()), 0, "Table can be read.");
+	free(buf.data);
+	compare_tables(table.get(), fitstable.get());
+
+	/* Native files keep the blocked layout */
+	fs::path tmp("photospline-blocked-test.spline");
+	if (fs::exists(tmp))
+		fs::remove(tmp);
+	ENSURE_EQUAL(writesplinemmaptable(tmp.string().c_str(), blocked.get()), 0, "Table can be written");
+	boost::shared_ptr<struct splinetable> mapped(new struct splinetable, splinetable_destructor);
+	ENSURE_EQUAL(readsplinetable(tmp.string().c_str(), mapped.get()), 0, "Table can be read.");
+	ENSURE_EQUAL(mapped->blocksize, 4);
+	for (size_t i=0; i < npts; i++)
+		ENSURE_EQUAL(ndsplineeval(mapped.get(), &x[i*ndim], &centers[i*ndim], 0),
+		    ndsplineeval(table.get(), &x[i*ndim], &centers[i*ndim], 0),
+		    "Mapped blocked table yields identical evaluates");
+	fs::remove(tmp);
+
+	/* Unblocking restores the original array */
+	ENSURE_EQUAL(splinetable_unblock(mapped.get()), 0);
+	ENSURE(mapped->mmap_base == NULL);
+	compare_tables(table.get(), mapped.get());
+}
+
+TEST(PackedCoefficients)
+{
+	srand(42);
+
+	TableSet tables = get_splinetables();
+	boost::shared_ptr<struct splinetable> table = load_splinetable(tables.prob);
+	ENSURE_EQUAL(splinetable_block(table.get(), 4), 0);
+	ENSURE_EQUAL(splinetable_pack(table.get(), SPLINETABLE_INT16), EINVAL,
+	    "Blocked tables can't be packed");
+	ENSURE_EQUAL(splinetable_unblock(table.get()), 0);
+
+	const int ndim = table->ndim;
+	const size_t npts = 1000;
+	const size_t ncoeffs = splinetable_ncoefficients(table.get());
+	std::vector<double> x(npts*ndim);
+	std::vector<int> centers(npts*ndim);
+	for (size_t i=0; i < npts; i++)
+		for (int j=0; j < ndim; j++)
+			x[i*ndim+j] = table->extents[j][0] + (table->extents[j][1] -
+			    table->extents[j][0])*double(rand())/double(RAND_MAX);
+	ENSURE_EQUAL(tablesearchcenters_batch(table.get(), npts, &x[0], &centers[0]), 0);
+
+	const splinetable_precision precisions[] =
+	    { SPLINETABLE_FLOAT16, SPLINETABLE_BFLOAT16, SPLINETABLE_INT16 };
+	for (unsigned p=0; p < sizeof(precisions)/sizeof(precisions[0]); p++) {
+		boost::shared_ptr<struct splinetable> packed = load_splinetable(tables.prob);
+		ENSURE_EQUAL(splinetable_pack(packed.get(), precisions[p]), 0);
+		ENSURE_EQUAL(packed->precision, precisions[p]);
+		ENSURE(packed->coefficients == NULL);
+
+		/*
+		 * The evaluators must give exactly what they give on a float
+		 * table holding the decoded coefficients.
+		 */
+		boost::shared_ptr<struct splinetable> decoded = load_splinetable(tables.prob);
+		splinetable_coefficients_rowmajor(packed.get(), decoded->coefficients);
+		for (size_t i=0; i < ncoeffs; i++) {
+			float c = table->coefficients[i], d = decoded->coefficients[i];
+			float tol = (precisions[p] == SPLINETABLE_INT16) ?
+			    packed->scales[i/SPLINETABLE_QBLOCK] :
+			    (precisions[p] == SPLINETABLE_FLOAT16) ?
+			    std::max(std::fabs(c)*9.8e-4f, 6e-8f) : std::fabs(c)*7.9e-3f;
+			ENSURE(std::fabs(c - d) <= tol, "Coefficients are rounded");
+		}
+
+		ndsplineeval_func select = ndsplineeval_select(packed.get());
+		for (size_t i=0; i < npts; i++) {
+			const double *xi = &x[i*ndim];
+			const int *ci = &centers[i*ndim];
+			double ref = ndsplineeval(decoded.get(), xi, ci, 0);
+			ENSURE_EQUAL(ndsplineeval(packed.get(), xi, ci, 0), ref,
+			    "ndsplineeval() yields identical evaluates");
+			ENSURE_EQUAL(select(packed.get(), xi, ci, 0), ref,
+			    "ndsplineeval_select() yields identical evaluates");
+			ENSURE_EQUAL(ndsplineeval_deriv2(packed.get(), xi, ci, 1),
+			    ndsplineeval_deriv2(decoded.get(), xi, ci, 1),
+			    "ndsplineeval_deriv2() yields identical evaluates");
+		}
+
+		/* Native files keep the packed coefficients */
+		fs::path tmp("photospline-packed-test.spline");
+		if (fs::exists(tmp))
+			fs::remove(tmp);
+		ENSURE_EQUAL(writesplinemmaptable(tmp.string().c_str(), packed.get()), 0, "Table can be written");
+		boost::shared_ptr<struct splinetable> mapped(new struct splinetable, splinetable_destructor);
+		ENSURE_EQUAL(readsplinetable(tmp.string().c_str(), mapped.get()), 0, "Table can be read.");
+		ENSURE_EQUAL(mapped->precision, precisions[p]);
+		for (size_t i=0; i < npts; i++)
+			ENSURE_EQUAL(ndsplineeval(mapped.get(), &x[i*ndim], &centers[i*ndim], 0),
+			    ndsplineeval(decoded.get(), &x[i*ndim], &centers[i*ndim], 0),
+			    "Mapped packed table yields identical evaluates");
+		fs::remove(tmp);
+
+		/* FITS files and unpacking give the decoded coefficients */
+		struct splinetable_buffer buf;
+		buf.mem_alloc = &malloc;
+		buf.mem_realloc = &realloc;
+		ENSURE_EQUAL(writesplinefitstable_mem(&buf, packed.get()), 0, "Table can be written");
+		boost::shared_ptr<struct splinetable> fitstable(new struct splinetable, splinetable_destructor);
+		ENSURE_EQUAL(readsplinefitstable_mem(&buf, fitstable.get()), 0, "Table can be read.");
+		free(buf.data);
+		compare_tables(decoded.get(), fitstable.get());
+
+		ENSURE_EQUAL(splinetable_unpack(mapped.get()), 0);
+		ENSURE(mapped->mmap_base == NULL);
+		compare_tables(decoded.get(), mapped.get());
+	}
+}
+
 /*
  * bsplvb_simple() can be made to return sensical values anywhere
  * in the knot field.
@@ -0,0 +1,198 @@
+/*
+ * benchsplinefits: time the different ways of evaluating a spline table
+ *   (generic ndsplineeval(), the shape-specialized evaluator chosen by
+ *   ndsplineeval_select(), and ndsplineeval_batch()) at random points
+ *   inside the table's extents, e.g.
+ *
+ *   benchsplinefits ems_mie_z20_a10.abs.fits ZeroLengthMieMuons_250_z20_a10.abs.fits
+ *
+ *   With -b, the evaluators are timed again after converting the table to
+ *   the blocked coefficient layout with the given block size. The points
+ *   are visited in random order, so for tables much larger than the cache
+ *   the difference is mostly in cache misses, which can be counted with
+ *   e.g. perf stat -e cache-misses. Likewise, -p times the evaluators with
+ *   the coefficients stored in 16 bits (float16, bfloat16 or int16).
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <sys/time.h>
+
+#include <photospline/splinetable.h>
+#include <photospline/bspline.h>
+
+static void usage() {
+	fprintf(stderr,"benchsplinefits [-n samples] [-b blocksize | "
+	    "-p float16|bfloat16|int16] <path> [<path> ...]\n");
+	exit(1);
+}
+
+static double
+elapsed(struct timeval *tp1, struct timeval *tp2)
+{
+	return (tp2->tv_sec - tp1->tv_sec) + 1e-6*(tp2->tv_usec - tp1->tv_usec);
+}
+
+static double
+timeeval(const struct splinetable *table, ndsplineeval_func eval, int npts,
+    const double *x, const int *centers, double *results)
+{
+	struct timeval tp1, tp2;
+	int i;
+
+	gettimeofday(&tp1, NULL);
+	for (i = 0; i < npts; i++)
+		results[i] = eval(table, &x[i*table->ndim],
+		    &centers[i*table->ndim], 0);
+	gettimeofday(&tp2, NULL);
+
+	return (elapsed(&tp1, &tp2));
+}
+
+static double
+maxdeviation(const double *a, const double *b, int npts)
+{
+	double maxdev = 0;
+	int i;
+
+	for (i = 0; i < npts; i++)
+		if (fabs(a[i] - b[i]) > maxdev)
+			maxdev = fabs(a[i] - b[i]);
+
+	return (maxdev);
+}
+
+static int
+bench(const char *path, int samples, int blocksize,
+    splinetable_precision precision)
+{
+	struct splinetable table;
+	struct timeval tp1, tp2;
+	ndsplineeval_func eval;
+	double *x, *generic, *results, maxdev, sum;
+	double t_generic, t_special, t_batch, t_converted;
+	int *centers;
+	int i, j, ndim, npts, err = 0;
+
+	if (readsplinetable(path, &table) != 0) {
+		fprintf(stderr, "Couldn't read spline table %s\n", path);
+		return (-1);
+	}
+	ndim = table.ndim;
+	eval = ndsplineeval_select(&table);
+
+	printf("%s\n", path);
+	printf("  NDim: %d Order:", ndim);
+	for (j = 0; j < ndim; j++)
+		printf(" %d", table.order[j]);
+	printf(" (%s evaluator)\n", eval == &ndsplineeval ?
+	    "generic" : "specialized");
+
+	x = malloc(samples*ndim*sizeof(double));
+	centers = malloc(samples*ndim*sizeof(int));
+	generic = malloc(samples*sizeof(double));
+	results = malloc(samples*sizeof(double));
+
+	/* Draw points inside the region of full support */
+	srand(42);
+	for (i = 0, npts = 0; i < samples; i++) {
+		for (j = 0; j < ndim; j++)
+			x[npts*ndim + j] = table.extents[j][0] +
+			    (table.extents[j][1] - table.extents[j][0])*
+			    ((double)rand()/(double)RAND_MAX);
+		if (tablesearchcenters(&table, &x[npts*ndim],
+		    &centers[npts*ndim]) == 0)
+			npts++;
+	}
+
+	t_generic = timeeval(&table, &ndsplineeval, npts, x, centers, generic);
+	t_special = timeeval(&table, eval, npts, x, centers, results);
+	maxdev = maxdeviation(results, generic, npts);
+	for (i = 0, sum = 0; i < npts; i++)
+		sum += fabs(generic[i]);
+
+	gettimeofday(&tp1, NULL);
+	tablesearchcenters_batch(&table, npts, x, centers);
+	ndsplineeval_batch(&table, npts, x, centers, 0, results);
+	gettimeofday(&tp2, NULL);
+	t_batch = elapsed(&tp1, &tp2);
+
+	printf("  %d points\n", npts);
+	printf("  ndsplineeval:        %8.3f microseconds/point\n",
+	    1e6*t_generic/npts);
+	printf("  ndsplineeval_select: %8.3f microseconds/point "
+	    "(%.2fx, max deviation %.2e of mean |value| %.2e)\n",
+	    1e6*t_special/npts, t_generic/t_special, maxdev, sum/npts);
+	printf("  ndsplineeval_batch:  %8.3f microseconds/point "
+	    "(%.2fx, including center search)\n",
+	    1e6*t_batch/npts, t_generic/t_batch);
+
+	if (blocksize > 0)
+		err = splinetable_block(&table, blocksize);
+	else if (precision != SPLINETABLE_FLOAT32)
+		err = splinetable_pack(&table, precision);
+	if (err) {
+		fprintf(stderr, "Couldn't convert spline table %s: %s\n", path,
+		    strerror(err));
+	} else if (blocksize > 0 || precision != SPLINETABLE_FLOAT32) {
+		eval = ndsplineeval_select(&table);
+		if (blocksize > 0)
+			printf("  blocked layout (block size %d, %.1f%% "
+			    "padding)\n", blocksize,
+			    100.*((double)splinetable_ncoefficients(&table)/
+			    (table.strides[0]*table.naxes[0]) - 1));
+		else
+			printf("  16-bit coefficients\n");
+		t_converted = timeeval(&table, &ndsplineeval, npts, x, centers,
+		    results);
+		printf("  ndsplineeval:        %8.3f microseconds/point "
+		    "(%.2fx, max deviation %.2e)\n", 1e6*t_converted/npts,
+		    t_generic/t_converted, maxdeviation(results, generic, npts));
+		t_converted = timeeval(&table, eval, npts, x, centers, results);
+		printf("  ndsplineeval_select: %8.3f microseconds/point "
+		    "(%.2fx, max deviation %.2e)\n", 1e6*t_converted/npts,
+		    t_generic/t_converted, maxdeviation(results, generic, npts));
+	}
+
+	free(x);
+	free(centers);
+	free(generic);
+	free(results);
+	splinetable_free(&table);
+
+	return (0);
+}
+
+int main(int argc, char **argv) {
+	int i, samples = 100000, blocksize = 0, err = 0;
+	splinetable_precision precision = SPLINETABLE_FLOAT32;
+
+	for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+		if (strcmp(argv[i], "-n") == 0 && i+1 < argc)
+			samples = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-b") == 0 && i+1 < argc)
+			blocksize = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-p") == 0 && i+1 < argc) {
+			i++;
+			if (strcmp(argv[i], "float16") == 0)
+				precision = SPLINETABLE_FLOAT16;
+			else if (strcmp(argv[i], "bfloat16") == 0)
+				precision = SPLINETABLE_BFLOAT16;
+			else if (strcmp(argv[i], "int16") == 0)
+				precision = SPLINETABLE_INT16;
+			else
+				usage();
+		} else
+			usage();
+	}
+	if (i == argc || samples <= 0 || blocksize < 0 ||
+	    (blocksize > 0 && precision != SPLINETABLE_FLOAT32))
+		usage();
+
+	for ( ; i < argc; i++)
+		err |= bench(argv[i], samples, blocksize, precision);
+
+	return (err ? 1 : 0);
+}
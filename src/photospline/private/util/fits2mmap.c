@@ -0,0 +1,175 @@
+/*
+ * fits2mmap: convert a FITS spline table to the native binary layout that
+ *   readsplinemmaptable() maps into memory, and check that the result reads
+ *   back identically. With -b, the coefficients are stored in the blocked
+ *   layout (see splinetable_block()) with the given block size, which
+ *   should be the spline order + 1. With -p, they are stored in 16 bits
+ *   (float16, bfloat16 or int16, see splinetable_pack()), and the deviation
+ *   from the full-precision table is reported, both for the coefficients
+ *   and for the spline surface at -n random points inside the extents.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <photospline/splinetable.h>
+#include <photospline/bspline.h>
+
+static void usage() {
+	fprintf(stderr,"fits2mmap [-b blocksize | -p float16|bfloat16|int16] "
+	    "[-n samples] <input.fits> <output>\n");
+	exit(1);
+}
+
+static void
+deviation(const struct splinetable *full, const struct splinetable *packed,
+    int samples)
+{
+	double x[full->ndim];
+	int centers[full->ndim];
+	double dev, maxdev, sumdev2, sum2;
+	float *coefficients;
+	size_t i, ncoeffs;
+	int j, npts;
+
+	ncoeffs = splinetable_ncoefficients(full);
+	coefficients = malloc(ncoeffs*sizeof(float));
+	splinetable_coefficients_rowmajor(packed, coefficients);
+	for (i = 0, maxdev = sumdev2 = sum2 = 0; i < ncoeffs; i++) {
+		dev = fabs(coefficients[i] - full->coefficients[i]);
+		if (dev > maxdev)
+			maxdev = dev;
+		sumdev2 += dev*dev;
+		sum2 += full->coefficients[i]*full->coefficients[i];
+	}
+	free(coefficients);
+	printf("Coefficients: max deviation %.3e, RMS deviation %.3e "
+	    "(RMS coefficient %.3e)\n", maxdev, sqrt(sumdev2/ncoeffs),
+	    sqrt(sum2/ncoeffs));
+
+	srand(42);
+	for (i = 0, npts = 0, maxdev = sumdev2 = sum2 = 0; i < samples; i++) {
+		double value;
+
+		for (j = 0; j < full->ndim; j++)
+			x[j] = full->extents[j][0] + (full->extents[j][1] -
+			    full->extents[j][0])*((double)rand()/(double)RAND_MAX);
+		if (tablesearchcenters(full, x, centers) != 0)
+			continue;
+		value = ndsplineeval(full, x, centers, 0);
+		dev = fabs(ndsplineeval(packed, x, centers, 0) - value);
+		if (dev > maxdev)
+			maxdev = dev;
+		sumdev2 += dev*dev;
+		sum2 += value*value;
+		npts++;
+	}
+	if (npts > 0)
+		printf("Surface (%d points): max deviation %.3e, RMS deviation "
+		    "%.3e (RMS value %.3e)\n", npts, maxdev,
+		    sqrt(sumdev2/npts), sqrt(sum2/npts));
+}
+
+int main(int argc, char **argv) {
+	struct splinetable table, full, mapped;
+	const char *input, *output;
+	float *original, *readback;
+	size_t i, ncoeffs;
+	int j, err, blocksize = 0, samples = 100000;
+	splinetable_precision precision = SPLINETABLE_FLOAT32;
+
+	for (j = 1; j < argc && argv[j][0] == '-'; j++) {
+		if (strcmp(argv[j], "-b") == 0 && j+1 < argc)
+			blocksize = atoi(argv[++j]);
+		else if (strcmp(argv[j], "-n") == 0 && j+1 < argc)
+			samples = atoi(argv[++j]);
+		else if (strcmp(argv[j], "-p") == 0 && j+1 < argc) {
+			j++;
+			if (strcmp(argv[j], "float16") == 0)
+				precision = SPLINETABLE_FLOAT16;
+			else if (strcmp(argv[j], "bfloat16") == 0)
+				precision = SPLINETABLE_BFLOAT16;
+			else if (strcmp(argv[j], "int16") == 0)
+				precision = SPLINETABLE_INT16;
+			else
+				usage();
+		} else
+			usage();
+	}
+	if (argc - j != 2 || blocksize < 0 || samples < 0 ||
+	    (blocksize > 0 && precision != SPLINETABLE_FLOAT32))
+		usage();
+	input = argv[j];
+	output = argv[j+1];
+
+	if ((err = readsplinefitstable(input, &table)) != 0) {
+		fprintf(stderr, "Couldn't read spline table %s\n", input);
+		return (1);
+	}
+
+	if (blocksize > 0 && (err = splinetable_block(&table, blocksize)) != 0) {
+		fprintf(stderr, "Couldn't block %s: %s\n", input,
+		    strerror(err));
+		splinetable_free(&table);
+		return (1);
+	}
+
+	if (precision != SPLINETABLE_FLOAT32) {
+		if ((err = readsplinefitstable(input, &full)) != 0 ||
+		    (err = splinetable_pack(&table, precision)) != 0) {
+			fprintf(stderr, "Couldn't pack %s: %s\n", input,
+			    strerror(err));
+			splinetable_free(&table);
+			return (1);
+		}
+		deviation(&full, &table, samples);
+		splinetable_free(&full);
+	}
+
+	if ((err = writesplinemmaptable(output, &table)) != 0) {
+		fprintf(stderr, "Couldn't write %s: %s\n", output,
+		    strerror(err));
+		splinetable_free(&table);
+		return (1);
+	}
+
+	if ((err = readsplinemmaptable(output, &mapped)) != 0) {
+		fprintf(stderr, "Couldn't read back %s: %s\n", output,
+		    strerror(err));
+		splinetable_free(&table);
+		return (1);
+	}
+
+	err = (mapped.ndim != table.ndim || mapped.naux != table.naux ||
+	    mapped.blocksize != table.blocksize ||
+	    mapped.precision != table.precision);
+	for (j = 0; j < table.ndim && !err; j++) {
+		err |= (mapped.order[j] != table.order[j]);
+		err |= (mapped.naxes[j] != table.naxes[j]);
+		err |= (mapped.nknots[j] != table.nknots[j]);
+		err |= (memcmp(mapped.knots[j], table.knots[j],
+		    table.nknots[j]*sizeof(double)) != 0);
+	}
+	if (!err) {
+		ncoeffs = table.strides[0]*table.naxes[0];
+		original = malloc(ncoeffs*sizeof(float));
+		readback = malloc(ncoeffs*sizeof(float));
+		splinetable_coefficients_rowmajor(&table, original);
+		splinetable_coefficients_rowmajor(&mapped, readback);
+		for (i = 0; i < ncoeffs && !err; i++)
+			err |= (readback[i] != original[i]);
+		free(original);
+		free(readback);
+	}
+	if (err)
+		fprintf(stderr, "%s does not match %s!\n", output, input);
+	else
+		printf("Wrote %s (%.1f MB)\n", output, mapped.mmap_size/1e6);
+
+	splinetable_free(&mapped);
+	splinetable_free(&table);
+
+	return (err ? 1 : 0);
+}
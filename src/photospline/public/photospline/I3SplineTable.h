@@ -4,13 +4,18 @@
 
 #include <string>
 #include <photospline/splinetable.h>
+#include <photospline/bspline.h>
 
 class I3SplineTable {
 public:
 	/**
 	 * @param[in] path Path to a FITS file
+	 * @param[in] blocksize If non-zero, rearrange the coefficients into
+	 *                      blocks of this size for faster evaluation of
+	 *                      large tables (see splinetable_block()). The
+	 *                      spline order + 1 is a good choice.
 	 */ 
-	I3SplineTable(const std::string &path);
+	I3SplineTable(const std::string &path, int blocksize=0);
 	virtual ~I3SplineTable();
 
 	/** Evaluate the spline surface
@@ -29,6 +34,22 @@ public:
 	int Eval(double *x, double *result, int derivatives=0) const;
 	int EvalDeriv2(double *x, double *result, int derivatives=0) const;
 
+	/** Evaluate the spline surface at many points at once
+	 *
+	 * This gives the same results as calling Eval() on each point,
+	 * but is considerably faster for large numbers of points.
+	 *
+	 * @param[in]       x npts N-dimensional coordinates, stored one
+	                      point after the other
+	 * @param[out] results Values of the spline surface at each point,
+	                       or NaN for points outside the table
+	 * @param[in]    npts Number of points
+	 * @param[in] derivatives As for Eval()
+	 * @returns 0 if all points were inside the table, EINVAL otherwise
+	 */
+	int EvalBatch(const double *x, double *results, size_t npts,
+	    int derivatives=0) const;
+
 	/** Get the number of dimensions */
 	unsigned GetNDim() const { return table_.ndim; };
 	/** Get the extent of full support in dimension dim */
@@ -41,6 +62,7 @@ private:
 	
 	struct splinetable table_;
 	double bias_;
+	ndsplineeval_func eval_;
 };
 
 #endif
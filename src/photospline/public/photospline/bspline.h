@@ -1,6 +1,8 @@
 #ifndef _BSPLINE_H
 #define _BSPLINE_H
 
+#include <string.h>
+
 #include "splinetable.h"
 
 #ifdef __cplusplus
@@ -65,19 +67,113 @@ double splineeval(const double *knots, const double *weights, int nknots, double
 
 int tablesearchcenters(const struct splinetable *table, const double *x, int *centers);
 
+/*
+ * For tables in the blocked layout (see splinetable_block()), fill
+ * offsets[n*maxdegree + k] with the position of coefficient
+ * centers[n] - order[n] + k along axis n, such that the coefficient at a
+ * corner of the evaluation stencil is at the sum of its axes' offsets.
+ */
+
+void tableblockoffsets(const struct splinetable *table, const int *centers,
+    int maxdegree, unsigned long *offsets);
+
+/*
+ * The n coefficients starting at pos in a row-major table, as floats:
+ * a pointer into the table if it is stored in single precision, otherwise
+ * the coefficients decoded into buf (see splinetable_pack()).
+ */
+
+static inline const float *
+tablecoefficients(const struct splinetable *table, unsigned long pos, int n,
+    float *buf)
+{
+	unsigned int bits;
+	int i;
+
+	switch (table->precision) {
+	case SPLINETABLE_FLOAT16:
+		/*
+		 * Move sign, exponent and mantissa into place and rebias the
+		 * exponent from 15 to 127 by multiplying with 2^112. This
+		 * also gets subnormals right.
+		 */
+		for (i = 0; i < n; i++) {
+			bits = ((unsigned int)(table->packed[pos+i] & 0x8000) << 16)
+			    | ((unsigned int)(table->packed[pos+i] & 0x7fff) << 13);
+			memcpy(&buf[i], &bits, sizeof(float));
+			buf[i] *= 5.192296858534828e33f;
+		}
+		return buf;
+	case SPLINETABLE_BFLOAT16:
+		for (i = 0; i < n; i++) {
+			bits = (unsigned int)table->packed[pos+i] << 16;
+			memcpy(&buf[i], &bits, sizeof(float));
+		}
+		return buf;
+	case SPLINETABLE_INT16:
+		for (i = 0; i < n; i++)
+			buf[i] = ((const short *)table->packed)[pos+i]*
+			    table->scales[(pos+i)/SPLINETABLE_QBLOCK];
+		return buf;
+	default:
+		return table->coefficients + pos;
+	}
+}
+
 double ndsplineeval(const struct splinetable *table, const double *x, 
     const int *centers, int derivatives);
 double ndsplineeval_linalg(const struct splinetable *table, const double *x, 
     const int *centers, int derivatives);
 
-double ndsplineeval_deriv2(const struct splinetable *table, const double *x, 
+double ndsplineeval_deriv2(const struct splinetable *table, const double *x,
     const int *centers, int derivatives);
 
+/*
+ * ndsplineeval_select() returns a version of ndsplineeval() compiled
+ * specifically for the number of dimensions and spline order of the given
+ * table, or ndsplineeval() itself if there is none for this shape. The
+ * specialized versions give exactly the same results as ndsplineeval().
+ * Choose once after loading a table, and again if its order or coefficient
+ * layout changes (e.g. after splinetable_convolve() or splinetable_block()).
+ */
+
+typedef double (*ndsplineeval_func)(const struct splinetable *table,
+    const double *x, const int *centers, int derivatives);
+
+ndsplineeval_func ndsplineeval_select(const struct splinetable *table);
+
+/*
+ * Batched versions of tablesearchcenters() and ndsplineeval() for npts
+ * points at once. Coordinates and centers are stored point by point, i.e.
+ * x[i*ndim + n] is coordinate n of point i.
+ *
+ * tablesearchcenters_batch() returns the number of points outside the
+ * table, and marks each of them by setting its first center to -1.
+ * ndsplineeval_batch() writes the value for point i to results[i], leaving
+ * the entries of points marked as outside untouched. Its results are
+ * identical to calling ndsplineeval() point by point, but several points
+ * are evaluated at once using the vector unit.
+ */
+
+int tablesearchcenters_batch(const struct splinetable *table, size_t npts,
+    const double *x, int *centers);
+void ndsplineeval_batch(const struct splinetable *table, size_t npts,
+    const double *x, const int *centers, int derivatives, double *results);
+
 /* Evaluate a spline surface and all its derivatives at x */
 
 void ndsplineeval_gradient(const struct splinetable *table, const double *x,
     const int *centers, double *evaluates);
 
+/*
+ * Evaluate a spline surface, its gradient and its Hessian at x, sharing the
+ * bases and the walk over the coefficients. hessian is ndim x ndim, row
+ * major, and comes out symmetric.
+ */
+
+void ndsplineeval_hessian(const struct splinetable *table, const double *x,
+    const int *centers, double *value, double *gradient, double *hessian);
+
 /*
  * Convolve a table with the spline defined on a set of knots along a given 
  * dimension and store the spline expansion of the convolved surface in the
@@ -24,6 +24,33 @@ struct splinetable {
 
 	int naux;
 	char ***aux;
+
+	/*
+	 * If blocksize is 0, the coefficients are in row-major order with
+	 * the above strides. Otherwise they are grouped into blocks of
+	 * blocksize^ndim (see splinetable_block()), and blockstrides holds
+	 * the distance between neighboring blocks along each dimension.
+	 */
+	int blocksize;
+	unsigned long *blockstrides;
+
+	/*
+	 * Storage precision of the coefficients (see splinetable_pack()).
+	 * Unless it is SPLINETABLE_FLOAT32, coefficients is NULL and packed
+	 * holds a 16-bit word per coefficient. For SPLINETABLE_INT16,
+	 * coefficient i is packed[i] as a signed integer times
+	 * scales[i/SPLINETABLE_QBLOCK].
+	 */
+	int precision;
+	unsigned short *packed;
+	float *scales;
+
+	/*
+	 * The file mapping holding the coefficients for tables read with
+	 * readsplinemmaptable(), NULL if they were allocated with malloc().
+	 */
+	void *mmap_base;
+	size_t mmap_size;
 };
 
 struct splinetable_buffer {
@@ -38,13 +65,66 @@ typedef enum {
 	SPLINETABLE_DOUBLE
 } splinetable_dtype;
 
+typedef enum {
+	SPLINETABLE_FLOAT32 = 0,
+	SPLINETABLE_FLOAT16,
+	SPLINETABLE_BFLOAT16,
+	SPLINETABLE_INT16
+} splinetable_precision;
+
+#define SPLINETABLE_QBLOCK 64
+
 int readsplinefitstable(const char *path, struct splinetable *table);
 int readsplinefitstable_mem(struct splinetable_buffer *buffer,
     struct splinetable *table);
 int writesplinefitstable(const char *path, const struct splinetable *table);
 int writesplinefitstable_mem(struct splinetable_buffer *buffer,
     const struct splinetable *table);
+
+/*
+ * Native binary tables (see mmaptable.c) are mapped read-only rather than
+ * read into memory, so that processes using the same table share it.
+ * readsplinetable() reads either format, depending on the file's contents.
+ */
+int readsplinemmaptable(const char *path, struct splinetable *table);
+int writesplinemmaptable(const char *path, const struct splinetable *table);
+int readsplinetable(const char *path, struct splinetable *table);
+
 void splinetable_free(struct splinetable *table);
+/* Free (or unmap) only the coefficient array */
+void splinetable_free_coefficients(struct splinetable *table);
+
+/*
+ * Reorder the coefficients into blocks of blocksize^ndim, so that the
+ * (order+1)^ndim coefficients needed for one evaluation fall into a few
+ * contiguous blocks instead of being spread over the whole array. Each
+ * axis is padded with zeros to a multiple of blocksize. blocksize should
+ * be order+1. splinetable_unblock() restores the row-major layout, as do
+ * splinetable_convolve() and splinetable_permute().
+ * splinetable_ncoefficients() is the length of the coefficient array in
+ * the current layout, including padding, and
+ * splinetable_coefficients_rowmajor() copies the coefficients into dest in
+ * row-major order regardless of the layout.
+ */
+int splinetable_block(struct splinetable *table, int blocksize);
+int splinetable_unblock(struct splinetable *table);
+size_t splinetable_ncoefficients(const struct splinetable *table);
+void splinetable_coefficients_rowmajor(const struct splinetable *table,
+    float *dest);
+
+/*
+ * Store the coefficients in 16 bits each instead of 32: as IEEE half
+ * precision floats (11 significant bits, magnitudes up to 65504), as
+ * bfloat16 (8 significant bits, full float range), or as integers with a
+ * common scale for each SPLINETABLE_QBLOCK consecutive coefficients
+ * (16 bits relative to the largest coefficient in the group). Returns
+ * ERANGE, leaving the table as it was, if a coefficient is out of range,
+ * and EINVAL for blocked tables. splinetable_unpack() converts the
+ * coefficients back to float, as do splinetable_convolve() and
+ * splinetable_permute().
+ */
+int splinetable_pack(struct splinetable *table, splinetable_precision precision);
+int splinetable_unpack(struct splinetable *table);
 void splinetable_permute(struct splinetable *table, int *permutation);
 char * splinetable_get_key(const struct splinetable *table, const char *key);
 int splinetable_read_key(const struct splinetable *table, splinetable_dtype type,
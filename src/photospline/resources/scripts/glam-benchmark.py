@@ -0,0 +1,65 @@
+#!/usr/bin/env python
+
+"""
+Time spglam.fit() on synthetic histograms of representative shapes, with
+different numbers of threads and both linear solvers, e.g.
+
+  python glam-benchmark.py --dims 4 --bins 50 --knots 15 --threads 1,2,4,8
+
+The threads are taken from GOTO_NUM_THREADS, like the rest of the fitter.
+A fraction of the bins can be given zero weight (--empty) to mimic sparse
+tabulator output; those bins are never stored.
+"""
+
+from optparse import OptionParser
+import os
+import time
+import numpy
+
+from icecube.photospline import spglam as glam
+from icecube.photospline.utils import pad_knots
+
+usage = "usage: %prog [options]"
+optparser = OptionParser(usage=usage)
+optparser.add_option("--dims", dest="dims", type="int", default=4,
+             help="number of dimensions")
+optparser.add_option("--bins", dest="bins", type="int", default=40,
+             help="number of bins in each dimension")
+optparser.add_option("--knots", dest="knots", type="int", default=12,
+             help="number of knots in each dimension")
+optparser.add_option("--order", dest="order", type="int", default=2,
+             help="spline order")
+optparser.add_option("--empty", dest="empty", type="float", default=0.5,
+             help="fraction of bins with zero weight")
+optparser.add_option("--threads", dest="threads", default="1,2,4",
+             help="comma-separated thread counts to try")
+optparser.add_option("--solvers", dest="solvers", default="cholesky,cg",
+             help="comma-separated solvers to try")
+(opts, args) = optparser.parse_args()
+
+numpy.random.seed(42)
+
+centers = [numpy.linspace(-1, 1, opts.bins)]*opts.dims
+knots = [pad_knots(numpy.linspace(-1, 1, opts.knots), opts.order)]*opts.dims
+grid = numpy.meshgrid(*centers, indexing='ij')
+z = numpy.exp(-sum(x**2 for x in grid))
+z = numpy.random.poisson(1000*z).astype(float)
+w = numpy.ones(z.shape)
+w[numpy.random.uniform(size=z.shape) < opts.empty] = 0
+
+print("%d-D, %d bins (%d with weight), %d coefficients" % (opts.dims,
+    z.size, (w > 0).sum(), (opts.knots + opts.order - 1)**opts.dims))
+
+reference = None
+for solver in opts.solvers.split(','):
+	for nthreads in [int(n) for n in opts.threads.split(',')]:
+		os.environ['GOTO_NUM_THREADS'] = str(nthreads)
+		t0 = time.time()
+		spline = glam.fit(z, w, centers, knots, opts.order, 1.,
+		    penalties={2:[1.]*opts.dims}, solver=solver)
+		dt = time.time() - t0
+		if reference is None:
+			reference = spline.coefficients
+		dev = abs(spline.coefficients - reference).max()
+		print("%-8s %2d threads: %8.2f s (max deviation %.2e)" % (solver,
+		    nthreads, dt, dev))
@@ -23,3 +23,8 @@ spline = glam.fit(z, w, centers, knots, order, smooth, penalties={2:[smooth]*3},
 y = glam.grideval(spline, centers)
 residual = ((z-y)**2).sum()
 numpy.testing.assert_almost_equal(residual, 50791.31, 2)
+
+# the iterative solver converges to the direct solution
+direct = glam.fit(z, w, centers, knots, order, smooth, penalties={2:[smooth]*3})
+iterative = glam.fit(z, w, centers, knots, order, smooth, penalties={2:[smooth]*3}, solver='cg')
+numpy.testing.assert_allclose(iterative.coefficients, direct.coefficients, rtol=1e-4, atol=1e-6*abs(direct.coefficients).max())
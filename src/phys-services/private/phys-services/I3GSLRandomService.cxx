@@ -70,6 +70,39 @@ double I3GSLRandomService::Gaus(double mean,double stddev)
   return mean + gsl_ran_gaussian(r,stddev);
 }
 
+void I3GSLRandomService::FillUniform(double *values, size_t n, double x1,
+                                     double x2)
+{
+  for(size_t i=0; i<n; i++)
+    values[i] = gsl_ran_flat(r,x1,x2);
+}
+
+void I3GSLRandomService::FillGaus(double *values, size_t n, double mean,
+                                  double stddev)
+{
+  for(size_t i=0; i<n; i++)
+    values[i] = mean + gsl_ran_gaussian(r,stddev);
+}
+
+void I3GSLRandomService::FillExp(double *values, size_t n, double tau)
+{
+  for(size_t i=0; i<n; i++)
+    values[i] = gsl_ran_exponential(r,tau);
+}
+
+void I3GSLRandomService::FillPoisson(int *values, size_t n, double mean)
+{
+  for(size_t i=0; i<n; i++)
+    values[i] = gsl_ran_poisson(r,mean);
+}
+
+void I3GSLRandomService::FillBinomial(int *values, size_t n, int ntot,
+                                      double prob)
+{
+  for(size_t i=0; i<n; i++)
+    values[i] = gsl_ran_binomial(r,prob,ntot);
+}
+
 struct I3GSLRandomServiceState : public I3FrameObject {
   std::string gsl_version_;
   std::string rng_type_;
@@ -0,0 +1,288 @@
+#include "phys-services/I3PhiloxRandomService.h"
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const uint32_t PHILOX_M0 = 0xD2511F53;
+const uint32_t PHILOX_M1 = 0xCD9E8D57;
+const uint32_t PHILOX_W0 = 0x9E3779B9;
+const uint32_t PHILOX_W1 = 0xBB67AE85;
+const unsigned PHILOX_ROUNDS = 10;
+
+// Added to the key when deriving substream numbers, so that those never
+// coincide with the blocks of the stream itself
+const uint32_t SUBSTREAM_K0 = 0x243F6A88;
+const uint32_t SUBSTREAM_K1 = 0x85A308D3;
+
+// A double in (0,1): the top 52 bits of hi:lo as the mantissa of a number
+// in [1,2), shifted down by 1 - 2^-53. Both steps are exact.
+inline double
+to_double(uint32_t hi, uint32_t lo)
+{
+  uint64_t bits = (((uint64_t(hi) << 32) | lo) >> 12) | 0x3FF0000000000000ULL;
+  double d;
+  memcpy(&d, &bits, sizeof(d));
+  return d - (1. - 1./9007199254740992.);
+}
+
+inline void
+box_muller(double u1, double u2, double &z0, double &z1)
+{
+  double r = std::sqrt(-2*std::log(u1));
+  z0 = r*std::cos(2*M_PI*u2);
+  z1 = r*std::sin(2*M_PI*u2);
+}
+
+inline void
+philox_round(uint32_t &x0, uint32_t &x1, uint32_t &x2, uint32_t &x3,
+             uint32_t k0, uint32_t k1)
+{
+  uint64_t p0 = uint64_t(PHILOX_M0)*x0;
+  uint64_t p1 = uint64_t(PHILOX_M1)*x2;
+  x0 = uint32_t(p1 >> 32) ^ x1 ^ k0;
+  x1 = uint32_t(p1);
+  x2 = uint32_t(p0 >> 32) ^ x3 ^ k1;
+  x3 = uint32_t(p0);
+}
+
+}
+
+void I3PhiloxRandomService::Philox4x32(const uint32_t counter[4],
+                                       const uint32_t key[2], uint32_t out[4])
+{
+  uint32_t x0 = counter[0], x1 = counter[1], x2 = counter[2], x3 = counter[3];
+  uint32_t k0 = key[0], k1 = key[1];
+
+  for (unsigned r = 0; r < PHILOX_ROUNDS; r++) {
+    philox_round(x0, x1, x2, x3, k0, k1);
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+  out[0] = x0;
+  out[1] = x1;
+  out[2] = x2;
+  out[3] = x3;
+}
+
+/*
+ * Two uniform doubles from each of nblocks consecutive blocks, starting at
+ * block position. A single block is one long chain of dependent multiplies,
+ * so the blocks are done in pairs whose rounds interleave. This was faster
+ * than arrays of 4 or 8 blocks left to the auto-vectorizer, which without
+ * AVX2 has no good 32x32->64 bit vector multiply.
+ */
+static void
+philox_uniforms(const uint32_t key[2], uint64_t stream, uint64_t position,
+                size_t nblocks, double *out)
+{
+  const uint32_t s0 = uint32_t(stream), s1 = uint32_t(stream >> 32);
+  size_t b = 0;
+
+  for (; b + 2 <= nblocks; b += 2) {
+    uint32_t a0 = uint32_t(position + b), a1 = uint32_t((position + b) >> 32);
+    uint32_t a2 = s0, a3 = s1;
+    uint32_t c0 = uint32_t(position + b + 1);
+    uint32_t c1 = uint32_t((position + b + 1) >> 32);
+    uint32_t c2 = s0, c3 = s1;
+    uint32_t k0 = key[0], k1 = key[1];
+
+    for (unsigned r = 0; r < PHILOX_ROUNDS; r++) {
+      philox_round(a0, a1, a2, a3, k0, k1);
+      philox_round(c0, c1, c2, c3, k0, k1);
+      k0 += PHILOX_W0;
+      k1 += PHILOX_W1;
+    }
+    out[2*b] = to_double(a0, a1);
+    out[2*b+1] = to_double(a2, a3);
+    out[2*b+2] = to_double(c0, c1);
+    out[2*b+3] = to_double(c2, c3);
+  }
+  if (b < nblocks) {
+    const uint32_t counter[4] = { uint32_t(position + b),
+                                  uint32_t((position + b) >> 32), s0, s1 };
+    uint32_t words[4];
+    I3PhiloxRandomService::Philox4x32(counter, key, words);
+    out[2*b] = to_double(words[0], words[1]);
+    out[2*b+1] = to_double(words[2], words[3]);
+  }
+}
+
+I3PhiloxRandomService::I3PhiloxRandomService(uint64_t seed, uint64_t stream):
+seed_(seed),
+stream_(stream),
+position_(0),
+spare_(0),
+haveSpare_(false),
+gausSpare_(0),
+haveGausSpare_(false)
+{}
+
+I3PhiloxRandomService::~I3PhiloxRandomService(){}
+
+I3PhiloxRandomServicePtr I3PhiloxRandomService::Substream(uint64_t id) const
+{
+  const uint32_t counter[4] = { uint32_t(id), uint32_t(id >> 32),
+                                uint32_t(stream_), uint32_t(stream_ >> 32) };
+  const uint32_t key[2] = { uint32_t(seed_) + SUBSTREAM_K0,
+                            uint32_t(seed_ >> 32) + SUBSTREAM_K1 };
+  uint32_t out[4];
+
+  Philox4x32(counter, key, out);
+  return I3PhiloxRandomServicePtr(new I3PhiloxRandomService(seed_,
+    (uint64_t(out[1]) << 32) | out[0]));
+}
+
+inline double I3PhiloxRandomService::Next()
+{
+  if (haveSpare_) {
+    haveSpare_ = false;
+    return spare_;
+  }
+
+  const uint32_t counter[4] = { uint32_t(position_), uint32_t(position_ >> 32),
+                                uint32_t(stream_), uint32_t(stream_ >> 32) };
+  const uint32_t key[2] = { uint32_t(seed_), uint32_t(seed_ >> 32) };
+  uint32_t out[4];
+
+  Philox4x32(counter, key, out);
+  position_++;
+  spare_ = to_double(out[2], out[3]);
+  haveSpare_ = true;
+  return to_double(out[0], out[1]);
+}
+
+double I3PhiloxRandomService::Exp(double tau)
+{
+  return -tau*std::log(Next());
+}
+
+double I3PhiloxRandomService::Uniform(double x1)
+{
+  return Uniform(0, x1);
+}
+
+double I3PhiloxRandomService::Uniform(double x1, double x2)
+{
+  return x1 + (x2-x1)*Next();
+}
+
+double I3PhiloxRandomService::Gaus(double mean, double stddev)
+{
+  if (haveGausSpare_) {
+    haveGausSpare_ = false;
+    return mean + stddev*gausSpare_;
+  }
+
+  double u1 = Next();
+  double u2 = Next();
+  double z0;
+  box_muller(u1, u2, z0, gausSpare_);
+  haveGausSpare_ = true;
+  return mean + stddev*z0;
+}
+
+void I3PhiloxRandomService::FillUniform(double *values, size_t n, double x1,
+                                        double x2)
+{
+  const uint32_t key[2] = { uint32_t(seed_), uint32_t(seed_ >> 32) };
+  size_t i = 0;
+
+  // Use up the spare first, so that the sequence is the same as from
+  // n calls to Uniform()
+  if (i < n && haveSpare_)
+    values[i++] = Next();
+  size_t nblocks = (n - i)/2;
+  philox_uniforms(key, stream_, position_, nblocks, values + i);
+  position_ += nblocks;
+  i += 2*nblocks;
+  if (i < n)
+    values[i++] = Next();
+
+  for (i = 0; i < n; i++)
+    values[i] = x1 + (x2-x1)*values[i];
+}
+
+void I3PhiloxRandomService::FillGaus(double *values, size_t n, double mean,
+                                     double stddev)
+{
+  size_t i = 0;
+
+  if (i < n && haveGausSpare_) {
+    haveGausSpare_ = false;
+    values[i++] = mean + stddev*gausSpare_;
+  }
+  size_t npairs = (n - i)/2;
+  FillUniform(values + i, 2*npairs);
+  for (size_t j = 0; j < npairs; j++, i += 2) {
+    double z0, z1;
+    box_muller(values[i], values[i+1], z0, z1);
+    values[i] = mean + stddev*z0;
+    values[i+1] = mean + stddev*z1;
+  }
+  if (i < n)
+    values[i] = Gaus(mean, stddev);
+}
+
+void I3PhiloxRandomService::FillExp(double *values, size_t n, double tau)
+{
+  FillUniform(values, n);
+  for (size_t i = 0; i < n; i++)
+    values[i] = -tau*std::log(values[i]);
+}
+
+struct I3PhiloxRandomServiceState : public I3FrameObject {
+  uint64_t seed_;
+  uint64_t stream_;
+  uint64_t position_;
+  bool haveSpare_;
+  double spare_;
+  bool haveGausSpare_;
+  double gausSpare_;
+
+  friend class boost::serialization::access;
+  template <typename Archive>
+  void serialize(Archive &ar, unsigned version)
+  {
+    ar & make_nvp("I3FrameObject", base_object<I3FrameObject>(*this));
+    ar & make_nvp("Seed", seed_);
+    ar & make_nvp("Stream", stream_);
+    ar & make_nvp("Position", position_);
+    ar & make_nvp("HaveSpare", haveSpare_);
+    ar & make_nvp("Spare", spare_);
+    ar & make_nvp("HaveGausSpare", haveGausSpare_);
+    ar & make_nvp("GausSpare", gausSpare_);
+  }
+};
+
+BOOST_CLASS_VERSION(I3PhiloxRandomServiceState, 0);
+I3_SERIALIZABLE(I3PhiloxRandomServiceState);
+
+I3FrameObjectPtr I3PhiloxRandomService::GetState() const
+{
+  boost::shared_ptr<I3PhiloxRandomServiceState>
+    state(new I3PhiloxRandomServiceState);
+  state->seed_ = seed_;
+  state->stream_ = stream_;
+  state->position_ = position_;
+  state->haveSpare_ = haveSpare_;
+  state->spare_ = spare_;
+  state->haveGausSpare_ = haveGausSpare_;
+  state->gausSpare_ = gausSpare_;
+  return state;
+}
+
+void I3PhiloxRandomService::RestoreState(I3FrameObjectConstPtr vstate)
+{
+  boost::shared_ptr<const I3PhiloxRandomServiceState> state;
+  if (!(state = boost::dynamic_pointer_cast<const I3PhiloxRandomServiceState>(vstate)))
+    log_fatal("The provided state is not an I3PhiloxRandomServiceState!");
+
+  seed_ = state->seed_;
+  stream_ = state->stream_;
+  position_ = state->position_;
+  haveSpare_ = state->haveSpare_;
+  spare_ = state->spare_;
+  haveGausSpare_ = state->haveGausSpare_;
+  gausSpare_ = state->gausSpare_;
+}
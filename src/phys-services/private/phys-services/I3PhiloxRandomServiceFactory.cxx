@@ -0,0 +1,59 @@
+/*
+ * class: I3PhiloxRandomServiceFactory
+ *
+ * Version $Id$
+ *
+ * Date: 19 Oct 2016
+ *
+ * (c) IceCube Collaboration
+ */
+
+// Class header files
+
+#include "phys-services/I3PhiloxRandomServiceFactory.h"
+I3_SERVICE_FACTORY(I3PhiloxRandomServiceFactory);
+
+// Other header files
+
+#include "phys-services/I3PhiloxRandomService.h"
+
+// Constructors
+
+I3PhiloxRandomServiceFactory::I3PhiloxRandomServiceFactory(const I3Context& context) 
+  : I3ServiceFactory(context),
+  seed_(0),
+  stream_(0),
+  random_()
+{
+	AddParameter("Seed","Seed for random number generator", seed_);
+	AddParameter("Stream","Stream number, e.g. the job number. Different "
+	             "streams with the same seed never overlap.", stream_);
+
+	installServiceAs_ = I3DefaultName<I3RandomService>::value();
+	AddParameter("InstallServiceAs",
+	             "Install the random service at the following location",
+	             installServiceAs_);
+}
+
+// Destructors
+
+I3PhiloxRandomServiceFactory::~I3PhiloxRandomServiceFactory()
+{
+}
+
+// Member functions
+
+bool
+I3PhiloxRandomServiceFactory::InstallService(I3Context& services)
+{
+  if(!random_)
+    random_ = I3RandomServicePtr(new I3PhiloxRandomService(seed_, stream_));
+  return services.Put<I3RandomService>(installServiceAs_, random_);
+}
+
+void I3PhiloxRandomServiceFactory::Configure()
+{
+  GetParameter("Seed", seed_);
+  GetParameter("Stream", stream_);
+  GetParameter("InstallServiceAs",installServiceAs_);
+}
@@ -86,6 +86,39 @@ double I3RandomService::Uniform(double x2)
 	return Uniform(0, x2);
 }
 
+void I3RandomService::FillUniform(double *values, size_t n, double x1,
+    double x2)
+{
+	for (size_t i = 0; i < n; i++)
+		values[i] = Uniform(x1, x2);
+}
+
+void I3RandomService::FillGaus(double *values, size_t n, double mean,
+    double stddev)
+{
+	for (size_t i = 0; i < n; i++)
+		values[i] = Gaus(mean, stddev);
+}
+
+void I3RandomService::FillExp(double *values, size_t n, double tau)
+{
+	for (size_t i = 0; i < n; i++)
+		values[i] = Exp(tau);
+}
+
+void I3RandomService::FillPoisson(int *values, size_t n, double mean)
+{
+	for (size_t i = 0; i < n; i++)
+		values[i] = Poisson(mean);
+}
+
+void I3RandomService::FillBinomial(int *values, size_t n, int ntot,
+    double prob)
+{
+	for (size_t i = 0; i < n; i++)
+		values[i] = Binomial(ntot, prob);
+}
+
 const gsl_rng_wrap *
 I3RandomService::GSLRng() const
 {
@@ -26,6 +26,7 @@
 #include <phys-services/I3SPRNGRandomService.h>
 #endif
 #include <phys-services/I3GSLRandomService.h>
+#include <phys-services/I3PhiloxRandomService.h>
 
 using namespace boost::python;
 namespace bp = boost::python;
@@ -73,6 +74,14 @@ void register_RandomServices()
   register_randomservice<I3GSLRandomService>("I3GSLRandomService", "gsl random goodness",
 					     init<unsigned long int,bool>((bp::arg("seed"),bp::arg("track_state")=true)));
 
+  register_randomservice<I3PhiloxRandomService>("I3PhiloxRandomService",
+					     "counter-based (Philox4x32-10) random streams",
+					     init<uint64_t,uint64_t>((bp::arg("seed"),bp::arg("stream")=0)))
+    .def("substream", &I3PhiloxRandomService::Substream, bp::arg("id"),
+	 "A new service for the substream with the given id, independent of the position in this stream")
+    .add_property("stream", &I3PhiloxRandomService::GetStream)
+    ;
+
 #ifdef I3_USE_ROOT
   register_randomservice<I3TRandomService>("I3TRandomService", "ROOT random badness",
 					     init<unsigned long int>(bp::arg("seed")));
@@ -0,0 +1,137 @@
+#include <I3Test.h>
+
+#include "phys-services/I3PhiloxRandomService.h"
+
+#include <cmath>
+#include <vector>
+
+TEST_GROUP(I3PhiloxRandomService);
+
+// Known-answer vectors from the Random123 distribution
+TEST(KnownAnswers)
+{
+  const uint32_t counters[3][4] = {
+    { 0x00000000, 0x00000000, 0x00000000, 0x00000000 },
+    { 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff },
+    { 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 } };
+  const uint32_t keys[3][2] = {
+    { 0x00000000, 0x00000000 },
+    { 0xffffffff, 0xffffffff },
+    { 0xa4093822, 0x299f31d0 } };
+  const uint32_t answers[3][4] = {
+    { 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 },
+    { 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd },
+    { 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 } };
+
+  for (int i = 0; i < 3; i++) {
+    uint32_t out[4];
+    I3PhiloxRandomService::Philox4x32(counters[i], keys[i], out);
+    for (int j = 0; j < 4; j++)
+      ENSURE_EQUAL(out[j], answers[i][j], "Philox4x32-10 matches Random123");
+  }
+}
+
+TEST(Moments)
+{
+  I3PhiloxRandomService rng(42);
+  const int samples = 100000;
+  double sum = 0, sum2 = 0;
+
+  for (int i = 0; i < samples; i++) {
+    double u = rng.Uniform();
+    ENSURE(u > 0 && u < 1, "Uniform() is in (0,1)");
+    sum += u;
+    sum2 += u*u;
+  }
+  ENSURE_DISTANCE(sum/samples, 0.5, 0.01);
+  ENSURE_DISTANCE(std::sqrt(sum2/samples - std::pow(sum/samples, 2)),
+                  std::sqrt(1./12), 0.01);
+
+  sum = sum2 = 0;
+  for (int i = 0; i < samples; i++) {
+    double g = rng.Gaus(5, 1);
+    sum += g;
+    sum2 += g*g;
+  }
+  ENSURE_DISTANCE(sum/samples, 5., 0.01);
+  ENSURE_DISTANCE(std::sqrt(sum2/samples - std::pow(sum/samples, 2)), 1.,
+                  0.01);
+}
+
+// The Fill methods give exactly the numbers of the single-number calls,
+// whatever is left over from earlier calls
+TEST(BulkMatchesScalar)
+{
+  I3PhiloxRandomService bulk(7, 3), scalar(7, 3);
+  const size_t sizes[] = { 0, 1, 2, 5, 16, 17, 100, 1001 };
+
+  for (unsigned k = 0; k < sizeof(sizes)/sizeof(sizes[0]); k++) {
+    size_t n = sizes[k];
+    std::vector<double> values(n+1);
+
+    // Leave an odd number of uniforms and Gaussians behind
+    ENSURE_EQUAL(bulk.Uniform(), scalar.Uniform());
+    ENSURE_EQUAL(bulk.Gaus(0, 1), scalar.Gaus(0, 1));
+
+    bulk.FillUniform(&values[0], n, -1, 3);
+    for (size_t i = 0; i < n; i++)
+      ENSURE_EQUAL(values[i], scalar.Uniform(-1, 3), "FillUniform()");
+    bulk.FillGaus(&values[0], n, 2, 0.5);
+    for (size_t i = 0; i < n; i++)
+      ENSURE_EQUAL(values[i], scalar.Gaus(2, 0.5), "FillGaus()");
+    bulk.FillExp(&values[0], n, 3);
+    for (size_t i = 0; i < n; i++)
+      ENSURE_EQUAL(values[i], scalar.Exp(3), "FillExp()");
+    std::vector<int> counts(n+1);
+    bulk.FillPoisson(&counts[0], n, 4.5);
+    for (size_t i = 0; i < n; i++)
+      ENSURE_EQUAL(counts[i], scalar.Poisson(4.5), "FillPoisson()");
+  }
+}
+
+TEST(Substreams)
+{
+  I3PhiloxRandomService parent(11), other(11);
+  std::vector<double> values(100);
+
+  // Substreams don't depend on how far the parent has advanced
+  parent.FillUniform(&values[0], values.size());
+  I3PhiloxRandomServicePtr a = parent.Substream(5)->Substream(12);
+  I3PhiloxRandomServicePtr b = other.Substream(5)->Substream(12);
+  ENSURE_EQUAL(a->GetStream(), b->GetStream());
+  for (int i = 0; i < 100; i++)
+    ENSURE_EQUAL(a->Uniform(), b->Uniform(), "Same substream, same numbers");
+
+  I3PhiloxRandomServicePtr c = other.Substream(6);
+  I3PhiloxRandomServicePtr d = other.Substream(5);
+  ENSURE(c->GetStream() != d->GetStream(), "Different ids, different streams");
+  ENSURE(c->Uniform() != d->Uniform());
+
+  // Different stream numbers in the constructor are independent
+  I3PhiloxRandomService s1(11, 0), s2(11, 1);
+  double covariance = 0, sigma1 = 0, sigma2 = 0;
+  for (int i = 0; i < 1000000; i++) {
+    double u1 = s1.Uniform() - 0.5, u2 = s2.Uniform() - 0.5;
+    covariance += u1*u2;
+    sigma1 += u1*u1;
+    sigma2 += u2*u2;
+  }
+  ENSURE_DISTANCE(covariance/std::sqrt(sigma1*sigma2), 0.0, 0.01,
+                  "testing correlation");
+}
+
+TEST(StateRestoration)
+{
+  I3PhiloxRandomService rng(3);
+  rng.Uniform();
+  rng.Gaus(0, 1);
+  I3FrameObjectPtr state = rng.GetState();
+
+  std::vector<double> saved;
+  for (int i = 0; i < 1000; i++)
+    saved.push_back(rng.Gaus(0, 1) + rng.Uniform());
+  rng.RestoreState(state);
+  for (int i = 0; i < 1000; i++)
+    ENSURE_EQUAL(rng.Gaus(0, 1) + rng.Uniform(), saved[i],
+                 "Random stream after state restoration must match");
+}
@@ -171,6 +171,30 @@ TEST(I3GSLRandomService)
   randomServiceTest::testStateRestoration(random2);
 }
 
+TEST(I3GSLRandomServiceBulk)
+{
+  I3GSLRandomService bulk(666), scalar(666);
+  const unsigned int samples=1000;
+  vector<double> values(samples);
+  vector<int> counts(samples);
+
+  bulk.FillUniform(&values[0], samples, 2, 5);
+  for(unsigned int i = 0 ; i < samples ; i++)
+    ENSURE_EQUAL(values[i], scalar.Uniform(2, 5), "FillUniform()");
+  bulk.FillGaus(&values[0], samples, 5, 1);
+  for(unsigned int i = 0 ; i < samples ; i++)
+    ENSURE_EQUAL(values[i], scalar.Gaus(5, 1), "FillGaus()");
+  bulk.FillExp(&values[0], samples, 2);
+  for(unsigned int i = 0 ; i < samples ; i++)
+    ENSURE_EQUAL(values[i], scalar.Exp(2), "FillExp()");
+  bulk.FillPoisson(&counts[0], samples, 3.5);
+  for(unsigned int i = 0 ; i < samples ; i++)
+    ENSURE_EQUAL(counts[i], scalar.Poisson(3.5), "FillPoisson()");
+  bulk.FillBinomial(&counts[0], samples, 10, 0.3);
+  for(unsigned int i = 0 ; i < samples ; i++)
+    ENSURE_EQUAL(counts[i], scalar.Binomial(10, 0.3), "FillBinomial()");
+}
+
 #ifdef I3_USE_SPRNG
 TEST(I3SPRNGRandomService)
 {
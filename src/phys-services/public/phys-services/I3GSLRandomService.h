@@ -96,6 +96,16 @@ class I3GSLRandomService : public I3RandomService{
    */
   virtual double Gaus(double mean, double stddev);
   
+  /**
+   * Bulk versions of the above, straight into GSL
+   */
+  virtual void FillUniform(double *values, size_t n, double x1 = 0,
+                           double x2 = 1);
+  virtual void FillGaus(double *values, size_t n, double mean, double stddev);
+  virtual void FillExp(double *values, size_t n, double tau);
+  virtual void FillPoisson(int *values, size_t n, double mean);
+  virtual void FillBinomial(int *values, size_t n, int ntot, double prob);
+
   /**
    * get all information necessary to restore the internal
    * state of the generator
@@ -0,0 +1,130 @@
+/**
+ * copyright  (C) 2016
+ * the icecube collaboration
+ * $Id$
+ *
+ * @brief A counter-based implementation of the I3RandomService interface.
+ *
+ * Uses the Philox4x32-10 bijection of Salmon et al. ("Parallel random
+ * numbers: as easy as 1, 2, 3", SC11). The n-th block of four 32-bit words
+ * of a stream is Philox(key=seed, counter=(n, stream)), so any position of
+ * any stream can be computed directly, and streams with different numbers
+ * never overlap. Substream() derives further streams deterministically
+ * from this one, e.g. one per event and then one per DOM, so that work
+ * distributed over threads gets the same numbers no matter how many
+ * threads there are or in which order they run.
+ *
+ * Each block gives two doubles with 52 random bits. Gaus() uses the
+ * Box-Muller transform and keeps the second variate for the next call.
+ *
+ * An instance is not thread-safe; give each thread its own Substream().
+ *
+ * @version $Revision$
+ * @date $Date$
+ */
+
+#ifndef I3PHILOXRANDOMSERVICE_H
+#define I3PHILOXRANDOMSERVICE_H
+
+#include "phys-services/I3RandomService.h"
+
+#include <stdint.h>
+
+class I3PhiloxRandomService;
+I3_POINTER_TYPEDEFS(I3PhiloxRandomService);
+
+class I3PhiloxRandomService : public I3RandomService{
+ public:
+  /**
+   * constructor
+   */
+  explicit I3PhiloxRandomService(uint64_t seed = 0, uint64_t stream = 0);
+
+  /**
+   * destructor
+   */
+  virtual ~I3PhiloxRandomService();
+
+  /**
+   * A new service for the substream with the given id. The result depends
+   * only on the seed, this stream's number and id, not on how many numbers
+   * have been drawn from this stream.
+   */
+  I3PhiloxRandomServicePtr Substream(uint64_t id) const;
+
+  /**
+   * The number of this stream
+   */
+  uint64_t GetStream() const { return stream_; }
+
+  /**
+   * A number from an Exponential distribution
+   */
+  virtual double Exp(double tau);
+
+  /**
+   * a double drawn from a uniform distribution (0,x1)
+   */
+  virtual double Uniform(double x1 = 1);
+
+  /**
+   * a double drawn from a uniform distribution (x1,x2)
+   */
+  virtual double Uniform(double x1, double x2);
+
+  /**
+   * a double drawn from a Gaussian distribution with given
+   * mean and standard deviation
+   */
+  virtual double Gaus(double mean, double stddev);
+
+  /**
+   * Bulk versions of the above. Whole blocks are generated two at a time,
+   * with interleaved rounds.
+   */
+  virtual void FillUniform(double *values, size_t n, double x1 = 0,
+                           double x2 = 1);
+  virtual void FillGaus(double *values, size_t n, double mean, double stddev);
+  virtual void FillExp(double *values, size_t n, double tau);
+
+  /**
+   * get all information necessary to restore the internal
+   * state of the generator
+   */
+  virtual I3FrameObjectPtr GetState() const;
+
+  /**
+   * restore the internal state of the generator
+   */
+  virtual void RestoreState(I3FrameObjectConstPtr state);
+
+  /**
+   * The Philox4x32-10 bijection: encrypt counter with key into out
+   */
+  static void Philox4x32(const uint32_t counter[4], const uint32_t key[2],
+                         uint32_t out[4]);
+
+ private:
+  I3PhiloxRandomService(const I3PhiloxRandomService&);
+  I3PhiloxRandomService operator=(const I3PhiloxRandomService&);
+
+  /**
+   * A uniform double in (0,1)
+   */
+  inline double Next();
+
+  uint64_t seed_;
+  uint64_t stream_;
+  // index of the next block to generate
+  uint64_t position_;
+  // second double of the last block, if not used yet
+  double spare_;
+  bool haveSpare_;
+  // second Box-Muller variate, if not used yet
+  double gausSpare_;
+  bool haveGausSpare_;
+
+  SET_LOGGER("I3PhiloxRandomService");
+};
+
+#endif //I3PHILOXRANDOMSERVICE_H
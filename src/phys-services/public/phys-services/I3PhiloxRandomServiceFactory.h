@@ -0,0 +1,79 @@
+#ifndef I3PHILOXRANDOMSERVICEFACTORY_H
+#define I3PHILOXRANDOMSERVICEFACTORY_H
+/*
+ * class: I3PhiloxRandomServiceFactory
+ *
+ * Version $Id$
+ *
+ * Date: 19 Oct 2016
+ *
+ * (c) IceCube Collaboration
+ */
+
+// Header files
+
+#include <string>
+
+// Forward declarations
+
+class I3Context;
+
+// Superclasses
+
+#include "icetray/I3ServiceFactory.h"
+#include "phys-services/I3RandomService.h"
+
+#include <stdint.h>
+
+/**
+ * @brief This class installs a I3PhiloxRandomService.
+ *
+ * I3PhiloxRandomService supports three parameters: <VAR>Seed</VAR>,
+ * <VAR>Stream</VAR>, <VAR>InstallServiceAs</VAR>.
+ * @version $Id$
+ */
+class I3PhiloxRandomServiceFactory
+: public I3ServiceFactory
+{
+ public:
+
+  // Constructors and destructor
+
+  I3PhiloxRandomServiceFactory(const I3Context& context);
+
+  virtual ~I3PhiloxRandomServiceFactory();
+
+  // public member functions
+
+  /**
+   * Installed this objects service into the specified services object.
+   *
+   * @param services the I3Context into which the service should be installed.
+   * @return true if the services is successfully installed.
+   */
+  virtual bool InstallService(I3Context& services);
+
+  /**
+   * Configure service prior to installing it. 
+   */
+  virtual void Configure();
+
+ private:
+
+  // private constructors, destructor and assignment
+
+  I3PhiloxRandomServiceFactory
+    (const I3PhiloxRandomServiceFactory& rhs); // stop default
+  I3PhiloxRandomServiceFactory operator=
+    (const I3PhiloxRandomServiceFactory& rhs); // stop default
+
+  // instance member data
+  uint64_t seed_;
+  uint64_t stream_;
+  I3RandomServicePtr random_;
+  std::string installServiceAs_;
+
+  SET_LOGGER("I3PhiloxRandomServiceFactory");
+};
+
+#endif
@@ -95,6 +95,36 @@ class I3RandomService {
    */
   virtual double Gaus(double mean,double stddev);
    
+  /**
+   * Fill values[0..n) with doubles drawn from a uniform distribution
+   * (x1,x2). This and the other Fill methods give the same numbers as n
+   * calls to the corresponding single-number method, but implementations
+   * can produce them without a virtual call per number. The defaults
+   * just loop.
+   */
+  virtual void FillUniform(double *values, size_t n, double x1 = 0,
+                           double x2 = 1);
+
+  /**
+   * Fill values[0..n) with numbers drawn from a Gaussian distribution
+   */
+  virtual void FillGaus(double *values, size_t n, double mean, double stddev);
+
+  /**
+   * Fill values[0..n) with numbers drawn from an Exponential distribution
+   */
+  virtual void FillExp(double *values, size_t n, double tau);
+
+  /**
+   * Fill values[0..n) with integers drawn from a Poisson distribution
+   */
+  virtual void FillPoisson(int *values, size_t n, double mean);
+
+  /**
+   * Fill values[0..n) with integers drawn from a binomial distribution
+   */
+  virtual void FillBinomial(int *values, size_t n, int ntot, double prob);
+
   /**
    * get all information necessary to restore the internal
    * state of the generator
@@ -40,6 +40,7 @@
 #define OVER 1
 #define NBLK 1
 #define NTHR 512
+#define NBNC 1024    // size of photon bunches claimed by a CPU thread at a time
 #else
 #define OVER 10      // size of photon bunches along the muon track
 #endif
@@ -16,6 +16,8 @@
 #ifdef XCPU
 #include <cmath>
 #include <cstring>
+#include <unistd.h>
+#include <pthread.h>
 #endif
 
 using namespace std;
@@ -32,6 +34,10 @@ namespace xppc{
   dats *e;  // pointer to a copy of "d" on device
   int nblk, nthr, ntot;
 
+  vector<xcpu> cpus;           // one entry per CPU thread
+  unsigned int xnum;           // number of photons in the current kernel call
+  volatile unsigned int xpos;  // first photon of the next unclaimed bunch
+
   void ini(int type){
     rs_ini();
     pn=0;
@@ -55,8 +61,16 @@ namespace xppc{
     }
 
     {
-      unsigned int size=d.rsize, need=seed+1;
-      if(size<need) cerr<<"Error: not enough multipliers: asked for "<<seed<<"-th out of "<<size<<"!"<<endl;
+      // threads sharing a multiplier would produce the same photons, so
+      // run fewer threads if there are not enough of them
+      unsigned int size=d.rsize, ncpu=cpus.size();
+      if(size<(seed+1)*ncpu){
+	ncpu=size/(seed+1);
+	if(ncpu<1){ cerr<<"Error: not enough multipliers: asked for "<<seed<<"-th out of "<<size<<"!"<<endl; exit(6); }
+	cerr<<"Only "<<size<<" multipliers available, reducing NCPU to "<<ncpu<<endl;
+	cpus.resize(ncpu);
+	for(unsigned int i=0; i<ncpu; i++) cpus[i].seed=seed*ncpu+i;
+      }
     }
   }
 
@@ -67,6 +81,36 @@ namespace xppc{
     delete d.bf;
 #endif
   }
+
+  void * xwork(void * arg){
+    xcpu & t = * (xcpu *) arg;
+    t.hits.clear(), t.hidx=0;
+    while((t.beg=__sync_fetch_and_add(&xpos, NBNC))<xnum){
+      t.end=min(t.beg+NBNC, xnum);
+      propagate(e, t);
+    }
+    return NULL;
+  }
+
+  void xrun(unsigned int num){
+    xnum=num, xpos=0;
+
+    // threads grab bunches of photons until none are left, so a thread
+    // that fails to start only slows things down
+    unsigned int n=cpus.size();
+    vector<pthread_t> tid(n);
+    vector<bool> run(n, false);
+    for(unsigned int i=1; i<n; i++) run[i]=pthread_create(&tid[i], NULL, xwork, &cpus[i])==0;
+    xwork(&cpus[0]);
+    for(unsigned int i=1; i<n; i++) if(run[i]) pthread_join(tid[i], NULL);
+
+    d.hidx=0;
+    for(vector<xcpu>::iterator i=cpus.begin(); i!=cpus.end(); i++){
+      unsigned int size=i->hits.size();
+      if(d.hidx<d.hnum) copy(i->hits.begin(), i->hits.begin()+min(size, d.hnum-d.hidx), &q.hits[d.hidx]);
+      d.hidx+=i->hidx;
+    }
+  }
 #else
   bool xgpu=false;
 
@@ -354,8 +398,7 @@ namespace xppc{
     if(old>0){
       d.hidx=0;
 #ifdef XCPU
-      for(d.blockIdx=0, d.gridDim=nblk, blockDim.x=nthr; d.blockIdx<d.gridDim; d.blockIdx++)
-	for(threadIdx.x=0; threadIdx.x<blockDim.x; threadIdx.x++) propagate(e, num);
+      xrun(num);
 
       if(d.hidx>=d.hnum){ d.hidx=d.hnum; cerr<<"Error: data buffer overflow occurred!"<<endl; }
 #else
@@ -486,6 +529,21 @@ namespace xppc{
     sv+=device;
     seed=device;
     nblk=NBLK, nthr=NTHR;
+
+    int ncpu=sysconf(_SC_NPROCESSORS_ONLN);
+    {
+      char * env=getenv("NCPU");
+      if(env!=NULL) if(*env!=0){
+	ncpu=atoi(env);
+	cerr<<"Setting NCPU="<<ncpu<<endl;
+      }
+    }
+    if(ncpu<1) ncpu=1;
+
+    // give every thread its own multiplier; the ranges of different
+    // seeds do not overlap
+    cpus.resize(ncpu);
+    for(int i=0; i<ncpu; i++) cpus[i].seed=seed*ncpu+i;
   }
   void listDevices(){}
 #else
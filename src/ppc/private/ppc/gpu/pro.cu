@@ -23,18 +23,12 @@ float int_as_float(unsigned int x){
   i=x; return f;
 }
 
-unsigned int atomicAdd(unsigned int * i, unsigned int j){
-  unsigned int k=*i; *i+=j;
-  return k;
-}
-
-struct ThreadIdx{
-  int x;
-} threadIdx;
-
-struct BlockDim{
-  int x;
-} blockDim;
+struct xcpu{              // state of one CPU thread
+  unsigned int seed;      // index of its random number multiplier
+  unsigned int beg, end;  // bunch of photons it is working on
+  vector<hit> hits;       // thread-local hit buffer, at most hnum hits
+  unsigned int hidx;      // number of hits found, including those not stored
+};
 
 unsigned int seed=0;
 
@@ -180,12 +174,17 @@ __device__ inline unsigned int smid(){
 }
 #endif
 
-#if defined(USMA) && defined(RAND)
+#ifdef XCPU
+#define XINC i++
+#define XSTR 1
+#elif defined(USMA) && defined(RAND)
 #define XINC i=atomicAdd(&eidx, e.gridDim)
 #define XIDX e.gridDim*blockDim.x+e.blockIdx
+#define XSTR e.gridDim*blockDim.x
 #else
 #define XINC i+=eidx
 #define XIDX e.gridDim*blockDim.x
+#define XSTR e.gridDim*blockDim.x
 #endif
 
 #ifdef HOLE
@@ -194,15 +193,18 @@ __device__ inline unsigned int smid(){
 #define IFH(x,y) y
 #endif
 
+#ifdef XCPU
+void propagate(dats * ed, xcpu & t){
+  const unsigned int num=t.end;
+#else
 __global__ void propagate(dats * ed, unsigned int num){
+#endif
   uint4 s;
   unsigned int niw=0;
 #ifdef XCPU
   float3 n;
   float4 r;
   dats & e = * ed;
-  static unsigned int eidx;
-  if(threadIdx.x==0) eidx = XIDX;
 #else
   float3 n={0,0,0};
   float4 r={0,0,0,0};
@@ -230,10 +232,16 @@ __global__ void propagate(dats * ed, unsigned int num){
 #endif
 
   ices * w;
+#ifdef XCPU
+  const unsigned int idx=t.beg;
+#else
   const unsigned int idx=threadIdx.x*e.gridDim+e.blockIdx;
+#endif
 
   {
-#ifndef XCPU
+#ifdef XCPU
+    const unsigned int & seed = t.seed;
+#else
     const unsigned int & seed = idx;
 #endif
     s.w=seed%e.rsize;
@@ -246,7 +254,7 @@ __global__ void propagate(dats * ed, unsigned int num){
   float TOT=0, IFH(SCA,sca);
 
 #ifdef TALL
-  for(unsigned int i=idx; i<num; i+=e.gridDim*blockDim.x){
+  for(unsigned int i=idx; i<num; i+=XSTR){
 #else
   for(unsigned int i=idx; i<num; TOT==0 && (XINC)){
     int om=-1;
@@ -592,8 +600,12 @@ __global__ void propagate(dats * ed, unsigned int num){
       }
 
       if(flag){
+#ifdef XCPU
+	if(t.hidx++<e.hnum) t.hits.push_back(h);
+#else
 	unsigned int j = atomicAdd(&ed->hidx, 1);
 	if(j<e.hnum) e.hits[j]=h;
+#endif
       }
 
       if(e.zR==1) TOT=0; else old=om;
@@ -0,0 +1,168 @@
+/**
+ * Copyright (c) 2016
+ * the IceCube Collaboration <http://www.icecube.wisc.edu>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *
+ */
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <icetray/I3Units.h>
+#include "icetray/I3ConditionalModule.h"
+#include "simclasses/I3MCPE.h"
+
+namespace{
+  // orders PEs by the particle that made them, then by time
+  bool particle_then_time(const I3MCPE& lhs, const I3MCPE& rhs){
+    if(lhs.ID < rhs.ID) return true;
+    if(rhs.ID < lhs.ID) return false;
+    return lhs.time < rhs.time;
+  }
+
+  bool earlier(const I3MCPE& lhs, const I3MCPE& rhs){
+    return lhs.time < rhs.time;
+  }
+
+  /**
+   * Replaces the PEs of one DOM with one weighted PE for each run of PEs
+   * from the same particle that starts no more than timeBin after the
+   * first PE of the run. The new PE gets the summed npe and the
+   * npe-weighted mean time. The result is time ordered.
+   */
+  void compact(I3MCPESeries& pes, double timeBin){
+    if(pes.size() < 2) return;
+
+    std::sort(pes.begin(), pes.end(), particle_then_time);
+
+    I3MCPESeries::iterator out = pes.begin();
+    I3MCPESeries::const_iterator run = pes.begin();
+    while(run != pes.end()){
+      I3MCPESeries::const_iterator next = run;
+      uint32_t npe = 0;
+      double weightedTime = 0;
+      for(; next != pes.end() && next->ID == run->ID &&
+            next->time - run->time <= timeBin; ++next){
+        npe += next->npe;
+        weightedTime += next->npe*next->time;
+      }
+
+      I3MCPE merged(*run);
+      merged.npe = npe;
+      if(npe > 0)
+        merged.time = weightedTime/npe;
+      *out++ = merged;
+      run = next;
+    }
+    pes.erase(out, pes.end());
+
+    std::sort(pes.begin(), pes.end(), earlier);
+  }
+}
+
+/**
+ * @brief Merges MCPEs from the same DOM and particle that are closer in
+ * time than TimeBin into single MCPEs with a larger npe.
+ *
+ * Bright events and long stretches of noise leave millions of single-PE
+ * entries in the I3MCPESeriesMap, many of which are much closer together
+ * than the PMT can resolve. The PMT simulation splits weighted PEs back
+ * into single photons, each with its own jitter, so for a TimeBin well
+ * below the PMT jitter the launches and triggers come out the same
+ * while the map gets much smaller. The total npe of each DOM and
+ * particle is preserved.
+ *
+ * With the default names the input map is replaced.
+ */
+class I3CompactMCPE : public I3ConditionalModule{
+public:
+
+  I3CompactMCPE(const I3Context& ctx);
+  ~I3CompactMCPE(){};
+
+  void Configure();
+  void DAQ(I3FramePtr frame);
+  void Finish(){};
+
+private:
+  std::string inputName_;
+  std::string outputName_;
+  double      timeBin_;
+
+  SET_LOGGER("I3CompactMCPE");
+};
+
+
+I3CompactMCPE::I3CompactMCPE(const I3Context& ctx) :
+  I3ConditionalModule(ctx),
+  inputName_("I3MCPESeriesMap"),
+  outputName_("I3MCPESeriesMap"),
+  timeBin_(0.2*I3Units::ns)
+{
+  AddParameter("InputName",
+               "Name of the MCPE set to read in and compact",
+               inputName_);
+
+  AddParameter("OutputName",
+               "Name of the output MCPE series. If this is the same as "
+               "InputName the input is replaced.",
+               outputName_);
+
+  AddParameter("TimeBin",
+               "PEs from the same particle that come within this time of "
+               "the first one are merged",
+               timeBin_);
+
+  AddOutBox("OutBox");
+}
+
+void I3CompactMCPE::Configure()
+{
+  GetParameter("InputName", inputName_);
+  GetParameter("OutputName", outputName_);
+  GetParameter("TimeBin", timeBin_);
+
+  if(!(timeBin_ >= 0))
+    log_fatal("TimeBin has to be a non-negative time.");
+}
+
+void I3CompactMCPE::DAQ(I3FramePtr frame)
+{
+  I3MCPESeriesMapConstPtr input = frame->Get<I3MCPESeriesMapConstPtr>(inputName_);
+  if(!input){
+    log_warn("Frame is missing input MCPE series '%s'. Cannot compact.",
+             inputName_.c_str());
+    PushFrame(frame,"OutBox");
+    return;
+  }
+
+  I3MCPESeriesMapPtr output(new I3MCPESeriesMap(*input));
+  size_t nBefore = 0, nAfter = 0;
+  for(I3MCPESeriesMap::iterator map_iter = output->begin();
+      map_iter != output->end(); map_iter++){
+    nBefore += map_iter->second.size();
+    compact(map_iter->second, timeBin_);
+    nAfter += map_iter->second.size();
+  }
+  log_debug("Compacted %zu MCPEs into %zu", nBefore, nAfter);
+
+  if(outputName_ == inputName_)
+    frame->Delete(inputName_);
+  frame->Put(outputName_, output);
+  PushFrame(frame,"OutBox");
+}
+
+I3_MODULE(I3CompactMCPE);
@@ -186,6 +186,11 @@ void I3SumGenerator::Initialise(I3RandomServicePtr r, boost::function<double(dou
 }
  
 double I3SumGenerator::Generate(int terms)
+{
+  return Generate(terms, *random_);
+}
+
+double I3SumGenerator::Generate(int terms, I3RandomService& random) const
 {
   double retval;
   if(terms < switchGauss_){
@@ -193,7 +198,7 @@ double I3SumGenerator::Generate(int terms)
      * Low number of terms, read off sum from lookup table for a random
      * value of cumulative probability
      */
-    double xi = random_->Uniform(1.);
+    double xi = random.Uniform(1.);
     /**
      * If probability in lower or upper tail, use finer, cubically spaced tables
      * and interpolate linearly
@@ -221,9 +226,9 @@ double I3SumGenerator::Generate(int terms)
      * Large number of terms, rely on central limit theorem
      */
     double sigma = stdDev_*sqrt((double)terms);
-    retval = random_->Gaus(expectVal_*terms ,sigma);
+    retval = random.Gaus(expectVal_*terms ,sigma);
     while(retval<terms*xLo_ || retval>terms*xHi_)
-    retval = random_->Gaus(expectVal_*terms ,sigma);
+    retval = random.Gaus(expectVal_*terms ,sigma);
   }
   return retval;
 }
@@ -46,6 +46,16 @@ class I3SumGenerator
    */
   double Generate(int terms);
 
+  /**
+   *@brief Generate the value of a sum of random numbers, drawing from the
+   * given random service instead of the one given at initialisation.
+   * The tables are only read, so several threads may share a generator
+   * as long as each uses its own random service.
+   *@param terms   Number of terms in the sum
+   *@param random  The random service to use
+   */
+  double Generate(int terms, I3RandomService& random) const;
+
   /**
    *@brief      Initialise a SumGenerator
    *@param r            Pointer to random number service
@@ -0,0 +1,179 @@
+#!/usr/bin/env python
+
+"""
+Checks that I3CompactMCPE does not change what comes out of the
+detector simulation.  The same I3MCPESeriesMaps are run through
+DOMLauncher and trigger-sim twice, once as they are and once compacted,
+and the distributions of launches and triggers are compared, e.g.
+
+  python validate_compact_mcpe.py -g GCD.i3.gz -i photons.i3.gz -b 1.
+
+The launch and trigger distributions are compared with a
+Kolmogorov-Smirnov test if scipy is around, otherwise the means are
+compared.  The exit status is non-zero if any of them differ.
+"""
+
+from I3Tray import I3Units
+
+from os.path import expandvars
+from optparse import OptionParser
+parser = OptionParser()
+
+parser.add_option("-g","--gcd_file",
+                  dest="gcd_file",
+                  default=expandvars("$I3_TESTDATA/sim/GeoCalibDetectorStatus_IC86.55697_corrected_V2.i3.gz"),
+                  help="I3File which contains the GCD.")
+
+parser.add_option("-i","--infile",
+                  dest="infile",
+                  help="I3File with an I3MCPESeriesMap in the DAQ frames.")
+
+parser.add_option("-b","--time_bin", type = "float",
+                  dest="time_bin", default=0.2,
+                  help="TimeBin of I3CompactMCPE in ns.")
+
+parser.add_option("-n","--nevents", type="int",
+                  dest="nevents", default=0,
+                  help="Number of events to use (0 for all of them).")
+
+parser.add_option("-s","--seed", type="int",
+                  dest="seed", default=0,
+                  help="Seed for the random number generator.")
+
+parser.add_option("-a","--alpha", type="float",
+                  dest="alpha", default=0.01,
+                  help="Smallest p-value that still counts as agreement.")
+
+(options, args) = parser.parse_args()
+
+if not options.infile:
+    parser.error("An input file (-i) is needed.")
+
+import sys
+import math
+
+from I3Tray import I3Tray
+from icecube import icetray
+from icecube import dataclasses
+from icecube import dataio
+from icecube import simclasses
+from icecube import phys_services
+from icecube import sim_services
+from icecube import DOMLauncher
+from icecube import trigger_sim
+
+def simulate(compact):
+    '''
+    Runs the detector simulation over the input file and returns a dict
+    of lists with one entry per event (or per launch for launch times).
+    '''
+    stats = dict()
+    def fill(key, value):
+        stats.setdefault(key, list()).append(value)
+
+    def count_pes(frame):
+        mcpes = frame["I3MCPESeriesMap"]
+        fill("PE entries", sum([len(s) for k,s in mcpes]))
+        fill("npe", sum([pe.npe for k,s in mcpes for pe in s]))
+
+    def count_launches(frame):
+        for name in ("InIceRawData", "IceTopRawData"):
+            launches = frame[name]
+            fill(name + " DOMs", len(launches))
+            fill(name + " launches",
+                 sum([len(s) for k,s in launches]))
+            fill(name + " HLC launches",
+                 sum([1 for k,s in launches for l in s if l.lc_bit]))
+
+        times = [l.time for k,s in frame["InIceRawData"] for l in s]
+        if len(times) > 0:
+            first = min(times)
+            for t in times:
+                fill("InIceRawData launch time", t - first)
+
+        triggers = dict()
+        for t in frame["I3TriggerHierarchy"]:
+            key = "%s %s triggers" % (t.key.source, t.key.type)
+            triggers[key] = triggers.get(key, 0) + 1
+        for key, n in triggers.items():
+            fill(key, n)
+        fill("triggers", sum(triggers.values()))
+
+    tray = I3Tray()
+
+    tray.context["I3RandomService"] = phys_services.I3GSLRandomService(options.seed)
+
+    tray.AddModule("I3Reader", FilenameList = [options.gcd_file, options.infile])
+
+    if compact:
+        tray.AddModule("I3CompactMCPE", TimeBin = options.time_bin*I3Units.ns)
+
+    tray.AddModule(count_pes, Streams = [icetray.I3Frame.DAQ])
+
+    tray.AddSegment(DOMLauncher.DetectorResponse, "DetectorResponse")
+
+    tray.AddSegment(trigger_sim.TriggerSim, "TriggerSim",
+                    gcd_file = dataio.I3File(options.gcd_file),
+                    run_id = 0,
+                    filter_mode = False)
+
+    tray.AddModule(count_launches, Streams = [icetray.I3Frame.DAQ])
+
+    if options.nevents > 0:
+        tray.Execute(options.nevents + 3)
+    else:
+        tray.Execute()
+
+    return stats
+
+def compare(a, b):
+    '''
+    Returns the p-value for a and b coming from the same distribution.
+    '''
+    try:
+        from scipy.stats import ks_2samp
+        return ks_2samp(a, b)[1]
+    except ImportError:
+        # fall back on the difference of the means in standard errors
+        def moments(x):
+            mean = sum(x)/float(len(x))
+            var = sum([(v - mean)**2 for v in x])/max(len(x) - 1, 1)
+            return mean, var/len(x)
+        mean_a, err_a = moments(a)
+        mean_b, err_b = moments(b)
+        if err_a + err_b == 0:
+            return 1. if mean_a == mean_b else 0.
+        z = abs(mean_a - mean_b)/math.sqrt(err_a + err_b)
+        return math.erfc(z/math.sqrt(2))
+
+reference = simulate(compact = False)
+compacted = simulate(compact = True)
+
+print("I3MCPE entries : %d -> %d" % (sum(reference["PE entries"]),
+                                      sum(compacted["PE entries"])))
+print("npe            : %d -> %d" % (sum(reference["npe"]),
+                                      sum(compacted["npe"])))
+
+success = (reference["npe"] == compacted["npe"])
+if not success:
+    print("The compaction changed the number of PEs!")
+
+for key in sorted(set(reference.keys()) | set(compacted.keys())):
+    if key in ("PE entries", "npe"):
+        continue
+    a = reference.get(key, list())
+    b = compacted.get(key, list())
+    if len(a) == 0 or len(b) == 0:
+        print("%-40s only found in one of the samples (%d, %d)" % (key, len(a), len(b)))
+        success = False
+        continue
+    p = compare(a, b)
+    print("%-40s mean %10.2f -> %10.2f  p = %.3f" % (key,
+          sum(a)/float(len(a)), sum(b)/float(len(b)), p))
+    if p < options.alpha:
+        success = False
+
+if not success:
+    print("FAILED : the compacted PEs give different detector response.")
+    sys.exit(1)
+print("SUCCESS")
@@ -0,0 +1,108 @@
+#!/usr/bin/env python
+
+import unittest
+
+from I3Tray import I3Tray
+from I3Tray import I3Units
+from icecube import icetray
+from icecube import dataclasses
+from icecube import simclasses
+from icecube import sim_services
+
+OMKEY = icetray.OMKey(21,30)
+
+class Source(icetray.I3Module):
+    def __init__(self, context):
+        icetray.I3Module.__init__(self, context)
+        self.AddOutBox("OutBox")
+
+    def Configure(self):
+        pass
+
+    def Process(self):
+        frame = icetray.I3Frame(icetray.I3Frame.DAQ)
+        mcpes = simclasses.I3MCPESeries()
+        # two particles, each with 1000 PEs spread over 100 ns
+        for minor_id in (1, 2):
+            for i in range(1000):
+                pe = simclasses.I3MCPE(1, minor_id)
+                pe.time = (i % 500) * 0.2*I3Units.ns
+                pe.npe = 1 + i % 2
+                mcpes.append(pe)
+        mcpemap = simclasses.I3MCPESeriesMap()
+        mcpemap[OMKEY] = mcpes
+        frame["I3MCPESeriesMap"] = mcpemap
+        self.PushFrame(frame)
+
+def npe_by_particle(peseries):
+    npe = dict()
+    for pe in peseries:
+        key = (pe.ID.majorID, pe.ID.minorID)
+        npe[key] = npe.get(key, 0) + pe.npe
+    return npe
+
+class TestI3CompactMCPE(unittest.TestCase):
+
+    def setUp(self):
+        self.tray = I3Tray()
+        self.tray.AddModule(Source)
+
+    def test_compact_MCPE(self):
+
+        self.tray.AddModule("I3CompactMCPE",
+                            OutputName = "CompactedMCPEs",
+                            TimeBin = 1*I3Units.ns)
+
+        def TestModule(frame):
+            self.assertTrue("CompactedMCPEs" in frame)
+            before = frame["I3MCPESeriesMap"][OMKEY]
+            after = frame["CompactedMCPEs"][OMKEY]
+
+            # charge is kept per particle
+            self.assertEqual(npe_by_particle(before), npe_by_particle(after))
+            # five 0.2 ns steps fit into a 1 ns bin
+            self.assertTrue(len(after) < len(before)/5)
+
+            times = [pe.time for pe in after]
+            self.assertEqual(times, sorted(times))
+            self.assertTrue(min(times) >= 0)
+            self.assertTrue(max(times) <= 100*I3Units.ns)
+
+        self.tray.AddModule(TestModule, streams = [icetray.I3Frame.DAQ])
+        self.tray.Execute(1)
+
+    def test_replace_input(self):
+
+        self.tray.AddModule("I3CompactMCPE")
+
+        def TestModule(frame):
+            mcpes = frame["I3MCPESeriesMap"][OMKEY]
+            self.assertEqual(sum([pe.npe for pe in mcpes]), 3000)
+            self.assertTrue(len(mcpes) < 2000)
+
+        self.tray.AddModule(TestModule, streams = [icetray.I3Frame.DAQ])
+        self.tray.Execute(1)
+
+    def test_zero_bin(self):
+        # only PEs at exactly the same time are merged
+        self.tray.AddModule("I3CompactMCPE",
+                            OutputName = "CompactedMCPEs",
+                            TimeBin = 0.)
+
+        def TestModule(frame):
+            mcpes = frame["CompactedMCPEs"][OMKEY]
+            self.assertEqual(len(mcpes), 1000)
+            self.assertEqual(sum([pe.npe for pe in mcpes]), 3000)
+
+        self.tray.AddModule(TestModule, streams = [icetray.I3Frame.DAQ])
+        self.tray.Execute(1)
+
+    def test_failure_negative_bin(self):
+        self.tray.AddModule("I3CompactMCPE", TimeBin = -1*I3Units.ns)
+        self.assertRaises(RuntimeError, self.Execute)
+
+    def Execute(self):
+        self.tray.Execute(1)
+
+if __name__ == '__main__':
+    unittest.main()
@@ -12,6 +12,8 @@ void register_I3MCPESeries()
   {
     scope mcspe_scope = 
       class_<I3MCPE, boost::shared_ptr<I3MCPE> >("I3MCPE")
+      .def(init<const I3ParticleID&>())
+      .def(init<uint64_t, int32_t>())
       .def(dataclass_suite<I3MCPE>())
       .def_readwrite("time",&I3MCPE::time)
       .def_readwrite("npe",&I3MCPE::npe)
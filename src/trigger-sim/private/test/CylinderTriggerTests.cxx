@@ -0,0 +1,146 @@
+#include <I3Test.h>
+
+#include "trigger-sim/algorithms/CylinderTriggerAlgorithm.h"
+#include "trigger-sim/algorithms/TriggerHit.h"
+#include <dataclasses/geometry/I3Geometry.h>
+
+TEST_GROUP(CylinderTriggerTests);
+
+namespace {
+
+  // Strings 125 m apart along x, and 40 DOMs 17 m apart on each. The
+  // cylinder has a radius of 175 m and a height of 75 m, so it holds the
+  // neighbouring string and two DOMs up and down.
+  I3GeometryConstPtr MakeGeometry() {
+    I3GeometryPtr geometry(new I3Geometry());
+    for (int string = 1; string <= 40; string++) {
+      for (unsigned int om = 1; om <= 40; om++) {
+        I3OMGeo omgeo;
+        omgeo.position = I3Position(125.*string, 0., -17.*om);
+        geometry->omgeo[OMKey(string, om)] = omgeo;
+      }
+    }
+    return geometry;
+  }
+
+  const double window = 1000;
+  const double radius = 175;
+  const double height = 75;
+
+  // Four hits on neighbouring DOMs of strings 1 and 2 in 300 ns
+  void AddClusterHits(TriggerHitVectorPtr hits) {
+    hits->push_back(TriggerHit(0, 10, 1));
+    hits->push_back(TriggerHit(100, 10, 2));
+    hits->push_back(TriggerHit(200, 11, 1));
+    hits->push_back(TriggerHit(300, 12, 2));
+  }
+
+  void SortHits(TriggerHitVectorPtr hits) {
+    std::stable_sort(hits->begin(), hits->end());
+  }
+}
+
+TEST(cylinder_at_threshold) {
+  CylinderTriggerAlgorithm cylinderTrigger(window, 4, 10, MakeGeometry(), radius, height);
+  TriggerHitVectorPtr hits(new TriggerHitVector());
+  AddClusterHits(hits);
+
+  cylinderTrigger.AddHits(hits);
+  ENSURE_EQUAL(cylinderTrigger.GetNumberOfTriggers(), 1u, "Four hits in a cylinder should trigger");
+  TriggerHitVectorPtr trigger = cylinderTrigger.GetNextTrigger();
+  ENSURE_EQUAL(trigger->size(), 4u, "All four hits are in the trigger");
+}
+
+TEST(cylinder_below_threshold) {
+  CylinderTriggerAlgorithm cylinderTrigger(window, 4, 10, MakeGeometry(), radius, height);
+  TriggerHitVectorPtr hits(new TriggerHitVector());
+  AddClusterHits(hits);
+  hits->pop_back();
+
+  cylinderTrigger.AddHits(hits);
+  ENSURE_EQUAL(cylinderTrigger.GetNumberOfTriggers(), 0u, "Three hits should not trigger");
+}
+
+TEST(cylinder_outside_time_window) {
+  CylinderTriggerAlgorithm cylinderTrigger(window, 4, 10, MakeGeometry(), radius, height);
+  TriggerHitVectorPtr hits(new TriggerHitVector());
+  hits->push_back(TriggerHit(0, 10, 1));
+  hits->push_back(TriggerHit(600, 10, 2));
+  hits->push_back(TriggerHit(1200, 11, 1));
+  hits->push_back(TriggerHit(1800, 12, 2));
+
+  cylinderTrigger.AddHits(hits);
+  ENSURE_EQUAL(cylinderTrigger.GetNumberOfTriggers(), 0u, "Hits spread over more than the window should not trigger");
+}
+
+TEST(cylinder_pruning_hits) {
+  CylinderTriggerAlgorithm cylinderTrigger(window, 4, 10, MakeGeometry(), radius, height);
+  TriggerHitVectorPtr hits(new TriggerHitVector());
+  AddClusterHits(hits);
+  // one hit far away along x and one far down the same string
+  hits->push_back(TriggerHit(50, 10, 10));
+  hits->push_back(TriggerHit(150, 40, 1));
+  SortHits(hits);
+
+  cylinderTrigger.AddHits(hits);
+  ENSURE_EQUAL(cylinderTrigger.GetNumberOfTriggers(), 1u, "The cluster should trigger");
+  TriggerHitVectorPtr trigger = cylinderTrigger.GetNextTrigger();
+  ENSURE_EQUAL(trigger->size(), 4u, "The far hits are pruned from the trigger");
+  for (TriggerHitVector::const_iterator hit = trigger->begin(); hit != trigger->end(); hit++) {
+    ENSURE(hit->string <= 2 && hit->pos <= 12, "Only the cluster hits are kept");
+    if (hit != trigger->begin())
+      ENSURE((hit-1)->time <= hit->time, "The trigger hits are time ordered");
+  }
+}
+
+TEST(cylinder_pruning_spread_cluster) {
+  // Four hits, but no cylinder holds all of them
+  CylinderTriggerAlgorithm cylinderTrigger(window, 4, 10, MakeGeometry(), radius, height);
+  TriggerHitVectorPtr hits(new TriggerHitVector());
+  hits->push_back(TriggerHit(0, 10, 1));
+  hits->push_back(TriggerHit(100, 10, 2));
+  hits->push_back(TriggerHit(200, 10, 3));
+  hits->push_back(TriggerHit(300, 10, 4));
+
+  cylinderTrigger.AddHits(hits);
+  ENSURE_EQUAL(cylinderTrigger.GetNumberOfTriggers(), 0u, "Hits along a line should not trigger");
+}
+
+TEST(cylinder_simple_multiplicity) {
+  // Five hits far apart, which only trigger on their number
+  TriggerHitVectorPtr hits(new TriggerHitVector());
+  for (int i = 0; i < 5; i++)
+    hits->push_back(TriggerHit(100*i, 10, 1 + 8*i));
+
+  CylinderTriggerAlgorithm simpleTrigger(window, 4, 5, MakeGeometry(), radius, height);
+  simpleTrigger.AddHits(hits);
+  ENSURE_EQUAL(simpleTrigger.GetNumberOfTriggers(), 1u, "Five hits should trigger on simpleMultiplicity");
+  ENSURE_EQUAL(simpleTrigger.GetNextTrigger()->size(), 5u, "No hits are pruned on simpleMultiplicity");
+
+  CylinderTriggerAlgorithm cylinderTrigger(window, 4, 6, MakeGeometry(), radius, height);
+  cylinderTrigger.AddHits(hits);
+  ENSURE_EQUAL(cylinderTrigger.GetNumberOfTriggers(), 0u, "Five hits far apart are below simpleMultiplicity 6");
+}
+
+TEST(cylinder_unknown_dom_simple_multiplicity) {
+  // DOMs missing from the geometry are fine as long as only their number counts
+  TriggerHitVectorPtr hits(new TriggerHitVector());
+  for (int i = 0; i < 5; i++)
+    hits->push_back(TriggerHit(100*i, 10, 99));
+
+  CylinderTriggerAlgorithm cylinderTrigger(window, 4, 5, MakeGeometry(), radius, height);
+  cylinderTrigger.AddHits(hits);
+  ENSURE_EQUAL(cylinderTrigger.GetNumberOfTriggers(), 1u, "Five hits should trigger on simpleMultiplicity");
+}
+
+TEST(cylinder_unknown_dom_in_volume_check) {
+  TriggerHitVectorPtr hits(new TriggerHitVector());
+  AddClusterHits(hits);
+  hits->push_back(TriggerHit(400, 10, 99));
+
+  CylinderTriggerAlgorithm cylinderTrigger(window, 4, 10, MakeGeometry(), radius, height);
+  try {
+    cylinderTrigger.AddHits(hits);
+    FAIL("A DOM missing from the geometry should fail the cylinder check");
+  } catch (const std::exception& e) { }
+}
@@ -193,3 +193,88 @@ TEST(test_merged_length_long_enough){
   ENSURE(merged_iterator->GetTriggerLength() == 28000);
   
 }
+
+// Readout windows are merged whenever they overlap, also when a later
+// trigger has an earlier readout window than the one before it.
+
+TEST(test_merge_unordered_windows){
+
+  I3TriggerReadoutConfig roConfig;
+  roConfig.readoutTimeMinus = 10*I3Units::microsecond;
+  roConfig.readoutTimePlus = 10*I3Units::microsecond;
+  roConfig.readoutTimeOffset = 0*I3Units::microsecond;
+
+  std::map<I3TriggerStatus::Subdetector, I3TriggerReadoutConfig> roConfigMap;    
+  roConfigMap[I3TriggerStatus::ALL] = roConfig;
+
+  I3TriggerStatus ts;
+  ts.GetReadoutSettings() = roConfigMap;
+
+  TriggerKey inice_key=TriggerKey(TriggerKey::IN_ICE, TriggerKey::SIMPLE_MULTIPLICITY);
+  std::map<TriggerKey, I3TriggerStatus> tsMap;
+  tsMap[inice_key] = ts;
+
+  I3DetectorStatus d;
+  d.triggerStatus = tsMap;
+
+  GlobalTriggerSim gts(d);
+
+  TriggerKey global_key=TriggerKey(TriggerKey::GLOBAL, TriggerKey::THROUGHPUT);
+
+  // t2 starts before t1 and ends inside it, t3 is separate
+  I3Trigger t1;
+  t1.GetTriggerKey() = global_key;
+  t1.SetTriggerFired(true);
+  t1.SetTriggerTime(1000);
+  t1.SetTriggerLength(2000);
+  
+  I3Trigger t2;
+  t2.GetTriggerKey() = global_key;
+  t2.SetTriggerFired(true);
+  t2.SetTriggerTime(500);
+  t2.SetTriggerLength(1000);
+  
+  I3Trigger t3;
+  t3.GetTriggerKey() = global_key;
+  t3.SetTriggerFired(true);
+  t3.SetTriggerTime(5000);
+  t3.SetTriggerLength(1000);
+  
+  I3TriggerPairVector tTriggers;
+  tTriggers.push_back( I3TriggerPair( t1, I3Trigger() ) );
+  tTriggers.push_back( I3TriggerPair( t2, I3Trigger() ) );
+  tTriggers.push_back( I3TriggerPair( t3, I3Trigger() ) );
+
+  I3TriggerHierarchyPtr gTriggers = gts.Merge(tTriggers);
+
+  // one merged trigger with two throughputs below it, and t3 on its own
+  ENSURE(gTriggers->size() == 7);
+  ENSURE(gTriggers->number_of_siblings(gTriggers->begin()) == 1);
+
+  I3TriggerHierarchy::iterator merged;
+  for( merged = gTriggers->begin(); merged != gTriggers->end(); merged++ )
+    if( merged->GetTriggerKey().GetType() == TriggerKey::MERGED )
+      break;
+
+  ENSURE( merged != gTriggers->end() );
+  ENSURE( gTriggers->number_of_children(merged) == 2 );
+  ENSURE_DISTANCE( merged->GetTriggerTime(), 500., 1e-6 );
+  ENSURE_DISTANCE( merged->GetTriggerLength(), 2500., 1e-6 );
+
+  // the pruner's view of the same triggers is the union of the windows
+  I3TriggerHierarchy triggers;
+  t1.GetTriggerKey() = inice_key;
+  t2.GetTriggerKey() = inice_key;
+  t3.GetTriggerKey() = inice_key;
+  triggers.insert(triggers.begin(), t1);
+  triggers.insert(triggers.begin(), t2);
+  triggers.insert(triggers.begin(), t3);
+
+  ReadoutWindowUtil roUtil(d);
+  std::vector<std::pair<double,double> > windows =
+    roUtil.GetReadoutWindows(I3TriggerStatus::INICE, triggers);
+
+  ENSURE( windows.size() == 1 );
+  ENSURE_DISTANCE( windows.front().first, 500. - 10*I3Units::microsecond, 1e-6 );
+  ENSURE_DISTANCE( windows.front().second, 6000. + 10*I3Units::microsecond, 1e-6 );
+}
@@ -20,6 +20,7 @@ ClusterTriggerAlgorithm::ClusterTriggerAlgorithm(double triggerWindow, unsigned
 						 unsigned int coherenceLength) : 
   triggerWindow_(triggerWindow),
   triggerThreshold_(triggerThreshold),
+  sitesAboveThreshold_(0),
   triggerCount_(0)
 {
 
@@ -32,7 +33,7 @@ ClusterTriggerAlgorithm::ClusterTriggerAlgorithm(double triggerWindow, unsigned
   log_debug("  CoherenceUp = %d", coherenceUp_);
   log_debug("  CoherenceDown = %d", coherenceDown_);
 
-  hitQueue_.clear();
+  ClearHits();
 }
 
 ClusterTriggerAlgorithm::~ClusterTriggerAlgorithm() {}
@@ -48,7 +49,7 @@ void ClusterTriggerAlgorithm::AddHits(TriggerHitVectorPtr hits)
   triggers_.clear();
   triggerCount_ = 0;
 
-  hitQueue_.clear();
+  ClearHits();
 
   // Iterate over all the hits
   TriggerHitVector::const_iterator nextHit;
@@ -59,7 +60,7 @@ void ClusterTriggerAlgorithm::AddHits(TriggerHitVectorPtr hits)
     // Check for an empty queue
     if (hitQueue_.empty()) {  
       log_debug("Queue is empty, adding new hit");
-      hitQueue_.push_back(*nextHit);
+      PushHit(*nextHit);
       continue;  
     }      
 
@@ -94,7 +95,7 @@ void ClusterTriggerAlgorithm::AddHits(TriggerHitVectorPtr hits)
 	triggers_.push_back(*triggerHits);
 	triggerCount_++;
 
-	hitQueue_.clear();
+	ClearHits();
 	break;
 
       } else {
@@ -103,7 +104,7 @@ void ClusterTriggerAlgorithm::AddHits(TriggerHitVectorPtr hits)
 	log_debug("    No trigger, shift the queue");
 	if(hitQueue_.size() > 0) //////////////// CHANGE THORSTEN --- Here error occured before
 	{
-		hitQueue_.pop_front();
+		PopHit();
 	}
 	else // if size  is 0 break!!!
 	{
@@ -115,7 +116,7 @@ void ClusterTriggerAlgorithm::AddHits(TriggerHitVectorPtr hits)
 
     // Add nextHit to queue
     log_debug("    Hit is in window, adding it to queue");
-    hitQueue_.push_back(*nextHit);  
+    PushHit(*nextHit);  
 
   }
 
@@ -159,49 +160,56 @@ TriggerHitVectorPtr ClusterTriggerAlgorithm::GetNextTrigger() {
   return hits;
 }
 
-bool ClusterTriggerAlgorithm::PosWindow()
+void ClusterTriggerAlgorithm::PushHit(const TriggerHit& hit)
 {
-  log_debug("    Checking position window trigger...");
-
-  bool trigger = false;
-
-  std::map<int, unsigned> coherenceMap;
-
-  // Iterate over the hit queue
-  TriggerHitList::iterator centralHit;
-  for (centralHit = hitQueue_.begin(); centralHit != hitQueue_.end(); centralHit++) {
-
-    // Get the lower and upper bounds
-    unsigned int centralPos = centralHit->pos;
-    int centralString = centralHit->string;
-    int lower = centralPos - coherenceUp_;
-    if (lower < 1) lower = 1;
-    int upper = centralPos + coherenceDown_;
-    if (upper > 60) upper = 60;
-
-    log_debug("      Central hit at (%d, %d)   Pos window = (%d, %d)", centralString, centralPos, lower, upper);
+  hitQueue_.push_back(hit);
+  UpdateCoherence(hit, 1);
+}
 
-    // Iterate over the doms in the coherence window
-    for (int dom = lower; dom <= upper; dom++) {
+void ClusterTriggerAlgorithm::PopHit()
+{
+  UpdateCoherence(hitQueue_.front(), -1);
+  hitQueue_.pop_front();
+}
 
-      // create the key
-      int key = GetHash(centralString, dom);
+void ClusterTriggerAlgorithm::ClearHits()
+{
+  hitQueue_.clear();
+  coherenceCounts_.clear();
+  sitesAboveThreshold_ = 0;
+}
 
-      // Update counter for this dom
-      unsigned counter = 0;
-      std::map<int, unsigned>::const_iterator iter = coherenceMap.find(key);
-      if (iter != coherenceMap.end()) counter = iter->second;
-      counter += 1;
-      coherenceMap[key] = counter;
+void ClusterTriggerAlgorithm::UpdateCoherence(const TriggerHit& hit, int step)
+{
+  // Get the lower and upper bounds
+  unsigned int centralPos = hit.pos;
+  int centralString = hit.string;
+  int lower = centralPos - coherenceUp_;
+  if (lower < 1) lower = 1;
+  int upper = centralPos + coherenceDown_;
+  if (upper > 60) upper = 60;
+
+  // Iterate over the doms in the coherence window
+  for (int dom = lower; dom <= upper; dom++) {
+    std::map<int, unsigned>::iterator iter =
+      coherenceCounts_.insert(std::make_pair(GetHash(centralString, dom), 0u)).first;
+    bool wasAbove = (iter->second > 0 && iter->second >= triggerThreshold_);
+    iter->second += step;
+    bool isAbove = (iter->second > 0 && iter->second >= triggerThreshold_);
+    if (isAbove && !wasAbove) sitesAboveThreshold_++;
+    if (wasAbove && !isAbove) sitesAboveThreshold_--;
+    if (iter->second == 0) coherenceCounts_.erase(iter);
+  }
+}
 
-      log_debug("        Dom (%d, %d) now has count %d", centralString, dom, counter);
+bool ClusterTriggerAlgorithm::PosWindow()
+{
+  log_debug("    Checking position window trigger...");
 
-      if (counter >= triggerThreshold_) trigger = true;
-    }
-    
-  }
+  // The counts of the sites are kept up to date as the queue changes
+  if (sitesAboveThreshold_ == 0) return false;
 
-  if (!trigger) return false;
+  std::map<int, unsigned> coherenceMap(coherenceCounts_);
 
   // Now remove sites from the map that are below threshold
   std::map<int, unsigned>::iterator mapIter;
@@ -268,6 +276,12 @@ bool ClusterTriggerAlgorithm::PosWindow()
     }
     
   }
+
+  // Bring the counts back in line with the pruned queue
+  coherenceCounts_.clear();
+  sitesAboveThreshold_ = 0;
+  for (hitIter = hitQueue_.begin(); hitIter != hitQueue_.end(); hitIter++)
+    UpdateCoherence(*hitIter, 1);
   
   return true;
 }
@@ -41,11 +41,23 @@ class ClusterTriggerAlgorithm
 
   TriggerHitList hitQueue_;
 
+  // The number of hits in hitQueue_ within the coherence window of each
+  // site, updated as hits enter and leave the queue, and the number of
+  // sites at or above threshold
+  std::map<int, unsigned> coherenceCounts_;
+  unsigned int sitesAboveThreshold_;
+
   TriggerHitVectorVector triggers_;
   unsigned int triggerCount_;
 
   bool PosWindow();
 
+  void PushHit(const TriggerHit& hit);
+  void PopHit();
+  void ClearHits();
+  // Adds step (+1 or -1) to the counts of the sites around hit
+  void UpdateCoherence(const TriggerHit& hit, int step);
+
   SET_LOGGER("ClusterTriggerAlgorithm");
 };
 
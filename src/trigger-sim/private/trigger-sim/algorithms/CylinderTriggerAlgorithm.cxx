@@ -11,6 +11,7 @@
 
 #include <trigger-sim/algorithms/CylinderTriggerAlgorithm.h>
 #include <boost/foreach.hpp>
+#include <algorithm>
 
 CylinderTriggerAlgorithm::CylinderTriggerAlgorithm(double triggerWindow, unsigned int triggerThreshold, unsigned int simpleMultiplicity,
 					       I3GeometryConstPtr Geometry, double Radius , double Zdistance) : 
@@ -19,6 +20,7 @@ CylinderTriggerAlgorithm::CylinderTriggerAlgorithm(double triggerWindow, unsigne
   simpleMultiplicity_(simpleMultiplicity),
   Radius_(Radius),
   Zdistance_(Zdistance),
+  unlocatedHits_(0),
   triggerCount_(0)
 {
 
@@ -28,7 +30,7 @@ CylinderTriggerAlgorithm::CylinderTriggerAlgorithm(double triggerWindow, unsigne
   log_debug("  Radius = %g", Radius_);
   log_debug("  ZDistanze = %g", Zdistance_);
 
-  hitQueue_.clear();
+  ClearQueue();
   Geometry_ = Geometry;
 }
 
@@ -44,7 +46,7 @@ void CylinderTriggerAlgorithm::AddHits(TriggerHitVectorPtr hits)
    *------------------------------------------------------------*/
   triggers_.clear();
   triggerCount_ = 0;
-  hitQueue_.clear();
+  ClearQueue();
 
   // Iterate over all the hits
   TriggerHitVector::const_iterator nextHit;
@@ -55,17 +57,17 @@ void CylinderTriggerAlgorithm::AddHits(TriggerHitVectorPtr hits)
     // Check for an empty queue
     if (hitQueue_.empty()) {  
       log_debug("Queue is empty, adding new hit");
-      hitQueue_.push_back(*nextHit);
+      PushHit(*nextHit);
       continue;  
     }      
 
     // Check time window
-    double startTime = hitQueue_.front().time;
+    double startTime = hitQueue_.front().hit.time;
     double stopTime = startTime + triggerWindow_;
     log_debug("    Current time window = (%f, %f)", startTime, stopTime);
 
     // Slide the window until next time is in window
-    while ((nextTime - hitQueue_.front().time)  > triggerWindow_) {
+    while ((nextTime - hitQueue_.front().hit.time)  > triggerWindow_) {
 
       log_debug("    Hit is outside window, checking for trigger...");
 
@@ -83,18 +85,9 @@ void CylinderTriggerAlgorithm::AddHits(TriggerHitVectorPtr hits)
 	log_debug("  We have a trigger!");
 
 	// Copy hits in hitQueue into the vector of vectors
-	
 	if(hitQueue_.size() > 0)
-	{
-	
-	  TriggerHitVectorPtr triggerHits(new TriggerHitVector);
-	  TriggerHitList::const_iterator queueIter;
-	  for (queueIter = hitQueue_.begin(); queueIter != hitQueue_.end(); queueIter++)
-	    triggerHits->push_back(*queueIter);
-	  triggers_.push_back(*triggerHits);
-	  triggerCount_++;
-      	}
-	hitQueue_.clear();
+	  SaveTrigger();
+	ClearQueue();
 	break;
 
       } else {
@@ -103,7 +96,7 @@ void CylinderTriggerAlgorithm::AddHits(TriggerHitVectorPtr hits)
 	log_debug("    No trigger, shift the queue");
 	if(hitQueue_.size() > 0) //////////////// CHANGE THORSTEN --- Here error occured before
 	{
-		hitQueue_.pop_front();
+		PopHit();
 	}
 	else // if size  is 0 break!!!
 	{
@@ -114,7 +107,7 @@ void CylinderTriggerAlgorithm::AddHits(TriggerHitVectorPtr hits)
 
     // Add nextHit to queue
     log_debug("    Hit is in window, adding it to queue");
-    hitQueue_.push_back(*nextHit);  
+    PushHit(*nextHit);  
 
   }
 
@@ -134,12 +127,7 @@ void CylinderTriggerAlgorithm::AddHits(TriggerHitVectorPtr hits)
     // We have a trigger
     log_debug("  We have a trigger!");
     // Copy hits in hitQueue into the vector of vectors
-    TriggerHitVectorPtr triggerHits(new TriggerHitVector);
-    TriggerHitList::const_iterator queueIter;
-    for (queueIter = hitQueue_.begin(); queueIter != hitQueue_.end(); queueIter++)
-      triggerHits->push_back(*queueIter);
-    triggers_.push_back(*triggerHits);
-    triggerCount_++;
+    SaveTrigger();
   }
 }
 
@@ -157,109 +145,118 @@ TriggerHitVectorPtr CylinderTriggerAlgorithm::GetNextTrigger() {
   return hits;
 }
 
+void CylinderTriggerAlgorithm::SaveTrigger()
+{
+  TriggerHitVector triggerHits;
+  triggerHits.reserve(hitQueue_.size());
+  std::deque<QueuedHit>::const_iterator queueIter;
+  for (queueIter = hitQueue_.begin(); queueIter != hitQueue_.end(); queueIter++)
+    triggerHits.push_back(queueIter->hit);
+  triggers_.push_back(triggerHits);
+  triggerCount_++;
+}
+
+bool CylinderTriggerAlgorithm::InVolume(const I3Position& center,
+					const I3Position& other) const
+{
+  double dx = other.GetX() - center.GetX();
+  double dy = other.GetY() - center.GetY();
+  double dz = fabs(other.GetZ() - center.GetZ());
+  double dr = sqrt(dx*dx + dy*dy);
+
+  return (dr < Radius_ && dz < (0.5*Zdistance_));
+}
+
+void CylinderTriggerAlgorithm::PushHit(const TriggerHit& hit)
+{
+  OMKey omkey(hit.string, hit.pos);
+
+  QueuedHit queued;
+  queued.hit = hit;
+  queued.neighbours = 0;
+
+  /// find position, once per hit ///
+  I3OMGeoMap::const_iterator geo_iter = Geometry_->omgeo.find(omkey);
+  queued.located = (geo_iter != Geometry_->omgeo.end());
+  if (!queued.located) {
+    // PosWindow fails if it needs the position
+    unlocatedHits_++;
+    hitQueue_.push_back(queued);
+    return;
+  }
+  queued.position = geo_iter->second.position;
+
+  // The volume is symmetric, so each pair is counted on both sides
+  std::deque<QueuedHit>::iterator iter;
+  for (iter = hitQueue_.begin(); iter != hitQueue_.end(); iter++) {
+    if (iter->located && InVolume(queued.position, iter->position)) {
+      queued.neighbours++;
+      iter->neighbours++;
+    }
+  }
+  hitQueue_.push_back(queued);
+}
+
+void CylinderTriggerAlgorithm::PopHit()
+{
+  const QueuedHit& front = hitQueue_.front();
+  if (!front.located) {
+    unlocatedHits_--;
+    hitQueue_.pop_front();
+    return;
+  }
+
+  std::deque<QueuedHit>::iterator iter;
+  for (iter = hitQueue_.begin() + 1; iter != hitQueue_.end(); iter++)
+    if (iter->located && InVolume(front.position, iter->position))
+      iter->neighbours--;
+  hitQueue_.pop_front();
+}
+
+void CylinderTriggerAlgorithm::ClearQueue()
+{
+  hitQueue_.clear();
+  unlocatedHits_ = 0;
+}
+
 bool CylinderTriggerAlgorithm::PosWindow()
 {
   log_debug("    Checking position window trigger...");
 
-  double x1; 
-  double y1; 
-  double z1;
-  double x2; 
-  double y2; 
-  double z2;
-  double dx;
-  double dy;
-  double dz;
-  double dx2;
-  double dy2;
-  double dr2;
-  double dr;
-  
-  I3OMGeoMap::const_iterator geo_iter; 
-  TriggerHitList tempHits;
-
   if(hitQueue_.size() >= simpleMultiplicity_)
   {
     return true;
   }
-  TriggerHitList::iterator hit1;
-  for (hit1 = hitQueue_.begin(); hit1 != hitQueue_.end(); hit1++) {
-
-    // the hit string and position
-    int hitString = hit1->string;
-    unsigned int hitPos = hit1->pos;
-    log_debug("      Central hit at (%d, %d) - time: %f", hitString, hitPos, hit1->time);
-    
-    OMKey omkey(hitString, hitPos);
-
-    /// find position ///
-    geo_iter = Geometry_->omgeo.find(omkey);
-    if(geo_iter == Geometry_->omgeo.end()){
-      log_fatal("  Warning, OMKey not part of geometry"); // trigger algorithm  does not work when the geometry entry is not there
-      continue;
-    }
-    x1 = geo_iter->second.position.GetX();
-    y1 = geo_iter->second.position.GetY();
-    z1 = geo_iter->second.position.GetZ();
-   
-    tempHits.clear();
-    tempHits.push_back(*hit1);
-
-    TriggerHitList::iterator hit2;
-    for (hit2 = hitQueue_.begin(); hit2 != hitQueue_.end(); hit2++) {
-      if (hit2 == hit1) continue;
-
-      // see if this hit is in the volume
-      unsigned int thisOM = hit2->pos;
-      int thisString = hit2->string;
-      OMKey thisKey(thisString, thisOM);
-      
-        /// find position of other DOMs///
-      geo_iter = Geometry_->omgeo.find(thisKey);
-      if(geo_iter == Geometry_->omgeo.end()){
-	log_fatal("  Warning, OMKey not part of geometry");
-	
-	continue;
-      }
-      x2 = geo_iter->second.position.GetX();
-      y2 = geo_iter->second.position.GetY();
-      z2 = geo_iter->second.position.GetZ();
-      
-      dx = (x2-x1);
-      dy = (y2-y1);
-      dz = fabs(z2-z1); 
-     
-      dx2 = dx*dx;
-      dy2 = dy*dy;
-      
-      dr2 = dx2+dy2;
-      dr = sqrt(dr2);
-      
-      if (dr < Radius_ && dz < (0.5*Zdistance_) ) {
-	tempHits.push_back(*hit2);
- 	log_debug("      Hit at ( R = %f, Z = %f) OM(%d, %d) is in the volume - t: %f", dr, dz, thisString, thisOM, hit2->time);
-      } else {
- 	log_debug("      Hit at ( R = %f, Z = %f) OM(%d, %d) is not in the volume - t: %f", dr, dz, thisString, thisOM, hit2->time);
-      }
-    }
-    log_debug("    There are %zd hits in this volume", tempHits.size());
-   
-    // how many hits do we have?
-    if (tempHits.size() >= triggerThreshold_)
-    {
-      log_debug("    Found a volume over threshold (%d)", triggerThreshold_);
-      
-      tempHits.sort();
-      hitQueue_.clear();
-      for (TriggerHitList::iterator iter = tempHits.begin(); iter != tempHits.end(); iter++) 
-      {
-      	hitQueue_.push_back(*iter);
-      }
-      
-      return true;  
-    }
 
+  if(unlocatedHits_ > 0)
+    log_fatal("  Warning, OMKey not part of geometry"); // trigger algorithm  does not work when the geometry entry is not there
+
+  // The first hit, in time, with enough hits in its volume
+  std::deque<QueuedHit>::const_iterator hit1;
+  for (hit1 = hitQueue_.begin(); hit1 != hitQueue_.end(); hit1++)
+    if (hit1->neighbours + 1 >= triggerThreshold_)
+      break;
+  if (hit1 == hitQueue_.end())
+    return false;
+
+  log_debug("    Found a volume over threshold (%d) around OM(%d, %d)",
+	    triggerThreshold_, hit1->hit.string, hit1->hit.pos);
+
+  // Keep only that hit and the ones in its volume
+  std::vector<TriggerHit> tempHits;
+  tempHits.reserve(hit1->neighbours + 1);
+  tempHits.push_back(hit1->hit);
+  std::deque<QueuedHit>::const_iterator hit2;
+  for (hit2 = hitQueue_.begin(); hit2 != hitQueue_.end(); hit2++) {
+    if (hit2 == hit1) continue;
+    if (InVolume(hit1->position, hit2->position))
+      tempHits.push_back(hit2->hit);
   }
+  std::stable_sort(tempHits.begin(), tempHits.end());
+
+  ClearQueue();
+  for (std::vector<TriggerHit>::const_iterator iter = tempHits.begin(); iter != tempHits.end(); iter++)
+    PushHit(*iter);
 
-  return false;
+  return true;
 }
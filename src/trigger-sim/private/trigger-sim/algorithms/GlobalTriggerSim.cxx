@@ -17,10 +17,18 @@
 #include <dataclasses/I3Time.h>
 #include "trigger-sim/utilities/ReadoutWindowUtil.h"
 #include <boost/foreach.hpp>
+#include <algorithm>
 using namespace std;
 
 typedef std::map<I3TriggerStatus::Subdetector, I3TriggerReadoutConfig> roconfigmap_t;
 
+namespace {
+  // Orders throughput triggers by the start of their readout windows
+  bool EarlierReadout(const I3TriggerPair* a, const I3TriggerPair* b){
+    return a->first.GetTriggerTime() < b->first.GetTriggerTime();
+  }
+}
+
 
 void GlobalTriggerSim::InsertThroughputTriggers(std::vector<I3Trigger>& triggerStream,
 						std::vector< std::pair< I3Trigger, I3Trigger> >& triggerPairs){
@@ -99,14 +107,35 @@ GlobalTriggerSim::Merge(const I3TriggerPairVector& tpTriggers){
 
   I3TriggerHierarchyPtr mergedTriggers(new I3TriggerHierarchy() );
 
-  BOOST_FOREACH( const I3TriggerPair& tpair, tpTriggers ){
+  /**
+   * Sweep the readout windows in order of their start times.  The top level
+   * windows built so far are then disjoint and the last one has the latest
+   * start, so it is the only one the next window can overlap with.  This
+   * keeps the merging O(n log n) instead of searching the tree for every
+   * trigger.
+   */
+  std::vector<const I3TriggerPair*> sorted;
+  sorted.reserve(tpTriggers.size());
+  BOOST_FOREACH( const I3TriggerPair& tpair, tpTriggers )
+    sorted.push_back(&tpair);
+  std::stable_sort(sorted.begin(), sorted.end(), EarlierReadout);
+
+  I3TriggerHierarchy::iterator last_iter = mergedTriggers->end();
+
+  BOOST_FOREACH( const I3TriggerPair* tpair_ptr, sorted ){
+    const I3TriggerPair& tpair = *tpair_ptr;
     
-    I3TriggerHierarchy::iterator overlap_iter = FindOverlap( mergedTriggers, tpair.first );
+    I3TriggerHierarchy::iterator overlap_iter = mergedTriggers->end();
+    if( last_iter != mergedTriggers->end() &&
+        tpair.first.GetTriggerTime() >= last_iter->GetTriggerTime() && 
+        tpair.first.GetTriggerTime() <= last_iter->GetTriggerTime() + last_iter->GetTriggerLength() )
+      overlap_iter = last_iter;
  
     if( overlap_iter == mergedTriggers->end() ){
       // no overlap in the tree
       I3TriggerHierarchy::iterator tt_iter = mergedTriggers->insert( mergedTriggers->begin() , tpair.first);
       mergedTriggers->append_child( tt_iter, tpair.second );
+      last_iter = tt_iter;
     }else{
       // found an overlap
       // if it's already a MERGED we only need to add the child and expand the window
@@ -159,6 +188,7 @@ GlobalTriggerSim::Merge(const I3TriggerPairVector& tpTriggers){
 
 	mergedTriggers->erase_children( overlap_iter );
 	mergedTriggers->erase( overlap_iter );
+	last_iter = m_iter;
 
       }
       //need a check that it's one or the other
@@ -166,18 +196,3 @@ GlobalTriggerSim::Merge(const I3TriggerPairVector& tpTriggers){
   }
   return mergedTriggers;
 }
-
-
-I3TriggerHierarchy::iterator GlobalTriggerSim::FindOverlap(I3TriggerHierarchyConstPtr tree, const I3Trigger& t ){
-  
-  I3TriggerHierarchy::fixed_depth_iterator fd_iter;
-  for(fd_iter = tree->begin_fixed(tree->begin(),0);
-      tree->is_valid(fd_iter) ;  ++fd_iter ){
-    if( t.GetTriggerTime() >= fd_iter->GetTriggerTime() && 
-	t.GetTriggerTime() <= fd_iter->GetTriggerTime() + fd_iter->GetTriggerLength() ){
-      // there's an overlap
-      return I3TriggerHierarchy::iterator(fd_iter);
-    } 
-  }
-  return tree->end();
-}
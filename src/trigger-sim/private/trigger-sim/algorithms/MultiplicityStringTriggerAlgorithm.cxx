@@ -13,6 +13,7 @@
 #include <trigger-sim/algorithms/TimeWindow.h>
 #include <boost/foreach.hpp>
 #include <boost/assign/std/vector.hpp>
+#include <algorithm>
 
 using namespace boost::assign;
 
@@ -112,20 +113,29 @@ bool MultiplicityStringTriggerAlgorithm::PosWindow(TriggerHitVectorPtr inputHits
    * Check Veto condition
    *------------------------------------------------------------*/
 
-  bool veto = false;
   BOOST_FOREACH(const TriggerHit& hit1, *inputHits) {
     unsigned int pos1 = hit1.pos;
     if (pos1 <= vetoDepth_) {
       log_debug("  VETO: Hit in veto region (<= %u): %u", vetoDepth_, pos1);
-      veto = true;
+      return false;
     }
   }
-  if (veto) return false;
 
   /*------------------------------------------------------------*
    * Check Topology
    *------------------------------------------------------------*/
 
+  // Histogram the hit positions, cumulatively, so that the number of hits
+  // in any position window is a difference of two entries
+  unsigned int maxPos = 0;
+  BOOST_FOREACH(const TriggerHit& hit, *inputHits)
+    maxPos = std::max(maxPos, hit.pos);
+  std::vector<unsigned int> hitsBelow(maxPos + 2, 0);
+  BOOST_FOREACH(const TriggerHit& hit, *inputHits)
+    hitsBelow[hit.pos + 1]++;
+  for (unsigned int pos = 1; pos < hitsBelow.size(); pos++)
+    hitsBelow[pos] += hitsBelow[pos - 1];
+
   // loop over all hits and use each as the start of the trigger window
   unsigned int count = 0;
   BOOST_FOREACH(const TriggerHit& hit1, *inputHits){
@@ -135,17 +145,10 @@ bool MultiplicityStringTriggerAlgorithm::PosWindow(TriggerHitVectorPtr inputHits
 
     log_debug("    New position window = (%d,%d)", startPos, stopPos);
 
-    // now loop over all other hits and store any that fall in this window
-    BOOST_FOREACH(const TriggerHit& hit2, *inputHits){
-      unsigned int pos = hit2.pos;
-      log_debug("      Checking hit at %d", pos);
-      if ( (pos >= startPos) && (pos <= stopPos) ) {
-	count++;
-	log_debug("        Hit in window, count = %d", count);
-      } else {
-	log_debug("        Hit not in window");
-      }
-    }
+    // add the number of hits that fall in this window
+    if (stopPos >= startPos)
+      count += hitsBelow[std::min(stopPos, maxPos) + 1] - hitsBelow[startPos];
+    log_debug("        Hits in windows so far = %d", count);
 
     // next check if trigger is satisfied for this window
     if (count >= triggerThreshold_) {
@@ -21,7 +21,9 @@ class TimeWindow
   ~TimeWindow();
 
   /**
-   * Sliding time windows
+   * Sliding time windows. The hits must be time ordered. This makes a
+   * single pass over the hits, keeping the current time window and
+   * trigger window as ranges of indices into them.
    */
   TriggerHitIterPairVectorPtr SlidingTimeWindows(TriggerHitVectorPtr hits);
   TriggerHitIterPairVectorPtr SlidingTimeWindows(TriggerHitVector& hits);
@@ -38,16 +40,16 @@ class TimeWindow
    */
   TimeWindow();
 
-  void DumpHits(TriggerHitList& hits, const std::string& head, const std::string& pad);
-  void CopyHits(TriggerHitList& sourceHits, TriggerHitList& destHits);
-  bool Overlap(TriggerHitList& hits1, TriggerHitList& hits2);
+  /**
+   * The iterators bounding the hits [first, last) of a trigger window,
+   * from the first hit at the time of the first and the first hit at the
+   * time of the last.
+   */
+  TriggerHitIterPair WindowBounds(const TriggerHitVector& hits, size_t first, size_t last);
 
   unsigned int threshold_;
   double window_;
 
-  TriggerHitListPtr timeWindowHits_;
-  TriggerHitListPtr triggerWindowHits_;
-
   SET_LOGGER("TimeWindow");
 };
 
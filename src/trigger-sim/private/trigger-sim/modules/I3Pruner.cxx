@@ -8,6 +8,7 @@
  */
 
 #include <iostream>
+#include <cmath>
 #include "icetray/I3TrayHeaders.h"
 #include "dataclasses/physics/I3Trigger.h"
 #include "dataclasses/physics/I3TriggerHierarchy.h"
@@ -56,9 +57,14 @@ void I3Pruner::DAQ(I3FramePtr frame){
   // Get the trigger hierarchy
   I3TriggerHierarchyConstPtr gTrigger = frame->Get<I3TriggerHierarchyConstPtr>(triggerName_);
   
-  I3TriggerHierarchy::iterator th_iter;
   if (gTrigger && gTrigger->size()) {
 
+    // The readout windows of all the triggers, merged and sorted by time,
+    // so that the launches of each DOM can be checked in one sweep
+    typedef std::vector<std::pair<double,double> > WindowVector;
+    WindowVector iniceWindows = rwUtil.GetReadoutWindows(I3TriggerStatus::INICE, *gTrigger);
+    WindowVector icetopWindows = rwUtil.GetReadoutWindows(I3TriggerStatus::ICETOP, *gTrigger);
+
     BOOST_FOREACH(std::string dataReadoutName, dataReadoutNames_) { // suppose you have several input maps, loops through all
 
       // skip if the map isn't found in the frame
@@ -74,61 +80,32 @@ void I3Pruner::DAQ(I3FramePtr frame){
       I3DOMLaunchSeriesMap::const_iterator iter;
       for (iter = dlsInMap->begin(); iter != dlsInMap->end(); ++iter) { // loop thorugh all doms in this dataReadoutName
 
-	// get the sub-detector of these launches
-	bool hitIsInIce = iter->first.IsInIce();
-	bool hitIsIceTop = iter->first.IsIceTop();
+	// get the readout windows for the sub-detector of these launches
+	const WindowVector* windows = NULL;
+	if (iter->first.IsInIce())
+	  windows = &iniceWindows;
+	else if (iter->first.IsIceTop())
+	  windows = &icetopWindows;
+	if (!windows)
+	  continue;
 
 	I3DOMLaunchSeries launch_series;
+	WindowVector::const_iterator window = windows->begin();
+	double lastTime = -INFINITY;
 	I3DOMLaunchSeries::const_iterator dlIter;
 	for (dlIter = iter->second.begin(); dlIter != iter->second.end(); ++dlIter) { // loop through the launches per dom
 
-	  bool keepHit = false;
 	  double hitTime = dlIter->GetStartTime();
 
-	  // check the trigger hierarchy for a readout window that includes this hit
-	  for (th_iter = gTrigger->begin(); th_iter != gTrigger->end(); th_iter++) {
-
-	    // make sure this is a subdetector trigger (inice or icetop)
-	    bool triggerIsInIce = th_iter->GetTriggerKey().GetSource() == TriggerKey::IN_ICE;
-	    bool triggerIsIceTop = th_iter->GetTriggerKey().GetSource() == TriggerKey::ICE_TOP;
-
-	    if ( triggerIsInIce || triggerIsIceTop ) {
-
-	      // Get the readout windows
-	      const I3Trigger& trigger = *th_iter;
-	      std::pair<double,double> iniceReadoutWindow = rwUtil.GetInIceReadoutWindow(trigger);
-	      std::pair<double,double> icetopReadoutWindow = rwUtil.GetIceTopReadoutWindow(trigger);
-			 
-	      // Get the times (initalize to inice)
-	      double earliestTime = iniceReadoutWindow.first;
-	      double latestTime = iniceReadoutWindow.second;
-	      if (hitIsIceTop) {
-		earliestTime = icetopReadoutWindow.first;
-		latestTime = icetopReadoutWindow.second;
-	      }
-
-	      // See if this hit should be kept
-	      if (hitIsInIce && earliestTime != NAN && latestTime != NAN) {
-		// This is an inice hit and the inice readout window is valid
-		if ( (hitTime >= earliestTime) && (hitTime <= latestTime) )
-		  keepHit = true;
-	      }
-
-	      if (hitIsIceTop && earliestTime != NAN && latestTime != NAN) {
-		// This is an icetop hit and the icetop readout window is valid
-		if ( (hitTime >= earliestTime) && (hitTime <= latestTime) )
-		  keepHit = true;
-	      }
-
-	    }
- 
-	    // if we know we want it, break the iteration over sub-detector triggers
-	    if (keepHit) break;
-
-	  } // end loop over triggers
-
-	  // now see if we kept this hit
-	  if (keepHit) {
+	  // the launches are time ordered, so the window only moves forward;
+	  // start over if they aren't
+	  if (hitTime < lastTime)
+	    window = windows->begin();
+	  lastTime = hitTime;
+	  while (window != windows->end() && window->second < hitTime)
+	    window++;
+
+	  if (window != windows->end() && hitTime >= window->first) {
 	    //only push back events within the readout time window
 	    launch_series.push_back(*dlIter);             
 	  }
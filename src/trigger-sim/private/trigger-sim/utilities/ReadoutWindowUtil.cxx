@@ -1,5 +1,6 @@
 #include "trigger-sim/utilities/ReadoutWindowUtil.h"
 #include "dataclasses/TriggerKey.h"
+#include <algorithm>
 
 ReadoutWindowUtil::ReadoutWindowUtil(const I3DetectorStatus& detectorStatus) 
 {
@@ -34,6 +35,37 @@ double ReadoutWindowUtil::GetLatestReadoutTime(const I3Trigger& trigger) {
   
 }
 
+std::vector<std::pair<double,double> >
+ReadoutWindowUtil::GetReadoutWindows(I3TriggerStatus::Subdetector subdetector,
+				     const I3TriggerHierarchy& triggers) {
+
+  std::vector<std::pair<double,double> > windows;
+  I3TriggerHierarchy::iterator iter;
+  for (iter = triggers.begin(); iter != triggers.end(); iter++) {
+    TriggerKey::SourceID source = iter->GetTriggerKey().GetSource();
+    if (source != TriggerKey::IN_ICE && source != TriggerKey::ICE_TOP)
+      continue;
+
+    std::pair<double,double> window = GetReadoutWindow(subdetector, *iter);
+    // this also skips the NANs of triggers without a readout window
+    if (window.first <= window.second)
+      windows.push_back(window);
+  }
+
+  // Merge the overlapping windows
+  std::sort(windows.begin(), windows.end());
+  std::vector<std::pair<double,double> > merged;
+  std::vector<std::pair<double,double> >::const_iterator window;
+  for (window = windows.begin(); window != windows.end(); window++) {
+    if (!merged.empty() && window->first <= merged.back().second)
+      merged.back().second = std::max(merged.back().second, window->second);
+    else
+      merged.push_back(*window);
+  }
+
+  return merged;
+}
+
 /**
  * Return one readout window corresponding to subdetector InIce or IceTop
  *
@@ -15,6 +15,7 @@
 #include "icetray/I3Logging.h"
 #include "trigger-sim/algorithms/TriggerHit.h"
 #include <dataclasses/geometry/I3Geometry.h>
+#include <deque>
 
 class CylinderTriggerAlgorithm
 {
@@ -37,14 +38,33 @@ class CylinderTriggerAlgorithm
   double Radius_; 
   double Zdistance_; 
   I3GeometryConstPtr Geometry_;
-  
-  TriggerHitList hitQueue_;
+
+  // A hit in the queue, with the position of its DOM and the number of
+  // other hits in the queue inside its cylinder, kept up to date as hits
+  // enter and leave the queue. Hits on DOMs missing from the geometry are
+  // queued without a position, since the simpleMultiplicity check does not
+  // need one.
+  struct QueuedHit {
+    TriggerHit hit;
+    bool located;
+    I3Position position;
+    unsigned int neighbours;
+  };
+  std::deque<QueuedHit> hitQueue_;
+  // The number of queued hits without a position
+  unsigned int unlocatedHits_;
   
   TriggerHitVectorVector triggers_;
   unsigned int triggerCount_;
 
   bool PosWindow();
 
+  void PushHit(const TriggerHit& hit);
+  void PopHit();
+  void ClearQueue();
+  bool InVolume(const I3Position& center, const I3Position& other) const;
+  void SaveTrigger();
+
 
   SET_LOGGER("CylinderTriggerAlgorithm");
 };
@@ -64,8 +64,6 @@ class GlobalTriggerSim
     
     I3TriggerHierarchyPtr Merge( const std::vector< std::pair<I3Trigger, I3Trigger > >& );
 
-    I3TriggerHierarchy::iterator FindOverlap(I3TriggerHierarchyConstPtr, const I3Trigger&);
-
 };
 
 #endif //GLOBALTRIGGERSIM_H
@@ -13,6 +13,7 @@
  */
 
 #include "dataclasses/physics/I3Trigger.h"
+#include "dataclasses/physics/I3TriggerHierarchy.h"
 #include "dataclasses/TriggerKey.h"
 #include "dataclasses/status/I3DetectorStatus.h"
 #include "dataclasses/status/I3TriggerStatus.h"
@@ -39,6 +40,15 @@ class ReadoutWindowUtil
   double GetEarliestReadoutTime(const I3Trigger& trigger);
   double GetLatestReadoutTime(const I3Trigger& trigger);
 
+  /**
+   * The union of the readout windows for subdetector of all the in-ice and
+   * icetop triggers in the hierarchy, as disjoint closed intervals sorted
+   * by time.  Triggers without a readout window are skipped.
+   */
+  std::vector<std::pair<double,double> >
+  GetReadoutWindows(I3TriggerStatus::Subdetector subdetector,
+		    const I3TriggerHierarchy& triggers);
+
  private:
 
   std::map<TriggerKey, I3TriggerStatus> triggerStatus_;
@@ -39,3 +39,27 @@ TEST(HitSeriesMapAddition){
 
   ENSURE(n_hits == 3,"Wrong number of hits in the map.");
 }
+
+TEST(HitSeriesMapMergeInPlace){
+  I3MCPESeriesMap hits;
+  I3MCPESeriesMap noise;
+  OMKey omkey(21,30);
+  for (int i = 0; i < 5; i++){
+    I3MCPE hit;
+    hit.time = 10*i;
+    hits[omkey].push_back(hit);
+    hit.time = 10*i + 5;
+    noise[omkey].push_back(hit);
+  }
+  I3MCPE hit;
+  hit.time = 1;
+  noise[OMKey(29,30)].push_back(hit);
+
+  MergeHitMaps(hits, noise);
+
+  ENSURE_EQUAL(hits.size(), 2u, "Wrong number of DOMs in the map.");
+  const I3MCPESeries& merged = hits[omkey];
+  ENSURE_EQUAL(merged.size(), 10u, "Wrong number of hits on the DOM.");
+  for (size_t i = 1; i < merged.size(); i++)
+    ENSURE(merged[i-1].time <= merged[i].time, "Merged hits are not time ordered.");
+}
@@ -1,6 +1,7 @@
 #include <I3Test.h>
 
 #include "phys-services/I3GSLRandomService.h"
+#include "SplitRandomService.h"
 #include "icetray/I3Units.h"
 
 #include "vuvuzela/VuvuzelaFunctions.h"
@@ -37,3 +38,51 @@ TEST(NonThermalNoise){
 
   ENSURE_DISTANCE(bufferset.size(), expected, 10, "Unexpected number of hits for nonthermal processes in 1 s.");
 }
+
+TEST(BulkNonThermalNoise){
+  // Both versions draw the same numbers of each distribution
+  boost::shared_ptr<SplitRandomService> setRandom(new SplitRandomService(1000));
+  SplitRandomService bulkRandom(1000);
+
+  std::vector<double> buffer(4, 100);
+  double bufferTime = 3 * I3Units::second;
+  double nhits = 10;
+  double mean = 3;
+  double sigma = 3;
+  double rate = 100 * I3Units::hertz;
+  double start = 0 * I3Units::second;
+  double stop = 1 * I3Units::second;
+
+  for (int disableCutoff = 0; disableCutoff < 2; disableCutoff++){
+    std::set<double> bufferset(buffer.begin(), buffer.end());
+    MakeNonThermalHits(setRandom,
+		       bufferset,
+		       bufferTime,
+		       rate,
+		       nhits,
+		       mean,
+		       sigma,
+		       start,
+		       stop,
+		       disableCutoff);
+
+    std::vector<double> bulk(buffer);
+    MakeNonThermalHits(bulkRandom,
+		       bulk,
+		       bufferTime,
+		       rate,
+		       nhits,
+		       mean,
+		       sigma,
+		       start,
+		       stop,
+		       disableCutoff);
+
+    ENSURE(bulk.size() > buffer.size() + (stop-start)*rate/2, "Too few hits for nonthermal processes in 1 s.");
+    ENSURE(std::equal(buffer.begin(), buffer.end(), bulk.begin()), "Buffered hits were changed");
+    std::sort(bulk.begin(), bulk.end());
+    bulk.erase(std::unique(bulk.begin(), bulk.end()), bulk.end());
+    ENSURE_EQUAL(bulk.size(), bufferset.size(), "Different number of hits from the std::set version");
+    ENSURE(std::equal(bulk.begin(), bulk.end(), bufferset.begin()), "Different hits from the std::set version");
+  }
+}
@@ -1,6 +1,7 @@
 #include <I3Test.h>
 
 #include "phys-services/I3GSLRandomService.h"
+#include "SplitRandomService.h"
 #include "icetray/I3Units.h"
 
 #include "vuvuzela/VuvuzelaFunctions.h"
@@ -30,3 +31,38 @@ TEST(ThermalNoise){
 
   ENSURE_DISTANCE(bufferset.size(), expected, 10, "Unexpected number of hits for 100 hz in 1 second");
 }
+
+TEST(BulkThermalNoise){
+  // Both versions draw the same numbers of each distribution
+  boost::shared_ptr<SplitRandomService> setRandom(new SplitRandomService(1000));
+  SplitRandomService bulkRandom(1000);
+  
+  std::vector<double> buffer(4, 100);
+  double bufferTime = 3 * I3Units::second;
+  double rate = 1000 * I3Units::hertz;
+  double start = 0 * I3Units::second;
+  double stop = 1 * I3Units::second;
+
+  std::set<double> bufferset(buffer.begin(), buffer.end());
+  MakeThermalHits(setRandom,
+		  bufferset,
+		  bufferTime,
+		  rate,
+		  start,
+		  stop);
+
+  MakeThermalHits(bulkRandom,
+		  buffer,
+		  bufferTime,
+		  rate,
+		  start,
+		  stop);
+
+  ENSURE_EQUAL(buffer[3], 100, "Buffered hits were changed");
+  for (size_t i = 4; i < buffer.size(); i++)
+    ENSURE(buffer[i] >= bufferTime && buffer[i] <= bufferTime + stop - start, "Hit outside of the time window");
+  std::sort(buffer.begin(), buffer.end());
+  buffer.erase(std::unique(buffer.begin(), buffer.end()), buffer.end());
+  ENSURE_EQUAL(buffer.size(), bufferset.size(), "Different number of hits from the std::set version");
+  ENSURE(std::equal(buffer.begin(), buffer.end(), bufferset.begin()), "Different hits from the std::set version");
+}
@@ -0,0 +1,27 @@
+#ifndef VUVUZELA_SPLITRANDOMSERVICE_H_INCLUDED
+#define VUVUZELA_SPLITRANDOMSERVICE_H_INCLUDED
+
+#include "phys-services/I3GSLRandomService.h"
+
+/**
+ * A random service which draws uniform, Poisson and Gaussian numbers from
+ * three separate streams. The numbers of each distribution then come out
+ * the same whatever order the distributions are drawn in, so the bulk and
+ * the std::set versions of the hit generators must make the same hits.
+ */
+class SplitRandomService : public I3RandomService{
+ public:
+  SplitRandomService(unsigned long seed):
+    uniform_(seed), poisson_(seed + 1), gaus_(seed + 2) {}
+
+  double Uniform(double x1, double x2){ return uniform_.Uniform(x1, x2); }
+  int Poisson(double mean){ return poisson_.Poisson(mean); }
+  double Gaus(double mean, double stddev){ return gaus_.Gaus(mean, stddev); }
+
+ private:
+  I3GSLRandomService uniform_;
+  I3GSLRandomService poisson_;
+  I3GSLRandomService gaus_;
+};
+
+#endif
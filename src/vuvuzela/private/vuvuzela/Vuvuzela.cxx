@@ -2,6 +2,11 @@
 
 #include "vuvuzela/Vuvuzela.h"
 #include <cmath>
+#include <limits>
+
+#include <boost/thread.hpp>
+
+#include "phys-services/I3PhiloxRandomService.h"
 
 /* ******************************************************************** */ 
 /* Constructor                                                          */
@@ -73,6 +78,12 @@ Vuvuzela::Vuvuzela(const I3Context& ctx) : I3Module(ctx)
   randomServiceName_ = std::string("I3RandomService");
   AddParameter("RandomServiceName","Name of RNG in the context",randomServiceName_);
 
+  numThreads_ = 0;
+  AddParameter("NumThreads", "The number of threads among which to divide the DOMs. If zero, "
+	       "all random numbers are drawn directly from the random service. Otherwise each DOM "
+	       "draws from its own substream, seeded once per frame from the random service, so "
+	       "that the noise is the same for any number of threads.", numThreads_);
+
   AddOutBox("OutBox");
 }
 
@@ -105,6 +116,7 @@ Vuvuzela::~Vuvuzela()
  * ScintillationHits The expected number of hits from a cluster.
  * UseIndividual Use individual numbers for each DOM?
  * DisableLowDTCutoff Removes the truncation at 2 microseconds for the timing distribution of noise hits 
+ * NumThreads The number of threads to generate noise with. Zero for none.
  *//******************************************************************* */ 
 void Vuvuzela::Configure()
 {
@@ -129,6 +141,7 @@ void Vuvuzela::Configure()
   GetParameter("UseIndividual", useIndividual_);
   GetParameter("SimulateNewDOMs", simulateNewDoms_);
   GetParameter("DisableLowDTCutoff", disableLowDTcutoff_);
+  GetParameter("NumThreads", numThreads_);
 
   //   Check to see if valid values were passed
   if (endWindow_ < startWindow_)
@@ -167,7 +180,10 @@ void Vuvuzela::Configure()
       log_fatal("No Random Service configured!");
   }
 
-  bufferMap.clear();
+  buffers_.clear();
+  calibration_.reset();
+  frameStart_ = frameStop_ = 0;
+  frameSeed_ = 0;
   firstTime = true;
   nhits = 0;
   bufferTime = 0 * I3Units::second;
@@ -192,10 +208,49 @@ void Vuvuzela::Finish()
  *  \param frame The frame to process
  *//******************************************************************* */ 
 void Vuvuzela::DAQ(I3FramePtr frame)
+{
+  I3MCPESeriesMapConstPtr inputHitMap = BeginFrame(frame);
+  
+  // Get the noise hits for this event
+  I3MCPESeriesMapConstPtr noiseMap = GetNoiseHits(*calibration_,
+						  frameStart_, frameStop_);
+  
+  // Add the generated hits to the old hitmap
+  I3MCPESeriesMapConstPtr outputHitMap = AddHitMaps(inputHitMap, noiseMap);
+  
+  // If no output name is given, overwrite the input hit map. 
+  if (outputHitSeriesMapName_.size() == 0) {
+    frame->Delete(inputHitSeriesMapName_);
+    frame->Put(inputHitSeriesMapName_, outputHitMap);
+  }
+  // otherwise, use the new name
+  else {
+    frame->Put(outputHitSeriesMapName_, outputHitMap);
+  }
+  
+  EndFrame();
+  
+  PushFrame(frame, "OutBox");
+  
+}
+
+/* ******************************************************************** */ 
+/* BeginFrame                                                           */
+/** Finds the time window to simulate noise for in a frame, filling the
+ *  buffers first if this is the first frame. Either GetNoiseHits for
+ *  the window, or AddDOMNoise for each of the good DOMs in turn, may
+ *  then be called, followed by EndFrame.
+ *
+ *  \param frame The frame to process
+ *  \returns The input hit map, or an empty one in noise-only mode
+ *//******************************************************************* */ 
+I3MCPESeriesMapConstPtr Vuvuzela::BeginFrame(I3FramePtr frame)
 {
   // Load the GCD first
   const I3Geometry& geometry = frame->Get<I3Geometry>();
-  const I3Calibration& calib = frame->Get<I3Calibration>();
+  calibration_ = frame->Get<I3CalibrationConstPtr>();
+  if (!calibration_)
+    log_fatal("No I3Calibration is present in the frame!");
   
   // Get the hit series
   I3MCPESeriesMapConstPtr inputHitMap;
@@ -234,14 +289,14 @@ void Vuvuzela::DAQ(I3FramePtr frame)
   }
  
   // Set the bounds for the noise sampling
-  double start = range.first + startWindow_;
-  double stop = range.second + endWindow_;
+  frameStart_ = range.first + startWindow_;
+  frameStop_ = range.second + endWindow_;
   
   // The first time the DAQ method is called, fill the buffer with long dt hits
   if (firstTime){
-    GetGoodDoms(geometry, calib);
+    GetGoodDoms(geometry, *calibration_);
 
-    GetNoiseHits(calib,
+    GetNoiseHits(*calibration_,
                  -0.1 * I3Units::second,
                  0 * I3Units::second);
     
@@ -249,29 +304,18 @@ void Vuvuzela::DAQ(I3FramePtr frame)
     nhits = 0;
     log_trace("Filled the hit buffer.");
   }
-  
-  // Get the noise hits for this event
-  I3MCPESeriesMapConstPtr noiseMap = GetNoiseHits(calib,
-						  start, stop);
-  
-  // Add the generated hits to the old hitmap
-  I3MCPESeriesMapConstPtr outputHitMap = AddHitMaps(inputHitMap, noiseMap);
-  
-  // If no output name is given, overwrite the input hit map. 
-  if (outputHitSeriesMapName_.size() == 0) {
-    frame->Delete(inputHitSeriesMapName_);
-    frame->Put(inputHitSeriesMapName_, outputHitMap);
-  }
-  // otherwise, use the new name
-  else {
-    frame->Put(outputHitSeriesMapName_, outputHitMap);
-  }
-  
+
+  return inputHitMap;
+}
+
+/* ******************************************************************** */ 
+/* EndFrame                                                             */
+/** Moves the buffers on past the time window of the frame.
+ *//******************************************************************* */ 
+void Vuvuzela::EndFrame()
+{
   // Increment the file livetime
-  bufferTime += (stop-start);
-  
-  PushFrame(frame, "OutBox");
-  
+  bufferTime += (frameStop_ - frameStart_);
 }
 
 
@@ -323,10 +367,258 @@ void Vuvuzela::GetGoodDoms(const I3Geometry& geometry,
 
 
 
+/* ******************************************************************** */ 
+/* GetNoiseParameters                                                   */
+/** Finds the noise parameters of a DOM, either the individual ones from
+ *  the calibration or the configured ones, scaled by the scale factors.
+ *
+ *  \param calibration The I3Calibration for the file. Used to get HQE/QE status
+ *  \param dom The DOM
+ *  \returns The NoiseParameters for the DOM
+ *//******************************************************************* */ 
+Vuvuzela::NoiseParameters
+Vuvuzela::GetNoiseParameters(const I3Calibration& calibration,
+			     const OMKey& dom) const{
+
+  I3Map<OMKey,I3DOMCalibration>::const_iterator calibIter = calibration.domCal.find(dom);
+    
+  // Create the variables for this DOM
+  NoiseParameters p;
+  p.thermalRate = thermalRate_;
+  p.decayRate = decayRate_ ;
+  p.scintillationHits = scintillationHits_;
+  p.scintillationMean = scintillationMean_;
+  p.scintillationSigma = scintillationSigma_;
+	
+  // Get the values for thermal, decay, mean, sigma, and nhits
+  if (useIndividual_ && (calibIter != calibration.domCal.end())){
+    // Grab the individual DOM's parameters
+    p.thermalRate = calibIter->second.GetDomNoiseThermalRate();
+    p.decayRate = calibIter->second.GetDomNoiseDecayRate();
+    p.scintillationHits = calibIter->second.GetDomNoiseScintillationHits();
+    p.scintillationMean = calibIter->second.GetDomNoiseScintillationMean();
+    p.scintillationSigma = calibIter->second.GetDomNoiseScintillationSigma();
+      
+    // Check for NaNs
+    if ( (std::isnan(p.thermalRate) || 
+	  std::isnan(p.decayRate) ||
+	  std::isnan(p.scintillationHits) ||
+	  std::isnan(p.scintillationMean) ||
+	  std::isnan(p.scintillationSigma)) )
+      {
+	if (simulateNewDoms_){
+	  p.thermalRate = thermalRate_;
+	  p.decayRate = decayRate_ ;
+	  p.scintillationHits = scintillationHits_;
+	  p.scintillationMean = scintillationMean_;
+	  p.scintillationSigma = scintillationSigma_;
+	}
+	else{
+	  log_fatal("DOM %02i-%02i has no Vuvuzela parameters in GCD file! If you want to simply use the default values, enable SimulateNewDOMs.", 
+		    dom.GetString(),
+		    dom.GetOM());
+	}
+      }
+
+  }
+
+  // Multiply the rates (not anything else) by the scale factor.
+  p.thermalRate  *= scaleFactor_;
+  p.decayRate    *= scaleFactor_;
+
+  // For DeepCore: Scale noise for DeepCore(HQE) DOMs
+  if ( calibIter != calibration.domCal.end() && calibIter->second.GetRelativeDomEff() > 1 ){
+    p.thermalRate *= deepCoreScaleFactor_;
+    p.decayRate    *= deepCoreScaleFactor_;
+  }
+
+  return p;
+}
+
+/* ******************************************************************** */ 
+/* MakeDOMNoise                                                         */
+/** Adds the thermal and nonthermal noise of one DOM from start to stop
+ *  to its buffer, then moves the buffered hits up to stop to hitSeries.
+ *
+ *  \param random The random service to draw from
+ *  \param parameters The noise parameters of the DOM
+ *  \param buffer The time ordered buffered hit times of the DOM
+ *  \param start The time for the event to begin
+ *  \param stop The time for the event to end
+ *  \param hitSeries The series to add the hits to
+ *  \returns void
+ *//******************************************************************* */ 
+void Vuvuzela::MakeDOMNoise(I3RandomService& random,
+			    const NoiseParameters& parameters,
+			    std::vector<double>& buffer,
+			    double start, double stop,
+			    I3MCPESeries& hitSeries) const{
+
+  size_t nBuffered = buffer.size();
+
+  // Get the thermal hits
+  MakeThermalHits(random, 
+		  buffer,
+		  bufferTime,
+		  parameters.thermalRate, 
+		  start, 
+		  stop);
+    
+  // And the decay + scintillation hits
+  MakeNonThermalHits(random, 
+		     buffer,
+		     bufferTime,
+		     parameters.decayRate, 
+		     parameters.scintillationHits,
+		     parameters.scintillationMean,
+		     parameters.scintillationSigma,
+		     start, stop,
+		     disableLowDTcutoff_);
+
+  // Sort the new hits once and merge them with the buffered ones
+  std::vector<double>::iterator middle = buffer.begin() + nBuffered;
+  std::sort(middle, buffer.end());
+  std::inplace_merge(buffer.begin(), middle, buffer.end());
+
+  MoveBufferedHits(buffer, start, stop, hitSeries);
+}
+
+/* ******************************************************************** */ 
+/* MakeSerialDOMNoise                                                   */
+/** Adds the thermal and nonthermal noise of one DOM from start to stop
+ *  like MakeDOMNoise, but with the std::set versions of the hit
+ *  generators, which draw each random number from the module's random
+ *  service in turn.
+ *
+ *  \param parameters The noise parameters of the DOM
+ *  \param buffer The time ordered buffered hit times of the DOM
+ *  \param start The time for the event to begin
+ *  \param stop The time for the event to end
+ *  \param hitSeries The series to add the hits to
+ *  \returns void
+ *//******************************************************************* */ 
+void Vuvuzela::MakeSerialDOMNoise(const NoiseParameters& parameters,
+				  std::vector<double>& buffer,
+				  double start, double stop,
+				  I3MCPESeries& hitSeries) const{
+
+  std::set<double> bufferHits(buffer.begin(), buffer.end());
+
+  // Get the thermal hits
+  MakeThermalHits(randomService, 
+		  bufferHits,
+		  bufferTime,
+		  parameters.thermalRate, 
+		  start, 
+		  stop);
+    
+  // And the decay + scintillation hits
+  MakeNonThermalHits(randomService, 
+		     bufferHits,
+		     bufferTime,
+		     parameters.decayRate, 
+		     parameters.scintillationHits,
+		     parameters.scintillationMean,
+		     parameters.scintillationSigma,
+		     start, stop,
+		     disableLowDTcutoff_);
+
+  buffer.assign(bufferHits.begin(), bufferHits.end());
+  MoveBufferedHits(buffer, start, stop, hitSeries);
+}
+
+/* ******************************************************************** */ 
+/* MoveBufferedHits                                                     */
+/** Moves the buffered hits of one DOM up to stop to hitSeries.
+ *
+ *  \param buffer The time ordered buffered hit times of the DOM
+ *  \param start The time for the event to begin
+ *  \param stop The time for the event to end
+ *  \param hitSeries The series to add the hits to
+ *  \returns void
+ *//******************************************************************* */ 
+void Vuvuzela::MoveBufferedHits(std::vector<double>& buffer,
+				double start, double stop,
+				I3MCPESeries& hitSeries) const{
+
+  // Move all of the hits in the right time range to the MCPESeries
+  std::vector<double>::iterator bufferIter;
+  for (bufferIter = buffer.begin(); bufferIter != buffer.end(); ++bufferIter){
+      
+    // The time for this hit, corrected with start and buffer times
+    double hitTime = *bufferIter - bufferTime + start; 
+
+    if( hitTime > stop) break;
+      
+    // Now make an I3MCPESeries with the hits
+    I3MCPE hit;
+    hit.time = hitTime;
+    hit.npe = 1;
+    hitSeries.push_back(hit);
+  }
+  buffer.erase(buffer.begin(), bufferIter);
+}
+
+namespace {
+  // The substream number of a DOM, unique for every PMT
+  uint64_t DOMStreamID(const OMKey& dom){
+    return (uint64_t(uint32_t(dom.GetString())) << 32) | (uint64_t(dom.GetOM()) << 8) | dom.GetPMT();
+  }
+}
+
+Vuvuzela::NoiseQueue::NoiseQueue(const Vuvuzela& module,
+				 const std::vector<NoiseParameters>& parameters,
+				 std::vector<std::vector<double> >& buffers,
+				 std::vector<I3MCPESeries>& hits,
+				 double start, double stop, uint64_t seed):
+  module(module), parameters(parameters), buffers(buffers), hits(hits),
+  start(start), stop(stop), seed(seed), next(0) {}
+
+void Vuvuzela::NoiseQueue::operator()(){
+  while (true){
+    size_t index;
+    {
+      boost::lock_guard<boost::mutex> lock(mutex);
+      if (next >= hits.size() || !error.empty())
+	return;
+      index = next++;
+    }
+    try{
+      // Each DOM only touches its own buffer and series
+      I3PhiloxRandomService random(seed, DOMStreamID(module.goodDOMs[index]));
+      module.MakeDOMNoise(random, parameters[index], buffers[index],
+			  start, stop, hits[index]);
+    }
+    catch (std::exception& ex){
+      boost::lock_guard<boost::mutex> lock(mutex);
+      if (error.empty())
+	error = ex.what();
+      return;
+    }
+  }
+}
+
+/* ******************************************************************** */ 
+/* DrawSeed                                                             */
+/** Draws the 64 bit seed of the random substreams of the DOMs from the
+ *  main random service.
+ *
+ *  \returns The seed
+ *//******************************************************************* */ 
+uint64_t Vuvuzela::DrawSeed(){
+  const uint32_t maxInt = std::numeric_limits<uint32_t>::max();
+  uint64_t seed = randomService->Integer(maxInt);
+  return (seed << 32) | randomService->Integer(maxInt);
+}
+
 /* ******************************************************************** */ 
 /* GetNoiseHits                                                        */
 /** Fills the hit map with thermal and nonthermal noise
  *  for the entire period from start to stop and for each DOM.
+ *  With NumThreads = 0 the random numbers are drawn in the same order
+ *  as always. With NumThreads > 0 the DOMs are divided among threads,
+ *  each DOM drawing from its own substream in bulk into a flat buffer
+ *  which is sorted once.
  *
  *  \param calibration The I3Calibration for the file. Used to get HQE/QE status
  *  \param start The time for the event to begin
@@ -336,116 +628,80 @@ void Vuvuzela::GetGoodDoms(const I3Geometry& geometry,
 I3MCPESeriesMapConstPtr Vuvuzela::GetNoiseHits(const I3Calibration& calibration,
 					       double start, double stop){
   
-  I3MCPESeriesMap *noiseMap = new I3MCPESeriesMap();
+  I3MCPESeriesMapPtr noiseMap(new I3MCPESeriesMap());
 
+  // The parameters are looked up first, since that may fail
+  std::vector<NoiseParameters> parameters;
+  parameters.reserve(goodDOMs.size());
   std::vector<OMKey>::iterator domIter;
-  for(domIter = goodDOMs.begin(); domIter != goodDOMs.end(); ++domIter){
-    
-    OMKey dom = *domIter;
-    I3Map<OMKey,I3DOMCalibration>::const_iterator calibIter = calibration.domCal.find(dom);
-    
-    // Create the variables for this DOM
-    double currentThermalRate = thermalRate_;
-    double currentDecayRate = decayRate_ ;
-    double currentScintillationHits = scintillationHits_;
-    double currentScintillationMean = scintillationMean_;
-    double currentScintillationSigma = scintillationSigma_;
-	
-    // Get the values for thermal, decay, mean, sigma, and nhits
-    if (useIndividual_ && (calibIter != calibration.domCal.end())){
-      // Grab the individual DOM's parameters
-      currentThermalRate = calibIter->second.GetDomNoiseThermalRate();
-      currentDecayRate = calibIter->second.GetDomNoiseDecayRate();
-      currentScintillationHits = calibIter->second.GetDomNoiseScintillationHits();
-      currentScintillationMean = calibIter->second.GetDomNoiseScintillationMean();
-      currentScintillationSigma = calibIter->second.GetDomNoiseScintillationSigma();
-      
-      // Check for NaNs
-      if ( (std::isnan(currentThermalRate) || 
-	    std::isnan(currentDecayRate) ||
-	    std::isnan(currentScintillationHits) ||
-	    std::isnan(currentScintillationMean) ||
-	    std::isnan(currentScintillationSigma)) )
-	{
-	  if (simulateNewDoms_){
-	    currentThermalRate = thermalRate_;
-	    currentDecayRate = decayRate_ ;
-	    currentScintillationHits = scintillationHits_;
-	    currentScintillationMean = scintillationMean_;
-	    currentScintillationSigma = scintillationSigma_;
-	  }
-	  else{
-	    log_fatal("DOM %02i-%02i has no Vuvuzela parameters in GCD file! If you want to simply use the default values, enable SimulateNewDOMs.", 
-		      dom.GetString(),
-		      dom.GetOM());
-	  }
-	}
+  for(domIter = goodDOMs.begin(); domIter != goodDOMs.end(); ++domIter)
+    parameters.push_back(GetNoiseParameters(calibration, *domIter));
 
-    }
-
-    // Multiply the rates (not anything else) by the scale factor.
-    currentThermalRate  *= scaleFactor_;
-    currentDecayRate    *= scaleFactor_;
+  buffers_.resize(goodDOMs.size());
+  std::vector<I3MCPESeries> hits(goodDOMs.size());
 
-    // For DeepCore: Scale noise for DeepCore(HQE) DOMs
-    if (  calibIter->second.GetRelativeDomEff() > 1 ){
-      currentThermalRate *= deepCoreScaleFactor_;
-      currentDecayRate    *= deepCoreScaleFactor_;
+  if (numThreads_ == 0){
+    for (size_t i = 0; i < goodDOMs.size(); i++)
+      MakeSerialDOMNoise(parameters[i], buffers_[i], start, stop, hits[i]);
+  }
+  else{
+    // Draw one seed per call from the main service; everything else depends
+    // only on it and on the DOM, not on which thread processes which DOM
+    uint64_t seed = DrawSeed();
+
+    NoiseQueue queue(*this, parameters, buffers_, hits, start, stop, seed);
+    unsigned int nThreads = std::min<size_t>(numThreads_, goodDOMs.size());
+    if (nThreads <= 1)
+      queue();
+    else{
+      boost::thread_group threads;
+      for (unsigned int i = 0; i < nThreads; i++)
+	threads.create_thread(boost::ref(queue));
+      threads.join_all();
     }
+    if (!queue.error.empty())
+      log_fatal("Generating noise failed: %s", queue.error.c_str());
+  }
 
-    // Grab the buffer for this DOM
-    std::set<double> bufferHits;
-    if( !firstTime )
-      bufferHits = bufferMap[dom];
-
-    // Get the thermal hits
-    MakeThermalHits(randomService, 
-		    bufferHits,
-		    bufferTime,
-		    currentThermalRate, 
-		    start, 
-		    stop);
-    
-    // And the decay + scintillation hits
-    MakeNonThermalHits(randomService, 
-    		       bufferHits,
-		       bufferTime,
-		       currentDecayRate, 
-		       currentScintillationHits,
-		       currentScintillationMean,
-		       currentScintillationSigma,
-		       start, stop,
-		       disableLowDTcutoff_);
-
-    // At this point, the buffer is sorted so that we can pop_back with amortized O(1) time
-    // Pop all of the hits in the right time range to the MCPESeries
-    I3MCPESeries hitSeries;
-    while(!bufferHits.empty()){
-      
-      // The time for this hit, corrected with start and buffer times
-      double hitTime = *(bufferHits.begin()) - bufferTime + start; 
-
-      if( hitTime > stop) break;
-      
-      // Now make an I3MCPESeries with the hits
-      I3MCPE hit;
-      hit.time = hitTime;
-      hit.npe = 1;
-      hitSeries.push_back(hit);
-
-      // Increment the hit counter and remove the hit
-      nhits++;
-      bufferHits.erase(bufferHits.begin());
-    }
-    
-    // Add the hit series to the map and save the buffer
-    if(hitSeries.size() > 0) (*noiseMap)[dom] = hitSeries;
-    bufferMap[dom] = bufferHits;
+  // Add the hit series to the map; goodDOMs are in OMKey order
+  for (size_t i = 0; i < goodDOMs.size(); i++){
+    if (hits[i].empty()) continue;
+    nhits += hits[i].size();
+    noiseMap->insert(noiseMap->end(), std::make_pair(goodDOMs[i], I3MCPESeries()))->second.swap(hits[i]);
   }
   
-  I3MCPESeriesMapConstPtr hitMapPtr(noiseMap);
-  return hitMapPtr;
+  return noiseMap;
+
+}
+
+/* ******************************************************************** */ 
+/* AddDOMNoise                                                          */
+/** Merges the noise of one of the good DOMs in the window of the frame
+ *  into hitSeries. Called for each of the good DOMs in turn, this draws
+ *  the same random numbers and gives the same hits as GetNoiseHits, but
+ *  lets the caller go on with each DOM before the next one is simulated.
+ *
+ *  \param index The index of the DOM in GetGoodDOMs()
+ *  \param hitSeries The time ordered hits of the DOM to add the noise to
+ *  \returns void
+ *//******************************************************************* */ 
+void Vuvuzela::AddDOMNoise(size_t index, I3MCPESeries& hitSeries){
+
+  NoiseParameters parameters = GetNoiseParameters(*calibration_, goodDOMs[index]);
+
+  noiseHits_.clear();
+  if (numThreads_ == 0)
+    MakeSerialDOMNoise(parameters, buffers_[index], frameStart_, frameStop_, noiseHits_);
+  else{
+    // GetNoiseHits draws the seed for all DOMs at once
+    if (index == 0)
+      frameSeed_ = DrawSeed();
+    I3PhiloxRandomService random(frameSeed_, DOMStreamID(goodDOMs[index]));
+    MakeDOMNoise(random, parameters, buffers_[index], frameStart_, frameStop_, noiseHits_);
+  }
 
+  nhits += noiseHits_.size();
+  MergeHitSeries(hitSeries, noiseHits_);
 }
 
 I3_MODULE(Vuvuzela);
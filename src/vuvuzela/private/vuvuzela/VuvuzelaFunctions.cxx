@@ -106,6 +106,101 @@ void MakeThermalHits(I3RandomServicePtr random,
   return;
 }
 
+/* ******************************************************************** */ 
+/* MakeNonThermalHits                                                   */
+/** The same as the std::set version, except that the hit times are
+ *  appended to buffer without sorting and that the random numbers are
+ *  drawn in bulk: first the times of all decays, then the number of hits
+ *  of each, then the normal deviates of all of these hits.
+ *
+ *  \param random A random service
+ *  \param buffer The vector the hit times are appended to
+ *  (The other parameters are the same as for the std::set version.)
+ *  \returns void
+ *//******************************************************************* */ 
+void MakeNonThermalHits(I3RandomService& random,
+                        std::vector<double>& buffer,
+                        const double bufferTime,
+                        const double decayRate,
+                        const double nHits,
+                        const double mean,
+                        const double sigma,
+                        const double start,
+                        const double stop,
+			bool disableCutoff)
+{
+  int nClusters = random.Poisson(fabs(stop-start) * decayRate);
+  if (nClusters <= 0)
+    return;
+
+  // The first hit of the clusters is uniformly distributed in time
+  std::vector<double> clusterTimes(nClusters);
+  random.FillUniform(&clusterTimes[0], nClusters, 0, stop-start);
+
+  // The number of hits of each cluster is drawn from a Poisson distribution
+  std::vector<int> clusterHits(nClusters);
+  random.FillPoisson(&clusterHits[0], nClusters, nHits);
+  size_t totalHits = std::accumulate(clusterHits.begin(), clusterHits.end(), size_t(0));
+
+  // The lognormal time differences of all the hits
+  std::vector<double> deltaTs(totalHits);
+  if (totalHits > 0)
+    random.FillGaus(&deltaTs[0], totalHits, 0, 1);
+  for (size_t j=0; j < totalHits; j++)
+    deltaTs[j] = pow(10, mean + sigma*deltaTs[j]);
+
+  buffer.reserve(buffer.size() + nClusters + totalHits);
+  std::vector<double>::iterator dtIter = deltaTs.begin();
+  for (int i=0; i < nClusters; i++){
+    // We want to keep the current time in the event
+    double currentTime = bufferTime + clusterTimes[i];
+    buffer.push_back(currentTime);
+
+    std::vector<double>::iterator dtEnd = dtIter + clusterHits[i];
+    if (dtIter == dtEnd) continue;
+    std::sort(dtIter, dtEnd);
+
+    double hitTime = *dtIter * 2 + currentTime;
+    for(; dtIter != dtEnd; ++dtIter){
+      // Truncate the distribution?
+      if (!disableCutoff)
+	if (*dtIter < 2*I3Units::microsecond) continue;
+
+      buffer.push_back(hitTime);
+      hitTime += (*dtIter);
+    }
+  }
+}
+
+/* ******************************************************************** */ 
+/* MakeThermalHits                                                      */
+/** The same as the std::set version, except that the hit times are
+ *  appended to buffer without sorting and that the random numbers are
+ *  drawn in bulk.
+ *
+ *  \param random A random service
+ *  \param buffer The vector the hit times are appended to
+ *  (The other parameters are the same as for the std::set version.)
+ *  \returns void
+ *//******************************************************************* */ 
+void MakeThermalHits(I3RandomService& random,
+		     std::vector<double>& buffer,
+		     const double bufferTime,
+		     const double rate, 
+		     const double start, 
+		     const double stop){
+
+  int nhits = random.Poisson(fabs(stop-start)*rate);
+  if (nhits <= 0)
+    return;
+
+  size_t first = buffer.size();
+  buffer.resize(first + nhits);
+  random.FillUniform(&buffer[first], nhits, 0, stop-start);
+  for (size_t i=first; i < buffer.size(); i++)
+    buffer[i] += bufferTime;
+}
+
 /* ******************************************************************** */ 
 /* GetTimeRange                                                         */
 /** Reads the hit map to find the time of the first and last hits.
@@ -158,7 +253,7 @@ bool CompareMCPEs(const I3MCPE& lhs, const I3MCPE& rhs){
 
 /* ******************************************************************** */ 
 /* AddHitSeries                                                        */
-/** Merges two I3MCPEMaps. Shamelessly stolen wholesale from noise-generator.
+/** Merges two I3MCPEMaps into a new map.
  *
  *  \param firstterm The input hit map from the frame
  *  \param secondterm The noise hit map produced by Vuvuzela
@@ -166,30 +261,65 @@ bool CompareMCPEs(const I3MCPE& lhs, const I3MCPE& rhs){
  *//******************************************************************* */ 
 I3MCPESeriesMapConstPtr AddHitMaps(I3MCPESeriesMapConstPtr firstterm, I3MCPESeriesMapConstPtr secondterm){
   I3MCPESeriesMapPtr lhs(new I3MCPESeriesMap(*firstterm));
+  MergeHitMaps(*lhs, *secondterm);
+  return I3MCPESeriesMapConstPtr(lhs);
+}
+
+namespace {
+  bool IsTimeOrdered(I3MCPESeries::const_iterator begin, I3MCPESeries::const_iterator end){
+    for (; begin != end && begin+1 != end; ++begin)
+      if (CompareMCPEs(*(begin+1), *begin)) return false;
+    return true;
+  }
+}
+
+/* ******************************************************************** */ 
+/* MergeHitSeries                                                       */
+/** Merges the hits of the second series into the first one in place.
+ *  Where both series are already time ordered, as the noise from
+ *  Vuvuzela is, they are merged rather than sorted again.
+ *
+ *  \param hits The hit series to add to
+ *  \param noise The hits to add
+ *  \returns void
+ *//******************************************************************* */ 
+void MergeHitSeries(I3MCPESeries& hits, const I3MCPESeries& noise){
+  if (noise.empty()) return;
+
+  // Add the noise hits after the prexisting ones and merge
+  size_t nOld = hits.size();
+  hits.insert(hits.end(), noise.begin(), noise.end());
+  I3MCPESeries::iterator middle = hits.begin() + nOld;
+  if (IsTimeOrdered(hits.begin(), middle) && IsTimeOrdered(middle, hits.end()))
+    std::inplace_merge(hits.begin(), middle, hits.end(), CompareMCPEs);
+  else
+    sort(hits.begin(), hits.end(), CompareMCPEs);
+}
+
+/* ******************************************************************** */ 
+/* MergeHitMaps                                                         */
+/** Merges the hits of the second map into the first one in place, DOM
+ *  by DOM with MergeHitSeries.
+ *
+ *  \param hits The hit map to add to
+ *  \param noise The hits to add
+ *  \returns void
+ *//******************************************************************* */ 
+void MergeHitMaps(I3MCPESeriesMap& hits, const I3MCPESeriesMap& noise){
   I3MCPESeriesMap::const_iterator iter;
 
   // Loop over the noise hits
-  for(iter = secondterm->begin(); iter != secondterm->end(); ++iter){
-    // If there are prexisting hits on that DOM, then save those first
+  for(iter = noise.begin(); iter != noise.end(); ++iter){
+    if (iter->second.empty()) continue;
+
     const OMKey& dom = iter->first;
-    I3MCPESeriesMap::const_iterator keyVectPair = lhs->find(dom);
-    if(keyVectPair != lhs->end()){
-      I3MCPESeries newHS = keyVectPair->second;
-      const I3MCPESeries& hs = iter->second;
-      I3MCPESeries::const_iterator hsIter;
-      assert(!iter->second.empty());
-      // Then add each of the noise hits. Could be done with STL copy too.
-      for(hsIter = hs.begin(); hsIter != hs.end(); ++hsIter) 
-        newHS.push_back(*hsIter); 
-
-      // Sort the hit series
-      sort(newHS.begin(), newHS.end(), CompareMCPEs);
-      (*lhs)[dom] = newHS;
-    }
+    I3MCPESeriesMap::iterator keyVectPair = hits.lower_bound(dom);
     // If there weren't any prexisting hits, just copy the noise hits
-    else if (!iter->second.empty()){
-      (*lhs)[dom] = iter->second;
+    if (keyVectPair == hits.end() || keyVectPair->first != dom){
+      hits.insert(keyVectPair, std::make_pair(dom, iter->second));
+      continue;
     }
+
+    MergeHitSeries(keyVectPair->second, iter->second);
   }
-  return I3MCPESeriesMapConstPtr(lhs);
 }
@@ -28,6 +28,8 @@
 
 #include "phys-services/I3RandomService.h"
 
+#include <boost/thread/mutex.hpp>
+
 #include "vuvuzela/VuvuzelaFunctions.h"
 
 /**
@@ -72,9 +74,112 @@ class Vuvuzela : public I3Module
     I3MCPESeriesMapConstPtr GetNoiseHits(const I3Calibration& calibration,
 					  double start, double stop);
 
+    /**
+     * \brief BeginFrame: Find the noise window of a frame, as DAQ does, and
+     *  return its input hit map. AddDOMNoise is then called for each of the
+     *  good DOMs in order, followed by EndFrame.
+     */
+    I3MCPESeriesMapConstPtr BeginFrame(I3FramePtr frame);
+
+    /**
+     * \brief GetGoodDOMs: The DOMs to simulate, in OMKey order
+     */
+    const std::vector<OMKey>& GetGoodDOMs() const { return goodDOMs; }
+
+    /**
+     * \brief AddDOMNoise: Merge the noise of one good DOM in the window of
+     *  the frame into its hits
+     */
+    void AddDOMNoise(size_t index, I3MCPESeries& hitSeries);
+
+    /**
+     * \brief EndFrame: Move the noise buffers on past the frame
+     */
+    void EndFrame();
+
 
  private:
 
+    /**
+     * \brief The noise parameters of one DOM
+     */
+    struct NoiseParameters{
+      double thermalRate;
+      double decayRate;
+      double scintillationHits;
+      double scintillationMean;
+      double scintillationSigma;
+    };
+
+    /**
+     * \brief GetNoiseParameters: The noise parameters to use for a DOM
+     */
+    NoiseParameters GetNoiseParameters(const I3Calibration& calibration,
+				       const OMKey& dom) const;
+
+    /**
+     * \brief DrawSeed: Draw the seed of the DOM substreams of one call
+     */
+    uint64_t DrawSeed();
+
+    /**
+     * \brief MakeDOMNoise: Adds the noise of one DOM from start to stop to
+     *  its buffer and moves the buffered hits up to stop to hitSeries. This
+     *  only touches the given buffer and series, so it may be called for
+     *  different DOMs concurrently.
+     */
+    void MakeDOMNoise(I3RandomService& random,
+		      const NoiseParameters& parameters,
+		      std::vector<double>& buffer,
+		      double start, double stop,
+		      I3MCPESeries& hitSeries) const;
+
+    /**
+     * \brief MakeSerialDOMNoise: As MakeDOMNoise, but draws the random
+     *  numbers from the random service one at a time, in the order Vuvuzela
+     *  always has. A given seed then gives the same noise as before the hits
+     *  were generated in bulk.
+     */
+    void MakeSerialDOMNoise(const NoiseParameters& parameters,
+			    std::vector<double>& buffer,
+			    double start, double stop,
+			    I3MCPESeries& hitSeries) const;
+
+    /**
+     * \brief MoveBufferedHits: Moves the time ordered buffered hits up to
+     *  stop from the buffer to hitSeries.
+     */
+    void MoveBufferedHits(std::vector<double>& buffer,
+			  double start, double stop,
+			  I3MCPESeries& hitSeries) const;
+
+    /**
+     * \brief Hands out the DOMs to worker threads, one at a time
+     */
+    struct NoiseQueue{
+      const Vuvuzela& module;
+      const std::vector<NoiseParameters>& parameters;
+      std::vector<std::vector<double> >& buffers;
+      std::vector<I3MCPESeries>& hits;
+      double start, stop;
+      // The seed for the random substreams of all DOMs in this call
+      const uint64_t seed;
+      // The index of the next DOM to process
+      size_t next;
+      // The message of the first exception thrown by any worker
+      std::string error;
+      boost::mutex mutex;
+
+      NoiseQueue(const Vuvuzela& module,
+		 const std::vector<NoiseParameters>& parameters,
+		 std::vector<std::vector<double> >& buffers,
+		 std::vector<I3MCPESeries>& hits,
+		 double start, double stop, uint64_t seed);
+      // Processes DOMs until none are left
+      void operator()();
+    };
+
+
     // Option variables
     std::string inputHitSeriesMapName_;
     std::string outputHitSeriesMapName_;
@@ -101,10 +206,21 @@ class Vuvuzela : public I3Module
     double scintillationSigma_;
     double scintillationHits_; 
 
+    unsigned int numThreads_;
+
     // Runtime variables
     I3RandomServicePtr randomService;
     std::string randomServiceName_;
-    I3Map<OMKey, std::set<double> > bufferMap;
+    // The time ordered buffered hit times of each of the goodDOMs
+    std::vector<std::vector<double> > buffers_;
+    // The calibration and noise window of the current frame
+    I3CalibrationConstPtr calibration_;
+    double frameStart_;
+    double frameStop_;
+    // The seed of the DOM substreams of the current frame, with NumThreads > 0
+    uint64_t frameSeed_;
+    // The noise of the DOM being added by AddDOMNoise
+    I3MCPESeries noiseHits_;
 
     bool firstTime;
     int nhits;
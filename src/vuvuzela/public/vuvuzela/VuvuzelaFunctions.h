@@ -15,6 +15,7 @@
 #include <functional>
 #include <numeric>
 #include <set>
+#include <vector>
 #include <math.h>
 
 #include "simclasses/I3MCPE.h"
@@ -52,6 +53,34 @@ void MakeThermalHits(I3RandomServicePtr random,
 		     const double start, 
 		     const double stop);
 
+/* ******************************************************************** */ 
+/* MakeNonThermalHits                                                   */
+/** \brief As above, but appends the hit times to a vector, unsorted, and
+ * draws the random numbers in bulk.
+ *//******************************************************************* */ 
+void MakeNonThermalHits(I3RandomService& random,
+			std::vector<double>& buffer,
+			const double bufferTime,
+			const double rate, 
+			const double index, 
+			const double mean, 
+			const double sigma,
+			const double start, 
+			const double stop,
+			bool disableCutoff);
+
+/* ******************************************************************** */ 
+/* MakeThermalHits                                                      */
+/** \brief As above, but appends the hit times to a vector, unsorted, and
+ * draws the random numbers in bulk.
+ *//******************************************************************* */ 
+void MakeThermalHits(I3RandomService& random,
+		     std::vector<double>& buffer,
+		     const double bufferTime,
+		     const double rate, 
+		     const double start, 
+		     const double stop);
+
 /* ******************************************************************** */ 
 /* GetTimeRange                                                         */
 /** \brief Reads the hit map to find the time of the first and last hits.
@@ -74,4 +103,16 @@ bool CompareMCPEs(const I3MCPE& lhs, const I3MCPE& rhs);
 I3MCPESeriesMapConstPtr AddHitMaps(I3MCPESeriesMapConstPtr firstterm,
                                     I3MCPESeriesMapConstPtr secondterm);
 
+/* ******************************************************************** */ 
+/* MergeHitSeries                                                       */
+/** \brief Merges the hits of the second series into the first one in place.
+*//******************************************************************* */ 
+void MergeHitSeries(I3MCPESeries& hits, const I3MCPESeries& noise);
+
+/* ******************************************************************** */ 
+/* MergeHitMaps                                                         */
+/** \brief Merges the hits of the second map into the first one in place.
+*//******************************************************************* */ 
+void MergeHitMaps(I3MCPESeriesMap& hits, const I3MCPESeriesMap& noise);
+
 #endif